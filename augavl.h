@@ -0,0 +1,405 @@
+#ifndef AUGAVL_H
+#define AUGAVL_H
+
+#include <iostream>
+#include <exception>
+#include <cstdlib>
+#include <algorithm>
+#include <limits>
+#include "avlbst.h"
+
+/*
+ * A Monoid for AugmentedAVLTree supplies the aggregate type and three
+ * static functions:
+ *
+ *     typedef ... value_type;
+ *     static value_type identity();
+ *     static value_type lift(const Key& key, const Value& value);
+ *     static value_type combine(const value_type& a, const value_type& b);
+ *
+ * combine must be associative and identity neutral on both sides. It
+ * need not be commutative: items are always combined in key order.
+ */
+
+/**
+* Sum of the values.
+*/
+template <typename Value>
+struct SumMonoid
+{
+    typedef Value value_type;
+    static Value identity() { return Value(); }
+    template <typename Key>
+    static Value lift(const Key&, const Value& value) { return value; }
+    static Value combine(const Value& a, const Value& b) { return a + b; }
+};
+
+/**
+* Smallest value; the identity is the largest representable one.
+*/
+template <typename Value>
+struct MinMonoid
+{
+    typedef Value value_type;
+    static Value identity() { return std::numeric_limits<Value>::max(); }
+    template <typename Key>
+    static Value lift(const Key&, const Value& value) { return value; }
+    static Value combine(const Value& a, const Value& b) { return std::min(a, b); }
+};
+
+/**
+* Largest value; the identity is the lowest representable one.
+*/
+template <typename Value>
+struct MaxMonoid
+{
+    typedef Value value_type;
+    static Value identity() { return std::numeric_limits<Value>::lowest(); }
+    template <typename Key>
+    static Value lift(const Key&, const Value& value) { return value; }
+    static Value combine(const Value& a, const Value& b) { return std::max(a, b); }
+};
+
+/**
+* An AVLNode that also stores the aggregate of its subtree.
+*/
+template <typename Key, typename Value, typename Monoid>
+class AugmentedAVLNode : public AVLNode<Key, Value>
+{
+public:
+    typedef typename Monoid::value_type Aggregate;
+
+    AugmentedAVLNode(const Key& key, const Value& value, AVLNode<Key, Value>* parent);
+    virtual ~AugmentedAVLNode();
+
+    const Aggregate& getAggregate() const;
+    void setAggregate(const Aggregate& aggregate);
+
+    virtual Node<Key, Value>* cloneAt(void* mem, Node<Key, Value>* parent) const override;
+    virtual size_t allocationSize() const override;
+
+protected:
+    Aggregate aggregate_;
+};
+
+template<class Key, class Value, class Monoid>
+AugmentedAVLNode<Key, Value, Monoid>::AugmentedAVLNode(const Key& key, const Value& value,
+                                                       AVLNode<Key, Value>* parent)
+    : AVLNode<Key, Value>(key, value, parent), aggregate_(Monoid::lift(key, value))
+{
+
+}
+
+template<class Key, class Value, class Monoid>
+AugmentedAVLNode<Key, Value, Monoid>::~AugmentedAVLNode()
+{
+
+}
+
+template<class Key, class Value, class Monoid>
+const typename Monoid::value_type& AugmentedAVLNode<Key, Value, Monoid>::getAggregate() const
+{
+    return aggregate_;
+}
+
+template<class Key, class Value, class Monoid>
+void AugmentedAVLNode<Key, Value, Monoid>::setAggregate(const Aggregate& aggregate)
+{
+    aggregate_ = aggregate;
+}
+
+/**
+* Copies the node, balance and aggregate included.
+*/
+template<class Key, class Value, class Monoid>
+Node<Key, Value>* AugmentedAVLNode<Key, Value, Monoid>::cloneAt(void* mem, Node<Key, Value>* parent) const
+{
+    AugmentedAVLNode<Key, Value, Monoid>* copy =
+        new (mem) AugmentedAVLNode<Key, Value, Monoid>(this->getKey(), this->getValue(),
+                                                        static_cast<AVLNode<Key, Value>*>(parent));
+    copy->setTags(this->getTags());
+    copy->setBalance(this->getBalance());
+    copy->aggregate_ = aggregate_;
+    return copy;
+}
+
+template<class Key, class Value, class Monoid>
+size_t AugmentedAVLNode<Key, Value, Monoid>::allocationSize() const
+{
+    return sizeof(AugmentedAVLNode<Key, Value, Monoid>);
+}
+
+/**
+* An AVLTree whose nodes carry the Monoid aggregate of their subtree, so
+* that reduce(lo, hi) combines the items in any key range in O(log n)
+* instead of walking the range.
+*
+* Aggregates follow every change made through the tree: inserts and
+* value overwrites, removals (eager or tombstoned), node swaps,
+* rotations and rebuilds. A value changed in place through an iterator
+* or operator[] is not seen; write it back with insert instead.
+*/
+template <typename Key, typename Value, typename Monoid, typename Compare = std::less<Key> >
+class AugmentedAVLTree : public AVLTree<Key, Value, Compare>
+{
+public:
+    typedef typename Monoid::value_type Aggregate;
+    typedef AugmentedAVLNode<Key, Value, Monoid> NodeType;
+
+    virtual void remove(const Key& key);
+
+    // Combines the items with lo <= key < hi, in key order.
+    Aggregate reduce(const Key& lo, const Key& hi) const;
+    // Combines every item in the tree.
+    Aggregate reduce() const;
+
+protected:
+    virtual Node<Key, Value>* insertNear(Node<Key, Value>* finger, const std::pair<const Key, Value>& new_item);
+    virtual void removeNode(Node<Key, Value>* node);
+    virtual AVLNode<Key, Value>* createNode(const Key& key, const Value& value, AVLNode<Key, Value>* parent);
+    virtual void nodeSwap(AVLNode<Key, Value>* n1, AVLNode<Key, Value>* n2);
+    virtual void rotated(Node<Key, Value>* lowered);
+    virtual void rebuildFix(Node<Key, Value>* subtree);
+    virtual Node<Key, Value>* join(Node<Key, Value>* left, int leftRank, Node<Key, Value>* mid,
+                                   Node<Key, Value>* right, int rightRank, int& rank);
+
+    static Aggregate own(const NodeType* node);
+    static Aggregate aggregateOf(const NodeType* node);
+    static void recompute(NodeType* node);
+    static void recomputeAll(NodeType* node);
+    static void recomputeUp(NodeType* node);
+};
+
+/**
+* The node's own contribution: tombstones count as empty.
+*/
+template<class Key, class Value, class Monoid, class Compare>
+typename Monoid::value_type AugmentedAVLTree<Key, Value, Monoid, Compare>::own(const NodeType* node)
+{
+    return node->isDead() ? Monoid::identity() : Monoid::lift(node->getKey(), node->getValue());
+}
+
+template<class Key, class Value, class Monoid, class Compare>
+typename Monoid::value_type AugmentedAVLTree<Key, Value, Monoid, Compare>::aggregateOf(const NodeType* node)
+{
+    return node == NULL ? Monoid::identity() : node->getAggregate();
+}
+
+/**
+* Recomputes node's aggregate from its children's.
+*/
+template<class Key, class Value, class Monoid, class Compare>
+void AugmentedAVLTree<Key, Value, Monoid, Compare>::recompute(NodeType* node)
+{
+    node->setAggregate(Monoid::combine(Monoid::combine(aggregateOf(static_cast<NodeType*>(node->getLeft())),
+                                                       own(node)),
+                                       aggregateOf(static_cast<NodeType*>(node->getRight()))));
+}
+
+/**
+* Recomputes every aggregate in the subtree at node, bottom up.
+*/
+template<class Key, class Value, class Monoid, class Compare>
+void AugmentedAVLTree<Key, Value, Monoid, Compare>::recomputeAll(NodeType* node)
+{
+    if(node == NULL)
+    {
+        return;
+    }
+    recomputeAll(static_cast<NodeType*>(node->getLeft()));
+    recomputeAll(static_cast<NodeType*>(node->getRight()));
+    recompute(node);
+}
+
+/**
+* Recomputes node and each of its ancestors.
+*/
+template<class Key, class Value, class Monoid, class Compare>
+void AugmentedAVLTree<Key, Value, Monoid, Compare>::recomputeUp(NodeType* node)
+{
+    for(; node != NULL; node = static_cast<NodeType*>(node->getParent()))
+    {
+        recompute(node);
+    }
+}
+
+/**
+* Inserts as AVLTree does, then refreshes the path from the new,
+* overwritten or revived node to the root. Nodes that rotations moved
+* off that path were refreshed by rotated.
+*/
+template<class Key, class Value, class Monoid, class Compare>
+Node<Key, Value>* AugmentedAVLTree<Key, Value, Monoid, Compare>::insertNear(Node<Key, Value>* finger,
+                                                                   const std::pair<const Key, Value>& new_item)
+{
+    Node<Key, Value>* node = AVLTree<Key, Value, Compare>::insertNear(finger, new_item);
+    recomputeUp(static_cast<NodeType*>(node));
+    return node;
+}
+
+/**
+* Marking a node dead changes the aggregates on its path, so a lazy
+* remove refreshes them; an unlinking remove goes through removeNode.
+*/
+template<class Key, class Value, class Monoid, class Compare>
+void AugmentedAVLTree<Key, Value, Monoid, Compare>::remove(const Key& key)
+{
+    if(!this->tombstones_)
+    {
+        AVLTree<Key, Value, Compare>::remove(key);
+        return;
+    }
+    NodeType* node = static_cast<NodeType*>(this->internalFind(key));
+    if(node == NULL)
+    {
+        return;
+    }
+    AVLTree<Key, Value, Compare>::remove(key);
+    if(this->dead_ != 0)
+    {
+        // not compacted away, so node is still linked
+        recomputeUp(node);
+    }
+}
+
+/**
+* Removes as AVLTree does, then refreshes the path from the spliced-out
+* node's parent to the root. That parent is found beforehand: with two
+* children the node first trades places with its predecessor.
+*/
+template<class Key, class Value, class Monoid, class Compare>
+void AugmentedAVLTree<Key, Value, Monoid, Compare>::removeNode(Node<Key, Value>* node)
+{
+    NodeType* start = static_cast<NodeType*>(node->getParent());
+    if(node->getLeft() != NULL && node->getRight() != NULL)
+    {
+        Node<Key, Value>* pred = this->predecessor(node);
+        start = static_cast<NodeType*>(pred->getParent() == node ? pred : pred->getParent());
+    }
+    AVLTree<Key, Value, Compare>::removeNode(node);
+    recomputeUp(start);
+}
+
+/**
+* Joins as AVLTree does, then refreshes the path from mid, whose
+* children are new, to the root of the joined tree.
+*/
+template<class Key, class Value, class Monoid, class Compare>
+Node<Key, Value>* AugmentedAVLTree<Key, Value, Monoid, Compare>::join(Node<Key, Value>* left, int leftRank,
+                                                                      Node<Key, Value>* mid, Node<Key, Value>* right,
+                                                                      int rightRank, int& rank)
+{
+    Node<Key, Value>* top = AVLTree<Key, Value, Compare>::join(left, leftRank, mid, right, rightRank, rank);
+    recomputeUp(static_cast<NodeType*>(mid));
+    return top;
+}
+
+template<class Key, class Value, class Monoid, class Compare>
+AVLNode<Key, Value>* AugmentedAVLTree<Key, Value, Monoid, Compare>::createNode(const Key& key, const Value& value,
+                                                                      AVLNode<Key, Value>* parent)
+{
+    return new NodeType(key, value, parent);
+}
+
+/**
+* Swapped nodes trade positions, so they trade subtree aggregates too.
+*/
+template<class Key, class Value, class Monoid, class Compare>
+void AugmentedAVLTree<Key, Value, Monoid, Compare>::nodeSwap(AVLNode<Key, Value>* n1, AVLNode<Key, Value>* n2)
+{
+    AVLTree<Key, Value, Compare>::nodeSwap(n1, n2);
+    NodeType* a = static_cast<NodeType*>(n1);
+    NodeType* b = static_cast<NodeType*>(n2);
+    Aggregate temp = a->getAggregate();
+    a->setAggregate(b->getAggregate());
+    b->setAggregate(temp);
+}
+
+/**
+* A rotation changes the subtrees of only the lowered node and the
+* child that took its place.
+*/
+template<class Key, class Value, class Monoid, class Compare>
+void AugmentedAVLTree<Key, Value, Monoid, Compare>::rotated(Node<Key, Value>* lowered)
+{
+    recompute(static_cast<NodeType*>(lowered));
+    recompute(static_cast<NodeType*>(lowered->getParent()));
+}
+
+template<class Key, class Value, class Monoid, class Compare>
+void AugmentedAVLTree<Key, Value, Monoid, Compare>::rebuildFix(Node<Key, Value>* subtree)
+{
+    AVLTree<Key, Value, Compare>::rebuildFix(subtree);
+    recomputeAll(static_cast<NodeType*>(subtree));
+    recomputeUp(static_cast<NodeType*>(subtree->getParent()));
+}
+
+/**
+* Descends to the highest node inside [lo, hi), then follows the two
+* boundary paths below it. On the left path every node at or above lo
+* contributes itself and its right subtree whole; the right path
+* mirrors that, so at most two nodes per level are combined.
+*/
+template<class Key, class Value, class Monoid, class Compare>
+typename Monoid::value_type AugmentedAVLTree<Key, Value, Monoid, Compare>::reduce(const Key& lo, const Key& hi) const
+{
+    const NodeType* split = static_cast<NodeType*>(this->root_);
+    while(split != NULL)
+    {
+        if(this->comp_(split->getKey(), lo))
+        {
+            split = static_cast<NodeType*>(split->getRight());
+        }
+        else if(!this->comp_(split->getKey(), hi))
+        {
+            split = static_cast<NodeType*>(split->getLeft());
+        }
+        else
+        {
+            break;
+        }
+    }
+    if(split == NULL)
+    {
+        return Monoid::identity();
+    }
+
+    Aggregate left = Monoid::identity();
+    for(const NodeType* n = static_cast<NodeType*>(split->getLeft()); n != NULL; )
+    {
+        if(this->comp_(n->getKey(), lo))
+        {
+            n = static_cast<NodeType*>(n->getRight());
+        }
+        else
+        {
+            left = Monoid::combine(Monoid::combine(own(n), aggregateOf(static_cast<NodeType*>(n->getRight()))),
+                                   left);
+            n = static_cast<NodeType*>(n->getLeft());
+        }
+    }
+
+    Aggregate right = Monoid::identity();
+    for(const NodeType* n = static_cast<NodeType*>(split->getRight()); n != NULL; )
+    {
+        if(this->comp_(n->getKey(), hi))
+        {
+            right = Monoid::combine(right, Monoid::combine(aggregateOf(static_cast<NodeType*>(n->getLeft())),
+                                                           own(n)));
+            n = static_cast<NodeType*>(n->getRight());
+        }
+        else
+        {
+            n = static_cast<NodeType*>(n->getLeft());
+        }
+    }
+    return Monoid::combine(Monoid::combine(left, own(split)), right);
+}
+
+template<class Key, class Value, class Monoid, class Compare>
+typename Monoid::value_type AugmentedAVLTree<Key, Value, Monoid, Compare>::reduce() const
+{
+    return aggregateOf(static_cast<NodeType*>(this->root_));
+}
+
+#endif
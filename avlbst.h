@@ -1,5 +1,5 @@
-#ifndef RBBST_H
-#define RBBST_H
+#ifndef AVLBST_H
+#define AVLBST_H
 
 #include <iostream>
 #include <exception>
@@ -23,7 +23,7 @@ public:
     AVLNode(const Key& key, const Value& value, AVLNode<Key, Value>* parent);
     virtual ~AVLNode();
 
-    // Getter/setter for the node's height.
+    // Getter/setter for the node's balance, which is always -1, 0 or +1.
     int8_t getBalance () const;
     void setBalance (int8_t balance);
     void updateBalance(int8_t diff);
@@ -35,8 +35,9 @@ public:
     virtual AVLNode<Key, Value>* getLeft() const override;
     virtual AVLNode<Key, Value>* getRight() const override;
 
-protected:
-    int8_t balance_;    // effectively a signed char
+    virtual Node<Key, Value>* cloneAt(void* mem, Node<Key, Value>* parent) const override;
+    virtual size_t allocationSize() const override;
+
 };
 
 /*
@@ -51,7 +52,7 @@ protected:
 */
 template<class Key, class Value>
 AVLNode<Key, Value>::AVLNode(const Key& key, const Value& value, AVLNode<Key, Value> *parent) :
-    Node<Key, Value>(key, value, parent), balance_(0)
+    Node<Key, Value>(key, value, parent)
 {
 
 }
@@ -66,12 +67,15 @@ AVLNode<Key, Value>::~AVLNode()
 }
 
 /**
-* A getter for the balance of a AVLNode.
+* A getter for the balance of a AVLNode. The balance takes no space of
+* its own: the child pointer's flag on the taller side is set, so the
+* node is no bigger than a plain Node.
 */
 template<class Key, class Value>
 int8_t AVLNode<Key, Value>::getBalance() const
 {
-    return balance_;
+    uintptr_t tags = this->getChildTags();
+    return (int8_t)((int)(tags >> 1) - (int)(tags & 1));
 }
 
 /**
@@ -80,7 +84,7 @@ int8_t AVLNode<Key, Value>::getBalance() const
 template<class Key, class Value>
 void AVLNode<Key, Value>::setBalance(int8_t balance)
 {
-    balance_ = balance;
+    this->setChildTags(balance < 0 ? 1 : (balance > 0 ? 2 : 0));
 }
 
 /**
@@ -89,7 +93,7 @@ void AVLNode<Key, Value>::setBalance(int8_t balance)
 template<class Key, class Value>
 void AVLNode<Key, Value>::updateBalance(int8_t diff)
 {
-    balance_ += diff;
+    setBalance((int8_t)(getBalance() + diff));
 }
 
 /**
@@ -99,7 +103,7 @@ void AVLNode<Key, Value>::updateBalance(int8_t diff)
 template<class Key, class Value>
 AVLNode<Key, Value> *AVLNode<Key, Value>::getParent() const
 {
-    return static_cast<AVLNode<Key, Value>*>(this->parent_);
+    return static_cast<AVLNode<Key, Value>*>(Node<Key, Value>::getParent());
 }
 
 /**
@@ -108,7 +112,7 @@ AVLNode<Key, Value> *AVLNode<Key, Value>::getParent() const
 template<class Key, class Value>
 AVLNode<Key, Value> *AVLNode<Key, Value>::getLeft() const
 {
-    return static_cast<AVLNode<Key, Value>*>(this->left_);
+    return static_cast<AVLNode<Key, Value>*>(Node<Key, Value>::getLeft());
 }
 
 /**
@@ -117,7 +121,26 @@ AVLNode<Key, Value> *AVLNode<Key, Value>::getLeft() const
 template<class Key, class Value>
 AVLNode<Key, Value> *AVLNode<Key, Value>::getRight() const
 {
-    return static_cast<AVLNode<Key, Value>*>(this->right_);
+    return static_cast<AVLNode<Key, Value>*>(Node<Key, Value>::getRight());
+}
+
+/**
+* Copies the node, balance included.
+*/
+template<class Key, class Value>
+Node<Key, Value>* AVLNode<Key, Value>::cloneAt(void* mem, Node<Key, Value>* parent) const
+{
+    AVLNode<Key, Value>* copy = new (mem) AVLNode<Key, Value>(this->getKey(), this->getValue(),
+                                                              static_cast<AVLNode<Key, Value>*>(parent));
+    copy->setTags(this->getTags());
+    copy->setChildTags(this->getChildTags());
+    return copy;
+}
+
+template<class Key, class Value>
+size_t AVLNode<Key, Value>::allocationSize() const
+{
+    return sizeof(AVLNode<Key, Value>);
 }
 
 
@@ -128,78 +151,384 @@ AVLNode<Key, Value> *AVLNode<Key, Value>::getRight() const
 */
 
 
-template <class Key, class Value>
-class AVLTree : public BinarySearchTree<Key, Value>
+template <class Key, class Value, class Compare = std::less<Key> >
+class AVLTree : public BinarySearchTree<Key, Value, Compare>
 {
-public:
-    virtual void insert (const std::pair<const Key, Value> &new_item); // TODO
-    virtual void remove(const Key& key);  // TODO
 protected:
+    virtual Node<Key, Value>* insertNear(Node<Key, Value>* finger, const std::pair<const Key, Value> &new_item);
+    virtual void removeNode(Node<Key, Value>* node);
     virtual void nodeSwap( AVLNode<Key,Value>* n1, AVLNode<Key,Value>* n2);
+    // Allocates the node for a new item; trees with richer nodes override it.
+    virtual AVLNode<Key, Value>* createNode(const Key& key, const Value& value, AVLNode<Key, Value>* parent);
 
     // Add helper functions here
-void rotateLeft(AVLNode<Key, Value> *grandParent, AVLNode<Key, Value> *parent, AVLNode<Key, Value> *grandChild);
-void rotateRight(AVLNode<Key, Value> *grandParent, AVLNode<Key, Value> *parent, AVLNode<Key, Value> *grandChild);
-
-
-
-
+    bool insertFix(AVLNode<Key, Value>* parent, AVLNode<Key, Value>* node);
+    void removeFix(AVLNode<Key, Value>* node, int8_t diff);
+    // Ranks are heights.
+    virtual int rankOf(Node<Key, Value>* node) const;
+    virtual int rankAbove(Node<Key, Value>* parent, bool fromLeft, int childRank, int& siblingRank) const;
+    virtual Node<Key, Value>* join(Node<Key, Value>* left, int leftRank, Node<Key, Value>* mid,
+                                   Node<Key, Value>* right, int rightRank, int& rank);
+    virtual void rebuildFix(Node<Key, Value>* subtree);
+    virtual void describeNode(std::ostream& os, const Node<Key, Value>* node) const;
+    virtual void profileNode(TreeProfile& profile, const Node<Key, Value>* node) const;
+    static int setBalances(AVLNode<Key, Value>* node);
 };
 
 /*
- * Recall: If key is already in the tree, you should 
+ * Recall: If key is already in the tree, you should
  * overwrite the current value with the updated value.
  */
-template<class Key, class Value>
-void AVLTree<Key, Value>::insert (const std::pair<const Key, Value> &new_item)
+template<typename Key, typename Value, typename Compare>
+Node<Key, Value>* AVLTree<Key, Value, Compare>::insertNear(Node<Key, Value>* finger, const std::pair<const Key, Value> &new_item)
+{
+    Node<Key, Value>* parentNode;
+    bool isMax;
+    Node<Key, Value>* found = this->locate(finger, new_item.first, parentNode, isMax);
+    if(found != NULL)
+    {
+        found->setValue(new_item.second);
+        return found;
+    }
+
+    AVLNode<Key, Value>* parent = static_cast<AVLNode<Key, Value>*>(parentNode);
+    AVLNode<Key, Value>* newNode = createNode(new_item.first, new_item.second, parent);
+    this->nodeAdded(newNode, isMax);
+    if(parent == NULL)
+    {
+        this->root_ = newNode;
+        return newNode;
+    }
+    if(this->comp_(new_item.first, parent->getKey()))
+    {
+        parent->setLeft(newNode);
+    }
+    else
+    {
+        parent->setRight(newNode);
+    }
+    insertFix(parent, newNode);
+    return newNode;
+}
+
+template<typename Key, typename Value, typename Compare>
+AVLNode<Key, Value>* AVLTree<Key, Value, Compare>::createNode(const Key& key, const Value& value, AVLNode<Key, Value>* parent)
 {
-    // TODO
+    return new AVLNode<Key, Value>(key, value, parent);
 }
 
 /*
  * Recall: The writeup specifies that if a node has 2 children you
  * should swap with the predecessor and then remove.
  */
-template<class Key, class Value>
-void AVLTree<Key, Value>:: remove(const Key& key)
+template<typename Key, typename Value, typename Compare>
+void AVLTree<Key, Value, Compare>::removeNode(Node<Key, Value>* deletedNode)
 {
-    //see if it already exist 
-    Node<Key,Value>* temp = internalFind(key);
-    if(temp)
+    AVLNode<Key, Value>* node = static_cast<AVLNode<Key, Value>*>(deletedNode);
+    if(node->getLeft() != NULL && node->getRight() != NULL)
     {
-        //if so, check to see if it has children or not
-        //three cases: no children, one child or two children
-        if(temp->getLeft() && temp->getRight())
+        nodeSwap(static_cast<AVLNode<Key, Value>*>(this->predecessor(node)), node);
+    }
+
+    // The node now has at most one child; splice it out and retrace.
+    AVLNode<Key, Value>* child = node->getLeft();
+    if(child == NULL)
+    {
+        child = node->getRight();
+    }
+    AVLNode<Key, Value>* parent = node->getParent();
+    int8_t diff = 0;
+    if(child != NULL)
+    {
+        child->setParent(parent);
+    }
+    if(parent == NULL)
+    {
+        this->root_ = child;
+    }
+    else if(parent->getLeft() == node)
+    {
+        parent->setLeft(child);
+        diff = 1;
+    }
+    else
+    {
+        parent->setRight(child);
+        diff = -1;
+    }
+    this->nodeRemoved(node);
+    this->releaseNode(node);
+    removeFix(parent, diff);
+}
+
+/**
+* Recomputes the balance factors of a rebuilt subtree.
+*/
+template<typename Key, typename Value, typename Compare>
+void AVLTree<Key, Value, Compare>::rebuildFix(Node<Key, Value>* subtree)
+{
+    setBalances(static_cast<AVLNode<Key, Value>*>(subtree));
+}
+
+/**
+* Exporters show each node's balance factor.
+*/
+template<typename Key, typename Value, typename Compare>
+void AVLTree<Key, Value, Compare>::describeNode(std::ostream& os, const Node<Key, Value>* node) const
+{
+    int balance = static_cast<const AVLNode<Key, Value>*>(node)->getBalance();
+    os << " b=" << (balance > 0 ? "+" : "") << balance;
+    BinarySearchTree<Key, Value, Compare>::describeNode(os, node);
+}
+
+/**
+* Profiles count the balance factors.
+*/
+template<typename Key, typename Value, typename Compare>
+void AVLTree<Key, Value, Compare>::profileNode(TreeProfile& profile, const Node<Key, Value>* node) const
+{
+    profile.balanceCounts.resize(3);
+    ++profile.balanceCounts[static_cast<const AVLNode<Key, Value>*>(node)->getBalance() + 1];
+}
+
+/**
+* Stores the balance of every node below node and returns its height.
+*/
+template<typename Key, typename Value, typename Compare>
+int AVLTree<Key, Value, Compare>::setBalances(AVLNode<Key, Value>* node)
+{
+    if(node == NULL)
+    {
+        return 0;
+    }
+    int left = setBalances(node->getLeft());
+    int right = setBalances(node->getRight());
+    node->setBalance((int8_t)(right - left));
+    return std::max(left, right) + 1;
+}
+
+template<typename Key, typename Value, typename Compare>
+void AVLTree<Key, Value, Compare>::nodeSwap( AVLNode<Key,Value>* n1, AVLNode<Key,Value>* n2)
+{
+    BinarySearchTree<Key, Value, Compare>::nodeSwap(n1, n2);
+    int8_t tempB = n1->getBalance();
+    n1->setBalance(n2->getBalance());
+    n2->setBalance(tempB);
+}
+
+/**
+* Walks up from a freshly attached node, updating balances (right height
+* minus left height) until the subtree height stops growing or a single
+* or double rotation restores it. Balances outside [-1, 1] are never stored.
+* Returns true if the height of the whole tree grew.
+*/
+template<typename Key, typename Value, typename Compare>
+bool AVLTree<Key, Value, Compare>::insertFix(AVLNode<Key, Value>* parent, AVLNode<Key, Value>* node)
+{
+    while(parent != NULL)
+    {
+        int8_t diff = (node == parent->getLeft()) ? -1 : 1;
+        int balance = parent->getBalance() + diff;
+        if(balance == 0)
         {
-            nodeSwap((AVLNode<Key,Value>*)this->predecessor(temp), (AVLNode<Key,Value>*)temp);
+            parent->setBalance(0);
+            return false;
         }
-        else if(temp->getLeft())
+        if(balance == diff)
         {
-            nodeSwap((AVLNode<Key,Value>*)temp->getLeft(), (AVLNode<Key,Value>*)temp);
+            parent->setBalance(balance);
+            node = parent;
+            parent = parent->getParent();
+            continue;
         }
-        else if(temp->getRight())
+
+        // parent is now off by two on node's side
+        if(node->getBalance() == diff)
+        {
+            if(diff < 0) this->rotateRight(parent);
+            else this->rotateLeft(parent);
+            parent->setBalance(0);
+            node->setBalance(0);
+        }
+        else
         {
-            nodeSwap((AVLNode<Key,Value>*)temp->getRight(), (AVLNode<Key,Value>*)temp);
+            AVLNode<Key, Value>* grandChild = (diff < 0) ? node->getRight() : node->getLeft();
+            int8_t gb = grandChild->getBalance();
+            if(diff < 0)
+            {
+                this->rotateLeft(node);
+                this->rotateRight(parent);
+            }
+            else
+            {
+                this->rotateRight(node);
+                this->rotateLeft(parent);
+            }
+            node->setBalance(gb == -diff ? diff : 0);
+            parent->setBalance(gb == diff ? -diff : 0);
+            grandChild->setBalance(0);
         }
-        temp = nullptr;
-        delete(temp);
+        return false;
     }
+    return true;
 }
-template<class Key, class Value>
-void AVLTree<Key, Value>::nodeSwap( AVLNode<Key,Value>* n1, AVLNode<Key,Value>* n2)
+
+/**
+* Walks up from node after one of its subtrees shrank by one level;
+* diff is +1 if the left side shrank and -1 if the right side did.
+*/
+template<typename Key, typename Value, typename Compare>
+void AVLTree<Key, Value, Compare>::removeFix(AVLNode<Key, Value>* node, int8_t diff)
 {
-    BinarySearchTree<Key, Value>::nodeSwap(n1, n2);
-    int8_t tempB = n1->getBalance();
-    n1->setBalance(n2->getBalance());
-    n2->setBalance(tempB);
+    while(node != NULL)
+    {
+        AVLNode<Key, Value>* parent = node->getParent();
+        int8_t nextDiff = 0;
+        if(parent != NULL)
+        {
+            nextDiff = (node == parent->getLeft()) ? 1 : -1;
+        }
+
+        int balance = node->getBalance() + diff;
+        if(balance == diff)
+        {
+            // was even, now leans one way: height is unchanged
+            node->setBalance(balance);
+            return;
+        }
+        if(balance == 0)
+        {
+            node->setBalance(0);
+            node = parent;
+            diff = nextDiff;
+            continue;
+        }
+
+        // off by two towards diff; rotate the taller child up
+        AVLNode<Key, Value>* child = (diff > 0) ? node->getRight() : node->getLeft();
+        int8_t cb = child->getBalance();
+        if(cb == -diff)
+        {
+            AVLNode<Key, Value>* grandChild = (diff > 0) ? child->getLeft() : child->getRight();
+            int8_t gb = grandChild->getBalance();
+            if(diff > 0)
+            {
+                this->rotateRight(child);
+                this->rotateLeft(node);
+            }
+            else
+            {
+                this->rotateLeft(child);
+                this->rotateRight(node);
+            }
+            node->setBalance(gb == diff ? -diff : 0);
+            child->setBalance(gb == -diff ? diff : 0);
+            grandChild->setBalance(0);
+        }
+        else
+        {
+            if(diff > 0) this->rotateLeft(node);
+            else this->rotateRight(node);
+            if(cb == 0)
+            {
+                // subtree height is unchanged by the rotation
+                node->setBalance(diff);
+                child->setBalance(-diff);
+                return;
+            }
+            node->setBalance(0);
+            child->setBalance(0);
+        }
+        node = parent;
+        diff = nextDiff;
+    }
 }
-template<class Key, class Value>
-void rotateLeft(AVLNode<Key, Value> *grandParent, AVLNode<Key, Value> *parent, AVLNode<Key, Value> *grandChild)
+
+/**
+* Returns the height of the subtree at node, following the taller child
+* down.
+*/
+template<typename Key, typename Value, typename Compare>
+int AVLTree<Key, Value, Compare>::rankOf(Node<Key, Value>* node) const
 {
+    int height = 0;
+    for(AVLNode<Key, Value>* n = static_cast<AVLNode<Key, Value>*>(node); n != NULL;
+        n = (n->getBalance() < 0) ? n->getLeft() : n->getRight())
+    {
+        ++height;
+    }
+    return height;
 }
-//Same set up for rotateright, but just different rotations 
-template<class Key, class Value>
-void rotateRight(AVLNode<Key, Value> *grandParent, AVLNode<Key, Value> *parent, AVLNode<Key, Value> *grandChild)
+
+template<typename Key, typename Value, typename Compare>
+int AVLTree<Key, Value, Compare>::rankAbove(Node<Key, Value>* parent, bool fromLeft, int childRank,
+                                            int& siblingRank) const
+{
+    int balance = static_cast<AVLNode<Key, Value>*>(parent)->getBalance();
+    siblingRank = fromLeft ? childRank + balance : childRank - balance;
+    return std::max(childRank, siblingRank) + 1;
+}
+
+/**
+* Joins two trees whose heights differ by at most one directly under
+* mid. Otherwise mid goes down the taller tree's inner spine to the
+* first subtree at most one taller than the shorter tree, takes its
+* place with it and the shorter tree as children, and the taller tree
+* is retraced from there as after an insert.
+*/
+template<typename Key, typename Value, typename Compare>
+Node<Key, Value>* AVLTree<Key, Value, Compare>::join(Node<Key, Value>* left, int leftRank, Node<Key, Value>* mid,
+                                                     Node<Key, Value>* right, int rightRank, int& rank)
 {
+    AVLNode<Key, Value>* node = static_cast<AVLNode<Key, Value>*>(mid);
+    if(std::abs(leftRank - rightRank) <= 1)
+    {
+        this->linkChildren(node, left, right);
+        node->setParent(NULL);
+        node->setBalance((int8_t)(rightRank - leftRank));
+        rank = std::max(leftRank, rightRank) + 1;
+        return node;
+    }
+
+    bool descendRight = leftRank > rightRank;
+    AVLNode<Key, Value>* top = static_cast<AVLNode<Key, Value>*>(descendRight ? left : right);
+    int low = std::min(leftRank, rightRank);
+    AVLNode<Key, Value>* parent = NULL;
+    AVLNode<Key, Value>* spine = top;
+    int spineHeight = std::max(leftRank, rightRank);
+    while(spineHeight > low + 1)
+    {
+        parent = spine;
+        int8_t balance = spine->getBalance();
+        if(descendRight)
+        {
+            spineHeight -= (balance < 0) ? 2 : 1;
+            spine = spine->getRight();
+        }
+        else
+        {
+            spineHeight -= (balance > 0) ? 2 : 1;
+            spine = spine->getLeft();
+        }
+    }
+
+    if(descendRight)
+    {
+        this->linkChildren(node, spine, right);
+        parent->setRight(node);
+        node->setBalance((int8_t)(low - spineHeight));
+    }
+    else
+    {
+        this->linkChildren(node, left, spine);
+        parent->setLeft(node);
+        node->setBalance((int8_t)(spineHeight - low));
+    }
+    node->setParent(parent);
+    // rotations at the top of the taller tree move root_
+    this->root_ = top;
+    rank = std::max(leftRank, rightRank) + (insertFix(parent, node) ? 1 : 0);
+    return this->root_;
 }
+
 #endif
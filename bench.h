@@ -0,0 +1,180 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+#include <sys/wait.h>
+#include <unistd.h>
+
+// Shared helpers for bst-bench: timing, workload generators and
+// command-line parsing. Everything here is header-only like the trees.
+
+/**
+* Wall-clock stopwatch on the steady clock.
+*/
+class BenchTimer
+{
+public:
+    BenchTimer() : start_(std::chrono::steady_clock::now()) { }
+    void reset() { start_ = std::chrono::steady_clock::now(); }
+    double seconds() const
+    {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - start_).count();
+    }
+
+private:
+    std::chrono::steady_clock::time_point start_;
+};
+
+/**
+* Draws ranks in [0, n) with P(rank k) proportional to 1 / (k + 1)^theta.
+* The CDF is tabulated once, so each draw is a binary search.
+*/
+class ZipfGenerator
+{
+public:
+    ZipfGenerator(size_t n, double theta, uint64_t seed)
+        : cdf_(n), rng_(seed), uniform_(0.0, 1.0)
+    {
+        double sum = 0;
+        for(size_t k = 0; k < n; ++k)
+        {
+            sum += 1.0 / std::pow((double)(k + 1), theta);
+            cdf_[k] = sum;
+        }
+        for(size_t k = 0; k < n; ++k)
+        {
+            cdf_[k] /= sum;
+        }
+    }
+
+    size_t next()
+    {
+        double u = uniform_(rng_);
+        size_t k = std::lower_bound(cdf_.begin(), cdf_.end(), u) - cdf_.begin();
+        return k < cdf_.size() ? k : cdf_.size() - 1;
+    }
+
+private:
+    std::vector<double> cdf_;
+    std::mt19937_64 rng_;
+    std::uniform_real_distribution<double> uniform_;
+};
+
+/**
+* Returns the keys 0 .. n-1 in a random order.
+*/
+inline std::vector<int> shuffledKeys(size_t n, uint64_t seed)
+{
+    std::vector<int> keys(n);
+    for(size_t i = 0; i < n; ++i)
+    {
+        keys[i] = (int)i;
+    }
+    std::mt19937_64 rng(seed);
+    std::shuffle(keys.begin(), keys.end(), rng);
+    return keys;
+}
+
+/**
+* Returns the resident set size of this process in bytes, or 0 if
+* /proc is unavailable.
+*/
+inline size_t currentRssBytes()
+{
+    FILE* f = std::fopen("/proc/self/statm", "r");
+    if(f == NULL)
+    {
+        return 0;
+    }
+    unsigned long pages = 0, resident = 0;
+    int got = std::fscanf(f, "%lu %lu", &pages, &resident);
+    std::fclose(f);
+    return got == 2 ? (size_t)resident * 4096 : 0;
+}
+
+/**
+* Runs fn in a forked child so that its memory footprint (RSS) is not
+* skewed by what earlier measurements left in the allocator. Falls back
+* to running in-process if fork fails.
+*/
+inline void runIsolated(void (*fn)(void*), void* arg)
+{
+    std::cout.flush();
+    pid_t pid = fork();
+    if(pid == 0)
+    {
+        fn(arg);
+        std::cout.flush();
+        _exit(0);
+    }
+    if(pid < 0)
+    {
+        fn(arg);
+        return;
+    }
+    int status = 0;
+    waitpid(pid, &status, 0);
+}
+
+/**
+* Reads "--name=value" from the command line, or returns fallback.
+*/
+inline double benchArg(int argc, char* argv[], const char* name, double fallback)
+{
+    size_t len = std::strlen(name);
+    for(int i = 1; i < argc; ++i)
+    {
+        if(std::strncmp(argv[i], "--", 2) == 0 && std::strncmp(argv[i] + 2, name, len) == 0
+           && argv[i][2 + len] == '=')
+        {
+            return std::atof(argv[i] + 3 + len);
+        }
+    }
+    return fallback;
+}
+
+/**
+* Reads "--name=text" from the command line, or returns fallback.
+*/
+inline std::string benchStringArg(int argc, char* argv[], const char* name, const std::string& fallback)
+{
+    size_t len = std::strlen(name);
+    for(int i = 1; i < argc; ++i)
+    {
+        if(std::strncmp(argv[i], "--", 2) == 0 && std::strncmp(argv[i] + 2, name, len) == 0
+           && argv[i][2 + len] == '=')
+        {
+            return std::string(argv[i] + 3 + len);
+        }
+    }
+    return fallback;
+}
+
+/**
+* Prints one result line: label, throughput and time per operation.
+*/
+inline void benchReport(const std::string& label, size_t ops, double seconds)
+{
+    std::streamsize precision = std::cout.precision();
+    std::cout << "  " << std::left << std::setw(28) << label << std::right
+              << std::fixed << std::setprecision(2) << std::setw(9) << (ops / seconds / 1e6) << " Mops/s"
+              << std::setprecision(1) << std::setw(9) << (seconds * 1e9 / ops) << " ns/op" << std::endl;
+    std::cout.unsetf(std::ios::floatfield);
+    std::cout.precision(precision);
+}
+
+// Keeps the optimizer from discarding benchmark results.
+static volatile long benchSink = 0;
+
+#endif
@@ -0,0 +1,1365 @@
+#include <iostream>
+#include <string>
+#include <algorithm>
+#include <vector>
+#include <array>
+#include <utility>
+#include <thread>
+#include "bst.h"
+#include "avlbst.h"
+#include "splaybst.h"
+#include "rbbst.h"
+#include "indexbst.h"
+#include "pathavl.h"
+#include "relaxedavl.h"
+#include "radixtree.h"
+#include "augavl.h"
+#include "intervaltree.h"
+#include "staticbst.h"
+#include "durabletree.h"
+#include "splitbst.h"
+#include "bench.h"
+#include "latency.h"
+
+using namespace std;
+
+// Looks up Zipf-distributed keys in a tree preloaded with n keys.
+// Hot ranks are mapped through a permutation so hot keys are scattered.
+template<typename Tree>
+static void zipfLookups(Tree& tree, const char* label, const vector<int>& keys,
+                        size_t ops, double theta)
+{
+    for(size_t i = 0; i < keys.size(); ++i) {
+        tree.insert(std::make_pair(keys[i], (int)i));
+    }
+    ZipfGenerator zipf(keys.size(), theta, 42);
+    vector<int> queries(ops);
+    for(size_t i = 0; i < ops; ++i) {
+        queries[i] = keys[zipf.next()];
+    }
+    BenchTimer timer;
+    long found = 0;
+    for(size_t i = 0; i < ops; ++i) {
+        found += tree.find(queries[i]) != tree.end();
+    }
+    benchReport(label, ops, timer.seconds());
+    benchSink += found;
+}
+
+// Splay trees versus AVLTree on skewed lookups.
+static void benchSplay(int argc, char* argv[])
+{
+    size_t n = (size_t)benchArg(argc, argv, "n", 1000000);
+    size_t ops = (size_t)benchArg(argc, argv, "ops", 5000000);
+    double theta = benchArg(argc, argv, "theta", 0.99);
+    vector<int> keys = shuffledKeys(n, 7);
+    cout << "splay: n=" << n << " lookups=" << ops << " zipf theta=" << theta << endl;
+    {
+        AVLTree<int,int> tree;
+        zipfLookups(tree, "AVLTree", keys, ops, theta);
+    }
+    {
+        SplayTree<int,int> tree(SPLAY_FULL);
+        zipfLookups(tree, "SplayTree full", keys, ops, theta);
+    }
+    {
+        SplayTree<int,int> tree(SPLAY_SEMI);
+        zipfLookups(tree, "SplayTree semi", keys, ops, theta);
+    }
+    {
+        SplayTree<int,int> tree(SPLAY_FULL, 4);
+        zipfLookups(tree, "SplayTree full, every 4th", keys, ops, theta);
+    }
+}
+
+// Runs a random mix over keys [0, 2n): insertPct% inserts, removePct%
+// removes and the rest finds, after preloading n random keys.
+template<typename Tree>
+static void mixedOps(const char* label, size_t n, size_t ops, int insertPct, int removePct)
+{
+    Tree tree;
+    std::mt19937_64 rng(11);
+    for(size_t i = 0; i < n; ++i) {
+        tree.insert(std::make_pair((int)(rng() % (2 * n)), (int)i));
+    }
+    vector<unsigned> mix(ops);
+    for(size_t i = 0; i < ops; ++i) {
+        mix[i] = (unsigned)rng();
+    }
+    BenchTimer timer;
+    long found = 0;
+    for(size_t i = 0; i < ops; ++i) {
+        int key = (int)((mix[i] >> 7) % (2 * n));
+        int roll = (int)(mix[i] % 100);
+        if(roll < insertPct) {
+            tree.insert(std::make_pair(key, (int)i));
+        }
+        else if(roll < insertPct + removePct) {
+            tree.remove(key);
+        }
+        else {
+            found += tree.find(key) != tree.end();
+        }
+    }
+    benchReport(label, ops, timer.seconds());
+    benchSink += found;
+}
+
+// RBTree versus AVLTree on insert-, delete- and read-heavy mixes.
+static void benchRedBlack(int argc, char* argv[])
+{
+    size_t n = (size_t)benchArg(argc, argv, "n", 1000000);
+    size_t ops = (size_t)benchArg(argc, argv, "ops", 3000000);
+    const struct { const char* name; int insertPct; int removePct; } mixes[] = {
+        { "insert-heavy (90/5/5)", 90, 5 },
+        { "delete-heavy (5/90/5)", 5, 90 },
+        { "read-heavy (5/5/90)", 5, 5 },
+    };
+    cout << "rb: n=" << n << " ops=" << ops << " (insert/remove/find %)" << endl;
+    for(size_t m = 0; m < sizeof(mixes) / sizeof(mixes[0]); ++m) {
+        cout << " " << mixes[m].name << endl;
+        mixedOps<AVLTree<int,int> >("AVLTree", n, ops, mixes[m].insertPct, mixes[m].removePct);
+        mixedOps<RBTree<int,int> >("RBTree", n, ops, mixes[m].insertPct, mixes[m].removePct);
+    }
+}
+
+struct FootprintArgs {
+    size_t n;
+    size_t lookups;
+};
+
+// Builds a tree of n random <int,int> items in a fresh process and
+// reports its RSS growth, insert and lookup throughput.
+template<typename Tree>
+static void footprint(void* raw)
+{
+    const FootprintArgs& args = *static_cast<FootprintArgs*>(raw);
+    vector<int> keys = shuffledKeys(args.n, 3);
+    vector<int> probes = shuffledKeys(args.n, 4);
+    size_t rssBefore = currentRssBytes();
+    Tree tree;
+    BenchTimer timer;
+    for(size_t i = 0; i < keys.size(); ++i) {
+        tree.insert(std::make_pair(keys[i], (int)i));
+    }
+    double insertSecs = timer.seconds();
+    size_t rssAfter = currentRssBytes();
+    timer.reset();
+    long found = 0;
+    for(size_t i = 0; i < args.lookups; ++i) {
+        found += tree.find(probes[i % probes.size()]) != tree.end();
+    }
+    double findSecs = timer.seconds();
+    timer.reset();
+    for(size_t i = 0; i < probes.size(); ++i) {
+        tree.remove(probes[i]);
+    }
+    double removeSecs = timer.seconds();
+    benchSink += found;
+    cout << "    RSS " << (rssAfter - rssBefore) / (1 << 20) << " MiB ("
+         << (double)(rssAfter - rssBefore) / args.n << " B/node)" << endl;
+    benchReport("insert", args.n, insertSecs);
+    benchReport("find", args.lookups, findSecs);
+    benchReport("remove", probes.size(), removeSecs);
+}
+
+// AVLTree versus the parent-pointer-free PathAVLTree.
+static void benchParentless(int argc, char* argv[])
+{
+    FootprintArgs args;
+    args.n = (size_t)benchArg(argc, argv, "n", 2000000);
+    args.lookups = (size_t)benchArg(argc, argv, "ops", 2000000);
+    cout << "parentless: n=" << args.n << " random <int,int> inserts, " << args.lookups << " lookups" << endl;
+    cout << "  AVLTree (sizeof node " << sizeof(AVLNode<int,int>) << ")" << endl;
+    runIsolated(footprint<AVLTree<int,int> >, &args);
+    cout << "  PathAVLTree (sizeof node " << sizeof(PathAVLNode<int,int>) << ")" << endl;
+    runIsolated(footprint<PathAVLTree<int,int> >, &args);
+}
+
+// An AVLNode padded back to the size it had with a separate balance
+// byte, so the packed layout can be compared within one build.
+template<typename Key, typename Value>
+class PaddedAVLNode : public AVLNode<Key, Value>
+{
+public:
+    PaddedAVLNode(const Key& key, const Value& value, AVLNode<Key, Value>* parent)
+        : AVLNode<Key, Value>(key, value, parent), spare_(0) { }
+    virtual size_t allocationSize() const { return sizeof(PaddedAVLNode<Key, Value>); }
+
+private:
+    int8_t spare_;
+};
+
+class PaddedAVLTree : public AVLTree<int,int>
+{
+protected:
+    virtual AVLNode<int,int>* createNode(const int& key, const int& value, AVLNode<int,int>* parent)
+    {
+        return new PaddedAVLNode<int,int>(key, value, parent);
+    }
+};
+
+// AVLTree nodes with the balance in child-pointer tags versus padded
+// back to their old size.
+static void benchPacked(int argc, char* argv[])
+{
+    FootprintArgs args;
+    args.n = (size_t)benchArg(argc, argv, "n", 2000000);
+    args.lookups = (size_t)benchArg(argc, argv, "ops", 2000000);
+    cout << "packed: n=" << args.n << " random <int,int> inserts, " << args.lookups << " lookups" << endl;
+    cout << "  AVLTree, balance in pointer tags (sizeof node " << sizeof(AVLNode<int,int>) << ", "
+         << 64.0 / sizeof(AVLNode<int,int>) << " per cache line)" << endl;
+    runIsolated(footprint<AVLTree<int,int> >, &args);
+    cout << "  AVLTree, padded with a balance byte (sizeof node " << sizeof(PaddedAVLNode<int,int>) << ", "
+         << 64.0 / sizeof(PaddedAVLNode<int,int>) << " per cache line)" << endl;
+    runIsolated(footprint<PaddedAVLTree>, &args);
+    cout << "  RBTree, color in the parent tag (sizeof node " << sizeof(RBNode<int,int>) << ")" << endl;
+    runIsolated(footprint<RBTree<int,int> >, &args);
+}
+
+// A value of Bytes bytes; lookups read its first word.
+template<size_t Bytes>
+struct Blob {
+    Blob(long v = 0) { words[0] = v; }
+    long words[Bytes / sizeof(long)];
+};
+
+// The tree's printers and exporters need values to be printable.
+template<size_t Bytes>
+static ostream& operator<<(ostream& os, const Blob<Bytes>& blob)
+{
+    return os << blob.words[0];
+}
+
+// Inserts n random keys with Blob values in a fresh process, then
+// looks up random present keys and reads each value found.
+template<typename Tree>
+static void valueRun(void* raw)
+{
+    const FootprintArgs& args = *static_cast<FootprintArgs*>(raw);
+    vector<int> keys = shuffledKeys(args.n, 3);
+    vector<int> probes = shuffledKeys(args.n, 4);
+    size_t rssBefore = currentRssBytes();
+    Tree tree;
+    BenchTimer timer;
+    for(size_t i = 0; i < keys.size(); ++i) {
+        tree.insert(std::make_pair(keys[i], (long)i));
+    }
+    double insertSecs = timer.seconds();
+    size_t rssAfter = currentRssBytes();
+    timer.reset();
+    long sum = 0;
+    for(size_t i = 0; i < args.lookups; ++i) {
+        typename Tree::iterator it = tree.find(probes[i % probes.size()]);
+        sum += it->second.words[0];
+    }
+    double findSecs = timer.seconds();
+    benchSink += sum;
+    cout << "    RSS " << (rssAfter - rssBefore) / (1 << 20) << " MiB, node "
+         << tree.profile().nodeBytes << " B" << endl;
+    benchReport("insert", args.n, insertSecs);
+    benchReport("find + read value", args.lookups, findSecs);
+}
+
+template<size_t Bytes>
+static void valueSize(FootprintArgs& args)
+{
+    cout << "  " << Bytes << " B values" << endl;
+    cout << "   AVLTree, values in the nodes" << endl;
+    runIsolated(valueRun<AVLTree<int, Blob<Bytes> > >, &args);
+    cout << "   SplitAVLTree, values in a pool" << endl;
+    runIsolated(valueRun<SplitAVLTree<int, Blob<Bytes> > >, &args);
+}
+
+// Lookup throughput as values grow, with values inline and out of line.
+static void benchSplit(int argc, char* argv[])
+{
+    FootprintArgs args;
+    args.n = (size_t)benchArg(argc, argv, "n", 200000);
+    args.lookups = (size_t)benchArg(argc, argv, "ops", 2000000);
+    cout << "split: n=" << args.n << " random int keys, " << args.lookups << " hits" << endl;
+    valueSize<8>(args);
+    valueSize<64>(args);
+    valueSize<256>(args);
+    valueSize<1024>(args);
+}
+
+// Pointer-linked trees versus 32-bit index-linked storage.
+static void benchIndexed(int argc, char* argv[])
+{
+    FootprintArgs args;
+    args.n = (size_t)benchArg(argc, argv, "n", 2000000);
+    args.lookups = (size_t)benchArg(argc, argv, "ops", 2000000);
+    cout << "index: n=" << args.n << " random <int,int> inserts, " << args.lookups << " lookups" << endl;
+    cout << "  BinarySearchTree" << endl;
+    runIsolated(footprint<BinarySearchTree<int,int> >, &args);
+    cout << "  IndexedBinarySearchTree" << endl;
+    runIsolated(footprint<IndexedBinarySearchTree<int,int> >, &args);
+    cout << "  AVLTree" << endl;
+    runIsolated(footprint<AVLTree<int,int> >, &args);
+    cout << "  IndexedAVLTree" << endl;
+    runIsolated(footprint<IndexedAVLTree<int,int> >, &args);
+}
+
+// A tree that maintains a hash index from construction on.
+template<typename Tree>
+class HashIndexed : public Tree
+{
+public:
+    HashIndexed() { this->enableHashIndex(); }
+};
+
+// Trees with and without the optional hash index.
+static void benchHashIndex(int argc, char* argv[])
+{
+    FootprintArgs args;
+    args.n = (size_t)benchArg(argc, argv, "n", 2000000);
+    args.lookups = (size_t)benchArg(argc, argv, "ops", 2000000);
+    cout << "hash: n=" << args.n << " random <int,int> inserts, " << args.lookups << " lookups" << endl;
+    cout << "  AVLTree" << endl;
+    runIsolated(footprint<AVLTree<int,int> >, &args);
+    cout << "  AVLTree + hash index" << endl;
+    runIsolated(footprint<HashIndexed<AVLTree<int,int> > >, &args);
+    cout << "  RBTree" << endl;
+    runIsolated(footprint<RBTree<int,int> >, &args);
+    cout << "  RBTree + hash index" << endl;
+    runIsolated(footprint<HashIndexed<RBTree<int,int> > >, &args);
+}
+
+// AVLTree with its finger disabled: every insert descends from the root.
+class RootInsertAVLTree : public AVLTree<long,int>
+{
+protected:
+    virtual Node<long,int>* insertNear(Node<long,int>*, const std::pair<const long, int>& item)
+    {
+        fingerAtMax_ = false;
+        return AVLTree<long,int>::insertNear(NULL, item);
+    }
+};
+
+// Time-series keys: n timestamps 16 apart, each moved back by up to
+// jitter, so keys arrive nearly sorted.
+static vector<long> timeSeries(size_t n, long jitter)
+{
+    std::mt19937_64 rng(21);
+    vector<long> keys(n);
+    for(size_t i = 0; i < n; ++i) {
+        keys[i] = (long)i * 16 - (jitter > 0 ? (long)(rng() % jitter) : 0);
+    }
+    return keys;
+}
+
+// Inserts keys from the root, with the automatic finger and with the
+// previous item as hint, then looks each key up with find and find_from.
+static void fingerRun(const vector<long>& keys)
+{
+    {
+        RootInsertAVLTree tree;
+        BenchTimer timer;
+        for(size_t i = 0; i < keys.size(); ++i) {
+            tree.insert(std::make_pair(keys[i], (int)i));
+        }
+        benchReport("insert from root", keys.size(), timer.seconds());
+    }
+    {
+        AVLTree<long,int> tree;
+        BenchTimer timer;
+        for(size_t i = 0; i < keys.size(); ++i) {
+            tree.insert(std::make_pair(keys[i], (int)i));
+        }
+        benchReport("insert (automatic finger)", keys.size(), timer.seconds());
+    }
+    AVLTree<long,int> tree;
+    AVLTree<long,int>::iterator hint = tree.end();
+    BenchTimer timer;
+    for(size_t i = 0; i < keys.size(); ++i) {
+        hint = tree.insert(hint, std::make_pair(keys[i], (int)i));
+    }
+    benchReport("insert(hint)", keys.size(), timer.seconds());
+
+    timer.reset();
+    long found = 0;
+    for(size_t i = 0; i < keys.size(); ++i) {
+        found += tree.find(keys[i]) != tree.end();
+    }
+    benchReport("find", keys.size(), timer.seconds());
+    timer.reset();
+    AVLTree<long,int>::iterator finger = tree.begin();
+    for(size_t i = 0; i < keys.size(); ++i) {
+        finger = tree.find_from(finger, keys[i]);
+        found += finger != tree.end();
+    }
+    benchReport("find_from(previous)", keys.size(), timer.seconds());
+    benchSink += found;
+}
+
+// Root descents versus finger search on nearly sorted keys.
+static void benchFinger(int argc, char* argv[])
+{
+    size_t n = (size_t)benchArg(argc, argv, "n", 2000000);
+    long jitter = (long)benchArg(argc, argv, "jitter", 256);
+    cout << "finger: n=" << n << " AVLTree<long,int>" << endl;
+    cout << " monotonic keys" << endl;
+    fingerRun(timeSeries(n, 0));
+    cout << " jittered keys (up to " << jitter / 16 << " slots late)" << endl;
+    fingerRun(timeSeries(n, jitter));
+}
+
+// Resolves random keys in batches, first with a loop of find, then with
+// find_many.
+template<typename Tree>
+static void batchRun(const char* label, size_t n, size_t ops, size_t batch)
+{
+    Tree tree;
+    vector<int> keys = shuffledKeys(n, 8);
+    for(size_t i = 0; i < n; ++i) {
+        tree.insert(std::make_pair(keys[i], (int)i));
+    }
+    std::mt19937_64 rng(9);
+    vector<int> queries(ops);
+    for(size_t i = 0; i < ops; ++i) {
+        queries[i] = (int)(rng() % n);
+    }
+    cout << "  " << label << ", batches of " << batch << endl;
+
+    vector<int> group(batch);
+    vector<typename Tree::iterator> out(batch);
+    long found = 0;
+    BenchTimer timer;
+    for(size_t i = 0; i + batch <= ops; i += batch) {
+        for(size_t j = 0; j < batch; ++j) {
+            out[j] = tree.find(queries[i + j]);
+        }
+        found += out[0] != tree.end();
+    }
+    benchReport("loop of find", ops, timer.seconds());
+    timer.reset();
+    for(size_t i = 0; i + batch <= ops; i += batch) {
+        group.assign(queries.begin() + i, queries.begin() + i + batch);
+        tree.find_many(group, out);
+        found += out[0] != tree.end();
+    }
+    benchReport("find_many", ops, timer.seconds());
+    benchSink += found;
+}
+
+// Batched lookups with interleaved prefetching versus plain find.
+static void benchBatch(int argc, char* argv[])
+{
+    size_t n = (size_t)benchArg(argc, argv, "n", 4000000);
+    size_t ops = (size_t)benchArg(argc, argv, "ops", 4000000);
+    cout << "batch: n=" << n << " random <int,int> keys, " << ops << " lookups" << endl;
+    const size_t batches[] = { 64, 512 };
+    for(size_t b = 0; b < 2; ++b) {
+        batchRun<AVLTree<int,int> >("AVLTree", n, ops, batches[b]);
+        batchRun<RBTree<int,int> >("RBTree", n, ops, batches[b]);
+    }
+}
+
+// Expiry bursts: a tree of n timestamps repeatedly drops its oldest
+// burst keys and appends burst new ones, then serves random lookups.
+// deadRatio 0 means eager deletion.
+template<typename Tree>
+static void expiryRun(const char* label, size_t n, size_t rounds, size_t burst, double deadRatio)
+{
+    Tree tree;
+    if(deadRatio > 0) {
+        tree.enableTombstones(deadRatio);
+    }
+    vector<int> keys = shuffledKeys(n, 12);
+    for(size_t i = 0; i < n; ++i) {
+        tree.insert(std::make_pair(keys[i], (int)i));
+    }
+    int oldest = 0;
+    int newest = (int)n;
+    double removeSecs = 0;
+    double insertSecs = 0;
+    BenchTimer timer;
+    for(size_t r = 0; r < rounds; ++r) {
+        timer.reset();
+        for(size_t i = 0; i < burst; ++i) {
+            tree.remove(oldest++);
+        }
+        removeSecs += timer.seconds();
+        timer.reset();
+        for(size_t i = 0; i < burst; ++i) {
+            tree.insert(std::make_pair(newest++, (int)i));
+        }
+        insertSecs += timer.seconds();
+    }
+    std::mt19937_64 rng(13);
+    timer.reset();
+    long found = 0;
+    for(size_t i = 0; i < n; ++i) {
+        found += tree.find(oldest + (int)(rng() % n)) != tree.end();
+    }
+    double findSecs = timer.seconds();
+    benchSink += found;
+    cout << "  " << label << endl;
+    benchReport("remove (expire)", rounds * burst, removeSecs);
+    benchReport("insert (append)", rounds * burst, insertSecs);
+    benchReport("find afterwards", n, findSecs);
+}
+
+// Eager deletion versus tombstones with amortized compaction.
+static void benchLazy(int argc, char* argv[])
+{
+    size_t n = (size_t)benchArg(argc, argv, "n", 1000000);
+    size_t burst = (size_t)benchArg(argc, argv, "burst", 50000);
+    size_t rounds = (size_t)benchArg(argc, argv, "rounds", 40);
+    cout << "lazy: n=" << n << " items, " << rounds << " rounds of " << burst
+         << " expiries + appends" << endl;
+    expiryRun<AVLTree<int,int> >("AVLTree, eager", n, rounds, burst, 0);
+    expiryRun<AVLTree<int,int> >("AVLTree, tombstones (compact at 25% dead)", n, rounds, burst, 0.25);
+    expiryRun<AVLTree<int,int> >("AVLTree, tombstones (compact at 50% dead)", n, rounds, burst, 0.5);
+    expiryRun<RBTree<int,int> >("RBTree, eager", n, rounds, burst, 0);
+    expiryRun<RBTree<int,int> >("RBTree, tombstones (compact at 50% dead)", n, rounds, burst, 0.5);
+}
+
+// Time windows: a tree of n timestamps repeatedly expires everything
+// older than a cutoff, window keys at a time, and appends as many new
+// ones. The expiry is remove per key, erase per iterator walking from
+// begin, or one erase(begin, cutoff) over the range.
+template<typename Tree>
+static void windowRun(const char* label, size_t n, size_t rounds, size_t window)
+{
+    static const char* modes[] = { "remove(key) per key", "erase(iterator) loop", "erase(begin, cutoff)" };
+    cout << "  " << label << ", expiring " << window << " at a time" << endl;
+    for(int mode = 0; mode < 3; ++mode) {
+        Tree tree;
+        for(size_t i = 0; i < n; ++i) {
+            tree.insert(std::make_pair((int)i, (int)i));
+        }
+        int oldest = 0;
+        int newest = (int)n;
+        double expireSecs = 0;
+        BenchTimer timer;
+        for(size_t r = 0; r < rounds; ++r) {
+            int cutoff = oldest + (int)window;
+            timer.reset();
+            if(mode == 0) {
+                for(; oldest < cutoff; ++oldest) {
+                    tree.remove(oldest);
+                }
+            }
+            else if(mode == 1) {
+                typename Tree::iterator it = tree.begin();
+                while(it != tree.end() && it->first < cutoff) {
+                    it = tree.erase(it);
+                }
+            }
+            else {
+                typename Tree::iterator last = tree.find(cutoff);
+                tree.erase(tree.begin(), last);
+            }
+            expireSecs += timer.seconds();
+            oldest = cutoff;
+            for(size_t i = 0; i < window; ++i) {
+                tree.insert(std::make_pair(newest++, (int)i));
+            }
+        }
+        benchSink += tree.size();
+        benchReport(modes[mode], rounds * window, expireSecs);
+    }
+}
+
+// Expiring time windows through remove, erase(iterator) and range erase,
+// and clear on a large tree.
+static void benchErase(int argc, char* argv[])
+{
+    size_t n = (size_t)benchArg(argc, argv, "n", 1000000);
+    size_t rounds = (size_t)benchArg(argc, argv, "rounds", 20);
+    cout << "erase: n=" << n << " timestamps, " << rounds << " rounds of expire + append" << endl;
+    const size_t percents[] = { 1, 10, 50, 75 };
+    for(size_t p = 0; p < 4; ++p) {
+        size_t window = n * percents[p] / 100;
+        windowRun<AVLTree<int,int> >("AVLTree", n, rounds, window);
+        windowRun<RBTree<int,int> >("RBTree", n, rounds, window);
+    }
+    AVLTree<int,int> tree;
+    for(size_t i = 0; i < n; ++i) {
+        tree.insert(std::make_pair((int)i, (int)i));
+    }
+    BenchTimer timer;
+    tree.clear();
+    benchReport("clear", n, timer.seconds());
+}
+
+// A BinarySearchTree in scapegoat mode from construction on.
+class ScapegoatTree : public BinarySearchTree<int,int>
+{
+public:
+    ScapegoatTree() { enableScapegoat(0.7); }
+};
+
+// Sorted inserts and then random lookups into a scapegoat BST with the
+// given alpha, or into an AVLTree when alpha is 0.
+static void sortedRun(const char* label, size_t n, double alpha)
+{
+    BinarySearchTree<int,int>* tree;
+    if(alpha > 0) {
+        tree = new BinarySearchTree<int,int>();
+        tree->enableScapegoat(alpha);
+    }
+    else {
+        tree = new AVLTree<int,int>();
+    }
+    cout << "  " << label << endl;
+    BenchTimer timer;
+    for(size_t i = 0; i < n; ++i) {
+        tree->insert(std::make_pair((int)i, (int)i));
+    }
+    benchReport("sorted insert", n, timer.seconds());
+    vector<int> probes = shuffledKeys(n, 14);
+    timer.reset();
+    long found = 0;
+    for(size_t i = 0; i < n; ++i) {
+        found += tree->find(probes[i]) != tree->end();
+    }
+    benchReport("find", n, timer.seconds());
+    benchSink += found;
+    delete tree;
+}
+
+// Scapegoat-mode BinarySearchTree versus AVLTree.
+static void benchScapegoat(int argc, char* argv[])
+{
+    FootprintArgs args;
+    args.n = (size_t)benchArg(argc, argv, "n", 1000000);
+    args.lookups = (size_t)benchArg(argc, argv, "ops", 1000000);
+    cout << "scapegoat: n=" << args.n << " sorted <int,int> inserts" << endl;
+    sortedRun("BinarySearchTree scapegoat alpha=0.6", args.n, 0.6);
+    sortedRun("BinarySearchTree scapegoat alpha=0.7", args.n, 0.7);
+    sortedRun("BinarySearchTree scapegoat alpha=0.8", args.n, 0.8);
+    sortedRun("AVLTree", args.n, 0);
+    cout << " random <int,int> inserts, " << args.lookups << " lookups" << endl;
+    cout << "  BinarySearchTree (sizeof node " << sizeof(Node<int,int>) << ")" << endl;
+    runIsolated(footprint<BinarySearchTree<int,int> >, &args);
+    cout << "  BinarySearchTree scapegoat alpha=0.7" << endl;
+    runIsolated(footprint<ScapegoatTree>, &args);
+    cout << "  AVLTree (sizeof node " << sizeof(AVLNode<int,int>) << ")" << endl;
+    runIsolated(footprint<AVLTree<int,int> >, &args);
+}
+
+// An AVLTree copied by a single thread, to compare against the
+// parallel copy constructor.
+class SerialCopyAVLTree : public AVLTree<int,int>
+{
+public:
+    explicit SerialCopyAVLTree(const AVLTree<int,int>& other) { cloneFrom(other, 1); }
+};
+
+// Random lookups and a full in-order walk over tree.
+static void cloneReads(const char* label, AVLTree<int,int>& tree, const vector<int>& probes)
+{
+    cout << "  " << label << endl;
+    BenchTimer timer;
+    long found = 0;
+    for(size_t i = 0; i < probes.size(); ++i) {
+        found += tree.find(probes[i]) != tree.end();
+    }
+    benchReport("find", probes.size(), timer.seconds());
+    timer.reset();
+    long sum = 0;
+    for(AVLTree<int,int>::iterator it = tree.begin(); it != tree.end(); ++it) {
+        sum += it->second;
+    }
+    benchReport("iterate", tree.size(), timer.seconds());
+    benchSink += found + sum;
+}
+
+// Copying by re-inserting versus the structural copy constructor, and
+// reads on the original versus on its contiguously laid out copy.
+static void benchClone(int argc, char* argv[])
+{
+    size_t n = (size_t)benchArg(argc, argv, "n", 1000000);
+    size_t ops = (size_t)benchArg(argc, argv, "ops", 1000000);
+    cout << "clone: n=" << n << " random <int,int> inserts, "
+         << std::thread::hardware_concurrency() << " hardware threads" << endl;
+    AVLTree<int,int> tree;
+    vector<int> keys = shuffledKeys(n, 15);
+    for(size_t i = 0; i < n; ++i) {
+        tree.insert(std::make_pair(keys[i], (int)i));
+    }
+
+    BenchTimer timer;
+    AVLTree<int,int>* reinserted = new AVLTree<int,int>();
+    for(AVLTree<int,int>::iterator it = tree.begin(); it != tree.end(); ++it) {
+        reinserted->insert(*it);
+    }
+    benchReport("copy by in-order re-insert", n, timer.seconds());
+    delete reinserted;
+
+    timer.reset();
+    SerialCopyAVLTree* serial = new SerialCopyAVLTree(tree);
+    benchReport("structural copy, 1 thread", n, timer.seconds());
+    timer.reset();
+    delete serial;
+    benchReport("destroy copy", n, timer.seconds());
+
+    timer.reset();
+    AVLTree<int,int> copy(tree);
+    benchReport("structural copy constructor", n, timer.seconds());
+
+    timer.reset();
+    AVLTree<int,int> moved(std::move(copy));
+    benchReport("move constructor", 1, timer.seconds());
+
+    vector<int> probes = shuffledKeys(n, 16);
+    probes.resize(min(ops, n));
+    cloneReads("original (nodes allocated in insert order)", tree, probes);
+    cloneReads("copy (nodes in pre-order blocks)", moved, probes);
+}
+
+// Random lookups on tree, with the share of its links that cross a
+// cache line and a page.
+template<typename Tree>
+static void layoutReads(const char* label, Tree& tree, const vector<int>& probes)
+{
+    TreeProfile shape = tree.profile();
+    cout << "  " << label << ": height " << shape.height << ", links crossing a line "
+         << 100 * shape.lineCrossings / max<size_t>(shape.links, 1) << "%, a page "
+         << 100 * shape.pageCrossings / max<size_t>(shape.links, 1) << "%" << endl;
+    BenchTimer timer;
+    long found = 0;
+    for(size_t i = 0; i < probes.size(); ++i) {
+        found += tree.find(probes[i]) != tree.end();
+    }
+    benchReport("find", probes.size(), timer.seconds());
+    benchSink += found;
+}
+
+// Lookups on a tree as its inserts left it, on a structural copy (one
+// block in pre-order) and after compactLayout (one block in van Emde
+// Boas order), then inserts on the compacted tree.
+template<typename Tree>
+static void layoutRun(const char* label, size_t n, const vector<int>& probes)
+{
+    cout << label << endl;
+    vector<int> keys = shuffledKeys(n, 17);
+    Tree tree;
+    for(size_t i = 0; i < n; ++i) {
+        tree.insert(std::make_pair(keys[i], (int)i));
+    }
+    layoutReads("as inserted", tree, probes);
+    {
+        Tree copy(tree);
+        layoutReads("structural copy (pre-order)", copy, probes);
+    }
+    BenchTimer timer;
+    tree.compactLayout();
+    benchReport("compactLayout", n, timer.seconds());
+    layoutReads("compactLayout (van Emde Boas)", tree, probes);
+    vector<int> more = shuffledKeys(n / 10, 19);
+    timer.reset();
+    for(size_t i = 0; i < more.size(); ++i) {
+        tree.insert(std::make_pair((int)n + more[i], (int)i));
+    }
+    benchReport("insert 10% more afterwards", n / 10, timer.seconds());
+    layoutReads("after the inserts", tree, probes);
+}
+
+// Read-mostly phases: lookups before and after compactLayout.
+static void benchLayout(int argc, char* argv[])
+{
+    size_t n = (size_t)benchArg(argc, argv, "n", 4000000);
+    size_t ops = (size_t)benchArg(argc, argv, "ops", 4000000);
+    cout << "layout: n=" << n << " random <int,int> inserts, " << ops << " random lookups" << endl;
+    vector<int> probes = shuffledKeys(n, 18);
+    probes.resize(min(ops, n));
+    layoutRun<AVLTree<int,int> >("AVLTree", n, probes);
+    layoutRun<RBTree<int,int> >("RBTree", n, probes);
+    layoutRun<BinarySearchTree<int,int> >("BinarySearchTree", n, probes);
+}
+
+// Window sums by walking each window with an iterator versus reduce on
+// a sum-augmented tree, plus what maintaining the sums costs inserts.
+static void benchReduce(int argc, char* argv[])
+{
+    size_t n = (size_t)benchArg(argc, argv, "n", 1000000);
+    size_t ops = (size_t)benchArg(argc, argv, "ops", 100000);
+    cout << "reduce: n=" << n << " random <long,long> inserts, " << ops << " window sums" << endl;
+    vector<int> keys = shuffledKeys(n, 17);
+
+    AVLTree<long,long> plain;
+    BenchTimer timer;
+    for(size_t i = 0; i < n; ++i) {
+        plain.insert(std::make_pair((long)keys[i], (long)i));
+    }
+    benchReport("AVLTree insert", n, timer.seconds());
+    AugmentedAVLTree<long,long,SumMonoid<long> > summed;
+    timer.reset();
+    for(size_t i = 0; i < n; ++i) {
+        summed.insert(std::make_pair((long)keys[i], (long)i));
+    }
+    benchReport("AugmentedAVLTree<sum> insert", n, timer.seconds());
+
+    const size_t widths[] = { 16, 1024, 65536 };
+    for(size_t w = 0; w < sizeof(widths) / sizeof(widths[0]); ++w) {
+        size_t width = min(widths[w], n);
+        size_t windows = max<size_t>(16, min(ops, ops * 16 / width));
+        vector<long> starts(windows);
+        srand(18);
+        for(size_t i = 0; i < windows; ++i) {
+            starts[i] = rand() % (n - width + 1);
+        }
+        cout << "  windows of " << width << " keys" << endl;
+        timer.reset();
+        long walked = 0;
+        for(size_t i = 0; i < windows; ++i) {
+            AVLTree<long,long>::iterator it = plain.find(starts[i]);
+            for(size_t k = 0; k < width; ++k, ++it) {
+                walked += it->second;
+            }
+        }
+        benchReport("iterate the window", windows, timer.seconds());
+        timer.reset();
+        long reduced = 0;
+        for(size_t i = 0; i < windows; ++i) {
+            reduced += summed.reduce(starts[i], starts[i] + (long)width);
+        }
+        benchReport("reduce(lo, hi)", windows, timer.seconds());
+        if(walked != reduced) {
+            cout << "  MISMATCH" << endl;
+        }
+        benchSink += walked + reduced;
+    }
+}
+
+// Overlap and stabbing queries on an IntervalTree versus scanning an
+// array of the same intervals. Intervals arrive in start order, like
+// time-stamped events; most are short and a few run long.
+static void benchInterval(int argc, char* argv[])
+{
+    size_t n = (size_t)benchArg(argc, argv, "n", 10000000);
+    size_t ops = (size_t)benchArg(argc, argv, "ops", 100000);
+    size_t scans = (size_t)benchArg(argc, argv, "scans", 20);
+    cout << "interval: n=" << n << " intervals, " << ops << " tree queries, "
+         << scans << " scans" << endl;
+    std::mt19937_64 rng(19);
+    vector<Interval<long> > intervals(n);
+    long start = 0;
+    for(size_t i = 0; i < n; ++i) {
+        start += 1 + rng() % 10;
+        long length = (rng() % 100 == 0) ? (long)(rng() % 100000) : (long)(rng() % 50);
+        intervals[i] = Interval<long>(start, start + length);
+    }
+
+    IntervalTree<long,int> tree;
+    BenchTimer timer;
+    for(size_t i = 0; i < n; ++i) {
+        tree.insert(intervals[i].start, intervals[i].end, (int)i);
+    }
+    benchReport("insert in start order", n, timer.seconds());
+
+    for(int query = 0; query < 2; ++query) {
+        long width = query == 0 ? 0 : 1000;
+        cout << "  " << (query == 0 ? "stabbing queries" : "overlap queries, width 1000") << endl;
+        vector<long> points(ops);
+        for(size_t i = 0; i < ops; ++i) {
+            points[i] = (long)(rng() % (uint64_t)(start + 1));
+        }
+        vector<IntervalTree<long,int>::iterator> found;
+        size_t hits = 0;
+        timer.reset();
+        for(size_t i = 0; i < ops; ++i) {
+            found.clear();
+            tree.overlapping(points[i], points[i] + width, found);
+            hits += found.size();
+        }
+        benchReport("IntervalTree", ops, timer.seconds());
+        cout << "    average matches: " << (double)hits / ops << endl;
+
+        size_t scanHits = 0;
+        size_t treeHits = 0;
+        timer.reset();
+        for(size_t i = 0; i < scans; ++i) {
+            for(size_t j = 0; j < n; ++j) {
+                scanHits += intervals[j].start <= points[i] + width && intervals[j].end >= points[i];
+            }
+        }
+        benchReport("linear scan", scans, timer.seconds());
+        for(size_t i = 0; i < scans; ++i) {
+            found.clear();
+            tree.overlapping(points[i], points[i] + width, found);
+            treeHits += found.size();
+        }
+        if(scanHits != treeHits) {
+            cout << "  MISMATCH" << endl;
+        }
+        benchSink += hits + scanHits;
+    }
+}
+
+static constexpr int opcodeKey(size_t i)
+{
+    return (int)((i * 40503) % 65521);
+}
+
+template<size_t... I>
+static constexpr array<pair<int,int>, sizeof...(I)> opcodeItems(index_sequence<I...>)
+{
+    return {{ pair<int,int>(opcodeKey(I), (int)I)... }};
+}
+
+static constexpr array<pair<int,int>, 256> opcodes = opcodeItems(make_index_sequence<256>());
+static constexpr StaticSearchTree<int,int,256> opcodeTable(opcodes);
+
+// A 256-entry lookup table: built by the compiler as a
+// StaticSearchTree versus built at startup as an AVLTree.
+static void benchStatic(int argc, char* argv[])
+{
+    size_t ops = (size_t)benchArg(argc, argv, "ops", 10000000);
+    cout << "static: 256 keys, " << ops << " lookups (half of them misses)" << endl;
+    std::mt19937_64 rng(20);
+    vector<int> probes(ops);
+    for(size_t i = 0; i < ops; ++i) {
+        probes[i] = (i % 2 == 0) ? opcodes[rng() % opcodes.size()].first : (int)(rng() % 65521);
+    }
+
+    BenchTimer timer;
+    AVLTree<int,int> tree;
+    for(size_t i = 0; i < opcodes.size(); ++i) {
+        tree.insert(opcodes[i]);
+    }
+    benchReport("AVLTree startup build", opcodes.size(), timer.seconds());
+
+    timer.reset();
+    long found = 0;
+    for(size_t i = 0; i < ops; ++i) {
+        found += tree.find(probes[i]) != tree.end();
+    }
+    benchReport("AVLTree find", ops, timer.seconds());
+    timer.reset();
+    long staticFound = 0;
+    for(size_t i = 0; i < ops; ++i) {
+        staticFound += opcodeTable.find(probes[i]) != opcodeTable.end();
+    }
+    benchReport("StaticSearchTree find", ops, timer.seconds());
+    if(found != staticFound) {
+        cout << "  MISMATCH" << endl;
+    }
+    cout << "  StaticSearchTree: " << sizeof(opcodeTable) << " bytes of static data, depth "
+         << opcodeTable.DEPTH << ", no heap" << endl;
+    benchSink += found + staticFound;
+}
+
+// Generates n distinct URL-like keys: a few hosts, a handful of path
+// sections per host, then numeric ids, so keys share long prefixes.
+static vector<string> urlCorpus(size_t n, unsigned seed)
+{
+    static const char* const sections[] = {
+        "/catalog/electronics/", "/catalog/home-and-garden/", "/api/v2/users/",
+        "/api/v2/orders/", "/static/assets/images/", "/blog/posts/2023/",
+    };
+    std::mt19937_64 rng(seed);
+    vector<string> keys(n);
+    for(size_t i = 0; i < n; ++i) {
+        string key = "https://www.shop" + std::to_string(rng() % 16) + ".example.com";
+        key += sections[rng() % 6];
+        key += std::to_string(rng() % 100000) + "/item-" + std::to_string(i);
+        keys[i] = key;
+    }
+    std::shuffle(keys.begin(), keys.end(), rng);
+    return keys;
+}
+
+// Builds a string-keyed tree from the URL corpus in a fresh process and
+// reports its RSS growth, insert and lookup throughput.
+template<typename Tree>
+static void stringFootprint(void* raw)
+{
+    const FootprintArgs& args = *static_cast<FootprintArgs*>(raw);
+    vector<string> keys = urlCorpus(args.n, 5);
+    vector<string> probes(keys);
+    std::shuffle(probes.begin(), probes.end(), std::mt19937_64(6));
+    size_t rssBefore = currentRssBytes();
+    Tree tree;
+    BenchTimer timer;
+    for(size_t i = 0; i < keys.size(); ++i) {
+        tree.insert(std::make_pair(keys[i], (int)i));
+    }
+    double insertSecs = timer.seconds();
+    size_t rssAfter = currentRssBytes();
+    timer.reset();
+    long found = 0;
+    for(size_t i = 0; i < args.lookups; ++i) {
+        found += tree.find(probes[i % probes.size()]) != tree.end();
+    }
+    double findSecs = timer.seconds();
+    benchSink += found;
+    cout << "    RSS " << (rssAfter - rssBefore) / (1 << 20) << " MiB ("
+         << (double)(rssAfter - rssBefore) / args.n << " B/key)" << endl;
+    benchReport("insert", args.n, insertSecs);
+    benchReport("find", args.lookups, findSecs);
+}
+
+// AVLTree<std::string,int> versus RadixTree on a generated URL corpus.
+static void benchStrings(int argc, char* argv[])
+{
+    FootprintArgs args;
+    args.n = (size_t)benchArg(argc, argv, "n", 1000000);
+    args.lookups = (size_t)benchArg(argc, argv, "ops", 2000000);
+    vector<string> sample = urlCorpus(3, 5);
+    cout << "strings: n=" << args.n << " URL keys (e.g. " << sample[0] << "), "
+         << args.lookups << " lookups" << endl;
+    cout << "  AVLTree<std::string,int>" << endl;
+    runIsolated(stringFootprint<AVLTree<string,int> >, &args);
+    cout << "  RadixTree<int>" << endl;
+    runIsolated(stringFootprint<RadixTree<int> >, &args);
+}
+
+// Orders strings through operator() alone, so each level of a descent
+// costs up to two calls, as every tree paid before compareKeys.
+struct TwoWayStringLess {
+    static size_t calls;
+    bool operator()(const string& a, const string& b) const
+    {
+        ++calls;
+        return a < b;
+    }
+};
+size_t TwoWayStringLess::calls = 0;
+
+// The same order with a three-way compare, one call per level.
+struct ThreeWayStringCompare {
+    static size_t calls;
+    bool operator()(const string& a, const string& b) const
+    {
+        ++calls;
+        return a < b;
+    }
+    int compare(const string& a, const string& b) const
+    {
+        ++calls;
+        return a.compare(b);
+    }
+};
+size_t ThreeWayStringCompare::calls = 0;
+
+// Builds a tree of keys and times find over probes. Returns the hits.
+template<typename Tree, typename Probe>
+static long compareRun(const char* label, const vector<string>& keys, const vector<Probe>& probes,
+                       size_t* calls)
+{
+    Tree tree;
+    for(size_t i = 0; i < keys.size(); ++i) {
+        tree.insert(std::make_pair(keys[i], (int)i));
+    }
+    size_t before = calls != NULL ? *calls : 0;
+    BenchTimer timer;
+    long found = 0;
+    for(size_t i = 0; i < probes.size(); ++i) {
+        found += tree.find(probes[i]) != tree.end();
+    }
+    benchReport(label, probes.size(), timer.seconds());
+    if(calls != NULL) {
+        cout << "    " << (double)(*calls - before) / probes.size() << " comparisons per find" << endl;
+    }
+    return found;
+}
+
+// One three-way comparison per level against the old two two-way
+// tests, on URL keys whose long shared prefixes make comparing costly.
+static void benchCompare(int argc, char* argv[])
+{
+    size_t n = (size_t)benchArg(argc, argv, "n", 200000);
+    size_t ops = (size_t)benchArg(argc, argv, "ops", 2000000);
+    vector<string> keys = urlCorpus(n, 5);
+    std::mt19937_64 rng(7);
+    vector<string> probes(ops);
+    vector<const char*> rawProbes(ops);
+    for(size_t i = 0; i < ops; ++i) {
+        probes[i] = keys[rng() % n];
+        if(i % 2 == 1) {
+            probes[i].back() = '#';
+        }
+    }
+    for(size_t i = 0; i < ops; ++i) {
+        rawProbes[i] = probes[i].c_str();
+    }
+    cout << "compare: n=" << n << " URL keys in an AVLTree, " << ops << " finds (half of them misses)" << endl;
+
+    long counts[5];
+    counts[0] = compareRun<AVLTree<string,int,TwoWayStringLess> >("two-way operator() only", keys, probes,
+                                                                  &TwoWayStringLess::calls);
+    counts[1] = compareRun<AVLTree<string,int,ThreeWayStringCompare> >("three-way compare()", keys, probes,
+                                                                       &ThreeWayStringCompare::calls);
+    counts[2] = compareRun<AVLTree<string,int> >("less<string>", keys, probes, NULL);
+    counts[3] = compareRun<AVLTree<string,int,less<> > >("less<> by const char*", keys, rawProbes, NULL);
+    // without a transparent comparator each lookup builds a std::string
+    vector<const char*> built(rawProbes);
+    BenchTimer timer;
+    AVLTree<string,int> tree;
+    for(size_t i = 0; i < keys.size(); ++i) {
+        tree.insert(std::make_pair(keys[i], (int)i));
+    }
+    timer.reset();
+    counts[4] = 0;
+    for(size_t i = 0; i < built.size(); ++i) {
+        counts[4] += tree.find(string(built[i])) != tree.end();
+    }
+    benchReport("less<string> by string(p)", built.size(), timer.seconds());
+    for(int i = 1; i < 5; ++i) {
+        if(counts[i] != counts[0]) {
+            cout << "  MISMATCH" << endl;
+        }
+    }
+    benchSink += counts[0];
+}
+
+// A streambuf that counts and discards what is written to it.
+class CountingBuf : public std::streambuf {
+public:
+    CountingBuf() : bytes(0) { }
+    size_t bytes;
+protected:
+    int overflow(int c) { ++bytes; return c; }
+    std::streamsize xsputn(const char*, std::streamsize n) { bytes += n; return n; }
+};
+
+// Runs one exporter over tree and reports its speed, its output size
+// and how much the process grew while it ran.
+template<typename Export>
+static void exportRun(const char* label, size_t nodes, Export write)
+{
+    CountingBuf buf;
+    ostream out(&buf);
+    size_t rssBefore = currentRssBytes();
+    BenchTimer timer;
+    write(out);
+    double seconds = timer.seconds();
+    size_t rssAfter = currentRssBytes();
+    benchReport(label, nodes, seconds);
+    cout << "    " << buf.bytes / (1 << 20) << " MiB written, RSS grew "
+         << (rssAfter > rssBefore ? (rssAfter - rssBefore) / 1024 : 0) << " KiB" << endl;
+}
+
+// Builds an AVLTree of n keys in a fresh process and exports it.
+static void exportTree(void* raw)
+{
+    const FootprintArgs& args = *static_cast<FootprintArgs*>(raw);
+    AVLTree<int,int> tree;
+    vector<int> keys = shuffledKeys(args.n, 9);
+    for(size_t i = 0; i < keys.size(); ++i) {
+        tree.insert(std::make_pair(keys[i], (int)i));
+    }
+    keys = vector<int>();
+    cout << "  tree built, RSS " << currentRssBytes() / (1 << 20) << " MiB" << endl;
+    exportRun("writePreorder", args.n, [&](ostream& out) { tree.writePreorder(out); });
+    exportRun("writeDot", args.n, [&](ostream& out) { tree.writeDot(out); });
+    exportRun("writeAscii, 8 levels", 255, [&](ostream& out) {
+        tree.writeAscii(out, (int)(args.n / 3), 8, 4);
+    });
+}
+
+// Streaming exports of a large tree: throughput and memory growth.
+static void benchExport(int argc, char* argv[])
+{
+    FootprintArgs args;
+    args.n = (size_t)benchArg(argc, argv, "n", 4000000);
+    args.lookups = 0;
+    cout << "export: AVLTree of n=" << args.n << " int keys, written to a counting stream" << endl;
+    runIsolated(exportTree, &args);
+}
+
+// Eager trees have nothing to settle and no maintenance thread.
+template<typename Tree> static void rebalanceAll(Tree&) { }
+template<typename Tree> static void startMaintenance(Tree&) { }
+template<typename Tree> static void stopMaintenance(Tree&) { }
+static std::mutex eagerMutex;
+template<typename Tree> static std::mutex& treeMutex(Tree&) { return eagerMutex; }
+static void rebalanceAll(RelaxedAVLTree<int,int>& tree) { tree.rebalance(); }
+static void startMaintenance(RelaxedAVLTree<int,int>& tree) { tree.startMaintenance(64); }
+static void stopMaintenance(RelaxedAVLTree<int,int>& tree)
+{
+    while(true) {
+        {
+            std::lock_guard<std::mutex> guard(tree.mutex());
+            if(tree.pendingRebalance() == 0) {
+                break;
+            }
+        }
+        std::this_thread::yield();
+    }
+    tree.stopMaintenance();
+}
+static std::mutex& treeMutex(RelaxedAVLTree<int,int>& tree) { return tree.mutex(); }
+
+// How a relaxedRun tree catches up with its rebalancing.
+enum RelaxedMode { RELAX_EAGER, RELAX_BETWEEN_BURSTS, RELAX_BACKGROUND };
+
+// Bursts of random inserts and removes against a tree of about n keys,
+// timing every operation; between bursts the relaxed tree is settled
+// in place or left to its maintenance thread.
+template<typename Tree>
+static void relaxedRun(const char* label, size_t n, size_t rounds, size_t burst, RelaxedMode mode)
+{
+    Tree tree;
+    std::mt19937_64 rng(21);
+    const long range = (long)n * 2;
+    for(size_t i = 0; i < n; ++i) {
+        tree.insert(std::make_pair((int)(rng() % range), (int)i));
+    }
+    rebalanceAll(tree);
+    LatencyHistogram ops;
+    double settleSecs = 0;
+    if(mode == RELAX_BACKGROUND) {
+        startMaintenance(tree);
+    }
+    BenchTimer timer;
+    for(size_t r = 0; r < rounds; ++r) {
+        for(size_t i = 0; i < burst; ++i) {
+            int key = (int)(rng() % range);
+            std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+            if(mode == RELAX_BACKGROUND) {
+                std::lock_guard<std::mutex> guard(treeMutex(tree));
+                i % 2 ? tree.remove(key) : tree.insert(std::make_pair(key, (int)i));
+            }
+            else {
+                i % 2 ? tree.remove(key) : tree.insert(std::make_pair(key, (int)i));
+            }
+            ops.record(latencyNanosSince(start));
+        }
+        if(mode == RELAX_BETWEEN_BURSTS) {
+            BenchTimer settle;
+            rebalanceAll(tree);
+            settleSecs += settle.seconds();
+        }
+    }
+    double totalSecs = timer.seconds();
+    if(mode == RELAX_BACKGROUND) {
+        stopMaintenance(tree);
+    }
+    TreeProfile shape = tree.profile();
+    cout << "  " << label << endl
+         << "    per op: mean " << (uint64_t)ops.mean() << " ns, p50 " << ops.percentile(50)
+         << ", p99 " << ops.percentile(99) << ", p99.9 " << ops.percentile(99.9)
+         << ", max " << ops.max() << " ns" << endl;
+    benchReport("wall time per op, all work", rounds * burst, totalSecs);
+    if(mode == RELAX_BETWEEN_BURSTS) {
+        cout << "    rebalancing between bursts: " << settleSecs * 1e9 / (rounds * burst)
+             << " ns per op" << endl;
+    }
+    cout << "    afterwards: height " << shape.height << " (optimal " << shape.optimalHeight
+         << "), average path " << shape.averagePath << endl;
+}
+
+// Update latency with AVL rebalancing done inline versus deferred.
+static void benchRelaxed(int argc, char* argv[])
+{
+    size_t n = (size_t)benchArg(argc, argv, "n", 1000000);
+    size_t burst = (size_t)benchArg(argc, argv, "burst", 10000);
+    size_t rounds = (size_t)benchArg(argc, argv, "rounds", 100);
+    cout << "relaxed: n=" << n << " keys, " << rounds << " bursts of " << burst
+         << " random inserts/removes" << endl;
+    relaxedRun<AVLTree<int,int> >("AVLTree, eager rebalancing", n, rounds, burst, RELAX_EAGER);
+    relaxedRun<RelaxedAVLTree<int,int> >("RelaxedAVLTree, rebalance() between bursts", n, rounds, burst,
+                                         RELAX_BETWEEN_BURSTS);
+    relaxedRun<RelaxedAVLTree<int,int> >("RelaxedAVLTree, maintenance thread (ops hold its mutex)", n, rounds,
+                                         burst, RELAX_BACKGROUND);
+    relaxedRun<AVLTree<int,int> >("AVLTree, eager, same mutex discipline", n, rounds, burst, RELAX_BACKGROUND);
+}
+
+// threads writers insert ops random keys in total into a fresh durable
+// tree in dir, and the commit throughput is reported.
+static void walRun(const string& dir, size_t ops, int threads, long intervalMicros, bool sync)
+{
+    string path = dir + "/bst-bench-wal";
+    ::unlink((path + ".wal").c_str());
+    ::unlink((path + ".snap").c_str());
+    WalOptions options;
+    options.commitInterval = std::chrono::microseconds(intervalMicros);
+    options.sync = sync;
+    options.checkpointBytes = 0;
+    DurableTree<int,int> tree(path, options);
+    BenchTimer timer;
+    vector<thread> writers;
+    for(int t = 0; t < threads; ++t) {
+        writers.push_back(thread([&tree, ops, threads, t]() {
+            std::mt19937_64 rng(t);
+            for(size_t i = t; i < ops; i += threads) {
+                tree.insert(std::make_pair((int)(rng() >> 33), (int)i));
+            }
+        }));
+    }
+    for(size_t t = 0; t < writers.size(); ++t) {
+        writers[t].join();
+    }
+    double seconds = timer.seconds();
+    size_t commits = tree.commits();
+    string label = to_string(threads) + (threads == 1 ? " writer, " : " writers, ") +
+        (sync ? "interval " + to_string(intervalMicros) + " us" : "no fsync");
+    benchReport(label.c_str(), ops, seconds);
+    cout << "    " << commits << " commits, " << (double)ops / commits << " records each" << endl;
+    ::unlink((path + ".wal").c_str());
+    ::unlink((path + ".snap").c_str());
+}
+
+// Durable insert throughput by commit interval and writer count.
+static void benchWal(int argc, char* argv[])
+{
+    size_t ops = (size_t)benchArg(argc, argv, "ops", 20000);
+    string dir = benchStringArg(argc, argv, "dir", ".");
+    cout << "wal: " << ops << " durable inserts into " << dir << " per configuration" << endl;
+    const int threadCounts[] = { 1, 4, 16 };
+    const long intervals[] = { 0, 100, 1000 };
+    for(size_t t = 0; t < 3; ++t) {
+        for(size_t i = 0; i < 3; ++i) {
+            walRun(dir, ops, threadCounts[t], intervals[i], true);
+        }
+        walRun(dir, ops, threadCounts[t], 0, false);
+    }
+}
+
+struct Benchmark {
+    const char* name;
+    void (*run)(int argc, char* argv[]);
+    const char* description;
+};
+
+static const Benchmark benchmarks[] = {
+    { "splay", benchSplay, "SplayTree modes vs AVLTree on Zipfian lookups" },
+    { "rb", benchRedBlack, "RBTree vs AVLTree on insert/delete/read-heavy mixes" },
+    { "index", benchIndexed, "RSS and throughput of 32-bit index-linked trees" },
+    { "parentless", benchParentless, "AVLTree vs parent-pointer-free PathAVLTree" },
+    { "packed", benchPacked, "AVL balance packed into child-pointer tags vs a padded node" },
+    { "split", benchSplit, "values out of line (SplitAVLTree) vs inline, 8 B to 1 KB values" },
+    { "strings", benchStrings, "RadixTree vs AVLTree<std::string> on URL-like keys" },
+    { "hash", benchHashIndex, "cost and benefit of the optional hash index" },
+    { "finger", benchFinger, "hinted insert and find_from on time-series keys" },
+    { "batch", benchBatch, "find_many with interleaved prefetching vs find" },
+    { "lazy", benchLazy, "tombstone deletion with compaction vs eager remove" },
+    { "erase", benchErase, "expiring time windows: remove vs erase(iterator) vs range erase" },
+    { "scapegoat", benchScapegoat, "scapegoat-mode BinarySearchTree vs AVLTree" },
+    { "clone", benchClone, "structural and parallel copies vs re-inserting" },
+    { "layout", benchLayout, "lookups before and after a van Emde Boas compactLayout" },
+    { "reduce", benchReduce, "O(log n) range aggregates vs iterating the range" },
+    { "interval", benchInterval, "IntervalTree overlap/stabbing queries vs scanning" },
+    { "static", benchStatic, "constexpr StaticSearchTree vs an AVLTree built at startup" },
+    { "compare", benchCompare, "three-way and transparent comparisons on string keys" },
+    { "export", benchExport, "streaming DOT/ASCII/preorder exporters on a large tree" },
+    { "relaxed", benchRelaxed, "deferred (relaxed) AVL rebalancing vs eager, per-op latency" },
+    { "wal", benchWal, "durable inserts through the write-ahead log by commit interval" },
+};
+
+int main(int argc, char* argv[])
+{
+    const size_t count = sizeof(benchmarks) / sizeof(benchmarks[0]);
+    string which = argc > 1 ? argv[1] : "";
+    bool ran = false;
+    for(size_t i = 0; i < count; ++i) {
+        if(which == "all" || which == benchmarks[i].name) {
+            benchmarks[i].run(argc, argv);
+            ran = true;
+        }
+    }
+    if(!ran) {
+        cout << "usage: bst-bench <benchmark|all> [--option=value ...]" << endl;
+        for(size_t i = 0; i < count; ++i) {
+            cout << "  " << benchmarks[i].name << ": " << benchmarks[i].description << endl;
+        }
+        return which.empty() ? 0 : 1;
+    }
+    return 0;
+}
@@ -0,0 +1,182 @@
+#include <iostream>
+#include <fstream>
+#include <random>
+#include <string>
+#include <vector>
+#include "bst.h"
+#include "avlbst.h"
+#include "splaybst.h"
+#include "rbbst.h"
+#include "trace.h"
+#include "bench.h"
+
+using namespace std;
+
+// Builds trees from a recorded trace or a synthetic insert order and
+// reports their shape, balance, memory and layout with profile().
+
+struct ProfileOptions {
+    const TraceStreams* streams;
+    size_t n;
+    string order;
+    bool copy;
+    bool hash;
+};
+
+// Returns n distinct keys in the requested insertion order.
+static vector<long> insertOrder(size_t n, const string& order)
+{
+    vector<long> keys(n);
+    for(size_t i = 0; i < n; ++i) {
+        keys[i] = (long)i;
+    }
+    if(order == "reverse") {
+        std::reverse(keys.begin(), keys.end());
+    }
+    else if(order == "random") {
+        std::shuffle(keys.begin(), keys.end(), mt19937_64(12));
+    }
+    else if(order == "nearly-sorted") {
+        // sorted, but every tenth key swapped with a random one
+        mt19937_64 rng(13);
+        for(size_t i = 0; i < n; i += 10) {
+            std::swap(keys[i], keys[rng() % n]);
+        }
+    }
+    return keys;
+}
+
+template<typename Tree>
+static void profileTree(const char* name, const ProfileOptions& opts, void (*setup)(Tree&))
+{
+    Tree tree;
+    if(setup != NULL) {
+        setup(tree);
+    }
+    if(opts.hash) {
+        tree.enableHashIndex();
+    }
+    if(opts.streams != NULL) {
+        int64_t sink = 0;
+        for(size_t s = 0; s < opts.streams->size(); ++s) {
+            const vector<TraceRecord>& records = (*opts.streams)[s];
+            for(size_t i = 0; i < records.size(); ++i) {
+                sink += applyTraceRecord<long, long>(tree, records[i]);
+            }
+        }
+        benchSink += sink;
+    }
+    else {
+        vector<long> keys = insertOrder(opts.n, opts.order);
+        for(size_t i = 0; i < keys.size(); ++i) {
+            tree.insert(make_pair(keys[i], (long)i));
+        }
+    }
+    BenchTimer timer;
+    TreeProfile profile = tree.profile();
+    double seconds = timer.seconds();
+    cout << "== " << name << " (profiled in " << seconds * 1000 << " ms)" << endl;
+    profile.writeText(cout);
+    if(opts.copy) {
+        Tree copy(tree);
+        cout << "-- structural copy" << endl;
+        copy.profile().writeText(cout);
+    }
+    cout << endl;
+}
+
+static void scapegoat(BinarySearchTree<long,long>& tree) { tree.enableScapegoat(); }
+
+struct TreeChoice {
+    const char* name;
+    void (*run)(const char* name, const ProfileOptions& opts);
+    const char* description;
+};
+
+static void runBst(const char* name, const ProfileOptions& o)
+{
+    profileTree<BinarySearchTree<long,long> >(name, o, NULL);
+}
+
+static void runScapegoat(const char* name, const ProfileOptions& o)
+{
+    profileTree<BinarySearchTree<long,long> >(name, o, scapegoat);
+}
+
+static void runAvl(const char* name, const ProfileOptions& o)
+{
+    profileTree<AVLTree<long,long> >(name, o, NULL);
+}
+
+static void runRb(const char* name, const ProfileOptions& o)
+{
+    profileTree<RBTree<long,long> >(name, o, NULL);
+}
+
+static void runSplay(const char* name, const ProfileOptions& o)
+{
+    profileTree<SplayTree<long,long> >(name, o, NULL);
+}
+
+static const TreeChoice trees[] = {
+    { "bst", runBst, "unbalanced BinarySearchTree" },
+    { "scapegoat", runScapegoat, "BinarySearchTree in scapegoat mode" },
+    { "avl", runAvl, "AVLTree" },
+    { "rb", runRb, "RBTree" },
+    { "splay", runSplay, "SplayTree" },
+};
+
+int main(int argc, char* argv[])
+{
+    const size_t count = sizeof(trees) / sizeof(trees[0]);
+    ProfileOptions opts;
+    opts.streams = NULL;
+    opts.n = (size_t)benchArg(argc, argv, "n", 1000000);
+    opts.order = benchStringArg(argc, argv, "order", "random");
+    opts.copy = benchArg(argc, argv, "copy", 0) != 0;
+    opts.hash = benchArg(argc, argv, "hash", 0) != 0;
+    string which = benchStringArg(argc, argv, "tree", "all");
+    if(argc > 1 && (string(argv[1]) == "-h" || string(argv[1]) == "--help")) {
+        cout << "usage: bst-profile [trace] [--tree=name|all] [--copy=1] [--hash=1]" << endl
+             << "       without a trace: [--n=N] [--order=random|sorted|reverse|nearly-sorted]" << endl
+             << "trees:" << endl;
+        for(size_t i = 0; i < count; ++i) {
+            cout << "  " << trees[i].name << ": " << trees[i].description << endl;
+        }
+        return 1;
+    }
+
+    TraceStreams streams;
+    if(argc > 1 && argv[1][0] != '-') {
+        try {
+            ifstream in(argv[1], ios::binary);
+            if(!in) {
+                cout << "cannot read " << argv[1] << endl;
+                return 1;
+            }
+            readTrace(in, streams);
+        }
+        catch(const runtime_error& e) {
+            cout << argv[1] << ": " << e.what() << endl;
+            return 1;
+        }
+        opts.streams = &streams;
+        cout << "replaying " << argv[1] << " into each tree" << endl << endl;
+    }
+    else {
+        cout << opts.n << " keys inserted in " << opts.order << " order" << endl << endl;
+    }
+
+    bool ran = false;
+    for(size_t i = 0; i < count; ++i) {
+        if(which == "all" || which == trees[i].name) {
+            trees[i].run(trees[i].name, opts);
+            ran = true;
+        }
+    }
+    if(!ran) {
+        cout << "unknown tree " << which << endl;
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,309 @@
+#include <iostream>
+#include <fstream>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+#include "bst.h"
+#include "avlbst.h"
+#include "splaybst.h"
+#include "rbbst.h"
+#include "relaxedavl.h"
+#include "augavl.h"
+#include "indexbst.h"
+#include "pathavl.h"
+#include "latency.h"
+#include "trace.h"
+#include "bench.h"
+
+using namespace std;
+
+// Replays a recorded trace against any of the trees and reports
+// throughput and per-operation latency. Also writes synthetic traces.
+
+struct ReplayOptions {
+    size_t threads;
+    bool isolated;
+};
+
+static LatencyOp latencyOpFor(TraceOp op)
+{
+    static const LatencyOp ops[TRACE_NUM_OPS] = { LAT_INSERT, LAT_REMOVE, LAT_FIND, LAT_ITERATE, LAT_CLEAR };
+    return ops[op];
+}
+
+// Replays streams first, first + step, ... into tree, timing every
+// operation. lock is NULL when the tree is not shared.
+template<typename Tree>
+static void replayStreams(Tree* tree, mutex* lock, const TraceStreams* streams, size_t first, size_t step,
+                          LatencyRecorder* recorder, int64_t* result)
+{
+    int64_t sink = 0;
+    for(size_t s = first; s < streams->size(); s += step) {
+        const vector<TraceRecord>& records = (*streams)[s];
+        for(size_t i = 0; i < records.size(); ++i) {
+            chrono::steady_clock::time_point start = chrono::steady_clock::now();
+            if(lock != NULL) {
+                lock_guard<mutex> guard(*lock);
+                sink += applyTraceRecord<long, long>(*tree, records[i]);
+            }
+            else {
+                sink += applyTraceRecord<long, long>(*tree, records[i]);
+            }
+            recorder->local(latencyOpFor(records[i].op)).record(latencyNanosSince(start));
+        }
+    }
+    *result = sink;
+}
+
+// Runs the replay on opts.threads threads. Streams are dealt out
+// round-robin; the threads share one tree behind a mutex unless
+// isolated, in which case each replays into a tree of its own.
+template<typename Tree>
+static void replay(const char* name, const TraceStreams& streams, const ReplayOptions& opts,
+                   void (*setup)(Tree&))
+{
+    size_t workers = max<size_t>(1, opts.threads);
+    vector<Tree*> trees(opts.isolated ? workers : 1);
+    for(size_t i = 0; i < trees.size(); ++i) {
+        trees[i] = new Tree();
+        if(setup != NULL) {
+            setup(*trees[i]);
+        }
+    }
+    mutex lock;
+    mutex* shared = (!opts.isolated && workers > 1) ? &lock : NULL;
+    LatencyRecorder recorder;
+    size_t total = 0;
+    for(size_t s = 0; s < streams.size(); ++s) {
+        total += streams[s].size();
+    }
+
+    vector<int64_t> results(workers);
+    BenchTimer timer;
+    vector<thread> pool;
+    for(size_t w = 1; w < workers; ++w) {
+        pool.push_back(thread(replayStreams<Tree>, trees[opts.isolated ? w : 0], shared, &streams,
+                              w, workers, &recorder, &results[w]));
+    }
+    replayStreams<Tree>(trees[0], shared, &streams, 0, workers, &recorder, &results[0]);
+    for(size_t w = 0; w < pool.size(); ++w) {
+        pool[w].join();
+    }
+    double seconds = timer.seconds();
+    for(size_t w = 0; w < workers; ++w) {
+        benchSink += results[w];
+    }
+
+    size_t items = 0;
+    for(size_t i = 0; i < trees.size(); ++i) {
+        items += trees[i]->size();
+        delete trees[i];
+    }
+    cout << name << ": " << total << " ops on " << workers << " thread(s), "
+         << (opts.isolated ? "a tree each" : "one shared tree") << ", " << items << " items at the end" << endl;
+    benchReport("replay", total, seconds);
+    recorder.writeText(cout);
+}
+
+// A RelaxedAVLTree whose rebalancing is done inline, a bounded step
+// after each update, as a maintenance thread would do between them; the
+// thread itself would need the tree's mutex held around every replayed
+// operation.
+class SteppedRelaxedAVLTree : public RelaxedAVLTree<long,long>
+{
+public:
+    virtual void insert(const pair<const long, long>& keyValuePair)
+    {
+        RelaxedAVLTree<long,long>::insert(keyValuePair);
+        rebalance_step(64);
+    }
+
+    virtual void remove(const long& key)
+    {
+        RelaxedAVLTree<long,long>::remove(key);
+        rebalance_step(64);
+    }
+};
+
+static void scapegoat(BinarySearchTree<long,long>& tree) { tree.enableScapegoat(); }
+static void hashIndexed(AVLTree<long,long>& tree) { tree.enableHashIndex(); }
+static void tombstones(AVLTree<long,long>& tree) { tree.enableTombstones(); }
+
+struct TreeChoice {
+    const char* name;
+    void (*run)(const char* name, const TraceStreams& streams, const ReplayOptions& opts);
+    const char* description;
+};
+
+static void runBst(const char* name, const TraceStreams& s, const ReplayOptions& o)
+{
+    replay<BinarySearchTree<long,long> >(name, s, o, NULL);
+}
+
+static void runScapegoat(const char* name, const TraceStreams& s, const ReplayOptions& o)
+{
+    replay<BinarySearchTree<long,long> >(name, s, o, scapegoat);
+}
+
+static void runAvl(const char* name, const TraceStreams& s, const ReplayOptions& o)
+{
+    replay<AVLTree<long,long> >(name, s, o, NULL);
+}
+
+static void runAvlHash(const char* name, const TraceStreams& s, const ReplayOptions& o)
+{
+    replay<AVLTree<long,long> >(name, s, o, hashIndexed);
+}
+
+static void runAvlLazy(const char* name, const TraceStreams& s, const ReplayOptions& o)
+{
+    replay<AVLTree<long,long> >(name, s, o, tombstones);
+}
+
+static void runRb(const char* name, const TraceStreams& s, const ReplayOptions& o)
+{
+    replay<RBTree<long,long> >(name, s, o, NULL);
+}
+
+static void runSplay(const char* name, const TraceStreams& s, const ReplayOptions& o)
+{
+    replay<SplayTree<long,long> >(name, s, o, NULL);
+}
+
+static void runRelaxed(const char* name, const TraceStreams& s, const ReplayOptions& o)
+{
+    replay<SteppedRelaxedAVLTree>(name, s, o, NULL);
+}
+
+static void runAugmented(const char* name, const TraceStreams& s, const ReplayOptions& o)
+{
+    replay<AugmentedAVLTree<long,long,SumMonoid<long> > >(name, s, o, NULL);
+}
+
+static void runIndexed(const char* name, const TraceStreams& s, const ReplayOptions& o)
+{
+    replay<IndexedBinarySearchTree<long,long> >(name, s, o, NULL);
+}
+
+static void runIndexedAvl(const char* name, const TraceStreams& s, const ReplayOptions& o)
+{
+    replay<IndexedAVLTree<long,long> >(name, s, o, NULL);
+}
+
+static void runPathAvl(const char* name, const TraceStreams& s, const ReplayOptions& o)
+{
+    replay<PathAVLTree<long,long> >(name, s, o, NULL);
+}
+
+static const TreeChoice trees[] = {
+    { "bst", runBst, "unbalanced BinarySearchTree" },
+    { "scapegoat", runScapegoat, "BinarySearchTree in scapegoat mode" },
+    { "avl", runAvl, "AVLTree" },
+    { "avl-hash", runAvlHash, "AVLTree with the hash index" },
+    { "avl-lazy", runAvlLazy, "AVLTree with tombstone deletion" },
+    { "rb", runRb, "RBTree" },
+    { "splay", runSplay, "SplayTree" },
+    { "relaxed", runRelaxed, "RelaxedAVLTree, rebalanced 64 nodes after each update" },
+    { "augmented", runAugmented, "AugmentedAVLTree summing the values" },
+    { "indexed", runIndexed, "unbalanced IndexedBinarySearchTree (32-bit links)" },
+    { "indexed-avl", runIndexedAvl, "IndexedAVLTree (32-bit links)" },
+    { "path-avl", runPathAvl, "PathAVLTree (no parent pointers)" },
+};
+
+// Records a synthetic workload: each thread inserts, removes, finds and
+// scans in its own tree over a shared key space with a hot region.
+static void synthesize(const string& path, size_t ops, size_t threads, long keys)
+{
+    ofstream out(path.c_str(), ios::binary);
+    if(!out) {
+        cout << "cannot write " << path << endl;
+        return;
+    }
+    TraceWriter writer(out);
+    vector<thread> pool;
+    for(size_t t = 0; t < threads; ++t) {
+        pool.push_back(thread([&writer, ops, threads, keys, t]() {
+            RecordingTree<long, long, AVLTree<long,long> > tree(writer);
+            mt19937_64 rng(t + 1);
+            for(size_t i = 0; i < ops / threads; ++i) {
+                long key = (rng() % 4 == 0) ? (long)(rng() % (keys / 100 + 1)) : (long)(rng() % keys);
+                unsigned op = rng() % 100;
+                if(op < 40) {
+                    tree.insert(make_pair(key, (long)i));
+                }
+                else if(op < 55) {
+                    tree.remove(key);
+                }
+                else if(op < 95) {
+                    tree.find(key);
+                }
+                else {
+                    RecordingTree<long, long, AVLTree<long,long> >::iterator it = tree.find(key);
+                    for(int step = 0; step < 16 && it != tree.end(); ++step) {
+                        ++it;
+                    }
+                }
+            }
+        }));
+    }
+    for(size_t t = 0; t < pool.size(); ++t) {
+        pool[t].join();
+    }
+    writer.flush();
+    cout << "wrote " << path << ": " << ops << " operations from " << threads << " thread(s), "
+         << out.tellp() << " bytes" << endl;
+}
+
+int main(int argc, char* argv[])
+{
+    const size_t count = sizeof(trees) / sizeof(trees[0]);
+    string synth = benchStringArg(argc, argv, "synth", "");
+    if(!synth.empty()) {
+        synthesize(synth, (size_t)benchArg(argc, argv, "ops", 1000000),
+                   max<size_t>(1, (size_t)benchArg(argc, argv, "threads", 1)),
+                   max<long>(1, (long)benchArg(argc, argv, "keys", 100000)));
+        return 0;
+    }
+    if(argc < 2 || argv[1][0] == '-') {
+        cout << "usage: bst-replay <trace> [--tree=name|all] [--threads=N] [--isolated=1]" << endl
+             << "       bst-replay --synth=<trace> [--ops=N] [--threads=N] [--keys=N]" << endl
+             << "trees:" << endl;
+        for(size_t i = 0; i < count; ++i) {
+            cout << "  " << trees[i].name << ": " << trees[i].description << endl;
+        }
+        return 1;
+    }
+
+    TraceStreams streams;
+    try {
+        ifstream in(argv[1], ios::binary);
+        if(!in) {
+            cout << "cannot read " << argv[1] << endl;
+            return 1;
+        }
+        readTrace(in, streams);
+    }
+    catch(const runtime_error& e) {
+        cout << argv[1] << ": " << e.what() << endl;
+        return 1;
+    }
+
+    ReplayOptions opts;
+    opts.threads = (size_t)benchArg(argc, argv, "threads", 1);
+    opts.isolated = benchArg(argc, argv, "isolated", 0) != 0;
+    string which = benchStringArg(argc, argv, "tree", "avl");
+    bool ran = false;
+    for(size_t i = 0; i < count; ++i) {
+        if(which == "all" || which == trees[i].name) {
+            trees[i].run(trees[i].name, streams, opts);
+            ran = true;
+        }
+    }
+    if(!ran) {
+        cout << "unknown tree " << which << endl;
+        return 1;
+    }
+    return 0;
+}
@@ -1,10 +1,1702 @@
 #include <iostream>
+#include <array>
+#include <cctype>
+#include <atomic>
 #include <map>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <cstdlib>
+#include <thread>
+#include <utility>
+#include <vector>
 #include "bst.h"
 #include "avlbst.h"
+#include "latency.h"
+#include "splaybst.h"
+#include "rbbst.h"
+#include "indexbst.h"
+#include "pathavl.h"
+#include "relaxedavl.h"
+#include "radixtree.h"
+#include "augavl.h"
+#include "intervaltree.h"
+#include "trace.h"
+#include "staticbst.h"
+#include "durabletree.h"
+#include "splitbst.h"
 
 using namespace std;
 
+static int failures = 0;
+
+// Reports a failed expectation without stopping the remaining tests.
+static void check(bool cond, const char* what)
+{
+    if(!cond) {
+        cout << "FAILED: " << what << endl;
+        ++failures;
+    }
+}
+
+// Runs random inserts and removes against tree and std::map and checks
+// that both hold the same items in the same order. The map starts out
+// with whatever tree already holds.
+template<typename Tree>
+static void checkAgainstMap(Tree& tree, const char* name, unsigned seed)
+{
+    map<int,int> ref;
+    for(typename Tree::iterator it = tree.begin(); it != tree.end(); ++it) {
+        ref[it->first] = it->second;
+    }
+    srand(seed);
+    for(int i = 0; i < 4000; ++i) {
+        int key = rand() % 500;
+        int op = rand() % 4;
+        if(op == 3) {
+            bool found = tree.find(key) != tree.end();
+            if(found != (ref.count(key) == 1)) {
+                check(false, "find agrees with std::map");
+                return;
+            }
+        }
+        else if(op != 2) {
+            tree.insert(std::make_pair(key, i));
+            ref[key] = i;
+        }
+        else {
+            tree.remove(key);
+            ref.erase(key);
+        }
+    }
+    bool same = true;
+    typename Tree::iterator it = tree.begin();
+    for(map<int,int>::iterator r = ref.begin(); r != ref.end(); ++r, ++it) {
+        if(it == tree.end() || it->first != r->first || it->second != r->second) {
+            same = false;
+            break;
+        }
+    }
+    same = same && it == tree.end();
+    cout << name << " matches std::map: " << same << endl;
+    check(same, name);
+}
+
+// Exposes the root so the red-black invariants can be verified.
+class CheckedRBTree : public RBTree<int,int>
+{
+public:
+    bool valid() const
+    {
+        RBNode<int,int>* root = static_cast<RBNode<int,int>*>(root_);
+        return root == NULL || (!root->isRed() && blackHeight(root) >= 0);
+    }
+
+private:
+    // Returns the black-height of n, or -1 if a rule is broken below it.
+    static int blackHeight(RBNode<int,int>* n)
+    {
+        if(n == NULL) {
+            return 1;
+        }
+        if(n->isRed() && ((n->getLeft() && n->getLeft()->isRed()) ||
+                          (n->getRight() && n->getRight()->isRed()))) {
+            return -1;
+        }
+        if((n->getLeft() && n->getLeft()->getParent() != n) ||
+           (n->getRight() && n->getRight()->getParent() != n)) {
+            return -1;
+        }
+        int left = blackHeight(n->getLeft());
+        int right = blackHeight(n->getRight());
+        if(left < 0 || left != right) {
+            return -1;
+        }
+        return left + (n->isRed() ? 0 : 1);
+    }
+};
+
+// An AVL tree that can check its stored balances against the real
+// heights, and its parent links.
+template<typename Tree>
+class CheckedAVL : public Tree
+{
+public:
+    bool valid() const
+    {
+        return height(static_cast<AVLNode<int,int>*>(this->root_)) >= 0 &&
+               (this->root_ == NULL || this->root_->getParent() == NULL);
+    }
+
+private:
+    // Returns the height of n, or -1 if a balance or link is wrong below it.
+    static int height(AVLNode<int,int>* n)
+    {
+        if(n == NULL) {
+            return 0;
+        }
+        if((n->getLeft() && n->getLeft()->getParent() != n) ||
+           (n->getRight() && n->getRight()->getParent() != n)) {
+            return -1;
+        }
+        int left = height(n->getLeft());
+        int right = height(n->getRight());
+        if(left < 0 || right < 0 || right - left != n->getBalance()) {
+            return -1;
+        }
+        return std::max(left, right) + 1;
+    }
+};
+
+// Hinted inserts and finger searches on nearly sorted keys.
+static void testFinger()
+{
+    AVLTree<int,int> tree;
+    map<int,int> ref;
+    AVLTree<int,int>::iterator last = tree.end();
+    srand(10);
+    for(int i = 0; i < 3000; ++i) {
+        int key = (i % 3 == 0) ? i * 2 : i * 2 - rand() % 40;
+        last = tree.insert(last, std::make_pair(key, i));
+        ref[key] = i;
+        check(last->first == key && last->second == i, "hinted insert returns the item");
+    }
+    for(int i = 6000; i < 7000; ++i) {
+        tree.insert(std::make_pair(i, i));
+        ref[i] = i;
+    }
+    bool same = tree.isBalanced();
+    AVLTree<int,int>::iterator it = tree.begin();
+    for(map<int,int>::iterator r = ref.begin(); same && r != ref.end(); ++r, ++it) {
+        same = it->first == r->first && it->second == r->second;
+    }
+    check(same, "hinted and appending inserts keep order and balance");
+
+    AVLTree<int,int>::iterator finger = tree.find(3000);
+    bool found = true;
+    for(int key = 2900; key < 3100; ++key) {
+        AVLTree<int,int>::iterator hit = tree.find_from(finger, key);
+        found = found && (hit == tree.end() ? ref.count(key) == 0 : hit->first == key);
+    }
+    check(found, "find_from agrees with std::map");
+}
+
+// find_many must give the same answers as find, key by key.
+template<typename Tree>
+static void checkFindMany(Tree& tree, const char* what)
+{
+    srand(11);
+    for(int i = 0; i < 1000; ++i) {
+        tree.insert(std::make_pair(rand() % 2000, i));
+    }
+    vector<int> keys;
+    for(int i = 0; i < 300; ++i) {
+        keys.push_back(rand() % 2100);
+    }
+    vector<typename Tree::iterator> out;
+    tree.find_many(keys, out);
+    bool same = out.size() == keys.size();
+    for(size_t i = 0; same && i < keys.size(); ++i) {
+        same = out[i] == tree.find(keys[i]);
+    }
+    check(same, what);
+}
+
+// Like checkAgainstMap, for RadixTree with keys drawn from a small
+// alphabet so that many of them share prefixes.
+static void testRadixTree()
+{
+    static const char* const parts[] = { "", "a", "ab", "abc", "b", "ba", "http://x/", "http://x/y" };
+    RadixTree<int> tree;
+    map<string,int> ref;
+    srand(9);
+    for(int i = 0; i < 6000; ++i) {
+        string key = string(parts[rand() % 8]) + parts[rand() % 8] + parts[rand() % 8];
+        int op = rand() % 4;
+        if(op == 3) {
+            bool found = tree.find(key) != tree.end();
+            if(found != (ref.count(key) == 1)) {
+                check(false, "RadixTree find agrees with std::map");
+                return;
+            }
+        }
+        else if(op != 2) {
+            tree.insert(std::make_pair(key, i));
+            ref[key] = i;
+        }
+        else {
+            tree.remove(key);
+            ref.erase(key);
+        }
+    }
+    bool same = tree.size() == ref.size();
+    RadixTree<int>::iterator it = tree.begin();
+    for(map<string,int>::iterator r = ref.begin(); same && r != ref.end(); ++r, ++it) {
+        same = it != tree.end() && it->first == r->first && it->second == r->second;
+    }
+    same = same && it == tree.end();
+    cout << "RadixTree matches std::map: " << same << endl;
+    check(same, "RadixTree");
+
+    tree.clear();
+    check(tree.empty() && tree.begin() == tree.end(), "RadixTree clear");
+    tree.insert(std::make_pair(string("key"), 1));
+    tree["key"] = 2;
+    check((*tree.find("key")).second == 2, "RadixTree operator[] writes through");
+    bool threw = false;
+    try {
+        tree["ke"];
+    }
+    catch(std::out_of_range&) {
+        threw = true;
+    }
+    check(threw, "RadixTree operator[] throws on a missing key");
+
+    tree.insert(std::make_pair(string("kettle"), 3));
+    tree.insert(std::make_pair(string("k"), 4));
+    RadixTree<int> copy(tree);
+    copy.insert(std::make_pair(string("kernel"), 5));
+    copy.remove("k");
+    copy["key"] = 6;
+    RadixTree<int> assigned;
+    assigned = copy;
+    RadixTree<int> moved(std::move(assigned));
+    moved.insert(std::make_pair(string("x"), 7));
+    check(tree.size() == 3 && tree["key"] == 2 && tree.find("kernel") == tree.end() && tree.find("k") != tree.end()
+          && copy.size() == 3 && copy["key"] == 6 && assigned.empty() && assigned.begin() == assigned.end()
+          && moved.size() == 4 && moved["kettle"] == 3, "RadixTree copies are deep");
+}
+
+// Exposes the height of a plain tree for the scapegoat checks.
+class HeightBST : public BinarySearchTree<int,int>
+{
+public:
+    int height() const
+    {
+        return height(root_);
+    }
+
+private:
+    static int height(Node<int,int>* n)
+    {
+        return n == NULL ? 0 : 1 + max(height(n->getLeft()), height(n->getRight()));
+    }
+};
+
+static void testScapegoat()
+{
+    HeightBST tree;
+    tree.enableScapegoat(0.7);
+    checkAgainstMap(tree, "BinarySearchTree (scapegoat)", 12);
+    tree.clear();
+    for(int i = 0; i < 20000; ++i) {
+        tree.insert(std::make_pair(i, i));
+    }
+    // log base 1/0.7 of 20000 is about 27.8
+    check(tree.height() <= 29, "scapegoat keeps sorted inserts shallow");
+    for(int i = 0; i < 19000; ++i) {
+        tree.remove(i);
+    }
+    check(tree.height() <= 22 && tree.size() == 1000, "scapegoat rebuilds after removals");
+
+    HeightBST sorted;
+    for(int i = 0; i < 1000; ++i) {
+        sorted.insert(std::make_pair(i, i));
+    }
+    sorted.enableScapegoat();
+    check(sorted.height() == 10, "enabling scapegoat mode rebuilds the tree");
+}
+
+// True when both trees hold the same items in the same order.
+template<typename Tree>
+static bool sameItems(Tree& a, Tree& b)
+{
+    typename Tree::iterator x = a.begin();
+    typename Tree::iterator y = b.begin();
+    for(; x != a.end() && y != b.end(); ++x, ++y) {
+        if(x->first != y->first || x->second != y->second) {
+            return false;
+        }
+    }
+    return x == a.end() && y == b.end() && a.size() == b.size();
+}
+
+// Copies with a fixed thread count, so the parallel path is covered on
+// any machine.
+template<typename Value>
+class ThreadedCopyAVLTree : public AVLTree<int,Value>
+{
+public:
+    ThreadedCopyAVLTree(const AVLTree<int,Value>& other, unsigned threads) { this->cloneFrom(other, threads); }
+};
+
+// Counts the live values; the copy that brings failAfter down to zero
+// throws.
+struct CountedValue {
+    static atomic<long> live;
+    static atomic<long> failAfter;
+    CountedValue() { ++live; }
+    CountedValue(const CountedValue&) {
+        if(failAfter.fetch_sub(1) == 1) {
+            throw runtime_error("CountedValue copy");
+        }
+        ++live;
+    }
+    ~CountedValue() { --live; }
+    friend ostream& operator<<(ostream& out, const CountedValue&) { return out << '.'; }
+};
+atomic<long> CountedValue::live(0);
+atomic<long> CountedValue::failAfter(0);
+
+// Copies the tree with the failAfter-th value copy throwing; true if it
+// threw and left no copied value behind.
+static bool copyUnwinds(const AVLTree<int,CountedValue>& tree, long failAfter, unsigned threads)
+{
+    long before = CountedValue::live;
+    CountedValue::failAfter = failAfter;
+    bool threw = false;
+    try {
+        ThreadedCopyAVLTree<CountedValue> copy(tree, threads);
+    }
+    catch(const runtime_error&) {
+        threw = true;
+    }
+    CountedValue::failAfter = 0;
+    return threw && CountedValue::live == before;
+}
+
+// A copy that throws partway destroys what it copied, on one thread or
+// several, and a throwing assignment leaves its target as it was.
+static void testCloneUnwinds()
+{
+    AVLTree<int,CountedValue> small;
+    small.enableHashIndex();
+    for(int i = 0; i < 1000; ++i) {
+        small.insert(std::make_pair(i, CountedValue()));
+    }
+    check(copyUnwinds(small, 1, 1) && copyUnwinds(small, 600, 1), "a throwing copy unwinds");
+
+    AVLTree<int,CountedValue> target;
+    for(int i = 0; i < 10; ++i) {
+        target.insert(std::make_pair(-i, CountedValue()));
+    }
+    CountedValue::failAfter = 300;
+    bool threw = false;
+    try {
+        target = small;
+    }
+    catch(const runtime_error&) {
+        threw = true;
+    }
+    CountedValue::failAfter = 0;
+    check(threw && target.size() == 10 && target.find(-9) != target.end() && target.isBalanced()
+          && CountedValue::live == 1010, "a throwing copy assignment leaves the target alone");
+
+    // large enough for the parallel clone: fail in the top levels, then
+    // in a worker
+    AVLTree<int,CountedValue> big;
+    for(int i = 0; i < 70000; ++i) {
+        big.insert(std::make_pair(i, CountedValue()));
+    }
+    check(copyUnwinds(big, 3, 4) && copyUnwinds(big, 40000, 4), "a throwing parallel copy unwinds");
+    ThreadedCopyAVLTree<CountedValue> bigCopy(big, 4);
+    check(bigCopy.size() == 70000 && bigCopy.isBalanced(), "a parallel copy works after one threw");
+}
+
+// Structural copies must equal the original, stay independent of it
+// and keep working as trees of their kind; moves must empty the source.
+static void testClone()
+{
+    AVLTree<int,int> avl;
+    avl.enableTombstones(0.3);
+    avl.enableHashIndex();
+    checkAgainstMap(avl, "AVLTree before copying", 13);
+    AVLTree<int,int> avlCopy(avl);
+    check(sameItems(avl, avlCopy) && avlCopy.hasHashIndex(), "AVLTree copy matches the original");
+    checkAgainstMap(avlCopy, "AVLTree copy after more updates", 14);
+    check(avlCopy.isBalanced() && avl.isBalanced(), "AVLTree copy keeps its balances");
+    check(!sameItems(avl, avlCopy), "AVLTree copy is independent of the original");
+
+    CheckedRBTree rb;
+    checkAgainstMap(rb, "RBTree before copying", 15);
+    CheckedRBTree rbCopy;
+    rbCopy.insert(std::make_pair(-1, -1));
+    rbCopy = rb;
+    check(sameItems(rb, rbCopy) && rbCopy.valid(), "RBTree copy assignment matches the original");
+    checkAgainstMap(rbCopy, "RBTree copy after more updates", 16);
+    check(rbCopy.valid(), "RBTree copy keeps red-black invariants");
+
+    BinarySearchTree<int,int> plain;
+    for(int i = 0; i < 5000; ++i) {
+        plain.insert(std::make_pair(i, i));
+    }
+    BinarySearchTree<int,int> plainCopy(plain);
+    check(sameItems(plain, plainCopy), "copying a degenerate tree");
+    BinarySearchTree<int,int> moved(std::move(plainCopy));
+    check(plainCopy.empty() && plainCopy.begin() == plainCopy.end() && moved.size() == 5000,
+          "move construction takes the nodes");
+    plainCopy = std::move(moved);
+    check(moved.empty() && sameItems(plain, plainCopy), "move assignment takes the nodes");
+    plainCopy.insert(std::make_pair(-1, 0));
+    check(plainCopy.size() == 5001 && plain.size() == 5000, "moved-to tree keeps working");
+
+    // large enough for the parallel clone
+    AVLTree<int,int> big;
+    for(int i = 0; i < 200000; ++i) {
+        big.insert(std::make_pair((i * 7919) % 200000, i));
+    }
+    ThreadedCopyAVLTree<int> bigCopy(big, 4);
+    check(sameItems<AVLTree<int,int> >(big, bigCopy) && bigCopy.isBalanced(),
+          "parallel copy matches the original");
+    for(int i = 0; i < 200000; i += 2) {
+        bigCopy.remove(i);
+    }
+    check(bigCopy.size() == 100000 && bigCopy.isBalanced() && big.size() == 200000,
+          "parallel copy supports removals");
+}
+
+// Concatenates keys in order, to check that reduce respects key order.
+struct ConcatMonoid
+{
+    typedef string value_type;
+    static string identity() { return ""; }
+    static string lift(const int& key, const int&) { return string(1, (char)('a' + key % 26)); }
+    static string combine(const string& a, const string& b) { return a + b; }
+};
+
+// Random updates against std::map, checking reduce on random ranges
+// against a walk over the map.
+template<typename Monoid>
+static bool reduceAgrees(AugmentedAVLTree<int,int,Monoid>& tree, map<int,int>& ref, unsigned seed, int ops)
+{
+    srand(seed);
+    for(int i = 0; i < ops; ++i) {
+        int key = rand() % 600;
+        if(rand() % 3 != 0) {
+            tree.insert(std::make_pair(key, rand() % 1000 - 500));
+            ref[key] = tree.find(key)->second;
+        }
+        else {
+            tree.remove(key);
+            ref.erase(key);
+        }
+        int lo = rand() % 650 - 25;
+        int hi = lo + rand() % 200;
+        typename Monoid::value_type expect = Monoid::identity();
+        for(map<int,int>::iterator it = ref.lower_bound(lo); it != ref.end() && it->first < hi; ++it) {
+            expect = Monoid::combine(expect, Monoid::lift(it->first, it->second));
+        }
+        if(!(tree.reduce(lo, hi) == expect)) {
+            return false;
+        }
+    }
+    typename Monoid::value_type all = Monoid::identity();
+    for(map<int,int>::iterator it = ref.begin(); it != ref.end(); ++it) {
+        all = Monoid::combine(all, Monoid::lift(it->first, it->second));
+    }
+    return tree.reduce() == all && tree.isBalanced();
+}
+
+static void testAugmented()
+{
+    AugmentedAVLTree<int,int,SumMonoid<int> > sum;
+    map<int,int> sumRef;
+    check(reduceAgrees(sum, sumRef, 17, 4000), "AugmentedAVLTree sums agree with std::map");
+    AugmentedAVLTree<int,int,SumMonoid<int> > sumCopy(sum);
+    check(reduceAgrees(sumCopy, sumRef, 18, 1000), "AugmentedAVLTree copy keeps its sums");
+
+    AugmentedAVLTree<int,int,MinMonoid<int> > lazyMin;
+    lazyMin.enableTombstones(0.3);
+    map<int,int> minRef;
+    check(reduceAgrees(lazyMin, minRef, 19, 4000), "AugmentedAVLTree minimum with tombstones");
+
+    AugmentedAVLTree<int,int,ConcatMonoid> concat;
+    map<int,int> concatRef;
+    check(reduceAgrees(concat, concatRef, 20, 2000), "AugmentedAVLTree combines in key order");
+}
+
+// Overlap and stabbing queries against a brute-force scan of a map.
+static void testIntervalTree()
+{
+    IntervalTree<int,int> tree;
+    map<pair<int,int>,int> ref;
+    tree.enableTombstones(0.4);
+    srand(21);
+    bool same = true;
+    for(int i = 0; i < 3000 && same; ++i) {
+        int start = rand() % 1000;
+        int end = start + (rand() % 8 == 0 ? rand() % 300 : rand() % 20);
+        if(rand() % 4 != 0) {
+            tree.insert(start, end, i);
+            ref[make_pair(start, end)] = i;
+        }
+        else if(!ref.empty()) {
+            map<pair<int,int>,int>::iterator victim = ref.lower_bound(make_pair(start, 0));
+            if(victim == ref.end()) {
+                victim = ref.begin();
+            }
+            tree.remove(Interval<int>(victim->first.first, victim->first.second));
+            ref.erase(victim);
+        }
+        int lo = rand() % 1100 - 50;
+        int hi = (i % 2 == 0) ? lo : lo + rand() % 40;
+        vector<IntervalTree<int,int>::iterator> found;
+        if(lo == hi) {
+            tree.stabbing(lo, found);
+        }
+        else {
+            tree.overlapping(lo, hi, found);
+        }
+        size_t k = 0;
+        for(map<pair<int,int>,int>::iterator it = ref.begin(); it != ref.end() && same; ++it) {
+            if(it->first.first <= hi && it->first.second >= lo) {
+                same = k < found.size() && found[k]->first.start == it->first.first &&
+                       found[k]->first.end == it->first.second && found[k]->second == it->second;
+                ++k;
+            }
+        }
+        same = same && k == found.size();
+    }
+    check(same && tree.isBalanced(), "IntervalTree overlap and stabbing queries agree with a scan");
+}
+
+// Reads a string through a stream buffer that cannot seek.
+struct OneWayBuf : public streambuf {
+    explicit OneWayBuf(string& s) { setg(&s[0], &s[0], &s[0] + s.size()); }
+};
+
+// Records a workload through RecordingTree, reads the trace back and
+// replays it into a fresh tree, which must end up identical.
+static void testTrace()
+{
+    ostringstream out;
+    vector<TraceRecord> expect;
+    {
+        TraceWriter writer(out);
+        RecordingTree<long, long, AVLTree<long,long> > tree(writer);
+        srand(22);
+        for(int i = 0; i < 20000; ++i) {
+            long key = rand() % 3000 - 1000;
+            int op = rand() % 10;
+            if(op < 5) {
+                if(op == 4) {
+                    tree.insert(tree.end(), std::make_pair(key, (long)i * 1000003));
+                }
+                else {
+                    tree.insert(std::make_pair(key, (long)i * 1000003));
+                }
+                TraceRecord rec = { TRACE_INSERT, key, (long)i * 1000003 };
+                expect.push_back(rec);
+            }
+            else if(op < 7) {
+                tree.remove(key);
+                TraceRecord rec = { TRACE_REMOVE, key, 0 };
+                expect.push_back(rec);
+            }
+            else {
+                RecordingTree<long, long, AVLTree<long,long> >::iterator it = tree.find(key);
+                TraceRecord rec = { TRACE_FIND, key, 0 };
+                expect.push_back(rec);
+                int steps = 0;
+                for(; op == 9 && steps < 5 && it != tree.end(); ++steps) {
+                    ++it;
+                }
+                if(steps > 0) {
+                    TraceRecord scan = { TRACE_SCAN, key, steps };
+                    expect.push_back(scan);
+                }
+            }
+        }
+        // a second thread records into a stream of its own
+        thread other([&writer]() {
+            RecordingTree<long, long, AVLTree<long,long> > mine(writer);
+            for(long i = 0; i < 100; ++i) {
+                mine.insert(std::make_pair(i, i));
+            }
+        });
+        other.join();
+    }
+
+    TraceStreams streams;
+    istringstream in(out.str());
+    readTrace(in, streams);
+    bool same = streams.size() == 2 && streams[0].size() == expect.size() && streams[1].size() == 100;
+    for(size_t i = 0; same && i < expect.size(); ++i) {
+        same = streams[0][i].op == expect[i].op && streams[0][i].key == expect[i].key &&
+               streams[0][i].arg == expect[i].arg;
+    }
+    check(same, "trace reads back as recorded");
+
+    AVLTree<long,long> replayed;
+    AVLTree<long,long> direct;
+    for(size_t i = 0; i < expect.size(); ++i) {
+        applyTraceRecord<long, long>(replayed, streams[0][i]);
+        applyTraceRecord<long, long>(direct, expect[i]);
+    }
+    check(sameItems(replayed, direct) && replayed.size() > 0, "trace replays to the same tree");
+
+    // erases are recorded as a remove per item and clears as clears, so
+    // a trace of them still replays to the tree that recorded it, with
+    // or without tombstones
+    for(int lazy = 0; lazy < 2; ++lazy) {
+        ostringstream erasing;
+        AVLTree<long,long> recorded;
+        {
+            TraceWriter writer(erasing);
+            RecordingTree<long, long, AVLTree<long,long> > tree(writer);
+            if(lazy) {
+                tree.enableTombstones(0.9);
+            }
+            AVLTree<long,long>& base = tree;
+            srand(23);
+            for(int round = 0; round < 60; ++round) {
+                for(int i = 0; i < 200; ++i) {
+                    tree.insert(std::make_pair((long)(rand() % 5000), (long)i));
+                }
+                tree.remove(rand() % 5000);
+                AVLTree<long,long>::iterator it = base.begin();
+                for(int step = rand() % 100; step > 0 && it != base.end(); --step) {
+                    ++it;
+                }
+                if(it != base.end()) {
+                    it = tree.erase(it);
+                }
+                AVLTree<long,long>::iterator last = it;
+                for(int step = rand() % 60; step > 0 && last != base.end(); --step) {
+                    ++last;
+                }
+                base.erase(it, last);
+                if(round % 20 == 10) {
+                    base.clear();
+                }
+            }
+            recorded = base;
+        }
+        TraceStreams erased;
+        istringstream erasedIn(erasing.str());
+        readTrace(erasedIn, erased);
+        AVLTree<long,long> replay;
+        bool cleared = false;
+        for(size_t i = 0; erased.size() == 1 && i < erased[0].size(); ++i) {
+            cleared = cleared || erased[0][i].op == TRACE_CLEAR;
+            applyTraceRecord<long, long>(replay, erased[0][i]);
+        }
+        check(cleared && recorded.size() > 0 && sameItems(replay, recorded),
+              lazy ? "a trace of erases with tombstones replays to the same tree" : "a trace of erases replays to the same tree");
+    }
+
+    bool threw = false;
+    try {
+        istringstream cut(out.str().substr(0, out.str().size() - 3));
+        TraceStreams partial;
+        readTrace(cut, partial);
+    }
+    catch(const runtime_error&) {
+        threw = true;
+    }
+    check(threw, "truncated trace is rejected");
+
+    // a block header claiming far more bytes than follow, read from a
+    // stream that can seek and from one that cannot
+    string bogus(TRACE_MAGIC, sizeof(TRACE_MAGIC));
+    tracePutVarint(bogus, 0);
+    tracePutVarint(bogus, (uint64_t)1 << 60);
+    bogus += "abc";
+    int rejected = 0;
+    for(int seekable = 0; seekable < 2; ++seekable) {
+        try {
+            istringstream seeking(bogus);
+            OneWayBuf oneWay(bogus);
+            istream forward(&oneWay);
+            TraceStreams partial;
+            readTrace(seekable ? static_cast<istream&>(seeking) : forward, partial);
+        }
+        catch(const runtime_error&) {
+            ++rejected;
+        }
+    }
+    check(rejected == 2, "a block length past the end of the trace is rejected");
+
+    // block headers are two varints, at most 20 bytes between them
+    string endless(TRACE_MAGIC, sizeof(TRACE_MAGIC));
+    endless += string(4096, (char)0x80);
+    bool headerRejected = false;
+    try {
+        istringstream in(endless);
+        TraceStreams partial;
+        readTrace(in, partial);
+    }
+    catch(const runtime_error& e) {
+        headerRejected = string(e.what()) == "trace: block header too long";
+    }
+    check(headerRejected, "an overlong block header is rejected");
+}
+
+// A compile-time table: built, searched and checked by the compiler.
+static constexpr pair<int,int> opcodes[] = {
+    { 0x90, 1 }, { 0x01, 2 }, { 0xc3, 3 }, { 0x50, 4 }, { 0x58, 5 }, { 0xe8, 6 }, { 0x0f, 7 }
+};
+static constexpr StaticSearchTree<int,int,7> opcodeTable(opcodes);
+static_assert(opcodeTable.find(0xc3)->second == 3, "constexpr find");
+static_assert(opcodeTable.find(0x91) == opcodeTable.end(), "constexpr find of a missing key");
+static_assert(opcodeTable.begin()->first == 0x01, "constexpr begin is the smallest key");
+static_assert(opcodeTable[0xe8] == 6, "constexpr operator[]");
+
+static constexpr int scatteredKey(size_t i)
+{
+    return (int)((i * 7919) % 4001);
+}
+
+template<size_t... I>
+static constexpr array<pair<int,int>, sizeof...(I)> scatteredItems(index_sequence<I...>)
+{
+    return {{ pair<int,int>(scatteredKey(I), (int)I)... }};
+}
+
+// Iteration order, lookups of present and absent keys, and operator[]
+// on a larger table built at compile time.
+static void testStaticTree()
+{
+    static constexpr array<pair<int,int>, 500> items = scatteredItems(make_index_sequence<500>());
+    static constexpr StaticSearchTree<int,int,500> table(items);
+    map<int,int> ref(items.begin(), items.end());
+    bool same = table.size() == ref.size();
+    StaticSearchTree<int,int,500>::iterator it = table.begin();
+    for(map<int,int>::iterator r = ref.begin(); same && r != ref.end(); ++r, ++it) {
+        same = it != table.end() && it->first == r->first && it->second == r->second;
+    }
+    check(same && it == table.end(), "StaticSearchTree iterates in key order");
+    bool found = true;
+    for(int key = -10; key < 4100 && found; ++key) {
+        StaticSearchTree<int,int,500>::iterator hit = table.find(key);
+        found = ref.count(key) == 1 ? (hit != table.end() && hit->second == ref[key]) : hit == table.end();
+    }
+    check(found, "StaticSearchTree find agrees with std::map");
+    bool threw = false;
+    try {
+        table[4002];
+    }
+    catch(const out_of_range&) {
+        threw = true;
+    }
+    check(threw, "StaticSearchTree operator[] throws for a missing key");
+}
+
+// Runs random inserts and removes against a tree ordered by
+// greater<int> and checks that it iterates from the largest key down.
+template<typename Tree>
+static bool descendsLikeMap(Tree& tree, unsigned seed)
+{
+    map<int,int,greater<int> > ref;
+    srand(seed);
+    for(int i = 0; i < 3000; ++i) {
+        int key = rand() % 400;
+        if(rand() % 3 == 2) {
+            tree.remove(key);
+            ref.erase(key);
+        }
+        else {
+            tree.insert(std::make_pair(key, i));
+            ref[key] = i;
+        }
+    }
+    typename Tree::iterator it = tree.begin();
+    for(map<int,int,greater<int> >::iterator r = ref.begin(); r != ref.end(); ++r, ++it) {
+        if(it == tree.end() || it->first != r->first || it->second != r->second) {
+            return false;
+        }
+    }
+    return it == tree.end();
+}
+
+// A string order that counts how it is called: compare() once per
+// three-way comparison, operator() once per two-way test.
+struct CountingStringCompare
+{
+    static size_t threeWay;
+    static size_t twoWay;
+    bool operator()(const string& a, const string& b) const
+    {
+        ++twoWay;
+        return a < b;
+    }
+    int compare(const string& a, const string& b) const
+    {
+        ++threeWay;
+        return a.compare(b);
+    }
+};
+size_t CountingStringCompare::threeWay = 0;
+size_t CountingStringCompare::twoWay = 0;
+
+// A case-insensitive order, with the hash and equality that agree with it.
+static string lowered(const string& s)
+{
+    string out(s);
+    for(size_t i = 0; i < out.size(); ++i) {
+        out[i] = (char)tolower((unsigned char)out[i]);
+    }
+    return out;
+}
+
+struct CaselessLess
+{
+    bool operator()(const string& a, const string& b) const { return lowered(a) < lowered(b); }
+};
+
+struct CaselessHash
+{
+    size_t operator()(const string& s) const { return hash<string>()(lowered(s)); }
+};
+
+struct CaselessEqual
+{
+    bool operator()(const string& a, const string& b) const { return lowered(a) == lowered(b); }
+};
+
+// A key with an order but no operator<.
+struct Ticket
+{
+    int id;
+    friend ostream& operator<<(ostream& os, const Ticket& t) { return os << '#' << t.id; }
+};
+
+struct TicketOrder
+{
+    bool operator()(const Ticket& a, const Ticket& b) const { return a.id < b.id; }
+};
+
+static void testCompare()
+{
+    AVLTree<int,int,greater<int> > avl;
+    check(descendsLikeMap(avl, 3) && avl.isBalanced(), "AVLTree ordered by greater<int>");
+    RBTree<int,int,greater<int> > rb;
+    check(descendsLikeMap(rb, 4), "RBTree ordered by greater<int>");
+    SplayTree<int,int,greater<int> > splay;
+    check(descendsLikeMap(splay, 5), "SplayTree ordered by greater<int>");
+    BinarySearchTree<int,int,greater<int> > plain;
+    plain.enableTombstones(0.3);
+    check(descendsLikeMap(plain, 6), "BinarySearchTree with tombstones ordered by greater<int>");
+    AVLTree<int,int,greater<int> > copy(avl);
+    check(sameItems(copy, avl), "a copy keeps the comparator's order");
+
+    BinarySearchTree<string,int,less<> > words;
+    AVLTree<string,int,less<> > avlWords;
+    SplayTree<string,int,less<> > splayWords;
+    const char* names[] = { "pear", "apple", "fig", "kiwi", "plum", "date" };
+    for(int i = 0; i < 6; ++i) {
+        words.insert(std::make_pair(string(names[i]), i));
+        avlWords.insert(std::make_pair(string(names[i]), i));
+        splayWords.insert(std::make_pair(string(names[i]), i));
+    }
+    string_view fig("figs", 3);
+    check(words.find("kiwi")->second == 3 && words.find(fig)->second == 2 && words.find("lime") == words.end(),
+          "BinarySearchTree find by const char* and string_view");
+    check(avlWords.find("date")->second == 5 && avlWords.find(string_view("apricot")) == avlWords.end(),
+          "AVLTree find by const char* and string_view");
+    check(splayWords.find("plum")->second == 4 && splayWords.find(string("pear"))->second == 0,
+          "SplayTree find by const char* and string");
+    words.remove("kiwi");
+    check(words.find("kiwi") == words.end(), "transparent find misses a removed key");
+
+    AVLTree<string,int,CountingStringCompare> counted;
+    for(int i = 0; i < 1000; ++i) {
+        counted.insert(std::make_pair(to_string(i * 7919 % 1000), i));
+    }
+    CountingStringCompare::threeWay = CountingStringCompare::twoWay = 0;
+    for(int i = 0; i < 1000; ++i) {
+        counted.find(to_string(i));
+    }
+    // an AVL tree of 1000 keys is at most 14 levels deep
+    check(CountingStringCompare::twoWay == 0 && CountingStringCompare::threeWay <= 1000 * 14,
+          "find makes one three-way comparison per level");
+
+    // the hash index must agree with the order; a custom order brings
+    // its own hash and equality (the defaults do not compile with it)
+    AVLTree<string,int,CaselessLess> fruit;
+    fruit.insert(std::make_pair(string("Apple"), 1));
+    fruit.insert(std::make_pair(string("pear"), 2));
+    bool plainFound = fruit.find("apple") != fruit.end();
+    fruit.enableHashIndex<CaselessHash, CaselessEqual>();
+    fruit.insert(std::make_pair(string("PEAR"), 3));
+    check(plainFound && fruit.find("apple") != fruit.end() && fruit.find("Pear")->second == 3 && fruit.size() == 2,
+          "the hash index follows a case-insensitive order");
+
+    // printing orders its placeholders by the tree's comparator
+    BinarySearchTree<Ticket,int,TicketOrder> tickets;
+    for(int i = 0; i < 5; ++i) {
+        Ticket t = { (i * 3) % 5 };
+        tickets.insert(std::make_pair(t, i));
+    }
+    tickets.print();
+}
+
+// Counts the lines in text.
+static size_t countLines(const string& text)
+{
+    size_t lines = 0;
+    for(size_t i = 0; i < text.size(); ++i) {
+        lines += text[i] == '\n';
+    }
+    return lines;
+}
+
+static void testExport()
+{
+    AVLTree<int,int> avl;
+    for(int key = 1; key <= 7; ++key) {
+        avl.insert(std::make_pair(key, key * 10));
+    }
+    avl.remove(7);
+    ostringstream ascii;
+    avl.writeAscii(ascii);
+    check(ascii.str() == "4 b=0\n"
+                         "|-- L 2 b=0\n"
+                         "|   |-- L 1 b=0\n"
+                         "|   `-- R 3 b=0\n"
+                         "`-- R 6 b=-1\n"
+                         "    `-- L 5 b=0\n", "writeAscii outlines an AVLTree");
+    ostringstream cut;
+    avl.writeAscii(cut, 5, 1, 1);
+    check(cut.str() == "6 b=-1 ...\n", "writeAscii around a key stops at the level limit");
+    ostringstream rbDump;
+    RBTree<int,int> rb;
+    rb.insert(std::make_pair(1, 1));
+    rb.insert(std::make_pair(2, 2));
+    rb.writePreorder(rbDump);
+    check(rbDump.str() == "1 1 black\n2 2 red\n", "writePreorder shows RBTree colors");
+
+    // a preorder dump rebuilds the same unbalanced tree
+    BinarySearchTree<int,int> random;
+    srand(11);
+    for(int i = 0; i < 3000; ++i) {
+        random.insert(std::make_pair(rand() % 5000, i));
+    }
+    ostringstream dump;
+    random.writePreorder(dump);
+    BinarySearchTree<int,int> rebuilt;
+    istringstream in(dump.str());
+    int key, value;
+    while(in >> key >> value) {
+        rebuilt.insert(std::make_pair(key, value));
+    }
+    ostringstream again;
+    rebuilt.writePreorder(again);
+    check(again.str() == dump.str() && countLines(dump.str()) == random.size(),
+          "writePreorder round-trips an unbalanced tree");
+
+    // a 200000-level path, far too deep for a recursive walk
+    BinarySearchTree<int,int> path;
+    for(int i = 0; i < 200000; ++i) {
+        path.insert(std::make_pair(i, i));
+    }
+    ostringstream deepDump, deepDot, deepAscii;
+    path.writePreorder(deepDump);
+    path.writeDot(deepDot);
+    path.writeAscii(deepAscii, 199990, 3, 2);
+    string dot = deepDot.str();
+    size_t edges = 0;
+    for(size_t at = dot.find(" -> "); at != string::npos; at = dot.find(" -> ", at + 1)) {
+        ++edges;
+    }
+    check(countLines(deepDump.str()) == 200000, "writePreorder walks a degenerate tree");
+    // each node but the leaf has its real edge and an invisible one
+    check(edges == 2 * (200000 - 1), "writeDot walks a degenerate tree");
+    check(deepAscii.str() == "199988\n`-- R 199989\n    `-- R 199990 ...\n",
+          "writeAscii shows the neighbourhood of a deep key");
+    path.clear();
+    check(path.empty() && path.begin() == path.end(), "clear takes apart a degenerate tree");
+}
+
+static void testProfile()
+{
+    AVLTree<int,int> perfect;
+    for(int key = 1; key <= 7; ++key) {
+        perfect.insert(std::make_pair(key, key));
+    }
+    TreeProfile shape = perfect.profile();
+    check(shape.nodes == 7 && shape.height == 3 && shape.optimalHeight == 3 && shape.links == 6,
+          "profile counts nodes, levels and links");
+    check(shape.levelCounts.size() == 3 && shape.levelCounts[2] == 4 && shape.averagePath == shape.optimalAveragePath,
+          "profile of a complete tree matches the optimum");
+    check(shape.balanceCounts.size() == 3 && shape.balanceCounts[1] == 7, "profile counts AVL balance factors");
+    check(shape.allocatedBytes >= 7 * shape.nodeBytes && shape.arenaNodes == 0, "profile counts heap bytes");
+
+    AVLTree<int,int> copy(perfect);
+    TreeProfile copied = copy.profile();
+    check(copied.arenaNodes == 7 && copied.allocatedBytes == 7 * copied.nodeBytes,
+          "profile sees a structural copy's arena");
+
+    BinarySearchTree<int,int> path;
+    for(int key = 0; key < 10; ++key) {
+        path.insert(std::make_pair(key, key));
+    }
+    path.enableTombstones(0.9);
+    path.remove(3);
+    TreeProfile chain = path.profile();
+    check(chain.height == 10 && chain.averagePath == 5.5 && chain.optimalHeight == 4 && chain.deadNodes == 1,
+          "profile of a degenerate tree");
+    check(chain.balanceCounts.empty(), "a plain tree reports no balance factors");
+    ostringstream report;
+    chain.writeText(report);
+    check(report.str().find("height 10, optimal 4") != string::npos, "writeText reports the height");
+}
+
+// Relaxed AVL: updates leave their rebalancing pending, and budgeted
+// steps or the maintenance thread restore a valid AVL tree.
+static void testRelaxed()
+{
+    RelaxedAVLTree<int,int> lazy;
+    checkAgainstMap(lazy, "RelaxedAVLTree with no rebalancing", 21);
+    check(lazy.pendingRebalance() > 0, "relaxed updates leave rebalancing pending");
+    size_t steps = 0;
+    while(lazy.rebalance_step(8) > 0) {
+        ++steps;
+    }
+    TreeProfile settled = lazy.profile();
+    check(steps > 1 && lazy.isBalanced() && settled.balanceViolations == 0,
+          "budgeted rebalance steps restore AVL balance");
+    checkAgainstMap(lazy, "RelaxedAVLTree after rebalancing", 22);
+
+    RelaxedAVLTree<int,int> chain;
+    for(int key = 0; key < 2000; ++key) {
+        chain.insert(std::make_pair(key, key));
+    }
+    check(chain.profile().height == 2000, "sorted inserts without rebalancing build a path");
+    chain.rebalance();
+    check(chain.isBalanced() && chain.profile().height <= 15, "rebalancing a path");
+
+    RelaxedAVLTree<int,int> stepped;
+    bool matches = true;
+    for(int i = 0; i < 3000 && matches; ++i) {
+        int key = i % 2 ? 3000 - i : i;
+        stepped.insert(std::make_pair(key, i));
+        stepped.rebalance_step(4);
+        matches = stepped.find(key) != stepped.end();
+        if(i % 3 == 0) {
+            stepped.remove(i / 2);
+        }
+    }
+    stepped.rebalance();
+    check(matches && stepped.isBalanced() && stepped.pendingRebalance() == 0,
+          "interleaved rebalance steps");
+
+    RelaxedAVLTree<int,int> copy(lazy);
+    RelaxedAVLTree<int,int> unsettled;
+    checkAgainstMap(unsettled, "RelaxedAVLTree before copying", 23);
+    RelaxedAVLTree<int,int> unsettledCopy(unsettled);
+    check(copy.isBalanced() && sameItems(copy, lazy), "copy of a settled relaxed tree");
+    check(unsettledCopy.isBalanced() && unsettledCopy.pendingRebalance() == 0 && sameItems(unsettledCopy, unsettled),
+          "copy of a relaxed tree with pending rebalancing is balanced");
+    RelaxedAVLTree<int,int> moved(std::move(unsettled));
+    check(moved.pendingRebalance() > 0 && unsettled.pendingRebalance() == 0 && unsettled.empty(),
+          "moving a relaxed tree takes its pending work");
+    moved.rebalance();
+    check(moved.isBalanced(), "moved relaxed tree rebalances");
+
+    RelaxedAVLTree<int,int> tombs;
+    tombs.enableTombstones(0.3);
+    checkAgainstMap(tombs, "RelaxedAVLTree with tombstones", 24);
+    tombs.compact();
+    tombs.rebalance();
+    check(tombs.isBalanced() && tombs.profile().balanceViolations == 0, "relaxed tree after compaction");
+
+    RelaxedAVLTree<int,int> background;
+    background.startMaintenance(16, std::chrono::microseconds(50));
+    vector<thread> writers;
+    for(int t = 0; t < 2; ++t) {
+        writers.push_back(thread([&background, t]() {
+            for(int i = 0; i < 5000; ++i) {
+                std::lock_guard<std::mutex> guard(background.mutex());
+                background.insert(std::make_pair(i * 2 + t, i));
+                if(i % 4 == 3) {
+                    background.remove(i * 2 + t - 4);
+                }
+            }
+        }));
+    }
+    for(size_t t = 0; t < writers.size(); ++t) {
+        writers[t].join();
+    }
+    while(true) {
+        {
+            std::lock_guard<std::mutex> guard(background.mutex());
+            if(background.pendingRebalance() == 0) {
+                break;
+            }
+        }
+        this_thread::sleep_for(std::chrono::microseconds(100));
+    }
+    background.stopMaintenance();
+    check(background.isBalanced() && background.size() == 7500, "maintenance thread rebalances in the background");
+}
+
+// Returns true if the durable tree holds exactly ref's items.
+static bool durableMatches(const DurableTree<int,int>& tree, const map<int,int>& ref)
+{
+    if(tree.size() != ref.size()) {
+        return false;
+    }
+    for(map<int,int>::const_iterator r = ref.begin(); r != ref.end(); ++r) {
+        int value;
+        if(!tree.lookup(r->first, value) || value != r->second) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Write-ahead logging: reopening recovers the checkpoint plus the log,
+// a torn tail is cut off, and concurrent writers share commits.
+static void testDurable()
+{
+    string path = "/tmp/bst-test-wal-" + to_string(getpid());
+    string files[] = { path + ".wal", path + ".snap" };
+    map<int,int> ref;
+    WalOptions options;
+    options.sync = false;
+    {
+        DurableTree<int,int> tree(path, options);
+        check(tree.size() == 0 && tree.recoveredRecords() == 0, "a new durable tree starts empty");
+        srand(31);
+        for(int i = 0; i < 2000; ++i) {
+            int key = rand() % 300;
+            if(rand() % 3 == 0) {
+                tree.remove(key);
+                ref.erase(key);
+            }
+            else {
+                tree.insert(std::make_pair(key, i));
+                ref[key] = i;
+            }
+        }
+    }
+    {
+        DurableTree<int,int> tree(path, options);
+        check(tree.recoveredRecords() == 2000 && durableMatches(tree, ref), "recovery replays the log");
+        tree.checkpoint();
+        for(int i = 0; i < 100; ++i) {
+            tree.insert(std::make_pair(1000 + i, i));
+            ref[1000 + i] = i;
+        }
+        tree.remove(1050);
+        ref.erase(1050);
+    }
+    {
+        DurableTree<int,int> tree(path, options);
+        check(tree.recoveredRecords() == 101 && durableMatches(tree, ref),
+              "recovery loads the checkpoint and replays only the newer log");
+    }
+
+    // a crash in the middle of writing a block leaves a torn tail
+    int fd = ::open(files[0].c_str(), O_WRONLY | O_APPEND);
+    const char torn[] = { 40, 1, 2, 3, 4, 0, 7 };
+    check(fd >= 0 && ::write(fd, torn, sizeof(torn)) == (ssize_t)sizeof(torn), "appending a torn block");
+    ::close(fd);
+    {
+        DurableTree<int,int> tree(path, options);
+        check(tree.discardedTailBytes() == sizeof(torn) && durableMatches(tree, ref), "recovery drops a torn tail");
+        tree.insert(std::make_pair(-1, -1));
+        ref[-1] = -1;
+    }
+    {
+        DurableTree<int,int> tree(path, options);
+        check(tree.discardedTailBytes() == 0 && durableMatches(tree, ref), "the log continues after the cut");
+    }
+
+    options.sync = true;
+    options.commitInterval = std::chrono::microseconds(200);
+    options.checkpointBytes = 4096;
+    {
+        DurableTree<int,int> tree(path, options);
+        vector<thread> writers;
+        for(int t = 0; t < 4; ++t) {
+            writers.push_back(thread([&tree, t]() {
+                for(int i = 0; i < 300; ++i) {
+                    tree.insert(std::make_pair(10000 + i * 4 + t, t));
+                }
+            }));
+        }
+        for(size_t t = 0; t < writers.size(); ++t) {
+            writers[t].join();
+        }
+        for(int i = 0; i < 1200; ++i) {
+            ref[10000 + i] = i % 4;
+        }
+        check(tree.commits() < 1200 && tree.checkpoints() > 0, "concurrent writers share group commits");
+    }
+    {
+        DurableTree<int,int> tree(path, options);
+        check(durableMatches(tree, ref), "recovery after group commits and automatic checkpoints");
+    }
+
+    // a log whose header does not parse is refused, not truncated
+    fd = ::open(files[0].c_str(), O_WRONLY | O_TRUNC);
+    const char foreign[] = "not a log at all";
+    check(fd >= 0 && ::write(fd, foreign, sizeof(foreign)) == (ssize_t)sizeof(foreign), "overwriting the log");
+    ::close(fd);
+    bool refused = false;
+    try {
+        DurableTree<int,int> tree(path, options);
+    }
+    catch(const runtime_error&) {
+        refused = true;
+    }
+    struct stat st;
+    check(refused && ::stat(files[0].c_str(), &st) == 0 && st.st_size == (off_t)sizeof(foreign),
+          "a log with a bad header is refused and kept");
+    for(size_t i = 0; i < 2; ++i) {
+        ::unlink(files[i].c_str());
+    }
+}
+
+// Values kept out of the nodes: the proxy iterator, in-place values
+// and copies.
+static void testSplit()
+{
+    SplitAVLTree<int,int> split;
+    checkAgainstMap(split, "SplitAVLTree", 25);
+    check(split.isBalanced(), "SplitAVLTree stays balanced");
+    check(sizeof(AVLNode<int, uint32_t>) == sizeof(AVLNode<int,int>), "SplitAVLTree nodes hold a 32-bit value index");
+
+    SplitAVLTree<int,string> names;
+    for(int i = 0; i < 3000; ++i) {
+        names.insert(std::make_pair(i, string(40, (char)('a' + i % 26))));
+    }
+    string& kept = names[1235];
+    for(int i = 0; i < 3000; i += 2) {
+        names.remove(i);
+    }
+    for(int i = 3000; i < 4500; ++i) {
+        names.insert(std::make_pair(i, "new"));
+    }
+    check(&names[1235] == &kept, "values stay in place across inserts and removes");
+    check(names.size() == 3000 && names[1235] == string(40, (char)('a' + 1235 % 26)) && names[4000] == "new",
+          "removed value slots are reused");
+    names.find(1235)->second = "changed";
+    check(names[1235] == "changed" && (*names.find(1237)).first == 1237, "proxy iterator reaches key and value");
+    names.insert(std::make_pair(1235, "overwritten"));
+    check(names[1235] == "overwritten" && names.size() == 3000, "insert overwrites the value in place");
+
+    SplitAVLTree<int,string> copy(names);
+    copy[1237] = "only in the copy";
+    bool same = copy.size() == names.size();
+    SplitAVLTree<int,string>::iterator a = names.begin();
+    for(SplitAVLTree<int,string>::iterator b = copy.begin(); same && b != copy.end(); ++a, ++b) {
+        same = a->first == b->first && (a->first == 1237 || a->second == b->second);
+    }
+    check(same && names[1237] != copy[1237], "copies own their values");
+    names.clear();
+    check(names.empty() && names.find(1235) == names.end() && copy.size() == 3000, "clear");
+}
+
+// Erases single items and ranges from tree, mirroring each in a
+// std::map, and checks that erase returns the item after the erased
+// ones and that both end up holding the same items.
+template<typename Tree>
+static bool checkErase(Tree& tree, unsigned seed)
+{
+    map<int,int> ref;
+    for(int i = 0; i < 3000; ++i) {
+        tree.insert(std::make_pair(i * 2, i));
+        ref[i * 2] = i;
+    }
+    srand(seed);
+    bool same = true;
+    for(int round = 0; round < 300 && !ref.empty(); ++round) {
+        int key = 2 * (rand() % 3000);
+        typename Tree::iterator it = tree.find(key);
+        map<int,int>::iterator r = ref.find(key);
+        if((it == tree.end()) != (r == ref.end())) {
+            return false;
+        }
+        if(it == tree.end()) {
+            continue;
+        }
+        if(round % 3 != 0) {
+            it = tree.erase(it);
+            r = ref.erase(r);
+        }
+        else {
+            // mostly short ranges, now and then most of the tree
+            int length = (round % 30 == 0) ? (int)ref.size() * 3 / 4 : rand() % 40;
+            typename Tree::iterator last = it;
+            map<int,int>::iterator refLast = r;
+            for(int i = 0; i < length && refLast != ref.end(); ++i, ++last, ++refLast) {
+            }
+            it = tree.erase(it, last);
+            r = ref.erase(r, refLast);
+        }
+        same = same && ((r == ref.end()) ? it == tree.end() : (it != tree.end() && it->first == r->first));
+        if(round % 7 == 0) {
+            tree.insert(std::make_pair(key + 1, round));
+            ref[key + 1] = round;
+        }
+    }
+    typename Tree::iterator it = tree.begin();
+    for(map<int,int>::iterator r = ref.begin(); r != ref.end(); ++r, ++it) {
+        if(it == tree.end() || it->first != r->first || it->second != r->second) {
+            return false;
+        }
+    }
+    return same && it == tree.end() && tree.size() == ref.size();
+}
+
+// Erases ranges of every length at random places, checking the items
+// against std::map and the tree's invariants after each one, so the
+// splits and joins behind range erase meet every shape.
+template<typename Tree, typename Valid>
+static bool checkRangeErase(Tree& tree, unsigned seed, Valid valid)
+{
+    srand(seed);
+    map<int,int> ref;
+    for(int i = 0; i < 4000; ++i) {
+        int key = rand() % 20000;
+        tree.insert(std::make_pair(key, i));
+        ref[key] = i;
+    }
+    for(int round = 0; round < 400; ++round) {
+        if(ref.size() < 200) {
+            for(int i = 0; i < 500; ++i) {
+                int key = rand() % 20000;
+                tree.insert(std::make_pair(key, i));
+                ref[key] = i;
+            }
+        }
+        // leaves tombstones in a tree that keeps them
+        int gone = rand() % 20000;
+        tree.remove(gone);
+        ref.erase(gone);
+        map<int,int>::iterator r = ref.begin();
+        std::advance(r, rand() % ref.size());
+        typename Tree::iterator it = tree.find(r->first);
+        size_t room = std::distance(r, ref.end());
+        // now and then a long range, and now and then one through end()
+        size_t length = rand() % (std::min<size_t>(room, 64) + 1);
+        if(round % 10 == 0) {
+            length = rand() % (room + 1);
+        }
+        else if(round % 10 == 5) {
+            length = room;
+        }
+        typename Tree::iterator last = it;
+        map<int,int>::iterator refLast = r;
+        for(size_t i = 0; i < length; ++i, ++last, ++refLast) {
+        }
+        it = tree.erase(it, last);
+        ref.erase(r, refLast);
+        if(it != last || !valid(tree) || tree.size() != ref.size()) {
+            return false;
+        }
+    }
+    typename Tree::iterator it = tree.begin();
+    for(map<int,int>::iterator r = ref.begin(); r != ref.end(); ++r, ++it) {
+        if(it == tree.end() || it->first != r->first || it->second != r->second ||
+           tree.find(r->first) != it) {
+            return false;
+        }
+    }
+    return it == tree.end();
+}
+
+// Removal by position: erase(iterator) and erase(first, last) on every
+// tree built on BinarySearchTree, and clear on a tree too deep to
+// take apart recursively.
+static void testErase()
+{
+    BinarySearchTree<int,int> plain;
+    check(checkErase(plain, 26), "BinarySearchTree erase matches std::map");
+    AVLTree<int,int> avl;
+    check(checkErase(avl, 27) && avl.isBalanced(), "AVLTree erase matches std::map and stays balanced");
+    CheckedRBTree rb;
+    check(checkErase(rb, 28) && rb.valid(), "RBTree erase matches std::map and keeps its invariants");
+    SplayTree<int,int> splay;
+    check(checkErase(splay, 29), "SplayTree erase matches std::map");
+    BinarySearchTree<int,int> scapegoat;
+    scapegoat.enableScapegoat(0.7);
+    check(checkErase(scapegoat, 30), "scapegoat erase matches std::map");
+
+    AugmentedAVLTree<int,int,SumMonoid<int> > sum;
+    bool augmented = checkErase(sum, 31);
+    long long total = 0;
+    for(AugmentedAVLTree<int,int,SumMonoid<int> >::iterator it = sum.begin(); it != sum.end(); ++it) {
+        total += it->second;
+    }
+    check(augmented && sum.reduce() == total && sum.isBalanced(), "AugmentedAVLTree erase keeps its aggregates");
+
+    RelaxedAVLTree<int,int> relaxed;
+    bool relaxedSame = checkErase(relaxed, 32);
+    relaxed.rebalance();
+    check(relaxedSame && relaxed.isBalanced(), "RelaxedAVLTree erase defers its rebalancing");
+
+    AVLTree<int,int> lazy;
+    lazy.enableTombstones(0.5);
+    check(checkErase(lazy, 33) && lazy.isBalanced(), "erase with tombstones matches std::map");
+
+    CheckedAVL<AVLTree<int,int> > joinedAvl;
+    check(checkRangeErase(joinedAvl, 40, [](const CheckedAVL<AVLTree<int,int> >& t) { return t.valid(); }),
+          "AVLTree range erase keeps exact balances");
+    CheckedRBTree joinedRb;
+    check(checkRangeErase(joinedRb, 41, [](const CheckedRBTree& t) { return t.valid(); }),
+          "RBTree range erase keeps its invariants");
+    typedef CheckedAVL<AugmentedAVLTree<int,int,SumMonoid<int> > > CheckedSum;
+    CheckedSum joinedSum;
+    check(checkRangeErase(joinedSum, 42, [](CheckedSum& t) {
+              long long total = 0;
+              for(CheckedSum::iterator it = t.begin(); it != t.end(); ++it) {
+                  total += it->second;
+              }
+              return t.valid() && t.reduce() == total;
+          }), "AugmentedAVLTree range erase keeps its aggregates");
+    CheckedAVL<AVLTree<int,int> > joinedHash;
+    joinedHash.enableHashIndex();
+    check(checkRangeErase(joinedHash, 43, [](const CheckedAVL<AVLTree<int,int> >& t) { return t.valid(); }),
+          "range erase keeps the hash index in step");
+    CheckedAVL<AVLTree<int,int> > joinedLazy;
+    joinedLazy.enableTombstones(0.9);
+    check(checkRangeErase(joinedLazy, 44, [](const CheckedAVL<AVLTree<int,int> >& t) { return t.valid(); }),
+          "range erase frees the tombstones in the range");
+    BinarySearchTree<int,int> joinedPlain;
+    check(checkRangeErase(joinedPlain, 45, [](const BinarySearchTree<int,int>&) { return true; }),
+          "BinarySearchTree range erase matches std::map");
+
+    // the items left by an erase through end() are a valid tree again
+    CheckedRBTree tail;
+    for(int i = 1; i <= 3; ++i) {
+        tail.insert(std::make_pair(i, i));
+    }
+    bool tailValid = tail.erase(tail.find(2), tail.end()) == tail.end() && tail.valid() && tail.size() == 1;
+    for(int i = 4; i < 100; ++i) {
+        tail.insert(std::make_pair(i, i));
+        tailValid = tailValid && tail.valid();
+    }
+    check(tailValid && tail.size() == 97, "RBTree erase through end() keeps a black root");
+
+    AVLTree<int,int> whole;
+    for(int i = 0; i < 100; ++i) {
+        whole.insert(std::make_pair(i, i));
+    }
+    check(whole.erase(whole.begin(), whole.end()) == whole.end() && whole.empty() && whole.begin() == whole.end(),
+          "erase everything");
+    whole.insert(std::make_pair(5, 5));
+    check(whole.erase(whole.begin(), whole.begin()) == whole.begin() && whole.size() == 1, "erase an empty range");
+}
+
+// Whether tree holds exactly the keys 0, step, 2 * step, ... below n,
+// each with its key as the value.
+template<typename Tree>
+static bool holdsMultiples(Tree& tree, int n, int step)
+{
+    int expected = 0;
+    for(typename Tree::iterator it = tree.begin(); it != tree.end(); ++it, expected += step) {
+        if(it->first != expected || it->second != expected) {
+            return false;
+        }
+    }
+    return expected >= n && tree.size() == (size_t)((n + step - 1) / step);
+}
+
+// compactLayout: every tree keeps its items and invariants, lands in
+// one block laid out for locality, and stays mutable afterwards.
+static void testLayout()
+{
+    vector<int> keys;
+    for(int i = 0; i < 20000; ++i) {
+        keys.push_back(i);
+    }
+    srand(34);
+    for(size_t i = keys.size() - 1; i > 0; --i) {
+        std::swap(keys[i], keys[rand() % (i + 1)]);
+    }
+
+    AVLTree<int,int> avl;
+    for(size_t i = 0; i < keys.size(); ++i) {
+        avl.insert(std::make_pair(keys[i], keys[i]));
+    }
+    TreeProfile before = avl.profile();
+    avl.compactLayout();
+    TreeProfile after = avl.profile();
+    check(holdsMultiples(avl, 20000, 1) && avl.isBalanced(), "compactLayout keeps the items");
+    check(after.arenaNodes == 20000 && after.height == after.optimalHeight, "compactLayout moves every node into one balanced block");
+    // a 64-byte line holds less than two 40-byte nodes, so most links
+    // still cross one; pages are where the order shows
+    check(after.lineCrossings < before.lineCrossings && after.pageCrossings * 4 < before.pageCrossings,
+          "van Emde Boas order keeps links within pages");
+    avl.compactLayout();
+    check(holdsMultiples(avl, 20000, 1) && avl.profile().arenaNodes == 20000, "compactLayout again replaces the block");
+    checkAgainstMap(avl, "AVLTree after compactLayout", 35);
+    check(avl.isBalanced(), "AVLTree stays balanced after compactLayout");
+
+    CheckedRBTree rb;
+    for(size_t i = 0; i < keys.size(); ++i) {
+        rb.insert(std::make_pair(keys[i], keys[i]));
+    }
+    rb.compactLayout();
+    check(rb.valid() && holdsMultiples(rb, 20000, 1), "RBTree keeps its invariants through compactLayout");
+    checkAgainstMap(rb, "RBTree after compactLayout", 36);
+    check(rb.valid(), "RBTree stays valid after compactLayout");
+
+    BinarySearchTree<int,int> lazy;
+    lazy.enableTombstones(0.9);
+    lazy.enableHashIndex();
+    for(int i = 0; i < 1000; ++i) {
+        lazy.insert(std::make_pair(i, i));
+    }
+    for(int i = 1; i < 1000; i += 2) {
+        lazy.remove(i);
+    }
+    lazy.compactLayout();
+    TreeProfile compacted = lazy.profile();
+    check(holdsMultiples(lazy, 1000, 2) && compacted.deadNodes == 0 && compacted.height == compacted.optimalHeight,
+          "compactLayout drops tombstones and balances a plain tree");
+    check(lazy.find(998) != lazy.end() && lazy.find(998)->second == 998 && lazy.find(999) == lazy.end(),
+          "the hash index follows the moved nodes");
+
+    AugmentedAVLTree<int,int,SumMonoid<int> > sum;
+    for(int i = 0; i < 1000; ++i) {
+        sum.insert(std::make_pair(i, i));
+    }
+    sum.compactLayout();
+    sum.remove(10);
+    check(sum.reduce(0, 100) == 4950 - 10 && sum.isBalanced(), "aggregates move with their nodes");
+
+    RelaxedAVLTree<int,int> relaxed;
+    for(int i = 0; i < 1000; ++i) {
+        relaxed.insert(std::make_pair(i, i));
+    }
+    relaxed.compactLayout();
+    check(relaxed.pendingRebalance() == 0 && relaxed.isBalanced() && holdsMultiples(relaxed, 1000, 1),
+          "compactLayout settles pending rebalancing");
+    for(int i = 1000; i < 2000; ++i) {
+        relaxed.insert(std::make_pair(i, i));
+    }
+    relaxed.rebalance();
+    check(relaxed.isBalanced() && holdsMultiples(relaxed, 2000, 1), "a relaxed tree rebalances after compactLayout");
+
+    AVLTree<int,int> empty;
+    empty.compactLayout();
+    check(empty.empty() && empty.begin() == empty.end(), "compactLayout on an empty tree");
+}
+
+// A value whose copies throw while throwing is set.
+struct FragileValue {
+    static bool throwing;
+    int v;
+    FragileValue(int v = 0) : v(v) { }
+    FragileValue(const FragileValue& other) : v(other.v) {
+        if(throwing) {
+            throw runtime_error("FragileValue copy");
+        }
+    }
+    FragileValue& operator=(const FragileValue& other) { v = other.v; return *this; }
+};
+bool FragileValue::throwing = false;
+
+// Index-linked slots: removed items are destroyed at once, copies skip
+// free slots, and an item whose copy throws leaves the tree unchanged.
+static void testIndexedSlots()
+{
+    shared_ptr<int> owned = make_shared<int>(7);
+    IndexedAVLTree<int, shared_ptr<int> > held;
+    for(int i = 0; i < 100; ++i) {
+        held.insert(std::make_pair(i, owned));
+    }
+    for(int i = 0; i < 100; i += 2) {
+        held.remove(i);
+    }
+    check(owned.use_count() == 51, "remove destroys the item in its slot");
+    {
+        IndexedAVLTree<int, shared_ptr<int> > copy(held);
+        check(owned.use_count() == 101 && copy.size() == 50, "a copy copies only live slots");
+    }
+    held.insert(std::make_pair(0, owned));
+    check(owned.use_count() == 52 && held.size() == 51 && held.isBalanced(), "free slots are reused");
+    held.clear();
+    check(owned.use_count() == 1, "clear destroys every item");
+
+    IndexedBinarySearchTree<int, FragileValue> fragile;
+    for(int i = 0; i < 10; ++i) {
+        fragile.insert(std::make_pair(i, FragileValue(i)));
+    }
+    fragile.remove(4);
+    // one into a free slot, one appended
+    const pair<const int, FragileValue> items[] = { pair<const int, FragileValue>(4, FragileValue(4)),
+                                                    pair<const int, FragileValue>(40, FragileValue(40)) };
+    int throws = 0;
+    FragileValue::throwing = true;
+    for(int i = 0; i < 2; ++i) {
+        try {
+            fragile.insert(items[i]);
+        }
+        catch(const runtime_error&) {
+            ++throws;
+        }
+    }
+    FragileValue::throwing = false;
+    fragile.insert(std::make_pair(4, FragileValue(4)));
+    check(throws == 2 && fragile.size() == 10 && fragile.find(40) == fragile.end() && fragile[4].v == 4,
+          "a throwing item copy leaves the slots usable");
+}
+
+static void testLatency()
+{
+    LatencyHistogram h;
+    for(uint64_t v = 1; v <= 1000; ++v) {
+        h.record(v);
+    }
+    check(h.count() == 1000, "histogram count");
+    check(h.max() == 1000, "histogram max");
+    uint64_t p50 = h.percentile(50);
+    check(p50 >= 485 && p50 <= 515, "histogram p50 within bucket error");
+    for(uint64_t v = 0; v < 100000; v += 7) {
+        uint64_t hi = LatencyHistogram::bucketHighest(LatencyHistogram::bucketIndex(v));
+        if(hi < v || hi - v > v / LatencyHistogram::SUB_BUCKETS) {
+            check(false, "histogram bucket bounds");
+            break;
+        }
+    }
+
+    LatencyRecorder recorder;
+    vector<thread> threads;
+    for(int t = 0; t < 4; ++t) {
+        threads.push_back(thread([&recorder, t]() {
+            LatencyTree<int, int, AVLTree<int, int> > tree(recorder);
+            for(int i = 0; i < 1000; ++i) {
+                tree.insert(std::make_pair(i * 4 + t, i));
+            }
+            for(LatencyTree<int, int, AVLTree<int, int> >::iterator it = tree.begin(); it != tree.end(); ++it) {
+            }
+            for(int i = 0; i < 1000; i += 2) {
+                tree.find(i * 4 + t);
+                tree.remove(i * 4 + t);
+            }
+            // hinted inserts and inserts through the base class are timed too
+            tree.insert(tree.end(), std::make_pair(100000 + t, 0));
+            AVLTree<int, int>& base = tree;
+            base.insert(std::make_pair(200000 + t, 0));
+            // so are erase and clear, through the tree's own hooks
+            base.erase(base.find(4 + t));
+            base.erase(base.begin(), base.find(404 + t));
+            base.clear();
+        }));
+    }
+    for(size_t t = 0; t < threads.size(); ++t) {
+        threads[t].join();
+    }
+    LatencyHistogram inserts, removes, finds, steps, clears;
+    recorder.mergeInto(LAT_INSERT, inserts);
+    recorder.mergeInto(LAT_REMOVE, removes);
+    recorder.mergeInto(LAT_FIND, finds);
+    recorder.mergeInto(LAT_ITERATE, steps);
+    recorder.mergeInto(LAT_CLEAR, clears);
+    cout << "\nLatency recorder:" << endl;
+    recorder.writeText(cout);
+    check(inserts.count() == 4008 && removes.count() == 2008 && finds.count() == 2000,
+          "per-thread latency histograms merge");
+    check(steps.count() == 4000, "iteration steps recorded");
+    check(clears.count() == 4, "clears recorded");
+}
 
 int main(int argc, char *argv[])
 {
@@ -44,5 +1736,119 @@ int main(int argc, char *argv[])
     cout << "Erasing b" << endl;
     at.remove('b');
 
-    return 0;
+    cout << endl;
+    BinarySearchTree<int,int> bst;
+    checkAgainstMap(bst, "BinarySearchTree", 1);
+    AVLTree<int,int> avl;
+    checkAgainstMap(avl, "AVLTree", 2);
+    check(avl.isBalanced(), "AVLTree stays balanced");
+    SplayTree<int,int> splay;
+    checkAgainstMap(splay, "SplayTree", 3);
+    SplayTree<int,int> semi(SPLAY_SEMI, 3);
+    checkAgainstMap(semi, "SplayTree (semi, every 3rd read)", 4);
+    CheckedRBTree rb;
+    checkAgainstMap(rb, "RBTree", 5);
+    check(rb.valid(), "RBTree keeps red-black invariants");
+    check(sizeof(RBNode<int,int>) == sizeof(Node<int,int>), "RBNode color costs no space");
+    IndexedBinarySearchTree<int,int> ibst;
+    checkAgainstMap(ibst, "IndexedBinarySearchTree", 6);
+    IndexedAVLTree<int,int> iavl;
+    checkAgainstMap(iavl, "IndexedAVLTree", 7);
+    check(iavl.isBalanced(), "IndexedAVLTree stays balanced");
+    testIndexedSlots();
+    PathAVLTree<int,int> pavl;
+    checkAgainstMap(pavl, "PathAVLTree", 8);
+    check(pavl.isBalanced(), "PathAVLTree stays balanced");
+    {
+        PathAVLTree<int,int> copy(pavl);
+        copy.insert(std::make_pair(100000, 1));
+        copy.remove(pavl.begin()->first);
+        PathAVLTree<int,int> assigned;
+        assigned = copy;
+        PathAVLTree<int,int> moved(std::move(assigned));
+        check(copy.size() == pavl.size() && pavl.find(100000) == pavl.end() && moved.find(100000) != moved.end()
+              && assigned.empty() && moved.isBalanced(), "PathAVLTree copies are deep");
+    }
+    // PathAVLNode still pads a balance byte to 8 that AVLNode keeps in its child pointers
+    check(sizeof(PathAVLNode<int,int>) + 16 == sizeof(AVLNode<int,int>) + 8, "PathAVLNode drops parent and vptr");
+    check(sizeof(AVLNode<int,int>) == sizeof(Node<int,int>), "AVLNode packs its balance into pointer tags");
+
+    BinarySearchTree<int,int> hbst;
+    hbst.enableHashIndex();
+    checkAgainstMap(hbst, "BinarySearchTree with hash index", 1);
+    AVLTree<int,int> havl;
+    havl.enableHashIndex();
+    checkAgainstMap(havl, "AVLTree with hash index", 2);
+    check(havl.isBalanced(), "AVLTree with hash index stays balanced");
+    CheckedRBTree hrb;
+    hrb.enableHashIndex();
+    checkAgainstMap(hrb, "RBTree with hash index", 5);
+    SplayTree<int,int> hsplay;
+    hsplay.enableHashIndex();
+    checkAgainstMap(hsplay, "SplayTree with hash index", 3);
+    // enabling on a populated tree indexes the existing nodes
+    AVLTree<int,int> late;
+    for(int i = 0; i < 100; ++i) {
+        late.insert(std::make_pair(i * 7, i));
+    }
+    late.enableHashIndex();
+    bool allFound = late.hasHashIndex() && late.hashIndexBytes() > 0;
+    for(int i = 0; i < 100 && allFound; ++i) {
+        allFound = late[i * 7] == i && late.find(i * 7 + 1) == late.end();
+    }
+    check(allFound, "hash index built from an existing tree");
+    late.disableHashIndex();
+    check(!late.hasHashIndex() && late[693] == 99, "lookups after dropping the hash index");
+
+    // a key removed lazily before the index existed is still found once
+    // an insert revives it
+    AVLTree<int,int> revived;
+    revived.enableTombstones();
+    for(int i = 0; i < 10; ++i) {
+        revived.insert(std::make_pair(i, i));
+    }
+    revived.remove(3);
+    revived.enableHashIndex();
+    revived.insert(std::make_pair(3, 33));
+    bool revivedFound = revived.size() == 10 && revived.find(3) != revived.end() && revived[3] == 33;
+    revived.remove(3);
+    check(revivedFound && revived.find(3) == revived.end() && revived.size() == 9,
+          "hash index built over tombstones finds revived keys");
+
+    AVLTree<int,int> lazyAvl;
+    lazyAvl.enableTombstones(0.3);
+    checkAgainstMap(lazyAvl, "AVLTree with tombstones", 2);
+    lazyAvl.compact();
+    check(lazyAvl.isBalanced() && lazyAvl.size() > 0, "AVLTree balanced after compaction");
+    CheckedRBTree lazyRb;
+    lazyRb.enableTombstones(0.3);
+    checkAgainstMap(lazyRb, "RBTree with tombstones", 5);
+    lazyRb.compact();
+    check(lazyRb.valid(), "RBTree keeps red-black invariants after compaction");
+
+    testScapegoat();
+    testFinger();
+    AVLTree<int,int> many;
+    checkFindMany(many, "AVLTree find_many matches find");
+    RBTree<int,int> rbMany;
+    checkFindMany(rbMany, "RBTree find_many matches find");
+    testRadixTree();
+    testClone();
+    testCloneUnwinds();
+    testAugmented();
+    testIntervalTree();
+    testTrace();
+    testStaticTree();
+    testCompare();
+    testExport();
+    testProfile();
+    testRelaxed();
+    testDurable();
+    testSplit();
+    testErase();
+    testLayout();
+    testLatency();
+
+    cout << "\n" << (failures == 0 ? "All checks passed" : "Some checks FAILED") << endl;
+    return failures == 0 ? 0 : 1;
 }
@@ -5,6 +5,25 @@
 #include <exception>
 #include <cstdlib>
 #include <utility>
+#include <stdexcept>
+#include <algorithm>
+#include <cstdint>
+#include <cmath>
+#include <functional>
+#include <vector>
+#include <thread>
+#include <new>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include "hashindex.h"
+#include "treeprofile.h"
+
+#if defined(__GNUC__)
+#define BST_PREFETCH(addr) __builtin_prefetch(addr)
+#else
+#define BST_PREFETCH(addr) ((void)0)
+#endif
 
 /**
  * A templated class for a Node in a search tree.
@@ -12,6 +31,13 @@
  * that they can be overridden for future kinds of
  * search trees, such as Red Black trees, Splay trees,
  * and AVL trees.
+ *
+ * Nodes are at least pointer-aligned, so the low bits of parent_ are
+ * always zero. Derived node types may keep small per-node flags there
+ * (see getTags/setTags); getParent and setParent leave them untouched.
+ * Bit 0 of left_ and of right_ is free in the same way (see
+ * getChildTags/setChildTags) and hidden by the child getters and
+ * setters.
  */
 template <typename Key, typename Value>
 class Node
@@ -35,7 +61,25 @@ public:
     void setRight(Node<Key, Value>* right);
     void setValue(const Value &value);
 
+    bool isDead() const;
+    void setDead(bool dead);
+
+    // Placement-constructs a childless copy of this node, of the same
+    // type and with the same per-node data, at mem.
+    virtual Node<Key, Value>* cloneAt(void* mem, Node<Key, Value>* parent) const;
+    virtual size_t allocationSize() const;
+
 protected:
+    static const uintptr_t TAG_MASK = 3;
+    // bit 0 is left to derived nodes (RBNode keeps its color there)
+    static const uintptr_t DEAD_TAG = 2;
+    uintptr_t getTags() const;
+    void setTags(uintptr_t tags);
+    // Bit 0 holds left_'s flag and bit 1 right_'s.
+    static const uintptr_t CHILD_TAG = 1;
+    uintptr_t getChildTags() const;
+    void setChildTags(uintptr_t tags);
+
     std::pair<const Key, Value> item_;
     Node<Key, Value>* parent_;
     Node<Key, Value>* left_;
@@ -58,7 +102,7 @@ Node<Key, Value>::Node(const Key& key, const Value& value, Node<Key, Value>* par
     left_(NULL),
     right_(NULL)
 {
-
+    static_assert(alignof(Node<Key, Value>) > TAG_MASK, "node tag bits need pointer alignment");
 }
 
 /**
@@ -123,7 +167,7 @@ Value& Node<Key, Value>::getValue()
 template<typename Key, typename Value>
 Node<Key, Value>* Node<Key, Value>::getParent() const
 {
-    return parent_;
+    return reinterpret_cast<Node<Key, Value>*>(reinterpret_cast<uintptr_t>(parent_) & ~TAG_MASK);
 }
 
 /**
@@ -132,7 +176,7 @@ Node<Key, Value>* Node<Key, Value>::getParent() const
 template<typename Key, typename Value>
 Node<Key, Value>* Node<Key, Value>::getLeft() const
 {
-    return left_;
+    return reinterpret_cast<Node<Key, Value>*>(reinterpret_cast<uintptr_t>(left_) & ~CHILD_TAG);
 }
 
 /**
@@ -141,7 +185,7 @@ Node<Key, Value>* Node<Key, Value>::getLeft() const
 template<typename Key, typename Value>
 Node<Key, Value>* Node<Key, Value>::getRight() const
 {
-    return right_;
+    return reinterpret_cast<Node<Key, Value>*>(reinterpret_cast<uintptr_t>(right_) & ~CHILD_TAG);
 }
 
 /**
@@ -150,7 +194,7 @@ Node<Key, Value>* Node<Key, Value>::getRight() const
 template<typename Key, typename Value>
 void Node<Key, Value>::setParent(Node<Key, Value>* parent)
 {
-    parent_ = parent;
+    parent_ = reinterpret_cast<Node<Key, Value>*>(reinterpret_cast<uintptr_t>(parent) | getTags());
 }
 
 /**
@@ -159,7 +203,8 @@ void Node<Key, Value>::setParent(Node<Key, Value>* parent)
 template<typename Key, typename Value>
 void Node<Key, Value>::setLeft(Node<Key, Value>* left)
 {
-    left_ = left;
+    left_ = reinterpret_cast<Node<Key, Value>*>(
+        reinterpret_cast<uintptr_t>(left) | (reinterpret_cast<uintptr_t>(left_) & CHILD_TAG));
 }
 
 /**
@@ -168,7 +213,50 @@ void Node<Key, Value>::setLeft(Node<Key, Value>* left)
 template<typename Key, typename Value>
 void Node<Key, Value>::setRight(Node<Key, Value>* right)
 {
-    right_ = right;
+    right_ = reinterpret_cast<Node<Key, Value>*>(
+        reinterpret_cast<uintptr_t>(right) | (reinterpret_cast<uintptr_t>(right_) & CHILD_TAG));
+}
+
+/**
+* Returns the flag bits stored alongside the parent pointer.
+*/
+template<typename Key, typename Value>
+uintptr_t Node<Key, Value>::getTags() const
+{
+    return reinterpret_cast<uintptr_t>(parent_) & TAG_MASK;
+}
+
+/**
+* Replaces the flag bits stored alongside the parent pointer.
+*/
+template<typename Key, typename Value>
+void Node<Key, Value>::setTags(uintptr_t tags)
+{
+    parent_ = reinterpret_cast<Node<Key, Value>*>(
+        (reinterpret_cast<uintptr_t>(parent_) & ~TAG_MASK) | (tags & TAG_MASK));
+}
+
+/**
+* Returns the flag bits stored alongside the child pointers: bit 0 from
+* left_ and bit 1 from right_.
+*/
+template<typename Key, typename Value>
+uintptr_t Node<Key, Value>::getChildTags() const
+{
+    return (reinterpret_cast<uintptr_t>(left_) & CHILD_TAG) |
+           (reinterpret_cast<uintptr_t>(right_) & CHILD_TAG) << 1;
+}
+
+/**
+* Replaces the flag bits stored alongside the child pointers.
+*/
+template<typename Key, typename Value>
+void Node<Key, Value>::setChildTags(uintptr_t tags)
+{
+    left_ = reinterpret_cast<Node<Key, Value>*>(
+        (reinterpret_cast<uintptr_t>(left_) & ~CHILD_TAG) | (tags & CHILD_TAG));
+    right_ = reinterpret_cast<Node<Key, Value>*>(
+        (reinterpret_cast<uintptr_t>(right_) & ~CHILD_TAG) | (tags >> 1 & CHILD_TAG));
 }
 
 /**
@@ -180,35 +268,139 @@ void Node<Key, Value>::setValue(const Value& value)
     item_.second = value;
 }
 
+/**
+* Returns true if the node is a tombstone: its item was removed while
+* the tree defers deletions (see BinarySearchTree::enableTombstones).
+*/
+template<typename Key, typename Value>
+bool Node<Key, Value>::isDead() const
+{
+    return (getTags() & DEAD_TAG) != 0;
+}
+
+template<typename Key, typename Value>
+void Node<Key, Value>::setDead(bool dead)
+{
+    setTags(dead ? (getTags() | DEAD_TAG) : (getTags() & ~DEAD_TAG));
+}
+
+template<typename Key, typename Value>
+Node<Key, Value>* Node<Key, Value>::cloneAt(void* mem, Node<Key, Value>* parent) const
+{
+    Node<Key, Value>* copy = new (mem) Node<Key, Value>(item_.first, item_.second, parent);
+    copy->setTags(getTags());
+    return copy;
+}
+
+template<typename Key, typename Value>
+size_t Node<Key, Value>::allocationSize() const
+{
+    return sizeof(Node<Key, Value>);
+}
+
 /*
   ---------------------------------------
   End implementations for the Node class.
   ---------------------------------------
 */
 
+/**
+* Detects a comparator with its own three-way int compare(a, b) const.
+*/
+template <typename Compare, typename A, typename B, typename = void>
+struct HasThreeWayCompare : std::false_type
+{
+};
+
+template <typename Compare, typename A, typename B>
+struct HasThreeWayCompare<Compare, A, B,
+    decltype((void)std::declval<const Compare&>().compare(std::declval<const A&>(), std::declval<const B&>()))>
+    : std::true_type
+{
+};
+
+/**
+* Orders a against b under comp: negative, zero or positive as a goes
+* before, with or after b. A comparator's own compare member is used
+* when it has one, and strings under std::less are compared in a
+* single pass; anything else takes up to two calls to comp.
+*/
+template <typename Compare, typename A, typename B>
+int compareKeys(const Compare& comp, const A& a, const B& b)
+{
+    if constexpr(HasThreeWayCompare<Compare, A, B>::value)
+    {
+        return comp.compare(a, b);
+    }
+    else if constexpr((std::is_same<Compare, std::less<std::string> >::value ||
+                       std::is_same<Compare, std::less<> >::value) &&
+                      std::is_convertible<const A&, std::string_view>::value &&
+                      std::is_convertible<const B&, std::string_view>::value)
+    {
+        return std::string_view(a).compare(std::string_view(b));
+    }
+    else
+    {
+        return comp(a, b) ? -1 : (comp(b, a) ? 1 : 0);
+    }
+}
+
 /**
 * A templated unbalanced binary search tree.
+*
+* Keys are ordered by Compare, a default-constructed strict weak
+* ordering as for std::map. Each level of a descent makes one
+* three-way comparison through compareKeys. When Compare is
+* transparent (it defines is_transparent, as std::less<> does), find
+* accepts any type Compare can order against Key, so a tree of
+* std::string is searched by const char* or std::string_view without
+* building a temporary string.
 */
-template <typename Key, typename Value>
+template <typename Key, typename Value, typename Compare = std::less<Key> >
 class BinarySearchTree
 {
 public:
-    BinarySearchTree(); //TODO
-    virtual ~BinarySearchTree(); //TODO
-    virtual void insert(const std::pair<const Key, Value>& keyValuePair); //TODO
-    virtual void remove(const Key& key); //TODO
-    void clear(); //TODO
-    bool isBalanced() const; //TODO
+    BinarySearchTree();
+    BinarySearchTree(const BinarySearchTree<Key, Value, Compare>& other);
+    BinarySearchTree(BinarySearchTree<Key, Value, Compare>&& other);
+    virtual ~BinarySearchTree();
+    BinarySearchTree<Key, Value, Compare>& operator=(const BinarySearchTree<Key, Value, Compare>& other);
+    BinarySearchTree<Key, Value, Compare>& operator=(BinarySearchTree<Key, Value, Compare>&& other);
+    virtual void insert(const std::pair<const Key, Value>& keyValuePair);
+    virtual void remove(const Key& key);
+    virtual void clear();
+    bool isBalanced() const;
+    TreeProfile profile() const;
     void print() const;
+    // Streaming exporters (export_bst.h): any ostream, any tree size.
+    void writeDot(std::ostream& os, size_t maxDepth = SIZE_MAX) const;
+    void writeAscii(std::ostream& os, size_t levels = 6) const;
+    void writeAscii(std::ostream& os, const Key& around, size_t levels = 6, size_t above = 2) const;
+    void writePreorder(std::ostream& os) const;
     bool empty() const;
+    size_t size() const;
 
-    template<typename PPKey, typename PPValue>
-    friend void prettyPrintBST(BinarySearchTree<PPKey, PPValue> & tree);
+    void enableScapegoat(double alpha = 0.7);
+    void disableScapegoat();
+
+    void enableTombstones(double deadRatio = 0.5);
+    void disableTombstones();
+    void compact();
+    void compactLayout();
+
+    template<typename Hash = std::hash<Key>, typename KeyEqual = std::equal_to<Key> >
+    void enableHashIndex();
+    void disableHashIndex();
+    bool hasHashIndex() const;
+    size_t hashIndexBytes() const;
+
+    template<typename PPKey, typename PPValue, typename PPCompare>
+    friend void prettyPrintBST(BinarySearchTree<PPKey, PPValue, PPCompare> & tree);
 public:
     /**
     * An internal iterator class for traversing the contents of the BST.
     */
-    class iterator  // TODO
+    class iterator
     {
     public:
         iterator();
@@ -222,7 +414,7 @@ public:
         iterator& operator++();
 
     protected:
-        friend class BinarySearchTree<Key, Value>;
+        friend class BinarySearchTree<Key, Value, Compare>;
         iterator(Node<Key,Value>* ptr);
         Node<Key, Value> *current_;
     };
@@ -231,27 +423,171 @@ public:
     iterator begin() const;
     iterator end() const;
     iterator find(const Key& key) const;
+    template<typename K, typename C = Compare, typename = typename C::is_transparent>
+    iterator find(const K& key) const;
+    iterator find_from(iterator finger, const Key& key) const;
+    void find_many(const std::vector<Key>& keys, std::vector<iterator>& out) const;
+    iterator insert(iterator hint, const std::pair<const Key, Value>& keyValuePair);
+    iterator erase(iterator pos);
+    iterator erase(iterator first, iterator last);
     Value& operator[](const Key& key);
     Value const & operator[](const Key& key) const;
 
 protected:
     // Mandatory helper functions
-    Node<Key, Value>* internalFind(const Key& k) const; // TODO
-    Node<Key, Value> *getSmallestNode() const;  // TODO
-    static Node<Key, Value>* predecessor(Node<Key, Value>* current); // TODO
+    Node<Key, Value>* internalFind(const Key& k) const;
+    template<typename K>
+    Node<Key, Value>* descend(const K& key) const;
+    template<typename A, typename B>
+    int order(const A& a, const B& b) const;
+    Node<Key, Value> *getSmallestNode() const;
+    static Node<Key, Value>* predecessor(Node<Key, Value>* current);
+    static Node<Key, Value>* successor(Node<Key, Value>* current);
     // Note:  static means these functions don't have a "this" pointer
     //        and instead just use the input argument.
 
+    static iterator makeIterator(Node<Key, Value>* node);
+
+    // Inserts or overwrites keyValuePair, searching from finger when it
+    // is not NULL, and returns the item's node. Trees override this
+    // rather than insert so that both insert overloads share it.
+    virtual Node<Key, Value>* insertNear(Node<Key, Value>* finger, const std::pair<const Key, Value>& keyValuePair);
+    // Unlinks and frees a live node of this tree. remove and erase go
+    // through it, so trees override this rather than remove to keep
+    // their invariants.
+    virtual void removeNode(Node<Key, Value>* node);
+    // Unlinks and frees the nodes from first up to last (NULL for the
+    // end of the tree). Both erase overloads go through it.
+    virtual void eraseRange(Node<Key, Value>* first, Node<Key, Value>* last);
+    void removeEach(Node<Key, Value>* first, Node<Key, Value>* last);
+    void discardSubtree(Node<Key, Value>* head);
+    void splitAround(Node<Key, Value>* node, Node<Key, Value>*& left, int& leftRank,
+                     Node<Key, Value>*& right, int& rightRank);
+    // Split and join: a rank is whatever the tree balances on (AVL
+    // height, red-black black height), or 0 for a tree that keeps none.
+    // rankAbove returns the rank of parent from that of the child on
+    // the given side, storing its other child's rank in siblingRank.
+    // join hangs left and right, which must have no parents, under mid
+    // and rebalances, returning the new root and storing its rank.
+    virtual int rankOf(Node<Key, Value>* node) const;
+    virtual int rankAbove(Node<Key, Value>* parent, bool fromLeft, int childRank, int& siblingRank) const;
+    virtual Node<Key, Value>* join(Node<Key, Value>* left, int leftRank, Node<Key, Value>* mid,
+                                   Node<Key, Value>* right, int rightRank, int& rank);
+    static void linkChildren(Node<Key, Value>* node, Node<Key, Value>* left, Node<Key, Value>* right);
+    Node<Key, Value>* locate(Node<Key, Value>* finger, const Key& key, Node<Key, Value>*& parent, bool& isMax);
+    Node<Key, Value>* fingerStart(Node<Key, Value>* finger, const Key& key) const;
+
     // Provided helper functions
     virtual void printRoot (Node<Key, Value> *r) const;
+    // Appends a node's tree-specific state (balance, color) for the
+    // exporters, each item preceded by a space.
+    virtual void describeNode(std::ostream& os, const Node<Key, Value>* node) const;
+    // Adds a node's tree-specific statistics (balance factors) to profile.
+    virtual void profileNode(TreeProfile& profile, const Node<Key, Value>* node) const;
+    template<typename Visit>
+    void walkPreorder(Node<Key, Value>* top, size_t maxDepth, Visit visit) const;
+    void writeAsciiFrom(std::ostream& os, Node<Key, Value>* top, size_t levels) const;
     virtual void nodeSwap( Node<Key,Value>* n1, Node<Key,Value>* n2) ;
+    void rotateLeft(Node<Key, Value>* node);
+    void rotateRight(Node<Key, Value>* node);
+    // Called after a rotation moved lowered below its former child.
+    virtual void rotated(Node<Key, Value>* lowered);
 
     // Add helper functions here
-	//	void properInsert(Node<Key, Value>* currRoot, const std::pair<const Key, Value> &keyValuePair);
-		void exactClear(Node<Key,Value>* head);
-		int calculateHeightIfBalanced(Node<Key,Value>* head) const;
+    void exactClear(Node<Key,Value>* head);
+    void releaseArenaNode(Node<Key, Value>* node);
+    int calculateHeightIfBalanced(Node<Key,Value>* head) const;
+
+    // Every insert that links a new node and every remove that unlinks
+    // one must report it here so the hash index and finger stay in step.
+    void nodeAdded(Node<Key, Value>* node, bool isMax = false);
+    void nodeRemoved(Node<Key, Value>* node);
+
+    // Tombstone support: every remove starts with removeLazily. After
+    // buildBalanced relinks sorted nodes, rebuildFix restores the tree's
+    // own per-node data (balance factors, colors).
+    bool removeLazily(const Key& key);
+    void revive(Node<Key, Value>* node);
+    static Node<Key, Value>* buildBalanced(std::vector<Node<Key, Value>*>& nodes, size_t lo, size_t hi,
+                                           Node<Key, Value>* parent);
+    virtual void rebuildFix(Node<Key, Value>* subtree);
+    // Called once clear() has released every node.
+    virtual void cleared();
+    void rebuildSubtree(Node<Key, Value>* top);
+
+    // Scapegoat mode for the plain insert and remove.
+    void scapegoatAfterInsert(Node<Key, Value>* node);
+    static size_t subtreeSize(Node<Key, Value>* node);
+
+    /**
+    * A block of nodes allocated together by a clone. Its memory is
+    * freed once every node in it has been released.
+    */
+    struct NodeArena
+    {
+        char* begin;
+        char* end;
+        size_t live;
+    };
+
+    /**
+    * A subtree below the top levels of a parallel clone.
+    */
+    struct CloneTask
+    {
+        const Node<Key, Value>* src;
+        Node<Key, Value>* parent;
+        bool left;
+        Node<Key, Value>* copy;
+        Node<Key, Value>* finger;
+        NodeArena arena;
+        // what the copy threw, rethrown on the calling thread
+        std::exception_ptr error;
+    };
+
+    // Every node a tree deletes goes through releaseNode, which knows
+    // whether it was allocated on its own or inside an arena.
+    void releaseNode(Node<Key, Value>* node);
+    void cloneFrom(const BinarySearchTree<Key, Value, Compare>& other, unsigned threads);
+    void cloneParallel(const BinarySearchTree<Key, Value, Compare>& other, size_t stride, unsigned threads);
+    Node<Key, Value>* cloneTop(const Node<Key, Value>* src, Node<Key, Value>* parent, int depth, char* mem,
+                               size_t& used, size_t stride, const Node<Key, Value>* finger,
+                               std::vector<CloneTask>& tasks);
+    static void runCloneTasks(std::vector<CloneTask>* tasks, size_t first, size_t step, size_t stride,
+                              const Node<Key, Value>* finger);
+    static Node<Key, Value>* cloneInto(const Node<Key, Value>* src, Node<Key, Value>* parent, char* mem,
+                                       size_t stride, const Node<Key, Value>* finger,
+                                       Node<Key, Value>*& fingerCopy);
+    static void destroyClone(Node<Key, Value>* head);
+    static size_t countNodes(const Node<Key, Value>* node);
+    void rebuildLive();
+    static void vebOrder(Node<Key, Value>* root, size_t height, std::vector<Node<Key, Value>*>& out);
+    static void nodesAtDepth(Node<Key, Value>* node, size_t depth, std::vector<Node<Key, Value>*>& out);
+    void takeFrom(BinarySearchTree<Key, Value, Compare>& other);
+
+    // Trees at least this large are cloned on several threads.
+    static const size_t PARALLEL_CLONE_MIN = 1 << 16;
+    // A parallel clone copies this many levels itself and hands each
+    // subtree below them to a worker thread.
+    static const int PARALLEL_CLONE_DEPTH = 4;
 protected:
+    Compare comp_;
     Node<Key, Value>* root_;
+    NodeIndex<Key, Node<Key, Value> >* index_;
+    // The last node inserted or updated, and whether it holds the
+    // largest key; lets in-order appends skip the descent.
+    Node<Key, Value>* finger_;
+    bool fingerAtMax_;
+    // Linked nodes, and how many of them are tombstones.
+    size_t size_;
+    size_t dead_;
+    bool tombstones_;
+    double deadRatio_;
+    // Scapegoat mode: alpha_ is 0 when off. maxSize_ is the largest
+    // size_ since the last full rebuild.
+    double alpha_;
+    size_t maxSize_;
+    std::vector<NodeArena> arenas_;
     // You should not need other data members
 };
 
@@ -264,38 +600,39 @@ Begin implementations for the BinarySearchTree::iterator class.
 /**
 * Explicit constructor that initializes an iterator with a given node pointer.
 */
-template<class Key, class Value>
-BinarySearchTree<Key, Value>::iterator::iterator(Node<Key,Value> *ptr)
+template<typename Key, typename Value, typename Compare>
+BinarySearchTree<Key, Value, Compare>::iterator::iterator(Node<Key,Value> *ptr)
+    : current_(ptr)
 {
-    // TODO
-    //returns pointer to current pointer 
-    current_ = ptr;
+
 }
+
 /**
 * A default constructor that initializes the iterator to NULL.
 */
-template<class Key, class Value>
-BinarySearchTree<Key, Value>::iterator::iterator() 
+template<typename Key, typename Value, typename Compare>
+BinarySearchTree<Key, Value, Compare>::iterator::iterator()
+    : current_(NULL)
 {
-    // TODO
-    //sets the null pointer
-  current_ = nullptr;
+
 }
+
 /**
 * Provides access to the item.
 */
-template<class Key, class Value>
+template<typename Key, typename Value, typename Compare>
 std::pair<const Key,Value> &
-BinarySearchTree<Key, Value>::iterator::operator*() const
+BinarySearchTree<Key, Value, Compare>::iterator::operator*() const
 {
     return current_->getItem();
 }
+
 /**
 * Provides access to the address of the item.
 */
-template<class Key, class Value>
+template<typename Key, typename Value, typename Compare>
 std::pair<const Key,Value> *
-BinarySearchTree<Key, Value>::iterator::operator->() const
+BinarySearchTree<Key, Value, Compare>::iterator::operator->() const
 {
     return &(current_->getItem());
 }
@@ -304,70 +641,39 @@ BinarySearchTree<Key, Value>::iterator::operator->() const
 * Checks if 'this' iterator's internals have the same value
 * as 'rhs'
 */
-template<class Key, class Value>
+template<typename Key, typename Value, typename Compare>
 bool
-BinarySearchTree<Key, Value>::iterator::operator==(
-const BinarySearchTree<Key, Value>::iterator& rhs) const
+BinarySearchTree<Key, Value, Compare>::iterator::operator==(
+    const BinarySearchTree<Key, Value, Compare>::iterator& rhs) const
 {
     return this->current_ == rhs.current_;
 }
+
 /**
 * Checks if 'this' iterator's internals have a different value
 * as 'rhs'
-*/ 
-template<class Key, class Value>
+*/
+template<typename Key, typename Value, typename Compare>
 bool
-BinarySearchTree<Key, Value>::iterator::operator!=(
-	const BinarySearchTree<Key, Value>::iterator& rhs) const
-{
-    // TODO
-   return this->current_ != rhs.current_;
-
-}
-/**
-* Advances the iterator's location using an in-order sequencing
-*/
-template<class Key, class Value>
-typename BinarySearchTree<Key, Value>::iterator&
-BinarySearchTree<Key, Value>::iterator::operator++()
-{
-// TODO
-//2 cases
-//1.)if the right child isn't NULL, 
-//go to the right child and then go all the way
-//to the left child 
-if(this->current_->getRight() != nullptr)
-{
-	current_ = this->current_->getRight();
-	while(this->current_->getLeft()!= nullptr)
-	{
-		current_ = this->current_->getLeft();
-	}
-}
-//2.)if the right child is nullptr
-	else {
-		Node<Key,Value>* parent = current_->getParent();
-		while(parent != nullptr && current_ == parent->getRight())
-		{
-			this->current_ = parent;
-			parent = parent->getParent();
-		}
-    //will immeditately jump to this statement
-		//if the current node is a left child 
-		this->current_ = parent;
-	}
-	return *this;
-	/*
-	if(this->current_->getLeft())
-        this->current_ = this->current_->getLeft();
-
-    else if(this->current_->getRight())
-        this->current_ = this->current_->getRight();
-    else
-        this->current_ = NULL;
-        
+BinarySearchTree<Key, Value, Compare>::iterator::operator!=(
+    const BinarySearchTree<Key, Value, Compare>::iterator& rhs) const
+{
+    return this->current_ != rhs.current_;
+}
+
+/**
+* Advances the iterator's location using an in-order sequencing,
+* skipping tombstones.
+*/
+template<typename Key, typename Value, typename Compare>
+typename BinarySearchTree<Key, Value, Compare>::iterator&
+BinarySearchTree<Key, Value, Compare>::iterator::operator++()
+{
+    do
+    {
+        current_ = BinarySearchTree<Key, Value, Compare>::successor(current_);
+    } while(current_ != NULL && current_->isDead());
     return *this;
-		*/
 }
 
 /*
@@ -383,32 +689,96 @@ Begin implementations for the BinarySearchTree class.
 /**
 * Default constructor for a BinarySearchTree, which sets the root to NULL.
 */
-template<class Key, class Value>
-BinarySearchTree<Key, Value>::BinarySearchTree()
+template<typename Key, typename Value, typename Compare>
+BinarySearchTree<Key, Value, Compare>::BinarySearchTree()
+    : comp_(), root_(NULL), index_(NULL), finger_(NULL), fingerAtMax_(false),
+      size_(0), dead_(0), tombstones_(false), deadRatio_(0.5),
+      alpha_(0), maxSize_(0)
 {
-    // TODO
-    this->root_ = nullptr;
+
 }
 
-template<typename Key, typename Value>
-BinarySearchTree<Key, Value>::~BinarySearchTree()
+/**
+* Copies other's shape node for node in O(n): no inserts and no
+* rebalancing, and per-node data such as AVL balances and colors is
+* copied as is. The copies are laid out in pre-order in one contiguous
+* block, so descents in the copy touch nearby memory. Large trees are
+* copied by several threads, one block per subtree.
+*/
+template<typename Key, typename Value, typename Compare>
+BinarySearchTree<Key, Value, Compare>::BinarySearchTree(const BinarySearchTree<Key, Value, Compare>& other)
+    : BinarySearchTree()
+{
+    cloneFrom(other, std::thread::hardware_concurrency());
+}
+
+/**
+* Takes over other's nodes in O(1), leaving other empty.
+*/
+template<typename Key, typename Value, typename Compare>
+BinarySearchTree<Key, Value, Compare>::BinarySearchTree(BinarySearchTree<Key, Value, Compare>&& other)
+    : BinarySearchTree()
+{
+    takeFrom(other);
+}
+
+template<typename Key, typename Value, typename Compare>
+BinarySearchTree<Key, Value, Compare>::~BinarySearchTree()
+{
+    clear();
+    delete index_;
+}
+
+template<typename Key, typename Value, typename Compare>
+BinarySearchTree<Key, Value, Compare>&
+BinarySearchTree<Key, Value, Compare>::operator=(const BinarySearchTree<Key, Value, Compare>& other)
 {
-    // TODO
-    this->clear();
+    if(this != &other)
+    {
+        // copy first, so that a throw leaves this tree as it was
+        BinarySearchTree<Key, Value, Compare> copy(other);
+        clear();
+        delete index_;
+        index_ = NULL;
+        takeFrom(copy);
+    }
+    return *this;
+}
 
+template<typename Key, typename Value, typename Compare>
+BinarySearchTree<Key, Value, Compare>&
+BinarySearchTree<Key, Value, Compare>::operator=(BinarySearchTree<Key, Value, Compare>&& other)
+{
+    if(this != &other)
+    {
+        clear();
+        delete index_;
+        index_ = NULL;
+        takeFrom(other);
+    }
+    return *this;
 }
 
 /**
  * Returns true if tree is empty
 */
-template<class Key, class Value>
-bool BinarySearchTree<Key, Value>::empty() const
+template<typename Key, typename Value, typename Compare>
+bool BinarySearchTree<Key, Value, Compare>::empty() const
 {
-    return root_;
+    return size() == 0;
 }
 
-template<typename Key, typename Value>
-void BinarySearchTree<Key, Value>::print() const
+/**
+* Returns the number of items, not counting tombstones.
+*/
+template<typename Key, typename Value, typename Compare>
+size_t BinarySearchTree<Key, Value, Compare>::size() const
+{
+    return size_ - dead_;
+}
+
+template<typename Key, typename Value, typename Compare>
+void BinarySearchTree<Key, Value, Compare>::print() const
 {
     printRoot(root_);
     std::cout << "\n";
@@ -417,22 +787,37 @@ void BinarySearchTree<Key, Value>::print() const
 /**
 * Returns an iterator to the "smallest" item in the tree
 */
-template<class Key, class Value>
-typename BinarySearchTree<Key, Value>::iterator
-BinarySearchTree<Key, Value>::begin() const
+template<typename Key, typename Value, typename Compare>
+typename BinarySearchTree<Key, Value, Compare>::iterator
+BinarySearchTree<Key, Value, Compare>::begin() const
 {
-    BinarySearchTree<Key, Value>::iterator begin(getSmallestNode());
+    BinarySearchTree<Key, Value, Compare>::iterator begin(getSmallestNode());
+    if(begin.current_ != NULL && begin.current_->isDead())
+    {
+        ++begin;
+    }
     return begin;
 }
 
+/**
+* Wraps a node in an iterator; lets derived trees hand out iterators
+* to nodes they locate themselves.
+*/
+template<typename Key, typename Value, typename Compare>
+typename BinarySearchTree<Key, Value, Compare>::iterator
+BinarySearchTree<Key, Value, Compare>::makeIterator(Node<Key, Value>* node)
+{
+    return iterator(node);
+}
+
 /**
 * Returns an iterator whose value means INVALID
 */
-template<class Key, class Value>
-typename BinarySearchTree<Key, Value>::iterator
-BinarySearchTree<Key, Value>::end() const
+template<typename Key, typename Value, typename Compare>
+typename BinarySearchTree<Key, Value, Compare>::iterator
+BinarySearchTree<Key, Value, Compare>::end() const
 {
-    BinarySearchTree<Key, Value>::iterator end(NULL);
+    BinarySearchTree<Key, Value, Compare>::iterator end(NULL);
     return end;
 }
 
@@ -440,28 +825,158 @@ BinarySearchTree<Key, Value>::end() const
 * Returns an iterator to the item with the given key, k
 * or the end iterator if k does not exist in the tree
 */
-template<class Key, class Value>
-typename BinarySearchTree<Key, Value>::iterator
-BinarySearchTree<Key, Value>::find(const Key & k) const
+template<typename Key, typename Value, typename Compare>
+typename BinarySearchTree<Key, Value, Compare>::iterator
+BinarySearchTree<Key, Value, Compare>::find(const Key & k) const
 {
     Node<Key, Value> *curr = internalFind(k);
-    BinarySearchTree<Key, Value>::iterator it(curr);
+    BinarySearchTree<Key, Value, Compare>::iterator it(curr);
     return it;
 }
 
+/**
+* Looks up a key of another type that a transparent Compare orders
+* against Key. The hash index is keyed by Key, so this always descends.
+*/
+template<typename Key, typename Value, typename Compare>
+template<typename K, typename C, typename>
+typename BinarySearchTree<Key, Value, Compare>::iterator
+BinarySearchTree<Key, Value, Compare>::find(const K& key) const
+{
+    if constexpr(std::is_convertible<const K&, const char*>::value &&
+                 std::is_invocable<const Compare&, const Key&, std::string_view>::value)
+    {
+        // measure a C string once rather than at every level
+        return find(std::string_view(key));
+    }
+    Node<Key, Value>* curr = descend(key);
+    return iterator((curr != NULL && curr->isDead()) ? NULL : curr);
+}
+
+/**
+* Like find, but starts from finger and climbs only as far as needed
+* before descending, so keys near finger are found in about
+* O(log d) steps for d items between them on a balanced tree.
+*/
+template<typename Key, typename Value, typename Compare>
+typename BinarySearchTree<Key, Value, Compare>::iterator
+BinarySearchTree<Key, Value, Compare>::find_from(iterator finger, const Key& key) const
+{
+    if(finger.current_ == NULL || index_ != NULL)
+    {
+        return find(key);
+    }
+    Node<Key, Value>* curr = fingerStart(finger.current_, key);
+    while(curr != NULL)
+    {
+        int c = order(key, curr->getKey());
+        if(c < 0)
+        {
+            curr = curr->getLeft();
+        }
+        else if(c > 0)
+        {
+            curr = curr->getRight();
+        }
+        else
+        {
+            break;
+        }
+    }
+    return iterator(curr != NULL && curr->isDead() ? NULL : curr);
+}
+
+/**
+* Looks up every key in keys, storing find(keys[i]) in out[i]. Up to
+* FIND_MANY_WIDTH descents advance in turn, one level per visit, and
+* each prefetches the node it moves to, so the cache misses of
+* independent lookups overlap instead of being paid one after another.
+* A slot whose lookup ends is refilled with the next key right away.
+*/
+template<typename Key, typename Value, typename Compare>
+void BinarySearchTree<Key, Value, Compare>::find_many(const std::vector<Key>& keys, std::vector<iterator>& out) const
+{
+    out.resize(keys.size());
+    if(index_ != NULL)
+    {
+        for(size_t i = 0; i < keys.size(); ++i)
+        {
+            out[i] = iterator(internalFind(keys[i]));
+        }
+        return;
+    }
+
+    const size_t FIND_MANY_WIDTH = 16;
+    Node<Key, Value>* curr[FIND_MANY_WIDTH];
+    size_t which[FIND_MANY_WIDTH];
+    size_t active = 0;
+    size_t next = 0;
+    while(active < FIND_MANY_WIDTH && next < keys.size())
+    {
+        curr[active] = root_;
+        which[active++] = next++;
+    }
+
+    while(active > 0)
+    {
+        for(size_t slot = 0; slot < active; )
+        {
+            Node<Key, Value>* node = curr[slot];
+            const Key& key = keys[which[slot]];
+            bool done = (node == NULL);
+            if(!done)
+            {
+                int c = order(key, node->getKey());
+                if(c < 0)
+                {
+                    node = node->getLeft();
+                }
+                else if(c > 0)
+                {
+                    node = node->getRight();
+                }
+                else
+                {
+                    done = true;
+                }
+            }
+            if(!done)
+            {
+                BST_PREFETCH(node);
+                curr[slot++] = node;
+                continue;
+            }
+            out[which[slot]] = iterator(node != NULL && node->isDead() ? NULL : node);
+
+            // this lookup is done; start the next key in its slot
+            if(next < keys.size())
+            {
+                curr[slot] = root_;
+                which[slot++] = next++;
+            }
+            else
+            {
+                --active;
+                curr[slot] = curr[active];
+                which[slot] = which[active];
+            }
+        }
+    }
+}
+
 /**
  * @precondition The key exists in the map
  * Returns the value associated with the key
  */
-template<class Key, class Value>
-Value& BinarySearchTree<Key, Value>::operator[](const Key& key)
+template<typename Key, typename Value, typename Compare>
+Value& BinarySearchTree<Key, Value, Compare>::operator[](const Key& key)
 {
     Node<Key, Value> *curr = internalFind(key);
     if(curr == NULL) throw std::out_of_range("Invalid key");
     return curr->getValue();
 }
-template<class Key, class Value>
-Value const & BinarySearchTree<Key, Value>::operator[](const Key& key) const
+template<typename Key, typename Value, typename Compare>
+Value const & BinarySearchTree<Key, Value, Compare>::operator[](const Key& key) const
 {
     Node<Key, Value> *curr = internalFind(key);
     if(curr == NULL) throw std::out_of_range("Invalid key");
@@ -471,259 +986,1690 @@ Value const & BinarySearchTree<Key, Value>::operator[](const Key& key) const
 /**
 * An insert method to insert into a Binary Search Tree.
 * The tree will not remain balanced when inserting.
-* Recall: If key is already in the tree, you should 
+* Recall: If key is already in the tree, you should
 * overwrite the current value with the updated value.
+*
+* A key greater than every other goes straight under the last inserted
+* node when that node is the maximum, so in-order appends are O(1)
+* before any rebalancing.
 */
-template<class Key, class Value>
-void BinarySearchTree<Key, Value>::insert(const std::pair<const Key, Value> &keyValuePair)
+template<typename Key, typename Value, typename Compare>
+void BinarySearchTree<Key, Value, Compare>::insert(const std::pair<const Key, Value> &keyValuePair)
 {
-Node<Key, Value> *newNode;
-    Node<Key, Value> *curr_ = root_;
-    //if null, set to equal the new node 
-    if(curr_ == nullptr){
-        newNode = new Node<Key, Value>(keyValuePair.first, keyValuePair.second, curr_);
-        root_ = newNode;
-        //iterate through the tree for the next empty spot 
-    }else{
-        while((curr_->getLeft() != nullptr) || (curr_->getRight() != nullptr)){
-
-            if(keyValuePair.first < curr_->getKey()){
-                if(curr_->getLeft() != nullptr){
-                    curr_ = curr_->getLeft();
-                }else{
-                    break;
-                }
+    insertNear(NULL, keyValuePair);
+}
 
-            }else if(keyValuePair.first > curr_->getKey()){
+/**
+* Inserts keyValuePair, searching from hint instead of the root; hint
+* need only be near the key's position. end() uses the last inserted
+* node. Returns an iterator to the item.
+*/
+template<typename Key, typename Value, typename Compare>
+typename BinarySearchTree<Key, Value, Compare>::iterator
+BinarySearchTree<Key, Value, Compare>::insert(iterator hint, const std::pair<const Key, Value>& keyValuePair)
+{
+    return iterator(insertNear(hint.current_, keyValuePair));
+}
 
-                if(curr_->getRight() != nullptr){
-                    curr_ = curr_->getRight();
-                }else{
-                    break;
-                }
+template<typename Key, typename Value, typename Compare>
+Node<Key, Value>*
+BinarySearchTree<Key, Value, Compare>::insertNear(Node<Key, Value>* finger, const std::pair<const Key, Value>& keyValuePair)
+{
+    Node<Key, Value>* parent;
+    bool isMax;
+    Node<Key, Value>* found = locate(finger, keyValuePair.first, parent, isMax);
+    if(found != NULL)
+    {
+        found->setValue(keyValuePair.second);
+        return found;
+    }
 
-            }else if(keyValuePair.first == curr_->getKey()){
+    Node<Key, Value>* newNode = new Node<Key, Value>(keyValuePair.first, keyValuePair.second, parent);
+    if(parent == NULL)
+    {
+        root_ = newNode;
+    }
+    else if(comp_(keyValuePair.first, parent->getKey()))
+    {
+        parent->setLeft(newNode);
+    }
+    else
+    {
+        parent->setRight(newNode);
+    }
+    nodeAdded(newNode, isMax);
+    if(alpha_ > 0)
+    {
+        scapegoatAfterInsert(newNode);
+    }
+    return newNode;
+}
 
-                curr_->setValue(keyValuePair.second);
-                return;
+/**
+* Finds where key belongs. Returns its node if present (and makes it the
+* finger); otherwise returns NULL, with parent set to the node a new
+* leaf would hang from and isMax telling whether it would be the new
+* maximum. The search starts from finger if given, from the automatic
+* finger for a key past the maximum, and from the root otherwise.
+*/
+template<typename Key, typename Value, typename Compare>
+Node<Key, Value>*
+BinarySearchTree<Key, Value, Compare>::locate(Node<Key, Value>* finger, const Key& key,
+                                     Node<Key, Value>*& parent, bool& isMax)
+{
+    Node<Key, Value>* curr = root_;
+    // only a descent from the root or from the maximum can end at a new maximum
+    bool onRightSpine = true;
+    if(fingerAtMax_ && (finger == NULL || finger == finger_) && comp_(finger_->getKey(), key))
+    {
+        curr = finger_;
+    }
+    else if(finger != NULL)
+    {
+        curr = fingerStart(finger, key);
+        onRightSpine = false;
+    }
 
-            }
+    parent = NULL;
+    while(curr != NULL)
+    {
+        parent = curr;
+        int c = order(key, curr->getKey());
+        if(c < 0)
+        {
+            onRightSpine = false;
+            curr = curr->getLeft();
         }
-        //compare the keys and then set it equal to the new node 
-        if(keyValuePair.first < curr_->getKey()){
-            newNode = new Node<Key, Value>(keyValuePair.first, keyValuePair.second, curr_);
-            curr_->setLeft(newNode);
-            return;
-
-        }else if(keyValuePair.first > curr_->getKey()){
-            newNode = new Node<Key, Value>(keyValuePair.first, keyValuePair.second, curr_);
-            curr_->setRight(newNode);
-            return;
+        else if(c > 0)
+        {
+            curr = curr->getRight();
         }
+        else
+        {
+            revive(curr);
+            finger_ = curr;
+            fingerAtMax_ = onRightSpine && curr->getRight() == NULL;
+            isMax = fingerAtMax_;
+            return curr;
+        }
+    }
+    isMax = onRightSpine;
+    return NULL;
+}
 
-        
+/**
+* Returns the lowest node at or above finger whose subtree spans key,
+* i.e. where a descent for key may start. Each round climbs to the
+* nearest ancestor bounding finger's subtree on key's side and stops as
+* soon as that bound is on the far side of key.
+*/
+template<typename Key, typename Value, typename Compare>
+Node<Key, Value>*
+BinarySearchTree<Key, Value, Compare>::fingerStart(Node<Key, Value>* finger, const Key& key) const
+{
+    Node<Key, Value>* start = finger;
+    while(true)
+    {
+        int c = order(key, start->getKey());
+        if(c == 0)
+        {
+            return start;
+        }
+        bool goLeft = c < 0;
+        // the bound is the first ancestor entered from key's other side
+        Node<Key, Value>* child = start;
+        Node<Key, Value>* bound = start->getParent();
+        while(bound != NULL && (goLeft ? bound->getLeft() : bound->getRight()) == child)
+        {
+            child = bound;
+            bound = bound->getParent();
+        }
+        if(bound == NULL || (goLeft ? comp_(bound->getKey(), key) : comp_(key, bound->getKey())))
+        {
+            return start;
+        }
+        start = bound;
     }
 }
+
 /**
 * A remove method to remove a specific key from a Binary Search Tree.
 * Recall: The writeup specifies that if a node has 2 children you
 * should swap with the predecessor and then remove.
 */
-template<typename Key, typename Value>
-void BinarySearchTree<Key, Value>::remove(const Key& key)
-{
-Node<Key, Value>* deletedNode = internalFind(key);
-	if(deletedNode != nullptr)
-	{
-		//CASE 1. Two children
-		if(deletedNode->getRight() != nullptr && deletedNode->getLeft() != nullptr)
-		{
-			nodeSwap(predecessor(deletedNode),deletedNode);
-		}
-		//CASE 2. One child(left child)
-		else if(deletedNode->getLeft() != nullptr && deletedNode->getRight() == nullptr)
-		{
-			nodeSwap(deletedNode, deletedNode->getLeft());
-		}
-		//CASE 3. One child(right child)
-		else if(deletedNode->getRight() != nullptr && deletedNode->getLeft() == nullptr)
-		{
-			nodeSwap(deletedNode,deletedNode->getRight());
-		}
-		//If one child, two children or no children, the node will be deleted
-        delete deletedNode;
-	}
-}
-
-template<class Key, class Value>
-Node<Key, Value>*
-BinarySearchTree<Key, Value>::predecessor(Node<Key, Value>* current)
-{
-    // TODO
-		 ///use current 
-		 //if the node is nullptr
-		 if(current == nullptr)
-		 {
-			 return current;
-		 }
-		 //if left child exits, predcessor is the right 
-		 //most node of the left subtree
-		 if(current->getLeft() != nullptr)
-		 {
-			 current = current->getLeft();
-			 while(current != nullptr)
-			 {
-				 current = current->getRight();
-			 }
-		 }
-		 else
-		 {
-             //iterate up in order to get the parent(predcessor)
-			 while(current->getRight() == nullptr)
-			 {
-				 if(current->getParent() != nullptr)
-				 {
-					 current = current->getParent();
-				 }
-				 else{
-					 break;
-				 }
-			 } 
-		 }
-		 return current;
+template<typename Key, typename Value, typename Compare>
+void BinarySearchTree<Key, Value, Compare>::remove(const Key& key)
+{
+    if(removeLazily(key))
+    {
+        return;
+    }
+    Node<Key, Value>* node = internalFind(key);
+    if(node != NULL)
+    {
+        removeNode(node);
+    }
 }
-/**
-* A method to remove all contents of the tree and
-* reset the values in the tree for use again.
-*/
-template<typename Key, typename Value>
-void BinarySearchTree<Key, Value>::clear()
+
+template<typename Key, typename Value, typename Compare>
+void BinarySearchTree<Key, Value, Compare>::removeNode(Node<Key, Value>* deletedNode)
 {
-    // TODO
-		if(empty())
-		{
-			return;
-		}
-		//pass in the root in order to delete everything 
-		else
-		{
-			exactClear(this->root_);
-		}
+    // After swapping with the predecessor the node has at most one child.
+    if(deletedNode->getLeft() != NULL && deletedNode->getRight() != NULL)
+    {
+        nodeSwap(predecessor(deletedNode), deletedNode);
+    }
 
+    Node<Key, Value>* child = deletedNode->getLeft();
+    if(child == NULL)
+    {
+        child = deletedNode->getRight();
+    }
+    Node<Key, Value>* parent = deletedNode->getParent();
+    if(child != NULL)
+    {
+        child->setParent(parent);
+    }
+    if(parent == NULL)
+    {
+        root_ = child;
+    }
+    else if(parent->getLeft() == deletedNode)
+    {
+        parent->setLeft(child);
+    }
+    else
+    {
+        parent->setRight(child);
+    }
+    nodeRemoved(deletedNode);
+    releaseNode(deletedNode);
+
+    // scapegoat mode: rebuild everything once the tree has shrunk enough
+    // that its height may exceed the bound for the current size
+    if(alpha_ > 0 && size_ < alpha_ * maxSize_)
+    {
+        if(root_ != NULL)
+        {
+            rebuildSubtree(root_);
+        }
+        maxSize_ = size_;
+    }
+}
+
+/**
+* Removes the item at pos, which must not be end(), without searching
+* for its key, and returns an iterator to the item after it. Iterators
+* to other items stay valid.
+*/
+template<typename Key, typename Value, typename Compare>
+typename BinarySearchTree<Key, Value, Compare>::iterator
+BinarySearchTree<Key, Value, Compare>::erase(iterator pos)
+{
+    Node<Key, Value>* node = pos.current_;
+    ++pos;
+    if(tombstones_)
+    {
+        // marking the node dead, and compacting, is the tree's remove
+        remove(node->getKey());
+    }
+    else
+    {
+        eraseRange(node, pos.current_);
+    }
+    return pos;
+}
+
+/**
+* Removes the items in [first, last) and returns last. The tree is split
+* just before first and just after the last item removed, the middle is
+* freed, and the two outer pieces are joined back under last. Each split
+* and the join rebalance only along the cut paths, so for AVLTree and
+* RBTree a range of k items costs O(log n + k) rather than k removals.
+* Tombstones in the range are freed with it. Scapegoat mode and
+* RelaxedAVLTree remove the items one at a time instead. A range
+* covering the whole tree is a clear.
+*/
+template<typename Key, typename Value, typename Compare>
+typename BinarySearchTree<Key, Value, Compare>::iterator
+BinarySearchTree<Key, Value, Compare>::erase(iterator first, iterator last)
+{
+    if(last.current_ == NULL && first.current_ != NULL && first.current_ == getSmallestNode())
+    {
+        clear();
+        return end();
+    }
+    eraseRange(first.current_, last.current_);
+    return last;
+}
+
+template<typename Key, typename Value, typename Compare>
+void BinarySearchTree<Key, Value, Compare>::eraseRange(Node<Key, Value>* first, Node<Key, Value>* last)
+{
+    if(first == last)
+    {
+        return;
+    }
+    // scapegoat mode counts on removals never deepening the tree, which
+    // the join under last would
+    if(alpha_ > 0 || successor(first) == last)
+    {
+        removeEach(first, last);
+        return;
+    }
+
+    Node<Key, Value>* left;
+    Node<Key, Value>* right;
+    int leftRank;
+    int rightRank;
+    int rank;
+    if(last == NULL)
+    {
+        // a split piece need not be a valid tree on its own (an RBTree
+        // piece can have a red root), so the kept items always go
+        // through a join: split around the item before first instead
+        // and join it back over the left piece and an empty right one
+        Node<Key, Value>* keep = predecessor(first);
+        if(keep == NULL)
+        {
+            discardSubtree(root_);
+            root_ = NULL;
+            return;
+        }
+        splitAround(keep, left, leftRank, right, rightRank);
+        discardSubtree(right);
+        root_ = join(left, leftRank, keep, NULL, 0, rank);
+    }
+    else
+    {
+        splitAround(first, left, leftRank, right, rightRank);
+        discardSubtree(first);
+        Node<Key, Value>* middle;
+        int middleRank;
+        // last is in right, so this split stays within it
+        splitAround(last, middle, middleRank, right, rightRank);
+        discardSubtree(middle);
+        root_ = join(left, leftRank, last, right, rightRank, rank);
+    }
+    if(root_ != NULL)
+    {
+        root_->setParent(NULL);
+    }
+}
+
+/**
+* Removes the nodes from first up to last one removeNode at a time.
+*/
+template<typename Key, typename Value, typename Compare>
+void BinarySearchTree<Key, Value, Compare>::removeEach(Node<Key, Value>* first, Node<Key, Value>* last)
+{
+    Node<Key, Value>* node = first;
+    while(node != last)
+    {
+        // the successor is neither freed nor moved by the removal
+        Node<Key, Value>* next = successor(node);
+        if(node->isDead())
+        {
+            --dead_;
+        }
+        removeNode(node);
+        node = next;
+    }
+}
+
+/**
+* Frees every node in the subtree at head, which is no longer linked to
+* the rest of the tree, with the bookkeeping removeNode does.
+*/
+template<typename Key, typename Value, typename Compare>
+void BinarySearchTree<Key, Value, Compare>::discardSubtree(Node<Key, Value>* head)
+{
+    // the same rotations as exactClear
+    while(head != NULL)
+    {
+        Node<Key, Value>* left = head->getLeft();
+        if(left != NULL)
+        {
+            head->setLeft(left->getRight());
+            left->setRight(head);
+            head = left;
+            continue;
+        }
+        Node<Key, Value>* next = head->getRight();
+        if(head->isDead())
+        {
+            --dead_;
+        }
+        nodeRemoved(head);
+        releaseNode(head);
+        head = next;
+    }
+}
+
+/**
+* Cuts node out of the tree, leaving it with no children, and splits the
+* rest into left, the items before node, and right, the items after it,
+* along with their ranks. Walking up from node, each ancestor is joined
+* with its other subtree onto the piece on its side.
+*/
+template<typename Key, typename Value, typename Compare>
+void BinarySearchTree<Key, Value, Compare>::splitAround(Node<Key, Value>* node, Node<Key, Value>*& left,
+                                                      int& leftRank, Node<Key, Value>*& right, int& rightRank)
+{
+    left = node->getLeft();
+    right = node->getRight();
+    leftRank = rankOf(left);
+    // childRank is the rank of node's subtree as it was, which is what
+    // its parent's rank was built on
+    int childRank = rankAbove(node, true, leftRank, rightRank);
+    if(left != NULL)
+    {
+        left->setParent(NULL);
+    }
+    if(right != NULL)
+    {
+        right->setParent(NULL);
+    }
+    Node<Key, Value>* child = node;
+    Node<Key, Value>* parent = node->getParent();
+    linkChildren(node, NULL, NULL);
+    while(parent != NULL)
+    {
+        Node<Key, Value>* up = parent->getParent();
+        bool fromLeft = (parent->getLeft() == child);
+        int siblingRank;
+        int parentRank = rankAbove(parent, fromLeft, childRank, siblingRank);
+        Node<Key, Value>* sibling = fromLeft ? parent->getRight() : parent->getLeft();
+        if(sibling != NULL)
+        {
+            sibling->setParent(NULL);
+        }
+        if(fromLeft)
+        {
+            right = join(right, rightRank, parent, sibling, siblingRank, rightRank);
+        }
+        else
+        {
+            left = join(sibling, siblingRank, parent, left, leftRank, leftRank);
+        }
+        child = parent;
+        childRank = parentRank;
+        parent = up;
+    }
+}
+
+/**
+* A plain tree keeps no ranks.
+*/
+template<typename Key, typename Value, typename Compare>
+int BinarySearchTree<Key, Value, Compare>::rankOf(Node<Key, Value>*) const
+{
+    return 0;
+}
+
+template<typename Key, typename Value, typename Compare>
+int BinarySearchTree<Key, Value, Compare>::rankAbove(Node<Key, Value>*, bool, int, int& siblingRank) const
+{
+    siblingRank = 0;
+    return 0;
+}
+
+/**
+* A plain tree just hangs left and right under mid.
+*/
+template<typename Key, typename Value, typename Compare>
+Node<Key, Value>* BinarySearchTree<Key, Value, Compare>::join(Node<Key, Value>* left, int, Node<Key, Value>* mid,
+                                                              Node<Key, Value>* right, int, int& rank)
+{
+    linkChildren(mid, left, right);
+    mid->setParent(NULL);
+    rank = 0;
+    return mid;
+}
+
+/**
+* Makes left and right (either may be NULL) node's children.
+*/
+template<typename Key, typename Value, typename Compare>
+void BinarySearchTree<Key, Value, Compare>::linkChildren(Node<Key, Value>* node, Node<Key, Value>* left,
+                                                         Node<Key, Value>* right)
+{
+    node->setLeft(left);
+    node->setRight(right);
+    if(left != NULL)
+    {
+        left->setParent(node);
+    }
+    if(right != NULL)
+    {
+        right->setParent(node);
+    }
+}
+
+/**
+* Returns the in-order predecessor of current, or NULL if current
+* holds the smallest key.
+*/
+template<typename Key, typename Value, typename Compare>
+Node<Key, Value>*
+BinarySearchTree<Key, Value, Compare>::predecessor(Node<Key, Value>* current)
+{
+    if(current == NULL)
+    {
+        return current;
+    }
+    // With a left subtree, the predecessor is its rightmost node.
+    if(current->getLeft() != NULL)
+    {
+        current = current->getLeft();
+        while(current->getRight() != NULL)
+        {
+            current = current->getRight();
+        }
+        return current;
+    }
+    // Otherwise it is the first ancestor we reach from a right child.
+    Node<Key, Value>* parent = current->getParent();
+    while(parent != NULL && current == parent->getLeft())
+    {
+        current = parent;
+        parent = parent->getParent();
+    }
+    return parent;
+}
+
+/**
+* Returns the in-order successor of current, or NULL if current holds
+* the largest key. Tombstones are not skipped.
+*/
+template<typename Key, typename Value, typename Compare>
+Node<Key, Value>*
+BinarySearchTree<Key, Value, Compare>::successor(Node<Key, Value>* current)
+{
+    // With a right subtree, the successor is its leftmost node.
+    if(current->getRight() != NULL)
+    {
+        current = current->getRight();
+        while(current->getLeft() != NULL)
+        {
+            current = current->getLeft();
+        }
+        return current;
+    }
+    // Otherwise climb until we arrive from a left child; that parent
+    // is the successor (or NULL once we walk off the root).
+    Node<Key, Value>* parent = current->getParent();
+    while(parent != NULL && current == parent->getRight())
+    {
+        current = parent;
+        parent = parent->getParent();
+    }
+    return parent;
+}
+
+/**
+* A method to remove all contents of the tree and
+* reset the values in the tree for use again.
+*/
+template<typename Key, typename Value, typename Compare>
+void BinarySearchTree<Key, Value, Compare>::clear()
+{
+    exactClear(root_);
+    root_ = NULL;
+    finger_ = NULL;
+    fingerAtMax_ = false;
+    size_ = 0;
+    dead_ = 0;
+    maxSize_ = 0;
+    if(index_ != NULL)
+    {
+        index_->clear();
+    }
+    cleared();
+}
+
+/**
+* A plain tree keeps nothing that refers to its nodes.
+*/
+template<typename Key, typename Value, typename Compare>
+void BinarySearchTree<Key, Value, Compare>::cleared()
+{
+
+}
+
+/**
+* A helper function to find the smallest node in the tree.
+*/
+template<typename Key, typename Value, typename Compare>
+Node<Key, Value>*
+BinarySearchTree<Key, Value, Compare>::getSmallestNode() const
+{
+    Node<Key, Value>* curr = root_;
+    if(curr == NULL)
+    {
+        return NULL;
+    }
+    while(curr->getLeft() != NULL)
+    {
+        curr = curr->getLeft();
+    }
+    return curr;
+}
+
+/**
+* Helper function to find a node with given key, k and
+* return a pointer to it or NULL if no item with that key
+* exists
+*/
+template<typename Key, typename Value, typename Compare>
+Node<Key, Value>* BinarySearchTree<Key, Value, Compare>::internalFind(const Key& key) const
+{
+    Node<Key, Value>* curr;
+    if(index_ != NULL)
+    {
+        curr = index_->find(key);
+    }
+    else
+    {
+        curr = descend(key);
+    }
+    return (curr != NULL && curr->isDead()) ? NULL : curr;
+}
+
+/**
+* Walks down from the root to key's node, dead or alive, or to NULL.
+*/
+template<typename Key, typename Value, typename Compare>
+template<typename K>
+Node<Key, Value>* BinarySearchTree<Key, Value, Compare>::descend(const K& key) const
+{
+    Node<Key, Value>* curr = root_;
+    while(curr != NULL)
+    {
+        int c = order(key, curr->getKey());
+        if(c < 0)
+        {
+            curr = curr->getLeft();
+        }
+        else if(c > 0)
+        {
+            curr = curr->getRight();
+        }
+        else
+        {
+            break;
+        }
+    }
+    return curr;
+}
+
+template<typename Key, typename Value, typename Compare>
+template<typename A, typename B>
+int BinarySearchTree<Key, Value, Compare>::order(const A& a, const B& b) const
+{
+    return compareKeys(comp_, a, b);
+}
+
+/**
+* Builds a hash index over the current nodes and keeps it up to date
+* from then on, making find, operator[] and remove's lookup O(1)
+* expected; ordered iteration is unaffected. Costs 16 to 32 bytes per
+* key and a table update on every insert and remove. nodeSwap needs no
+* index update, as nodes keep their items when they trade places.
+*
+* Indexed lookups use Hash and KeyEqual instead of Compare, so the two
+* must agree with it: keys Compare treats as equivalent must be equal
+* under KeyEqual and hash alike. std::hash and std::equal_to are only
+* accepted with std::less or std::greater; a tree with any other
+* ordering (a case-insensitive one, say) must pass its own pair.
+*/
+template<typename Key, typename Value, typename Compare>
+template<typename Hash, typename KeyEqual>
+void BinarySearchTree<Key, Value, Compare>::enableHashIndex()
+{
+    static_assert(!(std::is_same<Hash, std::hash<Key> >::value && std::is_same<KeyEqual, std::equal_to<Key> >::value) ||
+                  std::is_same<Compare, std::less<Key> >::value || std::is_same<Compare, std::less<> >::value ||
+                  std::is_same<Compare, std::greater<Key> >::value || std::is_same<Compare, std::greater<> >::value,
+                  "a tree with a custom Compare needs a Hash and KeyEqual that agree with it");
+    if(index_ != NULL)
+    {
+        return;
+    }
+    index_ = new HashIndex<Key, Node<Key, Value>, Hash, KeyEqual>();
+    // tombstones are indexed too, as nodeAdded indexes them: a revived
+    // node is not added again
+    for(Node<Key, Value>* n = getSmallestNode(); n != NULL; n = successor(n))
+    {
+        index_->insert(n);
+    }
+}
+
+/**
+* Drops the hash index; lookups go back to descending the tree.
+*/
+template<typename Key, typename Value, typename Compare>
+void BinarySearchTree<Key, Value, Compare>::disableHashIndex()
+{
+    delete index_;
+    index_ = NULL;
+}
+
+template<typename Key, typename Value, typename Compare>
+bool BinarySearchTree<Key, Value, Compare>::hasHashIndex() const
+{
+    return index_ != NULL;
+}
+
+/**
+* Returns the heap memory held by the hash index, or 0 if it is off.
+*/
+template<typename Key, typename Value, typename Compare>
+size_t BinarySearchTree<Key, Value, Compare>::hashIndexBytes() const
+{
+    return index_ == NULL ? 0 : index_->memoryBytes();
+}
+
+/**
+* Records a newly linked node: indexes it and makes it the finger.
+* isMax says whether it holds the largest key; trees that do not know
+* pass false, which only disables the append shortcut until the next
+* insert that does.
+*/
+template<typename Key, typename Value, typename Compare>
+void BinarySearchTree<Key, Value, Compare>::nodeAdded(Node<Key, Value>* node, bool isMax)
+{
+    if(index_ != NULL)
+    {
+        index_->insert(node);
+    }
+    finger_ = node;
+    fingerAtMax_ = isMax;
+    ++size_;
+}
+
+/**
+* Forgets a node that is about to be deleted.
+*/
+template<typename Key, typename Value, typename Compare>
+void BinarySearchTree<Key, Value, Compare>::nodeRemoved(Node<Key, Value>* node)
+{
+    if(index_ != NULL)
+    {
+        index_->erase(node);
+    }
+    if(node == finger_)
+    {
+        finger_ = NULL;
+        fingerAtMax_ = false;
+    }
+    --size_;
+}
+
+/**
+* Turns on deferred deletion: remove only marks the node dead, with no
+* unlinking or rebalancing, and find, operator[] and iteration skip
+* dead nodes. Once more than deadRatio of the nodes are dead, compact
+* rebuilds the tree. Re-inserting a dead key revives its node in place.
+*/
+template<typename Key, typename Value, typename Compare>
+void BinarySearchTree<Key, Value, Compare>::enableTombstones(double deadRatio)
+{
+    tombstones_ = true;
+    deadRatio_ = deadRatio;
+}
+
+/**
+* Compacts away any tombstones and goes back to eager deletion.
+*/
+template<typename Key, typename Value, typename Compare>
+void BinarySearchTree<Key, Value, Compare>::disableTombstones()
+{
+    compact();
+    tombstones_ = false;
+}
+
+/**
+* In tombstone mode, marks key's node dead and returns true (also when
+* key is absent); otherwise returns false and leaves the removal to the
+* caller.
+*/
+template<typename Key, typename Value, typename Compare>
+bool BinarySearchTree<Key, Value, Compare>::removeLazily(const Key& key)
+{
+    if(!tombstones_)
+    {
+        return false;
+    }
+    Node<Key, Value>* node = internalFind(key);
+    if(node != NULL)
+    {
+        node->setDead(true);
+        ++dead_;
+        if(dead_ > deadRatio_ * size_)
+        {
+            compact();
+        }
+    }
+    return true;
+}
+
+/**
+* Brings back a dead node that an insert found holding its key.
+*/
+template<typename Key, typename Value, typename Compare>
+void BinarySearchTree<Key, Value, Compare>::revive(Node<Key, Value>* node)
+{
+    if(node->isDead())
+    {
+        node->setDead(false);
+        --dead_;
+    }
+}
+
+/**
+* Deletes every tombstone and rebuilds the live nodes into a perfectly
+* balanced tree in O(n). Live nodes are reused, so iterators to them
+* stay valid.
+*/
+template<typename Key, typename Value, typename Compare>
+void BinarySearchTree<Key, Value, Compare>::compact()
+{
+    if(dead_ != 0)
+    {
+        rebuildLive();
+    }
+}
+
+/**
+* Frees the tombstones and links the live nodes into a perfectly
+* balanced tree.
+*/
+template<typename Key, typename Value, typename Compare>
+void BinarySearchTree<Key, Value, Compare>::rebuildLive()
+{
+    std::vector<Node<Key, Value>*> live;
+    std::vector<Node<Key, Value>*> dead;
+    live.reserve(size_ - dead_);
+    dead.reserve(dead_);
+    for(Node<Key, Value>* n = getSmallestNode(); n != NULL; n = successor(n))
+    {
+        (n->isDead() ? dead : live).push_back(n);
+    }
+    for(size_t i = 0; i < dead.size(); ++i)
+    {
+        nodeRemoved(dead[i]);
+        releaseNode(dead[i]);
+    }
+    dead_ = 0;
+    root_ = buildBalanced(live, 0, live.size(), NULL);
+    if(root_ != NULL)
+    {
+        rebuildFix(root_);
+    }
+}
+
+/**
+* Prepares a read-mostly tree for lookups: drops the tombstones,
+* rebuilds the tree perfectly balanced and moves every node into one
+* allocation in van Emde Boas order. That order stores the top half of
+* the levels first, then each subtree hanging below them, each laid out
+* the same way, so a search stays within a few blocks at every scale
+* (cache lines, pages) without knowing their sizes.
+*
+* The tree stays fully mutable: new nodes are allocated on their own,
+* and the block is freed once its last node is removed. Iterators and
+* references into the tree are invalidated. If copying an item throws,
+* the tree is left balanced but not moved.
+*/
+template<typename Key, typename Value, typename Compare>
+void BinarySearchTree<Key, Value, Compare>::compactLayout()
+{
+    rebuildLive();
+    if(root_ == NULL)
+    {
+        return;
+    }
+    size_t height = 0;
+    for(size_t n = size_; n > 0; n >>= 1)
+    {
+        ++height;
+    }
+    std::vector<Node<Key, Value>*> order;
+    order.reserve(size_);
+    vebOrder(root_, height, order);
+
+    // every node of a tree has the same type
+    size_t stride = root_->allocationSize();
+    char* mem = static_cast<char*>(::operator new(order.size() * stride));
+    std::vector<Node<Key, Value>*> copies(order.size());
+    size_t made = 0;
+    try
+    {
+        for(; made < order.size(); ++made)
+        {
+            copies[made] = order[made]->cloneAt(mem + made * stride, NULL);
+        }
+    }
+    catch(...)
+    {
+        for(size_t i = 0; i < made; ++i)
+        {
+            copies[i]->~Node();
+        }
+        ::operator delete(mem);
+        throw;
+    }
+
+    // Parents come before their children in the order, so each old
+    // node's parent link, once read, can hold its copy for the children.
+    for(size_t i = 0; i < order.size(); ++i)
+    {
+        Node<Key, Value>* old = order[i];
+        Node<Key, Value>* oldParent = old->getParent();
+        if(oldParent == NULL)
+        {
+            root_ = copies[i];
+        }
+        else
+        {
+            Node<Key, Value>* parent = oldParent->getParent();
+            copies[i]->setParent(parent);
+            if(oldParent->getLeft() == old)
+            {
+                parent->setLeft(copies[i]);
+            }
+            else
+            {
+                parent->setRight(copies[i]);
+            }
+        }
+        old->setParent(copies[i]);
+    }
+    for(size_t i = 0; i < order.size(); ++i)
+    {
+        if(index_ != NULL)
+        {
+            index_->erase(order[i]);
+            index_->insert(copies[i]);
+        }
+        releaseNode(order[i]);
+    }
+    NodeArena arena = { mem, mem + order.size() * stride, order.size() };
+    arenas_.push_back(arena);
+    finger_ = NULL;
+    fingerAtMax_ = false;
+}
+
+/**
+* Appends the nodes within height levels of root to out in van Emde
+* Boas order: the top height / 2 levels, then each subtree below them
+* from left to right, all recursively.
+*/
+template<typename Key, typename Value, typename Compare>
+void BinarySearchTree<Key, Value, Compare>::vebOrder(Node<Key, Value>* root, size_t height,
+                                            std::vector<Node<Key, Value>*>& out)
+{
+    if(height == 1)
+    {
+        out.push_back(root);
+        return;
+    }
+    size_t top = height / 2;
+    vebOrder(root, top, out);
+    std::vector<Node<Key, Value>*> bottoms;
+    nodesAtDepth(root, top, bottoms);
+    for(size_t i = 0; i < bottoms.size(); ++i)
+    {
+        vebOrder(bottoms[i], height - top, out);
+    }
+}
+
+/**
+* Appends the nodes depth levels below node to out, left to right.
+*/
+template<typename Key, typename Value, typename Compare>
+void BinarySearchTree<Key, Value, Compare>::nodesAtDepth(Node<Key, Value>* node, size_t depth,
+                                                std::vector<Node<Key, Value>*>& out)
+{
+    if(node == NULL)
+    {
+        return;
+    }
+    if(depth == 0)
+    {
+        out.push_back(node);
+        return;
+    }
+    nodesAtDepth(node->getLeft(), depth - 1, out);
+    nodesAtDepth(node->getRight(), depth - 1, out);
+}
+
+/**
+* Links nodes[lo, hi), which are in key order, into a subtree under
+* parent whose left and right sizes differ by at most one everywhere.
+* Returns the subtree root.
+*/
+template<typename Key, typename Value, typename Compare>
+Node<Key, Value>*
+BinarySearchTree<Key, Value, Compare>::buildBalanced(std::vector<Node<Key, Value>*>& nodes, size_t lo, size_t hi,
+                                            Node<Key, Value>* parent)
+{
+    if(lo >= hi)
+    {
+        return NULL;
+    }
+    size_t mid = lo + (hi - lo) / 2;
+    Node<Key, Value>* node = nodes[mid];
+    node->setParent(parent);
+    node->setLeft(buildBalanced(nodes, lo, mid, node));
+    node->setRight(buildBalanced(nodes, mid + 1, hi, node));
+    return node;
+}
+
+/**
+* Called after buildBalanced relinked subtree; plain nodes need nothing.
+*/
+template<typename Key, typename Value, typename Compare>
+void BinarySearchTree<Key, Value, Compare>::rebuildFix(Node<Key, Value>*)
+{
+
+}
+
+/**
+* Rebuilds the subtree rooted at top into a perfectly balanced one in
+* linear time and hangs it back in top's place.
+*/
+template<typename Key, typename Value, typename Compare>
+void BinarySearchTree<Key, Value, Compare>::rebuildSubtree(Node<Key, Value>* top)
+{
+    Node<Key, Value>* parent = top->getParent();
+    bool wasLeft = (parent != NULL && parent->getLeft() == top);
+    Node<Key, Value>* first = top;
+    while(first->getLeft() != NULL)
+    {
+        first = first->getLeft();
+    }
+    Node<Key, Value>* last = top;
+    while(last->getRight() != NULL)
+    {
+        last = last->getRight();
+    }
+
+    std::vector<Node<Key, Value>*> nodes;
+    for(Node<Key, Value>* n = first; ; n = successor(n))
+    {
+        nodes.push_back(n);
+        if(n == last)
+        {
+            break;
+        }
+    }
+    Node<Key, Value>* newTop = buildBalanced(nodes, 0, nodes.size(), parent);
+    if(parent == NULL)
+    {
+        root_ = newTop;
+    }
+    else if(wasLeft)
+    {
+        parent->setLeft(newTop);
+    }
+    else
+    {
+        parent->setRight(newTop);
+    }
+    rebuildFix(newTop);
+}
+
+/**
+* Turns on scapegoat rebalancing for BinarySearchTree's own insert and
+* remove (the balanced trees ignore it). An insert that lands deeper
+* than log base 1/alpha of the size climbs to the first ancestor whose
+* child holds more than alpha of its nodes and rebuilds that subtree,
+* which keeps operations O(log n) amortized without any per-node data.
+* alpha must lie in (0.5, 1); lower values keep the tree flatter at the
+* cost of more frequent rebuilds. The current tree is rebuilt once.
+*/
+template<typename Key, typename Value, typename Compare>
+void BinarySearchTree<Key, Value, Compare>::enableScapegoat(double alpha)
+{
+    alpha_ = alpha;
+    if(root_ != NULL)
+    {
+        rebuildSubtree(root_);
+    }
+    maxSize_ = size_;
+}
+
+template<typename Key, typename Value, typename Compare>
+void BinarySearchTree<Key, Value, Compare>::disableScapegoat()
+{
+    alpha_ = 0;
+}
+
+/**
+* Checks the depth of a freshly linked node and, if it is too deep,
+* finds and rebuilds a scapegoat above it.
+*/
+template<typename Key, typename Value, typename Compare>
+void BinarySearchTree<Key, Value, Compare>::scapegoatAfterInsert(Node<Key, Value>* node)
+{
+    maxSize_ = std::max(maxSize_, size_);
+    size_t depth = 0;
+    for(Node<Key, Value>* p = node->getParent(); p != NULL; p = p->getParent())
+    {
+        ++depth;
+    }
+    if(depth <= std::log((double)size_) / std::log(1 / alpha_))
+    {
+        return;
+    }
+
+    // sizes are only computed on this rare path; a subtree that is too
+    // deep always has an ancestor that is alpha-weight-unbalanced
+    size_t childSize = 1;
+    Node<Key, Value>* child = node;
+    for(Node<Key, Value>* p = node->getParent(); p != NULL; p = p->getParent())
+    {
+        Node<Key, Value>* sibling = (p->getLeft() == child) ? p->getRight() : p->getLeft();
+        size_t size = childSize + 1 + subtreeSize(sibling);
+        if(childSize > alpha_ * size)
+        {
+            rebuildSubtree(p);
+            return;
+        }
+        child = p;
+        childSize = size;
+    }
+}
+
+template<typename Key, typename Value, typename Compare>
+size_t BinarySearchTree<Key, Value, Compare>::subtreeSize(Node<Key, Value>* node)
+{
+    if(node == NULL)
+    {
+        return 0;
+    }
+    return 1 + subtreeSize(node->getLeft()) + subtreeSize(node->getRight());
 }
+
 /**
-* A helper function to find the smallest node in the tree.
+ * Return true iff the BST is balanced.
+ */
+template<typename Key, typename Value, typename Compare>
+bool BinarySearchTree<Key, Value, Compare>::isBalanced() const
+{
+    return calculateHeightIfBalanced(root_) != -1;
+}
+
+/**
+* Measures the tree's shape and layout in one iterative pass over its
+* nodes: level counts and search path lengths against a complete tree,
+* the tree's own per-node statistics, heap bytes per node, and how
+* often a parent and its child sit on different cache lines or pages.
 */
-template<typename Key, typename Value>
-Node<Key, Value>*
-BinarySearchTree<Key, Value>::getSmallestNode() const
-{
-    // TODO
-    //the root is empty, return nullptr
-		if (root_ == nullptr)
-		{
-        return nullptr;
-		}
-        //keep iterating until you get to the farthest left node 
-        //then return it 
-		Node<Key, Value>* curr_ = root_;
-		while(1)
-		{
-			if(curr_->getLeft() == nullptr)
-			{
-				return curr_;
-			}
-			curr_ = curr_->getLeft();
-		}
+template<typename Key, typename Value, typename Compare>
+TreeProfile BinarySearchTree<Key, Value, Compare>::profile() const
+{
+    TreeProfile profile;
+    profile.indexBytes = hashIndexBytes();
+    if(root_ != NULL)
+    {
+        profile.nodeBytes = root_->allocationSize();
+    }
+    walkPreorder(root_, SIZE_MAX, [&](Node<Key, Value>* node, size_t depth)
+    {
+        ++profile.nodes;
+        profile.deadNodes += node->isDead();
+        if(profile.levelCounts.size() <= depth)
+        {
+            profile.levelCounts.resize(depth + 1);
+        }
+        ++profile.levelCounts[depth];
+        profileNode(profile, node);
+
+        const char* at = reinterpret_cast<const char*>(node);
+        bool inArena = false;
+        for(size_t i = 0; i < arenas_.size() && !inArena; ++i)
+        {
+            inArena = at >= arenas_[i].begin && at < arenas_[i].end;
+        }
+        profile.arenaNodes += inArena;
+        profile.allocatedBytes += inArena ? node->allocationSize()
+                                          : heapBlockBytes(node, node->allocationSize());
+
+        Node<Key, Value>* parent = node->getParent();
+        if(parent != NULL)
+        {
+            uintptr_t from = reinterpret_cast<uintptr_t>(parent);
+            uintptr_t to = reinterpret_cast<uintptr_t>(node);
+            ++profile.links;
+            profile.lineCrossings += from / TreeProfile::CACHE_LINE != to / TreeProfile::CACHE_LINE;
+            profile.pageCrossings += from / TreeProfile::PAGE != to / TreeProfile::PAGE;
+        }
+    });
+    finishTreeProfile(profile);
+    return profile;
 }
 
 /**
-* Helper function to find a node with given key, k and
-* return a pointer to it or NULL if no item with that key
-* exists
+* A plain tree keeps no per-node statistics.
 */
-template<typename Key, typename Value>
-Node<Key, Value>* BinarySearchTree<Key, Value>::internalFind(const Key& key) const
+template<typename Key, typename Value, typename Compare>
+void BinarySearchTree<Key, Value, Compare>::profileNode(TreeProfile&, const Node<Key, Value>*) const
+{
+
+}
+
+/**
+* Returns the height of the subtree at head, or -1 if any node in it
+* has subtrees whose heights differ by more than one.
+*/
+template<typename Key, typename Value, typename Compare>
+int BinarySearchTree<Key, Value, Compare>::calculateHeightIfBalanced(Node<Key,Value>* head) const
+{
+    // An empty tree is balanced and has a height of 0
+    if(head == NULL)
+    {
+        return 0;
+    }
+
+    int leftHeight = calculateHeightIfBalanced(head->getLeft());
+    int rightHeight = calculateHeightIfBalanced(head->getRight());
+    if(leftHeight == -1 || rightHeight == -1)
+    {
+        return -1;
+    }
+    if(rightHeight - leftHeight >= 2 || leftHeight - rightHeight >= 2)
+    {
+        return -1;
+    }
+    return std::max(leftHeight, rightHeight) + 1;
+}
+
+/**
+* Deletes every node in the subtree rooted at head.
+*/
+template<typename Key, typename Value, typename Compare>
+void BinarySearchTree<Key, Value, Compare>::exactClear(Node<Key, Value>* head)
+{
+    // Rotating each left child up turns the tree into a right-leaning
+    // list as it goes, so every node is freed with no stack and no
+    // parent pointers, however deep the tree.
+    while(head != NULL)
+    {
+        Node<Key, Value>* left = head->getLeft();
+        if(left != NULL)
+        {
+            head->setLeft(left->getRight());
+            left->setRight(head);
+            head = left;
+            continue;
+        }
+        Node<Key, Value>* next = head->getRight();
+        if(arenas_.empty())
+        {
+            delete head;
+        }
+        else
+        {
+            releaseArenaNode(head);
+        }
+        head = next;
+    }
+    // every node is gone, so whole arenas go at once
+    for(size_t i = 0; i < arenas_.size(); ++i)
+    {
+        ::operator delete(arenas_[i].begin);
+    }
+    arenas_.clear();
+}
+
+/**
+* Destroys a node during exactClear, freeing it unless it lives in an
+* arena, which exactClear frees afterwards.
+*/
+template<typename Key, typename Value, typename Compare>
+void BinarySearchTree<Key, Value, Compare>::releaseArenaNode(Node<Key, Value>* node)
+{
+    char* addr = reinterpret_cast<char*>(node);
+    for(size_t i = 0; i < arenas_.size(); ++i)
+    {
+        if(addr >= arenas_[i].begin && addr < arenas_[i].end)
+        {
+            node->~Node();
+            return;
+        }
+    }
+    delete node;
+}
+
+/**
+* Destroys node and frees its memory, or just destroys it if it lives
+* in an arena, freeing the arena along with its last node.
+*/
+template<typename Key, typename Value, typename Compare>
+void BinarySearchTree<Key, Value, Compare>::releaseNode(Node<Key, Value>* node)
 {
-    // TODO
-    //iterate through and once a match is found, return it 
-		for (typename BinarySearchTree<Key, Value>::iterator it = this->begin(); it != this->end(); ++it) 
+    char* addr = reinterpret_cast<char*>(node);
+    for(size_t i = 0; i < arenas_.size(); ++i)
+    {
+        if(addr >= arenas_[i].begin && addr < arenas_[i].end)
         {
-            if (it->first == key)
+            node->~Node();
+            if(--arenas_[i].live == 0)
             {
-                return it.current_;
+                ::operator delete(arenas_[i].begin);
+                arenas_.erase(arenas_.begin() + i);
             }
-		}
-        //if not return nullptr
-		return nullptr;
+            return;
+        }
+    }
+    delete node;
 }
 
 /**
- * Return true iff the BST is balanced.
- */
-template<typename Key, typename Value>
-bool BinarySearchTree<Key, Value>::isBalanced() const
+* Makes this empty tree a copy of other, settings included, using up to
+* threads threads. If copying a node or allocating throws, every copy
+* made so far is destroyed and freed and this tree is left empty.
+*/
+template<typename Key, typename Value, typename Compare>
+void BinarySearchTree<Key, Value, Compare>::cloneFrom(const BinarySearchTree<Key, Value, Compare>& other, unsigned threads)
 {
-    // TODO
-		Node<Key, Value>* temp = root_;
-		int x = calculateHeightIfBalanced(temp);
-		return x;
+    comp_ = other.comp_;
+    tombstones_ = other.tombstones_;
+    deadRatio_ = other.deadRatio_;
+    alpha_ = other.alpha_;
+    maxSize_ = other.maxSize_;
+    fingerAtMax_ = other.fingerAtMax_;
+    if(other.root_ != NULL)
+    {
+        size_t stride = other.root_->allocationSize();
+        if(other.size_ >= PARALLEL_CLONE_MIN && threads > 1)
+        {
+            cloneParallel(other, stride, threads);
+        }
+        else
+        {
+            arenas_.reserve(1);
+            char* mem = static_cast<char*>(::operator new(other.size_ * stride));
+            try
+            {
+                root_ = cloneInto(other.root_, NULL, mem, stride, other.finger_, finger_);
+            }
+            catch(...)
+            {
+                finger_ = NULL;
+                ::operator delete(mem);
+                throw;
+            }
+            NodeArena arena = { mem, mem + other.size_ * stride, other.size_ };
+            arenas_.push_back(arena);
+        }
+    }
+    size_ = other.size_;
+    dead_ = other.dead_;
+    if(finger_ == NULL)
+    {
+        fingerAtMax_ = false;
+    }
+
+    if(other.index_ != NULL)
+    {
+        try
+        {
+            index_ = other.index_->cloneEmpty();
+            for(Node<Key, Value>* n = getSmallestNode(); n != NULL; n = successor(n))
+            {
+                index_->insert(n);
+            }
+        }
+        catch(...)
+        {
+            delete index_;
+            index_ = NULL;
+            clear();
+            throw;
+        }
+    }
 }
 
-//Helper Functions 
+/**
+* Copies the top PARALLEL_CLONE_DEPTH levels into a small arena, then
+* has threads workers copy the subtrees hanging below them, each into
+* its own arena, and links the results in. A worker that throws stops
+* and hands its exception back; once all have finished, every copy is
+* destroyed and the first exception is rethrown here.
+*/
+template<typename Key, typename Value, typename Compare>
+void BinarySearchTree<Key, Value, Compare>::cloneParallel(const BinarySearchTree<Key, Value, Compare>& other, size_t stride,
+                                                 unsigned threads)
+{
+    size_t topCapacity = ((size_t)1 << PARALLEL_CLONE_DEPTH) - 1;
+    // one arena for the top levels and one per task, reserved now so
+    // that recording them cannot throw
+    arenas_.reserve(topCapacity + 2);
+    std::vector<CloneTask> tasks;
+    tasks.reserve(topCapacity + 1);
+    char* top = static_cast<char*>(::operator new(topCapacity * stride));
+    size_t used = 0;
+    try
+    {
+        root_ = cloneTop(other.root_, NULL, 0, top, used, stride, other.finger_, tasks);
+    }
+    catch(...)
+    {
+        finger_ = NULL;
+        ::operator delete(top);
+        throw;
+    }
 
-template<typename Key, typename Value>
-int BinarySearchTree<Key, Value>:: calculateHeightIfBalanced(Node<Key,Value>* head) const {
-	// Base case: an empty tree is always balanced and has a height of 0
-	if (head == nullptr) return 0;
+    // A worker that cannot be started has its share of the tasks run
+    // on this thread instead.
+    size_t workers = std::min<size_t>(threads, tasks.size());
+    std::vector<std::thread> pool;
+    size_t started = 1;
+    try
+    {
+        for(; started < workers; ++started)
+        {
+            pool.push_back(std::thread(runCloneTasks, &tasks, started, workers, stride, other.finger_));
+        }
+    }
+    catch(...)
+    {
+        // the loop below runs the shares of the workers not started
+    }
+    for(size_t w = started; w < workers; ++w)
+    {
+        runCloneTasks(&tasks, w, workers, stride, other.finger_);
+    }
+    runCloneTasks(&tasks, 0, workers, stride, other.finger_);
+    for(size_t w = 0; w < pool.size(); ++w)
+    {
+        pool[w].join();
+    }
+
+    std::exception_ptr error;
+    for(size_t i = 0; i < tasks.size() && !error; ++i)
+    {
+        error = tasks[i].error;
+    }
+    if(error)
+    {
+        for(size_t i = 0; i < tasks.size(); ++i)
+        {
+            if(tasks[i].copy != NULL)
+            {
+                destroyClone(tasks[i].copy);
+                ::operator delete(tasks[i].arena.begin);
+            }
+        }
+        destroyClone(root_);
+        ::operator delete(top);
+        root_ = NULL;
+        finger_ = NULL;
+        std::rethrow_exception(error);
+    }
 
-	// Think about cases to handle:
-	// - What if at least one subtree is NOT balanced?
-	// - What if BOTH are balanced?
+    NodeArena topArena = { top, top + used * stride, used };
+    arenas_.push_back(topArena);
+    for(size_t i = 0; i < tasks.size(); ++i)
+    {
+        if(tasks[i].left)
+        {
+            tasks[i].parent->setLeft(tasks[i].copy);
+        }
+        else
+        {
+            tasks[i].parent->setRight(tasks[i].copy);
+        }
+        if(tasks[i].finger != NULL)
+        {
+            finger_ = tasks[i].finger;
+        }
+        arenas_.push_back(tasks[i].arena);
+    }
+}
 
-	//find the height of the subtrees
-	int rightHeight = calculateHeightIfBalanced(head->getRight());
-	int leftHeight = calculateHeightIfBalanced(head->getLeft());
+/**
+* Copies src and the levels below it down to PARALLEL_CLONE_DEPTH into
+* mem, queueing the subtrees further down as tasks. On a throw the
+* copies made here are destroyed, leaving mem to the caller.
+*/
+template<typename Key, typename Value, typename Compare>
+Node<Key, Value>*
+BinarySearchTree<Key, Value, Compare>::cloneTop(const Node<Key, Value>* src, Node<Key, Value>* parent, int depth,
+                                       char* mem, size_t& used, size_t stride,
+                                       const Node<Key, Value>* finger, std::vector<CloneTask>& tasks)
+{
+    Node<Key, Value>* copy = src->cloneAt(mem + used * stride, parent);
+    ++used;
+    if(src == finger)
+    {
+        finger_ = copy;
+    }
+    try
+    {
+        for(int side = 0; side < 2; ++side)
+        {
+            const Node<Key, Value>* child = (side == 0) ? src->getLeft() : src->getRight();
+            if(child == NULL)
+            {
+                continue;
+            }
+            if(depth + 1 < PARALLEL_CLONE_DEPTH)
+            {
+                Node<Key, Value>* childCopy = cloneTop(child, copy, depth + 1, mem, used, stride, finger, tasks);
+                if(side == 0)
+                {
+                    copy->setLeft(childCopy);
+                }
+                else
+                {
+                    copy->setRight(childCopy);
+                }
+            }
+            else
+            {
+                CloneTask task = { child, copy, side == 0, NULL, NULL, { NULL, NULL, 0 }, std::exception_ptr() };
+                tasks.push_back(task);
+            }
+        }
+    }
+    catch(...)
+    {
+        // the children copied so far are linked below copy
+        destroyClone(copy);
+        throw;
+    }
+    return copy;
+}
 
-	//is the rest of the tree ballanced 
-	if(rightHeight == -1 || leftHeight == -1){
-		return -1;
-	}
+/**
+* Worker body: copies tasks first, first + step, ... each into an arena
+* sized by counting its subtree. Nothing escapes a worker thread: a task
+* that throws frees its arena, keeps the exception and ends the loop.
+*/
+template<typename Key, typename Value, typename Compare>
+void BinarySearchTree<Key, Value, Compare>::runCloneTasks(std::vector<CloneTask>* tasks, size_t first, size_t step,
+                                                 size_t stride, const Node<Key, Value>* finger)
+{
+    for(size_t i = first; i < tasks->size(); i += step)
+    {
+        CloneTask& task = (*tasks)[i];
+        char* mem = NULL;
+        try
+        {
+            size_t count = countNodes(task.src);
+            mem = static_cast<char*>(::operator new(count * stride));
+            task.copy = cloneInto(task.src, task.parent, mem, stride, finger, task.finger);
+            NodeArena arena = { mem, mem + count * stride, count };
+            task.arena = arena;
+        }
+        catch(...)
+        {
+            ::operator delete(mem);
+            task.finger = NULL;
+            task.error = std::current_exception();
+            return;
+        }
+    }
+}
 
-	//is our node ballanced 
-	if(rightHeight - leftHeight >= 2 || leftHeight - rightHeight >= 2)
-	{
-		return -1;
-	}
+/**
+* Copies the subtree at src into consecutive stride-sized slots of mem
+* in pre-order and returns the copy of src, whose parent is parent but
+* which is not yet linked from it. Iterative, so degenerate trees cannot
+* overflow the stack. fingerCopy receives the copy of finger if it is
+* in the subtree. On a throw the copies made so far are destroyed,
+* leaving mem to the caller.
+*/
+template<typename Key, typename Value, typename Compare>
+Node<Key, Value>*
+BinarySearchTree<Key, Value, Compare>::cloneInto(const Node<Key, Value>* src, Node<Key, Value>* parent, char* mem,
+                                        size_t stride, const Node<Key, Value>* finger,
+                                        Node<Key, Value>*& fingerCopy)
+{
+    // each entry is a source node, the copy of its parent and which
+    // side of that copy it hangs from (0 for the subtree root)
+    struct Pending
+    {
+        const Node<Key, Value>* src;
+        Node<Key, Value>* parent;
+        int side;
+    };
+    std::vector<Pending> stack;
+    Pending start = { src, parent, 0 };
+    stack.push_back(start);
+    Node<Key, Value>* top = NULL;
+    try
+    {
+        while(!stack.empty())
+        {
+            Pending next = stack.back();
+            stack.pop_back();
+            Node<Key, Value>* copy = next.src->cloneAt(mem, next.parent);
+            mem += stride;
+            if(next.side < 0)
+            {
+                next.parent->setLeft(copy);
+            }
+            else if(next.side > 0)
+            {
+                next.parent->setRight(copy);
+            }
+            else
+            {
+                top = copy;
+            }
+            if(next.src == finger)
+            {
+                fingerCopy = copy;
+            }
+            if(next.src->getRight() != NULL)
+            {
+                Pending right = { next.src->getRight(), copy, 1 };
+                stack.push_back(right);
+            }
+            if(next.src->getLeft() != NULL)
+            {
+                Pending left = { next.src->getLeft(), copy, -1 };
+                stack.push_back(left);
+            }
+        }
+    }
+    catch(...)
+    {
+        // every copy is linked below top as soon as it is made
+        destroyClone(top);
+        throw;
+    }
+    return top;
+}
 
-	//find the height of current node
-	if(rightHeight > leftHeight)
-	{
-		return rightHeight + 1;
-	}
+/**
+* Destroys the copies in the subtree at head without freeing them, for
+* unwinding a clone whose arenas are freed by the caller. Rotates left
+* children up as exactClear does.
+*/
+template<typename Key, typename Value, typename Compare>
+void BinarySearchTree<Key, Value, Compare>::destroyClone(Node<Key, Value>* head)
+{
+    while(head != NULL)
+    {
+        Node<Key, Value>* left = head->getLeft();
+        if(left != NULL)
+        {
+            head->setLeft(left->getRight());
+            left->setRight(head);
+            head = left;
+            continue;
+        }
+        Node<Key, Value>* next = head->getRight();
+        head->~Node();
+        head = next;
+    }
+}
 
-	else{
-		return leftHeight+1;
-	}
+/**
+* Counts the nodes in the subtree at node without recursion.
+*/
+template<typename Key, typename Value, typename Compare>
+size_t BinarySearchTree<Key, Value, Compare>::countNodes(const Node<Key, Value>* node)
+{
+    std::vector<const Node<Key, Value>*> stack;
+    size_t count = 0;
+    if(node != NULL)
+    {
+        stack.push_back(node);
+    }
+    while(!stack.empty())
+    {
+        const Node<Key, Value>* n = stack.back();
+        stack.pop_back();
+        ++count;
+        if(n->getLeft() != NULL)
+        {
+            stack.push_back(n->getLeft());
+        }
+        if(n->getRight() != NULL)
+        {
+            stack.push_back(n->getRight());
+        }
+    }
+    return count;
 }
 
-template<typename Key, typename Value>
-void BinarySearchTree<Key, Value>:: exactClear(Node<Key, Value>* head)
-{
-    //return nullptr once a leaf node is hit 
-	if(head == nullptr)
-	{
-		return;
-	}
-    //check the left side and then the right side and then sets
-    //the head to nullptr once finished 
-	exactClear(head->getLeft());
-	exactClear(head->getRight());
-	head = nullptr;
-	delete head;
+/**
+* Moves other's nodes, index and settings into this empty tree.
+*/
+template<typename Key, typename Value, typename Compare>
+void BinarySearchTree<Key, Value, Compare>::takeFrom(BinarySearchTree<Key, Value, Compare>& other)
+{
+    comp_ = other.comp_;
+    root_ = other.root_;
+    index_ = other.index_;
+    finger_ = other.finger_;
+    fingerAtMax_ = other.fingerAtMax_;
+    size_ = other.size_;
+    dead_ = other.dead_;
+    tombstones_ = other.tombstones_;
+    deadRatio_ = other.deadRatio_;
+    alpha_ = other.alpha_;
+    maxSize_ = other.maxSize_;
+    arenas_.swap(other.arenas_);
+
+    other.root_ = NULL;
+    other.index_ = NULL;
+    other.finger_ = NULL;
+    other.fingerAtMax_ = false;
+    other.size_ = 0;
+    other.dead_ = 0;
+    other.maxSize_ = 0;
 }
-template<typename Key, typename Value>
-void BinarySearchTree<Key, Value>::nodeSwap( Node<Key,Value>* n1, Node<Key,Value>* n2)
+
+template<typename Key, typename Value, typename Compare>
+void BinarySearchTree<Key, Value, Compare>::nodeSwap( Node<Key,Value>* n1, Node<Key,Value>* n2)
 {
     if((n1 == n2) || (n1 == NULL) || (n2 == NULL) ) {
         return;
@@ -805,6 +2751,79 @@ void BinarySearchTree<Key, Value>::nodeSwap( Node<Key,Value>* n1, Node<Key,Value
     }
 
 }
+/**
+* Rotates node's right child up into node's position.
+*/
+template<typename Key, typename Value, typename Compare>
+void BinarySearchTree<Key, Value, Compare>::rotateLeft(Node<Key, Value>* node)
+{
+    Node<Key, Value>* pivot = node->getRight();
+    Node<Key, Value>* parent = node->getParent();
+
+    node->setRight(pivot->getLeft());
+    if(pivot->getLeft() != NULL)
+    {
+        pivot->getLeft()->setParent(node);
+    }
+    pivot->setLeft(node);
+    node->setParent(pivot);
+    pivot->setParent(parent);
+    if(parent == NULL)
+    {
+        root_ = pivot;
+    }
+    else if(parent->getLeft() == node)
+    {
+        parent->setLeft(pivot);
+    }
+    else
+    {
+        parent->setRight(pivot);
+    }
+    rotated(node);
+}
+
+/**
+* Rotates node's left child up into node's position.
+*/
+template<typename Key, typename Value, typename Compare>
+void BinarySearchTree<Key, Value, Compare>::rotateRight(Node<Key, Value>* node)
+{
+    Node<Key, Value>* pivot = node->getLeft();
+    Node<Key, Value>* parent = node->getParent();
+
+    node->setLeft(pivot->getRight());
+    if(pivot->getRight() != NULL)
+    {
+        pivot->getRight()->setParent(node);
+    }
+    pivot->setRight(node);
+    node->setParent(pivot);
+    pivot->setParent(parent);
+    if(parent == NULL)
+    {
+        root_ = pivot;
+    }
+    else if(parent->getLeft() == node)
+    {
+        parent->setLeft(pivot);
+    }
+    else
+    {
+        parent->setRight(pivot);
+    }
+    rotated(node);
+}
+
+/**
+* Rotations keep no per-subtree data in a plain tree.
+*/
+template<typename Key, typename Value, typename Compare>
+void BinarySearchTree<Key, Value, Compare>::rotated(Node<Key, Value>*)
+{
+
+}
+
 /**
  * Lastly, we are providing you with a print function,
    BinarySearchTree::printRoot().
@@ -818,6 +2837,7 @@ void BinarySearchTree<Key, Value>::nodeSwap( Node<Key,Value>* n1, Node<Key,Value
 
 // include print function (in its own file because it's fairly long)
 #include "print_bst.h"
+#include "export_bst.h"
 
 /*
 ---------------------------------------------------
@@ -0,0 +1,683 @@
+#ifndef DURABLETREE_H
+#define DURABLETREE_H
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "avlbst.h"
+#include "trace.h"
+
+/*
+ * Durable trees: a write-ahead log plus checkpoints.
+ *
+ * A DurableTree at path keeps two files. path.snap is the latest
+ * checkpoint:
+ *
+ *     "BSTSNP01"  varint generation  varint count  records  crc32
+ *
+ * with one insert record per item in key order, and a little-endian
+ * CRC-32 of everything before it. path.wal is the log written since:
+ *
+ *     "BSTWAL01"  varint generation  blocks...
+ *
+ * where each block is one group commit:
+ *
+ *     varint length  crc32 of the records  length bytes of records
+ *
+ * Records are insert and remove records in the trace encoding (see
+ * trace.h), with the key delta base reset at every block. A log whose
+ * generation is older than the checkpoint's was already folded into
+ * it. Recovery stops at the first short or corrupt block, which can
+ * only be the tail a crash cut off, and truncates the log there. The
+ * header is written whole, so a log whose header does not parse is
+ * refused rather than truncated.
+ */
+
+static const char WAL_MAGIC[8] = { 'B', 'S', 'T', 'W', 'A', 'L', '0', '1' };
+static const char SNAPSHOT_MAGIC[8] = { 'B', 'S', 'T', 'S', 'N', 'P', '0', '1' };
+
+/**
+* CRC-32 (IEEE) of [data, data + size), continuing from crc.
+*/
+inline uint32_t walCrc32(const char* data, size_t size, uint32_t crc = 0)
+{
+    static uint32_t table[256];
+    static std::once_flag built;
+    std::call_once(built, []()
+    {
+        for(uint32_t i = 0; i < 256; ++i)
+        {
+            uint32_t c = i;
+            for(int bit = 0; bit < 8; ++bit)
+            {
+                c = (c & 1) ? 0xedb88320u ^ (c >> 1) : c >> 1;
+            }
+            table[i] = c;
+        }
+    });
+    crc = ~crc;
+    for(size_t i = 0; i < size; ++i)
+    {
+        crc = table[(crc ^ (uint8_t)data[i]) & 0xff] ^ (crc >> 8);
+    }
+    return ~crc;
+}
+
+inline void walPutCrc(std::string& out, uint32_t crc)
+{
+    for(int i = 0; i < 4; ++i)
+    {
+        out.push_back((char)(crc >> (8 * i)));
+    }
+}
+
+inline uint32_t walGetCrc(const char* p)
+{
+    uint32_t crc = 0;
+    for(int i = 0; i < 4; ++i)
+    {
+        crc |= (uint32_t)(uint8_t)p[i] << (8 * i);
+    }
+    return crc;
+}
+
+/**
+* Throws std::runtime_error describing the failed call and errno.
+*/
+inline void walFail(const std::string& what)
+{
+    throw std::runtime_error("wal: " + what + ": " + std::strerror(errno));
+}
+
+inline void walWriteAll(int fd, const char* data, size_t size, const std::string& path)
+{
+    while(size > 0)
+    {
+        ssize_t n = ::write(fd, data, size);
+        if(n < 0)
+        {
+            if(errno == EINTR)
+            {
+                continue;
+            }
+            walFail("write " + path);
+        }
+        data += n;
+        size -= (size_t)n;
+    }
+}
+
+/**
+* Reads the whole file at path into out; returns false if it does not
+* exist.
+*/
+inline bool walReadFile(const std::string& path, std::string& out)
+{
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if(fd < 0)
+    {
+        if(errno == ENOENT)
+        {
+            return false;
+        }
+        walFail("open " + path);
+    }
+    out.clear();
+    char buf[1 << 16];
+    while(true)
+    {
+        ssize_t n = ::read(fd, buf, sizeof(buf));
+        if(n < 0)
+        {
+            if(errno == EINTR)
+            {
+                continue;
+            }
+            ::close(fd);
+            walFail("read " + path);
+        }
+        if(n == 0)
+        {
+            break;
+        }
+        out.append(buf, (size_t)n);
+    }
+    ::close(fd);
+    return true;
+}
+
+/**
+* Writes data to path through a temporary file, syncing it and the
+* directory, so that path holds either its old contents or data.
+*/
+inline void walReplaceFile(const std::string& path, const std::string& data, bool sync)
+{
+    std::string tmp = path + ".tmp";
+    int fd = ::open(tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if(fd < 0)
+    {
+        walFail("create " + tmp);
+    }
+    walWriteAll(fd, data.data(), data.size(), tmp);
+    if(sync && ::fsync(fd) != 0)
+    {
+        ::close(fd);
+        walFail("fsync " + tmp);
+    }
+    ::close(fd);
+    if(::rename(tmp.c_str(), path.c_str()) != 0)
+    {
+        walFail("rename " + tmp);
+    }
+    if(sync)
+    {
+        std::string dir = ".";
+        size_t slash = path.rfind('/');
+        if(slash != std::string::npos)
+        {
+            dir = slash == 0 ? "/" : path.substr(0, slash);
+        }
+        int dirFd = ::open(dir.c_str(), O_RDONLY);
+        if(dirFd >= 0)
+        {
+            ::fsync(dirFd);
+            ::close(dirFd);
+        }
+    }
+}
+
+/**
+* How a DurableTree commits.
+*
+* commitInterval is how long the writer that leads a group commit
+* waits for others to join before it writes and syncs; 0 commits at
+* once, which still groups writers that arrive during a sync. A batch
+* is also written as soon as it holds maxBatchBytes. Once the log holds
+* checkpointBytes a checkpoint is taken (0 never checkpoints on its
+* own). With sync off, commits reach the operating system but are not
+* fsynced, which survives a process crash but not a machine crash.
+*/
+struct WalOptions
+{
+    WalOptions()
+        : commitInterval(0), maxBatchBytes(1 << 20), checkpointBytes(64 << 20), sync(true)
+    {
+    }
+
+    std::chrono::microseconds commitInterval;
+    size_t maxBatchBytes;
+    size_t checkpointBytes;
+    bool sync;
+};
+
+/**
+* A map that survives crashes: an in-memory Tree (an AVLTree by
+* default) whose every insert and remove is appended to a write-ahead
+* log before the call returns. Opening the same path again loads the
+* last checkpoint and replays the log written since.
+*
+* Any number of threads may call the methods at once. Updates are
+* applied and logged under one lock and then wait, without it, for
+* their group commit: the first waiting writer syncs the log for every
+* record appended so far while the others sleep, so one fsync covers a
+* whole batch of concurrent writers.
+*
+* Keys and values are stored as 64-bit integers, as in traces, so both
+* must be integral types. Failed file operations throw
+* std::runtime_error; a writer whose commit failed sees the exception,
+* and the tree should then be reopened.
+*/
+template <typename Key, typename Value, class Tree = AVLTree<Key, Value> >
+class DurableTree
+{
+    static_assert(std::is_integral<Key>::value && std::is_integral<Value>::value,
+                  "DurableTree logs keys and values as 64-bit integers");
+
+public:
+    explicit DurableTree(const std::string& path, const WalOptions& options = WalOptions());
+    ~DurableTree();
+
+    void insert(const std::pair<const Key, Value>& keyValuePair);
+    void remove(const Key& key);
+    // Copies key's value into value and returns true if key is present.
+    bool lookup(const Key& key, Value& value) const;
+    size_t size() const;
+
+    // Writes the whole tree to a new checkpoint and starts a new log.
+    void checkpoint();
+    // Returns once everything applied so far is durable.
+    void sync();
+
+    // The tree itself, for reads while no thread is updating it.
+    const Tree& tree() const;
+
+    // Recovery and commit statistics.
+    size_t recoveredRecords() const;
+    size_t discardedTailBytes() const;
+    size_t commits() const;
+    size_t checkpoints() const;
+
+private:
+    DurableTree(const DurableTree&);
+    DurableTree& operator=(const DurableTree&);
+
+    void recover();
+    void startLog();
+    void append(TraceOp op, int64_t key, int64_t value);
+    void commit(std::unique_lock<std::mutex>& lock, uint64_t upTo);
+    void checkpointLocked(std::unique_lock<std::mutex>& lock);
+
+    std::string path_;
+    WalOptions options_;
+    Tree tree_;
+    mutable std::mutex mutex_;
+    std::condition_variable committed_;
+    std::condition_variable batchFull_;
+    int fd_;
+    uint64_t generation_;
+    // The batch being filled and the delta base of its keys.
+    std::string batch_;
+    int64_t batchPrevKey_;
+    // Bytes of records appended and made durable since opening.
+    uint64_t appended_;
+    uint64_t durable_;
+    bool committing_;
+    // Set once a commit fails; its records are lost, so no later commit
+    // may claim to be durable.
+    bool failed_;
+    size_t logBytes_;
+    size_t recovered_;
+    size_t discarded_;
+    size_t commits_;
+    size_t checkpoints_;
+};
+
+/**
+* Opens or creates the tree at path and recovers its contents. If
+* recovery throws, the log is closed again before the exception leaves,
+* since the destructor will not run.
+*/
+template <typename Key, typename Value, class Tree>
+DurableTree<Key, Value, Tree>::DurableTree(const std::string& path, const WalOptions& options)
+    : path_(path), options_(options), fd_(-1), generation_(0), batchPrevKey_(0), appended_(0), durable_(0),
+      committing_(false), failed_(false), logBytes_(0), recovered_(0), discarded_(0), commits_(0), checkpoints_(0)
+{
+    try
+    {
+        recover();
+    }
+    catch(...)
+    {
+        if(fd_ >= 0)
+        {
+            ::close(fd_);
+            fd_ = -1;
+        }
+        throw;
+    }
+}
+
+/**
+* Commits whatever is still pending. Errors are dropped here; call
+* sync() first to see them.
+*/
+template <typename Key, typename Value, class Tree>
+DurableTree<Key, Value, Tree>::~DurableTree()
+{
+    try
+    {
+        sync();
+    }
+    catch(const std::runtime_error&)
+    {
+    }
+    if(fd_ >= 0)
+    {
+        ::close(fd_);
+    }
+}
+
+/**
+* Loads the checkpoint, replays the log if it belongs to it, cuts off a
+* torn tail and leaves the log open for appending.
+*/
+template <typename Key, typename Value, class Tree>
+void DurableTree<Key, Value, Tree>::recover()
+{
+    std::string data;
+    if(walReadFile(path_ + ".snap", data))
+    {
+        const size_t magic = sizeof(SNAPSHOT_MAGIC);
+        if(data.size() < magic + 4 || std::memcmp(data.data(), SNAPSHOT_MAGIC, magic) != 0 ||
+           walCrc32(data.data(), data.size() - 4) != walGetCrc(data.data() + data.size() - 4))
+        {
+            throw std::runtime_error("wal: corrupt checkpoint " + path_ + ".snap");
+        }
+        const char* p = data.data() + magic;
+        const char* end = data.data() + data.size() - 4;
+        generation_ = traceGetVarint(p, end);
+        uint64_t count = traceGetVarint(p, end);
+        std::vector<TraceRecord> records;
+        records.reserve(count);
+        int64_t prevKey = 0;
+        traceDecode(p, end, prevKey, records);
+        for(size_t i = 0; i < records.size(); ++i)
+        {
+            tree_.insert(std::make_pair((Key)records[i].key, (Value)records[i].arg));
+        }
+    }
+
+    if(!walReadFile(path_ + ".wal", data))
+    {
+        startLog();
+        return;
+    }
+    const size_t magic = sizeof(WAL_MAGIC);
+    const char* p = data.data() + magic;
+    const char* end = data.data() + data.size();
+    uint64_t logGeneration = 0;
+    bool valid = data.size() > magic && std::memcmp(data.data(), WAL_MAGIC, magic) == 0;
+    if(valid)
+    {
+        try
+        {
+            logGeneration = traceGetVarint(p, end);
+        }
+        catch(const std::runtime_error&)
+        {
+            valid = false;
+        }
+    }
+    if(!valid)
+    {
+        // the header is written whole by walReplaceFile, so this is not
+        // a torn write but corruption or some other file; keep its data
+        throw std::runtime_error("wal: " + path_ + ".wal has no valid header");
+    }
+    if(logGeneration < generation_)
+    {
+        // the checkpoint already holds this log
+        startLog();
+        return;
+    }
+    if(logGeneration > generation_)
+    {
+        throw std::runtime_error("wal: " + path_ + ".wal is newer than its checkpoint");
+    }
+    std::vector<TraceRecord> records;
+    const char* good = p;
+    while(p != end)
+    {
+        try
+        {
+            uint64_t length = traceGetVarint(p, end);
+            if((uint64_t)(end - p) < 4 || length > (uint64_t)(end - p) - 4 ||
+               walCrc32(p + 4, length) != walGetCrc(p))
+            {
+                break;
+            }
+            records.clear();
+            int64_t prevKey = 0;
+            traceDecode(p + 4, p + 4 + length, prevKey, records);
+            p += 4 + length;
+        }
+        catch(const std::runtime_error&)
+        {
+            break;
+        }
+        for(size_t i = 0; i < records.size(); ++i)
+        {
+            if(records[i].op == TRACE_INSERT)
+            {
+                tree_.insert(std::make_pair((Key)records[i].key, (Value)records[i].arg));
+            }
+            else
+            {
+                tree_.remove((Key)records[i].key);
+            }
+        }
+        recovered_ += records.size();
+        good = p;
+    }
+
+    size_t keep = good - data.data();
+    discarded_ = data.size() - keep;
+    fd_ = ::open((path_ + ".wal").c_str(), O_WRONLY | O_APPEND);
+    if(fd_ < 0)
+    {
+        walFail("open " + path_ + ".wal");
+    }
+    if(discarded_ > 0 && ::ftruncate(fd_, (off_t)keep) != 0)
+    {
+        walFail("truncate " + path_ + ".wal");
+    }
+    logBytes_ = keep;
+}
+
+/**
+* Replaces the log with an empty one of the current generation.
+*/
+template <typename Key, typename Value, class Tree>
+void DurableTree<Key, Value, Tree>::startLog()
+{
+    std::string header(WAL_MAGIC, sizeof(WAL_MAGIC));
+    tracePutVarint(header, generation_);
+    walReplaceFile(path_ + ".wal", header, options_.sync);
+    if(fd_ >= 0)
+    {
+        ::close(fd_);
+    }
+    fd_ = ::open((path_ + ".wal").c_str(), O_WRONLY | O_APPEND);
+    if(fd_ < 0)
+    {
+        walFail("open " + path_ + ".wal");
+    }
+    logBytes_ = header.size();
+}
+
+template <typename Key, typename Value, class Tree>
+void DurableTree<Key, Value, Tree>::insert(const std::pair<const Key, Value>& keyValuePair)
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    tree_.insert(keyValuePair);
+    append(TRACE_INSERT, (int64_t)keyValuePair.first, (int64_t)keyValuePair.second);
+    commit(lock, appended_);
+}
+
+template <typename Key, typename Value, class Tree>
+void DurableTree<Key, Value, Tree>::remove(const Key& key)
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    tree_.remove(key);
+    append(TRACE_REMOVE, (int64_t)key, 0);
+    commit(lock, appended_);
+}
+
+template <typename Key, typename Value, class Tree>
+bool DurableTree<Key, Value, Tree>::lookup(const Key& key, Value& value) const
+{
+    std::lock_guard<std::mutex> guard(mutex_);
+    typename Tree::iterator it = tree_.find(key);
+    if(it == tree_.end())
+    {
+        return false;
+    }
+    value = it->second;
+    return true;
+}
+
+template <typename Key, typename Value, class Tree>
+size_t DurableTree<Key, Value, Tree>::size() const
+{
+    std::lock_guard<std::mutex> guard(mutex_);
+    return tree_.size();
+}
+
+template <typename Key, typename Value, class Tree>
+void DurableTree<Key, Value, Tree>::append(TraceOp op, int64_t key, int64_t value)
+{
+    size_t before = batch_.size();
+    TraceRecord rec = { op, key, value };
+    traceEncode(batch_, batchPrevKey_, rec);
+    appended_ += batch_.size() - before;
+    if(batch_.size() >= options_.maxBatchBytes)
+    {
+        batchFull_.notify_one();
+    }
+}
+
+/**
+* Waits, with lock held on entry and exit, until the first upTo bytes
+* appended are durable. If no commit is in progress this writer leads
+* one: it lets the batch fill for up to commitInterval, takes it, and
+* writes and syncs it with the lock released.
+*/
+template <typename Key, typename Value, class Tree>
+void DurableTree<Key, Value, Tree>::commit(std::unique_lock<std::mutex>& lock, uint64_t upTo)
+{
+    while(durable_ < upTo)
+    {
+        if(failed_)
+        {
+            throw std::runtime_error("wal: an earlier commit to " + path_ + ".wal failed");
+        }
+        if(committing_)
+        {
+            committed_.wait(lock);
+            continue;
+        }
+        committing_ = true;
+        if(options_.commitInterval.count() > 0)
+        {
+            batchFull_.wait_for(lock, options_.commitInterval, [this]()
+            {
+                return batch_.size() >= options_.maxBatchBytes;
+            });
+        }
+        std::string block;
+        tracePutVarint(block, batch_.size());
+        walPutCrc(block, walCrc32(batch_.data(), batch_.size()));
+        block += batch_;
+        batch_.clear();
+        batchPrevKey_ = 0;
+        uint64_t written = appended_;
+        lock.unlock();
+        try
+        {
+            walWriteAll(fd_, block.data(), block.size(), path_ + ".wal");
+            if(options_.sync && ::fdatasync(fd_) != 0)
+            {
+                walFail("fdatasync " + path_ + ".wal");
+            }
+        }
+        catch(...)
+        {
+            lock.lock();
+            failed_ = true;
+            committing_ = false;
+            committed_.notify_all();
+            throw;
+        }
+        lock.lock();
+        durable_ = written;
+        logBytes_ += block.size();
+        ++commits_;
+        committing_ = false;
+        committed_.notify_all();
+        if(options_.checkpointBytes > 0 && logBytes_ >= options_.checkpointBytes)
+        {
+            checkpointLocked(lock);
+        }
+    }
+}
+
+template <typename Key, typename Value, class Tree>
+void DurableTree<Key, Value, Tree>::sync()
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    commit(lock, appended_);
+}
+
+template <typename Key, typename Value, class Tree>
+void DurableTree<Key, Value, Tree>::checkpoint()
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    checkpointLocked(lock);
+}
+
+/**
+* Writes the tree, which already holds every appended record, to the
+* next generation's checkpoint and starts its log; pending records are
+* then durable without being logged. Writers wait meanwhile.
+*/
+template <typename Key, typename Value, class Tree>
+void DurableTree<Key, Value, Tree>::checkpointLocked(std::unique_lock<std::mutex>& lock)
+{
+    while(committing_)
+    {
+        committed_.wait(lock);
+    }
+    std::string data(SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC));
+    tracePutVarint(data, generation_ + 1);
+    tracePutVarint(data, tree_.size());
+    int64_t prevKey = 0;
+    for(typename Tree::iterator it = tree_.begin(); it != tree_.end(); ++it)
+    {
+        TraceRecord rec = { TRACE_INSERT, (int64_t)it->first, (int64_t)it->second };
+        traceEncode(data, prevKey, rec);
+    }
+    walPutCrc(data, walCrc32(data.data(), data.size()));
+    walReplaceFile(path_ + ".snap", data, options_.sync);
+    // a crash from here on finds the new checkpoint and skips the old log
+    ++generation_;
+    startLog();
+    batch_.clear();
+    batchPrevKey_ = 0;
+    durable_ = appended_;
+    ++checkpoints_;
+    committed_.notify_all();
+}
+
+template <typename Key, typename Value, class Tree>
+const Tree& DurableTree<Key, Value, Tree>::tree() const
+{
+    return tree_;
+}
+
+template <typename Key, typename Value, class Tree>
+size_t DurableTree<Key, Value, Tree>::recoveredRecords() const
+{
+    return recovered_;
+}
+
+template <typename Key, typename Value, class Tree>
+size_t DurableTree<Key, Value, Tree>::discardedTailBytes() const
+{
+    return discarded_;
+}
+
+template <typename Key, typename Value, class Tree>
+size_t DurableTree<Key, Value, Tree>::commits() const
+{
+    std::lock_guard<std::mutex> guard(mutex_);
+    return commits_;
+}
+
+template <typename Key, typename Value, class Tree>
+size_t DurableTree<Key, Value, Tree>::checkpoints() const
+{
+    std::lock_guard<std::mutex> guard(mutex_);
+    return checkpoints_;
+}
+
+#endif
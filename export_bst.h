@@ -0,0 +1,237 @@
+#ifndef EXPORT_BST_H
+#define EXPORT_BST_H
+
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <cstdint>
+
+// Streaming exporters for BinarySearchTree. Unlike printRoot they write
+// to any ostream, work on trees of any size and depth, and keep no
+// per-node state: the walks follow parent pointers instead of a stack,
+// so only the ASCII view's O(levels) prefix is held in memory.
+
+/**
+* Visits the subtree at top in preorder, calling visit(node, depth)
+* with depth 0 for top, and skipping nodes maxDepth or more levels
+* below it. Climbs back up through parent pointers, so it needs no
+* stack however deep the tree is.
+*/
+template<typename Key, typename Value, typename Compare>
+template<typename Visit>
+void BinarySearchTree<Key, Value, Compare>::walkPreorder(Node<Key, Value>* top, size_t maxDepth, Visit visit) const
+{
+    if(top == NULL || maxDepth == 0)
+    {
+        return;
+    }
+    Node<Key, Value>* node = top;
+    size_t depth = 0;
+    while(true)
+    {
+        visit(node, depth);
+        if(depth + 1 < maxDepth && node->getLeft() != NULL)
+        {
+            node = node->getLeft();
+            ++depth;
+            continue;
+        }
+        if(depth + 1 < maxDepth && node->getRight() != NULL)
+        {
+            node = node->getRight();
+            ++depth;
+            continue;
+        }
+        // climb to the nearest ancestor with a right subtree still to visit
+        while(true)
+        {
+            if(node == top)
+            {
+                return;
+            }
+            Node<Key, Value>* parent = node->getParent();
+            --depth;
+            if(node == parent->getLeft() && parent->getRight() != NULL)
+            {
+                node = parent->getRight();
+                ++depth;
+                break;
+            }
+            node = parent;
+        }
+    }
+}
+
+/**
+* Writes the tree as a Graphviz digraph, down to maxDepth levels.
+* Nodes are named by address, and an invisible point stands in for a
+* missing child beside a present one so left and right stay apart
+* when drawn. Render with e.g. dot -Tsvg.
+*/
+template<typename Key, typename Value, typename Compare>
+void BinarySearchTree<Key, Value, Compare>::writeDot(std::ostream& os, size_t maxDepth) const
+{
+    os << "digraph bst {\n"
+       << "    graph [ordering=out];\n"
+       << "    node [shape=box, fontname=\"monospace\"];\n";
+    std::ostringstream label;
+    walkPreorder(root_, maxDepth, [&](Node<Key, Value>* node, size_t depth)
+    {
+        label.str("");
+        label << node->getKey();
+        describeNode(label, node);
+        os << "    n" << static_cast<const void*>(node) << " [label=\"";
+        const std::string& text = label.str();
+        for(size_t i = 0; i < text.size(); ++i)
+        {
+            if(text[i] == '"' || text[i] == '\\')
+            {
+                os << '\\';
+            }
+            os << text[i];
+        }
+        os << "\"";
+        if(node->isDead())
+        {
+            os << ", style=dashed";
+        }
+        os << "];\n";
+        const void* id = node;
+        Node<Key, Value>* children[2] = { node->getLeft(), node->getRight() };
+        if(children[0] == NULL && children[1] == NULL)
+        {
+            return;
+        }
+        if(depth + 1 == maxDepth)
+        {
+            os << "    n" << id << "_more [label=\"...\", shape=plaintext];\n"
+               << "    n" << id << " -> n" << id << "_more [style=dotted];\n";
+            return;
+        }
+        for(int side = 0; side < 2; ++side)
+        {
+            if(children[side] != NULL)
+            {
+                os << "    n" << id << " -> n" << static_cast<const void*>(children[side]) << ";\n";
+            }
+            else
+            {
+                os << "    n" << id << "_" << side << " [shape=point, style=invis];\n"
+                   << "    n" << id << " -> n" << id << "_" << side << " [style=invis];\n";
+            }
+        }
+    });
+    os << "}\n";
+}
+
+/**
+* Writes the top levels of the tree as an indented outline, one node
+* per line, children marked L or R:
+*
+*   8 b=0
+*   |-- L 4 b=0
+*   |   `-- R 6 b=0 ...
+*   `-- R 12 b=0
+*
+* A trailing "..." marks a node whose children lie below the cut-off.
+*/
+template<typename Key, typename Value, typename Compare>
+void BinarySearchTree<Key, Value, Compare>::writeAscii(std::ostream& os, size_t levels) const
+{
+    writeAsciiFrom(os, root_, levels);
+}
+
+/**
+* Writes levels levels of the outline starting `above` ancestors up
+* from key's node, or from where key would be inserted, so that a
+* neighbourhood deep inside a large tree can be inspected.
+*/
+template<typename Key, typename Value, typename Compare>
+void BinarySearchTree<Key, Value, Compare>::writeAscii(std::ostream& os, const Key& around, size_t levels,
+                                                       size_t above) const
+{
+    Node<Key, Value>* node = root_;
+    Node<Key, Value>* last = NULL;
+    while(node != NULL)
+    {
+        last = node;
+        int c = order(around, node->getKey());
+        if(c == 0)
+        {
+            break;
+        }
+        node = c < 0 ? node->getLeft() : node->getRight();
+    }
+    for(size_t i = 0; i < above && last != NULL && last->getParent() != NULL; ++i)
+    {
+        last = last->getParent();
+    }
+    writeAsciiFrom(os, last, levels);
+}
+
+template<typename Key, typename Value, typename Compare>
+void BinarySearchTree<Key, Value, Compare>::writeAsciiFrom(std::ostream& os, Node<Key, Value>* top,
+                                                           size_t levels) const
+{
+    if(top == NULL)
+    {
+        os << "<empty tree>\n";
+        return;
+    }
+    // open[d] is true while the node at depth d still has a sibling
+    // to come, i.e. its vertical bar continues
+    std::vector<bool> open;
+    walkPreorder(top, levels, [&](Node<Key, Value>* node, size_t depth)
+    {
+        open.resize(depth + 1);
+        if(depth > 0)
+        {
+            Node<Key, Value>* parent = node->getParent();
+            bool isLeft = node == parent->getLeft();
+            open[depth] = isLeft && parent->getRight() != NULL;
+            for(size_t d = 1; d < depth; ++d)
+            {
+                os << (open[d] ? "|   " : "    ");
+            }
+            os << (open[depth] ? "|-- " : "`-- ") << (isLeft ? "L " : "R ");
+        }
+        os << node->getKey();
+        describeNode(os, node);
+        if(depth + 1 == levels && (node->getLeft() != NULL || node->getRight() != NULL))
+        {
+            os << " ...";
+        }
+        os << '\n';
+    });
+}
+
+/**
+* Writes one "key value" line per node in preorder, followed by the
+* tree's own node state (balance, color, dead). Inserting the keys in
+* this order into an empty unbalanced tree rebuilds the same shape.
+*/
+template<typename Key, typename Value, typename Compare>
+void BinarySearchTree<Key, Value, Compare>::writePreorder(std::ostream& os) const
+{
+    walkPreorder(root_, SIZE_MAX, [&](Node<Key, Value>* node, size_t)
+    {
+        os << node->getKey() << ' ' << node->getValue();
+        describeNode(os, node);
+        os << '\n';
+    });
+}
+
+/**
+* A plain tree has no per-node state beyond the tombstone flag.
+*/
+template<typename Key, typename Value, typename Compare>
+void BinarySearchTree<Key, Value, Compare>::describeNode(std::ostream& os, const Node<Key, Value>* node) const
+{
+    if(node->isDead())
+    {
+        os << " dead";
+    }
+}
+
+#endif
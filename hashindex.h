@@ -0,0 +1,199 @@
+#ifndef HASHINDEX_H
+#define HASHINDEX_H
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+/**
+* A key-to-node lookup table kept beside a search tree. Trees hold it
+* through this interface so that hashing is only instantiated for key
+* types whose index is actually enabled.
+*/
+template <typename Key, typename NodeType>
+class NodeIndex
+{
+public:
+    virtual ~NodeIndex() {}
+    virtual NodeType* find(const Key& key) const = 0;
+    virtual void insert(NodeType* node) = 0;
+    virtual void erase(NodeType* node) = 0;
+    virtual void clear() = 0;
+    virtual size_t size() const = 0;
+    virtual size_t memoryBytes() const = 0;
+    // Returns a new, empty index of the same kind.
+    virtual NodeIndex<Key, NodeType>* cloneEmpty() const = 0;
+};
+
+/**
+* An open-addressing hash table of node pointers with linear probing.
+* Only pointers are stored; keys are read through the nodes, so a slot
+* costs 8 bytes and the table is kept at most half full. Removal uses
+* backward-shift deletion, so there are no tombstones and probe runs
+* never grow from churn. Hash and KeyEqual must agree with the tree's
+* ordering: keys the tree orders as equivalent must compare equal and
+* hash alike.
+*/
+template <typename Key, typename NodeType, typename Hash = std::hash<Key>, typename KeyEqual = std::equal_to<Key> >
+class HashIndex : public NodeIndex<Key, NodeType>
+{
+public:
+    HashIndex();
+
+    virtual NodeType* find(const Key& key) const;
+    virtual void insert(NodeType* node);
+    virtual void erase(NodeType* node);
+    virtual void clear();
+    virtual size_t size() const;
+    virtual size_t memoryBytes() const;
+    virtual NodeIndex<Key, NodeType>* cloneEmpty() const;
+
+protected:
+    size_t home(const Key& key) const;
+    void grow();
+
+    static const size_t MIN_CAPACITY = 16;
+
+    std::vector<NodeType*> slots_;
+    size_t mask_;
+    size_t count_;
+    Hash hash_;
+    KeyEqual equal_;
+};
+
+template<typename Key, typename NodeType, typename Hash, typename KeyEqual>
+HashIndex<Key, NodeType, Hash, KeyEqual>::HashIndex()
+    : slots_(MIN_CAPACITY, NULL), mask_(MIN_CAPACITY - 1), count_(0)
+{
+
+}
+
+/**
+* Returns the slot a key hashes to. std::hash is the identity for
+* integers, so the hash is mixed before masking off the low bits.
+*/
+template<typename Key, typename NodeType, typename Hash, typename KeyEqual>
+size_t HashIndex<Key, NodeType, Hash, KeyEqual>::home(const Key& key) const
+{
+    uint64_t h = hash_(key);
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    return (size_t)h & mask_;
+}
+
+template<typename Key, typename NodeType, typename Hash, typename KeyEqual>
+NodeType* HashIndex<Key, NodeType, Hash, KeyEqual>::find(const Key& key) const
+{
+    for(size_t i = home(key); slots_[i] != NULL; i = (i + 1) & mask_)
+    {
+        if(equal_(slots_[i]->getKey(), key))
+        {
+            return slots_[i];
+        }
+    }
+    return NULL;
+}
+
+/**
+* Adds a node whose key is not yet in the index.
+*/
+template<typename Key, typename NodeType, typename Hash, typename KeyEqual>
+void HashIndex<Key, NodeType, Hash, KeyEqual>::insert(NodeType* node)
+{
+    if(2 * (count_ + 1) > slots_.size())
+    {
+        grow();
+    }
+    size_t i = home(node->getKey());
+    while(slots_[i] != NULL)
+    {
+        i = (i + 1) & mask_;
+    }
+    slots_[i] = node;
+    ++count_;
+}
+
+/**
+* Removes node, then shifts later entries of its probe run back so that
+* every entry stays reachable from its home slot.
+*/
+template<typename Key, typename NodeType, typename Hash, typename KeyEqual>
+void HashIndex<Key, NodeType, Hash, KeyEqual>::erase(NodeType* node)
+{
+    size_t hole = home(node->getKey());
+    while(slots_[hole] != node)
+    {
+        if(slots_[hole] == NULL)
+        {
+            return;
+        }
+        hole = (hole + 1) & mask_;
+    }
+
+    for(size_t next = (hole + 1) & mask_; slots_[next] != NULL; next = (next + 1) & mask_)
+    {
+        // an entry may fill the hole only if the hole lies on its probe
+        // path, i.e. its home is not cyclically within (hole, next]
+        size_t want = home(slots_[next]->getKey());
+        if(((next - want) & mask_) >= ((next - hole) & mask_))
+        {
+            slots_[hole] = slots_[next];
+            hole = next;
+        }
+    }
+    slots_[hole] = NULL;
+    --count_;
+}
+
+template<typename Key, typename NodeType, typename Hash, typename KeyEqual>
+void HashIndex<Key, NodeType, Hash, KeyEqual>::clear()
+{
+    slots_.assign(MIN_CAPACITY, NULL);
+    mask_ = MIN_CAPACITY - 1;
+    count_ = 0;
+}
+
+template<typename Key, typename NodeType, typename Hash, typename KeyEqual>
+size_t HashIndex<Key, NodeType, Hash, KeyEqual>::size() const
+{
+    return count_;
+}
+
+template<typename Key, typename NodeType, typename Hash, typename KeyEqual>
+size_t HashIndex<Key, NodeType, Hash, KeyEqual>::memoryBytes() const
+{
+    return slots_.capacity() * sizeof(NodeType*);
+}
+
+template<typename Key, typename NodeType, typename Hash, typename KeyEqual>
+NodeIndex<Key, NodeType>* HashIndex<Key, NodeType, Hash, KeyEqual>::cloneEmpty() const
+{
+    return new HashIndex<Key, NodeType, Hash, KeyEqual>();
+}
+
+/**
+* Doubles the table and reinserts every node.
+*/
+template<typename Key, typename NodeType, typename Hash, typename KeyEqual>
+void HashIndex<Key, NodeType, Hash, KeyEqual>::grow()
+{
+    std::vector<NodeType*> old(slots_.size() * 2, NULL);
+    old.swap(slots_);
+    mask_ = slots_.size() - 1;
+    for(size_t i = 0; i < old.size(); ++i)
+    {
+        if(old[i] != NULL)
+        {
+            size_t j = home(old[i]->getKey());
+            while(slots_[j] != NULL)
+            {
+                j = (j + 1) & mask_;
+            }
+            slots_[j] = old[i];
+        }
+    }
+}
+
+#endif
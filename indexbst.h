@@ -0,0 +1,872 @@
+#ifndef INDEXBST_H
+#define INDEXBST_H
+
+#include <iostream>
+#include <exception>
+#include <cstdlib>
+#include <cstdint>
+#include <new>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+/**
+* A binary search tree whose nodes live in one contiguous vector and link
+* to each other by 32-bit indices instead of pointers. It has the same
+* public interface as BinarySearchTree, but a node for <int,int> takes 24
+* bytes instead of 40 plus per-allocation malloc overhead, and neighbouring
+* nodes share cache lines.
+*
+* Iterators hold an index, so they stay valid across inserts, but
+* references obtained through them do not survive an insert that grows
+* the vector. Removed slots are kept on a free list and reused.
+*/
+template <typename Key, typename Value>
+class IndexedBinarySearchTree
+{
+public:
+    typedef uint32_t Index;
+    static const Index NIL = UINT32_MAX;
+
+    IndexedBinarySearchTree();
+    virtual ~IndexedBinarySearchTree();
+    virtual void insert(const std::pair<const Key, Value>& keyValuePair);
+    virtual void remove(const Key& key);
+    void clear();
+    bool isBalanced() const;
+    void print() const;
+    bool empty() const;
+    size_t size() const;
+
+    /**
+    * An iterator over the tree in key order.
+    */
+    class iterator
+    {
+    public:
+        iterator();
+
+        std::pair<const Key,Value>& operator*() const;
+        std::pair<const Key,Value>* operator->() const;
+
+        bool operator==(const iterator& rhs) const;
+        bool operator!=(const iterator& rhs) const;
+
+        iterator& operator++();
+
+    protected:
+        friend class IndexedBinarySearchTree<Key, Value>;
+        iterator(IndexedBinarySearchTree<Key, Value>* tree, Index index);
+        IndexedBinarySearchTree<Key, Value>* tree_;
+        Index current_;
+    };
+
+    iterator begin() const;
+    iterator end() const;
+    iterator find(const Key& key) const;
+    Value& operator[](const Key& key);
+    Value const & operator[](const Key& key) const;
+
+protected:
+    /**
+    * A node. The item is built in place when the slot is allocated and
+    * destroyed when it is released, so a free slot holds no item; its
+    * balance is FREE so that copies and the destructor can tell.
+    */
+    struct Slot
+    {
+        static const int8_t FREE = INT8_MIN;
+
+        explicit Slot(Index parent);
+        Slot(const Slot& other);
+        ~Slot();
+
+        std::pair<const Key, Value>& item();
+        const std::pair<const Key, Value>& item() const;
+
+        alignas(std::pair<const Key, Value>) unsigned char storage[sizeof(std::pair<const Key, Value>)];
+        Index parent;
+        Index left;
+        Index right;
+        int8_t balance;     // only used by IndexedAVLTree
+
+    private:
+        Slot& operator=(const Slot&);
+    };
+
+    Index allocate(const Key& key, const Value& value, Index parent);
+    void release(Index node);
+    Index internalFind(const Key& key) const;
+    Index getSmallestNode() const;
+    Index predecessor(Index node) const;
+    Index successor(Index node) const;
+    void nodeSwap(Index n1, Index n2);
+    void replaceChild(Index parent, Index oldChild, Index newChild);
+    void rotateLeft(Index node);
+    void rotateRight(Index node);
+    int calculateHeightIfBalanced(Index node) const;
+
+    std::vector<Slot> slots_;
+    Index root_;
+    Index freeList_;    // chained through Slot::right
+    size_t size_;
+};
+
+template <typename Key, typename Value>
+const typename IndexedBinarySearchTree<Key, Value>::Index IndexedBinarySearchTree<Key, Value>::NIL;
+
+template <typename Key, typename Value>
+const int8_t IndexedBinarySearchTree<Key, Value>::Slot::FREE;
+
+/*
+-----------------------------------------------------------------------
+Begin implementations for the IndexedBinarySearchTree::iterator class.
+-----------------------------------------------------------------------
+*/
+
+template<class Key, class Value>
+IndexedBinarySearchTree<Key, Value>::iterator::iterator()
+    : tree_(NULL), current_(NIL)
+{
+
+}
+
+template<class Key, class Value>
+IndexedBinarySearchTree<Key, Value>::iterator::iterator(IndexedBinarySearchTree<Key, Value>* tree, Index index)
+    : tree_(tree), current_(index)
+{
+
+}
+
+template<class Key, class Value>
+std::pair<const Key,Value>&
+IndexedBinarySearchTree<Key, Value>::iterator::operator*() const
+{
+    return tree_->slots_[current_].item();
+}
+
+template<class Key, class Value>
+std::pair<const Key,Value>*
+IndexedBinarySearchTree<Key, Value>::iterator::operator->() const
+{
+    return &(tree_->slots_[current_].item());
+}
+
+template<class Key, class Value>
+bool IndexedBinarySearchTree<Key, Value>::iterator::operator==(const iterator& rhs) const
+{
+    return current_ == rhs.current_;
+}
+
+template<class Key, class Value>
+bool IndexedBinarySearchTree<Key, Value>::iterator::operator!=(const iterator& rhs) const
+{
+    return current_ != rhs.current_;
+}
+
+template<class Key, class Value>
+typename IndexedBinarySearchTree<Key, Value>::iterator&
+IndexedBinarySearchTree<Key, Value>::iterator::operator++()
+{
+    current_ = tree_->successor(current_);
+    return *this;
+}
+
+/*
+---------------------------------------------------------
+Begin implementations for the IndexedBinarySearchTree class.
+---------------------------------------------------------
+*/
+
+/**
+* Makes a free slot; allocate builds the item in it.
+*/
+template<class Key, class Value>
+IndexedBinarySearchTree<Key, Value>::Slot::Slot(Index parent)
+    : parent(parent), left(NIL), right(NIL), balance(FREE)
+{
+
+}
+
+template<class Key, class Value>
+IndexedBinarySearchTree<Key, Value>::Slot::Slot(const Slot& other)
+    : parent(other.parent), left(other.left), right(other.right), balance(other.balance)
+{
+    if(balance != FREE)
+    {
+        new (storage) std::pair<const Key, Value>(other.item());
+    }
+}
+
+template<class Key, class Value>
+IndexedBinarySearchTree<Key, Value>::Slot::~Slot()
+{
+    if(balance != FREE)
+    {
+        item().~pair();
+    }
+}
+
+template<class Key, class Value>
+std::pair<const Key, Value>& IndexedBinarySearchTree<Key, Value>::Slot::item()
+{
+    return *std::launder(reinterpret_cast<std::pair<const Key, Value>*>(storage));
+}
+
+template<class Key, class Value>
+const std::pair<const Key, Value>& IndexedBinarySearchTree<Key, Value>::Slot::item() const
+{
+    return *std::launder(reinterpret_cast<const std::pair<const Key, Value>*>(storage));
+}
+
+template<class Key, class Value>
+IndexedBinarySearchTree<Key, Value>::IndexedBinarySearchTree()
+    : root_(NIL), freeList_(NIL), size_(0)
+{
+
+}
+
+template<class Key, class Value>
+IndexedBinarySearchTree<Key, Value>::~IndexedBinarySearchTree()
+{
+
+}
+
+template<class Key, class Value>
+bool IndexedBinarySearchTree<Key, Value>::empty() const
+{
+    return root_ == NIL;
+}
+
+template<class Key, class Value>
+size_t IndexedBinarySearchTree<Key, Value>::size() const
+{
+    return size_;
+}
+
+/**
+* Releases all slots at once.
+*/
+template<class Key, class Value>
+void IndexedBinarySearchTree<Key, Value>::clear()
+{
+    std::vector<Slot>().swap(slots_);
+    root_ = NIL;
+    freeList_ = NIL;
+    size_ = 0;
+}
+
+/**
+* Prints the items in key order.
+*/
+template<class Key, class Value>
+void IndexedBinarySearchTree<Key, Value>::print() const
+{
+    for(iterator it = begin(); it != end(); ++it)
+    {
+        std::cout << '(' << it->first << ", " << it->second << ") ";
+    }
+    std::cout << "\n";
+}
+
+template<class Key, class Value>
+typename IndexedBinarySearchTree<Key, Value>::iterator
+IndexedBinarySearchTree<Key, Value>::begin() const
+{
+    return iterator(const_cast<IndexedBinarySearchTree<Key, Value>*>(this), getSmallestNode());
+}
+
+template<class Key, class Value>
+typename IndexedBinarySearchTree<Key, Value>::iterator
+IndexedBinarySearchTree<Key, Value>::end() const
+{
+    return iterator(const_cast<IndexedBinarySearchTree<Key, Value>*>(this), NIL);
+}
+
+template<class Key, class Value>
+typename IndexedBinarySearchTree<Key, Value>::iterator
+IndexedBinarySearchTree<Key, Value>::find(const Key& key) const
+{
+    return iterator(const_cast<IndexedBinarySearchTree<Key, Value>*>(this), internalFind(key));
+}
+
+template<class Key, class Value>
+Value& IndexedBinarySearchTree<Key, Value>::operator[](const Key& key)
+{
+    Index node = internalFind(key);
+    if(node == NIL) throw std::out_of_range("Invalid key");
+    return slots_[node].item().second;
+}
+
+template<class Key, class Value>
+Value const & IndexedBinarySearchTree<Key, Value>::operator[](const Key& key) const
+{
+    Index node = internalFind(key);
+    if(node == NIL) throw std::out_of_range("Invalid key");
+    return slots_[node].item().second;
+}
+
+/**
+* Unbalanced insert; overwrites the value if the key already exists.
+*/
+template<class Key, class Value>
+void IndexedBinarySearchTree<Key, Value>::insert(const std::pair<const Key, Value>& keyValuePair)
+{
+    Index parent = NIL;
+    Index curr = root_;
+    while(curr != NIL)
+    {
+        parent = curr;
+        if(keyValuePair.first < slots_[curr].item().first)
+        {
+            curr = slots_[curr].left;
+        }
+        else if(keyValuePair.first > slots_[curr].item().first)
+        {
+            curr = slots_[curr].right;
+        }
+        else
+        {
+            slots_[curr].item().second = keyValuePair.second;
+            return;
+        }
+    }
+
+    Index node = allocate(keyValuePair.first, keyValuePair.second, parent);
+    if(parent == NIL)
+    {
+        root_ = node;
+    }
+    else if(keyValuePair.first < slots_[parent].item().first)
+    {
+        slots_[parent].left = node;
+    }
+    else
+    {
+        slots_[parent].right = node;
+    }
+}
+
+/**
+* Removes key, swapping a node with two children with its predecessor first.
+*/
+template<class Key, class Value>
+void IndexedBinarySearchTree<Key, Value>::remove(const Key& key)
+{
+    Index node = internalFind(key);
+    if(node == NIL)
+    {
+        return;
+    }
+    if(slots_[node].left != NIL && slots_[node].right != NIL)
+    {
+        nodeSwap(predecessor(node), node);
+    }
+    Index child = (slots_[node].left != NIL) ? slots_[node].left : slots_[node].right;
+    if(child != NIL)
+    {
+        slots_[child].parent = slots_[node].parent;
+    }
+    replaceChild(slots_[node].parent, node, child);
+    release(node);
+}
+
+/**
+* Takes a slot from the free list, or appends one, and builds the item
+* in it. If copying the item throws, the tree is unchanged.
+*/
+template<class Key, class Value>
+typename IndexedBinarySearchTree<Key, Value>::Index
+IndexedBinarySearchTree<Key, Value>::allocate(const Key& key, const Value& value, Index parent)
+{
+    Index node = freeList_;
+    if(node == NIL)
+    {
+        if(slots_.size() >= NIL)
+        {
+            throw std::length_error("IndexedBinarySearchTree is full");
+        }
+        slots_.push_back(Slot(NIL));
+        node = (Index)(slots_.size() - 1);
+        try
+        {
+            new (slots_[node].storage) std::pair<const Key, Value>(key, value);
+        }
+        catch(...)
+        {
+            slots_.pop_back();
+            throw;
+        }
+    }
+    else
+    {
+        new (slots_[node].storage) std::pair<const Key, Value>(key, value);
+        freeList_ = slots_[node].right;
+    }
+    Slot& slot = slots_[node];
+    slot.parent = parent;
+    slot.left = NIL;
+    slot.right = NIL;
+    slot.balance = 0;
+    ++size_;
+    return node;
+}
+
+/**
+* Destroys a slot's item and puts the slot on the free list.
+*/
+template<class Key, class Value>
+void IndexedBinarySearchTree<Key, Value>::release(Index node)
+{
+    --size_;
+    Slot& slot = slots_[node];
+    slot.item().~pair();
+    slot.balance = Slot::FREE;
+    slot.parent = NIL;
+    slot.left = NIL;
+    slot.right = freeList_;
+    freeList_ = node;
+}
+
+template<class Key, class Value>
+typename IndexedBinarySearchTree<Key, Value>::Index
+IndexedBinarySearchTree<Key, Value>::internalFind(const Key& key) const
+{
+    Index curr = root_;
+    while(curr != NIL)
+    {
+        const Slot& slot = slots_[curr];
+        if(key < slot.item().first)
+        {
+            curr = slot.left;
+        }
+        else if(key > slot.item().first)
+        {
+            curr = slot.right;
+        }
+        else
+        {
+            return curr;
+        }
+    }
+    return NIL;
+}
+
+template<class Key, class Value>
+typename IndexedBinarySearchTree<Key, Value>::Index
+IndexedBinarySearchTree<Key, Value>::getSmallestNode() const
+{
+    Index curr = root_;
+    if(curr == NIL)
+    {
+        return NIL;
+    }
+    while(slots_[curr].left != NIL)
+    {
+        curr = slots_[curr].left;
+    }
+    return curr;
+}
+
+template<class Key, class Value>
+typename IndexedBinarySearchTree<Key, Value>::Index
+IndexedBinarySearchTree<Key, Value>::predecessor(Index node) const
+{
+    if(slots_[node].left != NIL)
+    {
+        node = slots_[node].left;
+        while(slots_[node].right != NIL)
+        {
+            node = slots_[node].right;
+        }
+        return node;
+    }
+    Index parent = slots_[node].parent;
+    while(parent != NIL && node == slots_[parent].left)
+    {
+        node = parent;
+        parent = slots_[parent].parent;
+    }
+    return parent;
+}
+
+template<class Key, class Value>
+typename IndexedBinarySearchTree<Key, Value>::Index
+IndexedBinarySearchTree<Key, Value>::successor(Index node) const
+{
+    if(slots_[node].right != NIL)
+    {
+        node = slots_[node].right;
+        while(slots_[node].left != NIL)
+        {
+            node = slots_[node].left;
+        }
+        return node;
+    }
+    Index parent = slots_[node].parent;
+    while(parent != NIL && node == slots_[parent].right)
+    {
+        node = parent;
+        parent = slots_[parent].parent;
+    }
+    return parent;
+}
+
+/**
+* Points parent's link (or root_) that referred to oldChild at newChild.
+*/
+template<class Key, class Value>
+void IndexedBinarySearchTree<Key, Value>::replaceChild(Index parent, Index oldChild, Index newChild)
+{
+    if(parent == NIL)
+    {
+        root_ = newChild;
+    }
+    else if(slots_[parent].left == oldChild)
+    {
+        slots_[parent].left = newChild;
+    }
+    else
+    {
+        slots_[parent].right = newChild;
+    }
+}
+
+/**
+* Exchanges the tree positions of two nodes (their links and balances),
+* the index counterpart of BinarySearchTree::nodeSwap.
+*/
+template<class Key, class Value>
+void IndexedBinarySearchTree<Key, Value>::nodeSwap(Index n1, Index n2)
+{
+    if(n1 == n2 || n1 == NIL || n2 == NIL)
+    {
+        return;
+    }
+    // make n1 the upper node when they are parent and child
+    if(slots_[n1].parent == n2)
+    {
+        std::swap(n1, n2);
+    }
+    Slot& a = slots_[n1];
+    Slot& b = slots_[n2];
+    Index ap = a.parent;
+    Index bp = b.parent;
+
+    if(bp == n1)
+    {
+        bool bIsLeft = (a.left == n2);
+        Index aOther = bIsLeft ? a.right : a.left;
+        Index bl = b.left;
+        Index br = b.right;
+
+        replaceChild(ap, n1, n2);
+        b.parent = ap;
+        if(bIsLeft)
+        {
+            b.left = n1;
+            b.right = aOther;
+        }
+        else
+        {
+            b.right = n1;
+            b.left = aOther;
+        }
+        if(aOther != NIL) slots_[aOther].parent = n2;
+        a.parent = n2;
+        a.left = bl;
+        a.right = br;
+        if(bl != NIL) slots_[bl].parent = n1;
+        if(br != NIL) slots_[br].parent = n1;
+    }
+    else
+    {
+        // unrelated nodes: exchange parents' links, then children
+        bool aIsLeft = (ap != NIL && slots_[ap].left == n1);
+        bool bIsLeft = (bp != NIL && slots_[bp].left == n2);
+        if(ap == NIL) root_ = n2;
+        else if(aIsLeft) slots_[ap].left = n2;
+        else slots_[ap].right = n2;
+        if(bp == NIL) root_ = n1;
+        else if(bIsLeft) slots_[bp].left = n1;
+        else slots_[bp].right = n1;
+
+        std::swap(a.parent, b.parent);
+        std::swap(a.left, b.left);
+        std::swap(a.right, b.right);
+        if(a.left != NIL) slots_[a.left].parent = n1;
+        if(a.right != NIL) slots_[a.right].parent = n1;
+        if(b.left != NIL) slots_[b.left].parent = n2;
+        if(b.right != NIL) slots_[b.right].parent = n2;
+    }
+    std::swap(a.balance, b.balance);
+}
+
+template<class Key, class Value>
+void IndexedBinarySearchTree<Key, Value>::rotateLeft(Index node)
+{
+    Index pivot = slots_[node].right;
+    Index parent = slots_[node].parent;
+    Index inner = slots_[pivot].left;
+
+    slots_[node].right = inner;
+    if(inner != NIL) slots_[inner].parent = node;
+    slots_[pivot].left = node;
+    slots_[node].parent = pivot;
+    slots_[pivot].parent = parent;
+    replaceChild(parent, node, pivot);
+}
+
+template<class Key, class Value>
+void IndexedBinarySearchTree<Key, Value>::rotateRight(Index node)
+{
+    Index pivot = slots_[node].left;
+    Index parent = slots_[node].parent;
+    Index inner = slots_[pivot].right;
+
+    slots_[node].left = inner;
+    if(inner != NIL) slots_[inner].parent = node;
+    slots_[pivot].right = node;
+    slots_[node].parent = pivot;
+    slots_[pivot].parent = parent;
+    replaceChild(parent, node, pivot);
+}
+
+template<class Key, class Value>
+bool IndexedBinarySearchTree<Key, Value>::isBalanced() const
+{
+    return calculateHeightIfBalanced(root_) != -1;
+}
+
+template<class Key, class Value>
+int IndexedBinarySearchTree<Key, Value>::calculateHeightIfBalanced(Index node) const
+{
+    if(node == NIL)
+    {
+        return 0;
+    }
+    int leftHeight = calculateHeightIfBalanced(slots_[node].left);
+    int rightHeight = calculateHeightIfBalanced(slots_[node].right);
+    if(leftHeight == -1 || rightHeight == -1 || leftHeight - rightHeight > 1 || rightHeight - leftHeight > 1)
+    {
+        return -1;
+    }
+    return (leftHeight > rightHeight ? leftHeight : rightHeight) + 1;
+}
+
+/*
+---------------------------------------------------------
+End implementations for the IndexedBinarySearchTree class.
+---------------------------------------------------------
+*/
+
+/**
+* The AVL tree of avlbst.h over index-linked storage.
+*/
+template <class Key, class Value>
+class IndexedAVLTree : public IndexedBinarySearchTree<Key, Value>
+{
+public:
+    typedef typename IndexedBinarySearchTree<Key, Value>::Index Index;
+
+    virtual void insert(const std::pair<const Key, Value>& new_item);
+    virtual void remove(const Key& key);
+
+protected:
+    void insertFix(Index parent, Index node);
+    void removeFix(Index node, int8_t diff);
+};
+
+template<class Key, class Value>
+void IndexedAVLTree<Key, Value>::insert(const std::pair<const Key, Value>& new_item)
+{
+    const Index NIL = IndexedBinarySearchTree<Key, Value>::NIL;
+    Index parent = NIL;
+    Index curr = this->root_;
+    while(curr != NIL)
+    {
+        parent = curr;
+        if(new_item.first < this->slots_[curr].item().first)
+        {
+            curr = this->slots_[curr].left;
+        }
+        else if(new_item.first > this->slots_[curr].item().first)
+        {
+            curr = this->slots_[curr].right;
+        }
+        else
+        {
+            this->slots_[curr].item().second = new_item.second;
+            return;
+        }
+    }
+
+    Index node = this->allocate(new_item.first, new_item.second, parent);
+    if(parent == NIL)
+    {
+        this->root_ = node;
+        return;
+    }
+    if(new_item.first < this->slots_[parent].item().first)
+    {
+        this->slots_[parent].left = node;
+    }
+    else
+    {
+        this->slots_[parent].right = node;
+    }
+    insertFix(parent, node);
+}
+
+template<class Key, class Value>
+void IndexedAVLTree<Key, Value>::remove(const Key& key)
+{
+    const Index NIL = IndexedBinarySearchTree<Key, Value>::NIL;
+    Index node = this->internalFind(key);
+    if(node == NIL)
+    {
+        return;
+    }
+    if(this->slots_[node].left != NIL && this->slots_[node].right != NIL)
+    {
+        this->nodeSwap(this->predecessor(node), node);
+    }
+
+    Index child = (this->slots_[node].left != NIL) ? this->slots_[node].left : this->slots_[node].right;
+    Index parent = this->slots_[node].parent;
+    int8_t diff = 0;
+    if(child != NIL)
+    {
+        this->slots_[child].parent = parent;
+    }
+    if(parent != NIL)
+    {
+        diff = (this->slots_[parent].left == node) ? 1 : -1;
+    }
+    this->replaceChild(parent, node, child);
+    this->release(node);
+    removeFix(parent, diff);
+}
+
+/**
+* Same retracing as AVLTree::insertFix.
+*/
+template<class Key, class Value>
+void IndexedAVLTree<Key, Value>::insertFix(Index parent, Index node)
+{
+    const Index NIL = IndexedBinarySearchTree<Key, Value>::NIL;
+    while(parent != NIL)
+    {
+        int8_t diff = (node == this->slots_[parent].left) ? -1 : 1;
+        int balance = this->slots_[parent].balance + diff;
+        if(balance == 0)
+        {
+            this->slots_[parent].balance = 0;
+            return;
+        }
+        if(balance == diff)
+        {
+            this->slots_[parent].balance = diff;
+            node = parent;
+            parent = this->slots_[parent].parent;
+            continue;
+        }
+
+        if(this->slots_[node].balance == diff)
+        {
+            if(diff < 0) this->rotateRight(parent);
+            else this->rotateLeft(parent);
+            this->slots_[parent].balance = 0;
+            this->slots_[node].balance = 0;
+        }
+        else
+        {
+            Index grandChild = (diff < 0) ? this->slots_[node].right : this->slots_[node].left;
+            int8_t gb = this->slots_[grandChild].balance;
+            if(diff < 0)
+            {
+                this->rotateLeft(node);
+                this->rotateRight(parent);
+            }
+            else
+            {
+                this->rotateRight(node);
+                this->rotateLeft(parent);
+            }
+            this->slots_[node].balance = (gb == -diff) ? diff : 0;
+            this->slots_[parent].balance = (gb == diff) ? -diff : 0;
+            this->slots_[grandChild].balance = 0;
+        }
+        return;
+    }
+}
+
+/**
+* Same retracing as AVLTree::removeFix.
+*/
+template<class Key, class Value>
+void IndexedAVLTree<Key, Value>::removeFix(Index node, int8_t diff)
+{
+    const Index NIL = IndexedBinarySearchTree<Key, Value>::NIL;
+    while(node != NIL)
+    {
+        Index parent = this->slots_[node].parent;
+        int8_t nextDiff = 0;
+        if(parent != NIL)
+        {
+            nextDiff = (node == this->slots_[parent].left) ? 1 : -1;
+        }
+
+        int balance = this->slots_[node].balance + diff;
+        if(balance == diff)
+        {
+            this->slots_[node].balance = diff;
+            return;
+        }
+        if(balance == 0)
+        {
+            this->slots_[node].balance = 0;
+            node = parent;
+            diff = nextDiff;
+            continue;
+        }
+
+        Index child = (diff > 0) ? this->slots_[node].right : this->slots_[node].left;
+        int8_t cb = this->slots_[child].balance;
+        if(cb == -diff)
+        {
+            Index grandChild = (diff > 0) ? this->slots_[child].left : this->slots_[child].right;
+            int8_t gb = this->slots_[grandChild].balance;
+            if(diff > 0)
+            {
+                this->rotateRight(child);
+                this->rotateLeft(node);
+            }
+            else
+            {
+                this->rotateLeft(child);
+                this->rotateRight(node);
+            }
+            this->slots_[node].balance = (gb == diff) ? -diff : 0;
+            this->slots_[child].balance = (gb == -diff) ? diff : 0;
+            this->slots_[grandChild].balance = 0;
+        }
+        else
+        {
+            if(diff > 0) this->rotateLeft(node);
+            else this->rotateRight(node);
+            if(cb == 0)
+            {
+                this->slots_[node].balance = diff;
+                this->slots_[child].balance = -diff;
+                return;
+            }
+            this->slots_[node].balance = 0;
+            this->slots_[child].balance = 0;
+        }
+        node = parent;
+        diff = nextDiff;
+    }
+}
+
+#endif
@@ -0,0 +1,143 @@
+#ifndef INTERVALTREE_H
+#define INTERVALTREE_H
+
+#include <iostream>
+#include <exception>
+#include <cstdlib>
+#include <limits>
+#include <utility>
+#include <vector>
+#include "augavl.h"
+
+/**
+* A closed interval [start, end], ordered by start and then by end.
+*/
+template <typename T>
+struct Interval
+{
+    Interval() : start(), end() { }
+    Interval(const T& s, const T& e) : start(s), end(e) { }
+
+    T start;
+    T end;
+};
+
+template <typename T>
+bool operator<(const Interval<T>& a, const Interval<T>& b)
+{
+    return a.start < b.start || (!(b.start < a.start) && a.end < b.end);
+}
+
+template <typename T>
+bool operator>(const Interval<T>& a, const Interval<T>& b)
+{
+    return b < a;
+}
+
+template <typename T>
+bool operator==(const Interval<T>& a, const Interval<T>& b)
+{
+    return a.start == b.start && a.end == b.end;
+}
+
+template <typename T>
+std::ostream& operator<<(std::ostream& os, const Interval<T>& interval)
+{
+    return os << '[' << interval.start << ", " << interval.end << ']';
+}
+
+/**
+* Aggregates the largest interval end in a subtree.
+*/
+template <typename T>
+struct MaxEndMonoid
+{
+    typedef T value_type;
+    static T identity() { return std::numeric_limits<T>::lowest(); }
+    template <typename Value>
+    static T lift(const Interval<T>& key, const Value&) { return key.end; }
+    static T combine(const T& a, const T& b) { return a < b ? b : a; }
+};
+
+/**
+* Closed intervals with a Value each, kept in an AVL tree ordered by
+* (start, end) so that intervals may share a start. Every
+* subtree knows its largest end, which lets overlap and stabbing
+* queries skip whole subtrees.
+*
+* Matches that start inside the query range are reported in O(log n + k)
+* like a range scan. Matches that start before it are found through
+* the max-end bound, which can cost up to a root path per match when
+* they are scattered thinly among short intervals: O(k log(n / k)) in
+* the worst case.
+*/
+template <typename T, typename Value>
+class IntervalTree : public AugmentedAVLTree<Interval<T>, Value, MaxEndMonoid<T> >
+{
+public:
+    typedef AugmentedAVLTree<Interval<T>, Value, MaxEndMonoid<T> > Base;
+    typedef typename Base::iterator iterator;
+    typedef typename Base::NodeType NodeType;
+
+    using Base::insert;
+    void insert(const T& start, const T& end, const Value& value);
+
+    // Appends, in key order, every interval that shares a point with
+    // [lo, hi].
+    void overlapping(const T& lo, const T& hi, std::vector<iterator>& out) const;
+    // Appends every interval containing point.
+    void stabbing(const T& point, std::vector<iterator>& out) const;
+};
+
+template<class T, class Value>
+void IntervalTree<T, Value>::insert(const T& start, const T& end, const Value& value)
+{
+    this->insert(std::make_pair(Interval<T>(start, end), value));
+}
+
+/**
+* An in-order walk with an explicit stack that enters a left subtree
+* only if its largest end reaches lo, and stops going right at the
+* first start past hi. Every node visited either matches or lies on one
+* of O(log n) boundary paths.
+*/
+template<class T, class Value>
+void IntervalTree<T, Value>::overlapping(const T& lo, const T& hi, std::vector<iterator>& out) const
+{
+    std::vector<const NodeType*> stack;
+    const NodeType* node = static_cast<NodeType*>(this->root_);
+    while(node != NULL || !stack.empty())
+    {
+        // go left while the subtree can still hold an overlap
+        while(node != NULL && !(node->getAggregate() < lo))
+        {
+            stack.push_back(node);
+            node = static_cast<NodeType*>(node->getLeft());
+        }
+        if(stack.empty())
+        {
+            return;
+        }
+        node = stack.back();
+        stack.pop_back();
+        const Interval<T>& key = node->getKey();
+        if(hi < key.start)
+        {
+            // this and every later interval starts after hi
+            return;
+        }
+        if(!(key.end < lo) && !node->isDead())
+        {
+            out.push_back(this->makeIterator(const_cast<NodeType*>(node)));
+        }
+        node = static_cast<NodeType*>(node->getRight());
+    }
+}
+
+template<class T, class Value>
+void IntervalTree<T, Value>::stabbing(const T& point, std::vector<iterator>& out) const
+{
+    overlapping(point, point, out);
+}
+
+#endif
@@ -0,0 +1,539 @@
+#ifndef LATENCY_H
+#define LATENCY_H
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <utility>
+
+/**
+* The tree operations that a LatencyRecorder keeps separate histograms for.
+*/
+enum LatencyOp
+{
+    LAT_INSERT,
+    LAT_REMOVE,
+    LAT_FIND,
+    LAT_ITERATE,
+    LAT_CLEAR,
+    LAT_NUM_OPS
+};
+
+inline const char* latencyOpName(LatencyOp op)
+{
+    static const char* const names[LAT_NUM_OPS] = { "insert", "remove", "find", "iterate", "clear" };
+    return names[op];
+}
+
+/**
+* A log-linear latency histogram in the style of HdrHistogram.
+* Values (in nanoseconds) below 2 * SUB_BUCKETS are counted exactly;
+* above that every power of two is split into SUB_BUCKETS linear
+* sub-buckets, so any reported value is within 1 / SUB_BUCKETS (~3%)
+* of the true one. Counters are relaxed atomics: recording never
+* locks, and a histogram may be read or merged while it is recorded into.
+*/
+class LatencyHistogram
+{
+public:
+    static const unsigned SUB_BUCKET_BITS = 5;
+    static const unsigned SUB_BUCKETS = 1u << SUB_BUCKET_BITS;
+    static const unsigned NUM_BUCKETS = (64 - SUB_BUCKET_BITS + 1) * SUB_BUCKETS;
+
+    LatencyHistogram();
+
+    void record(uint64_t nanos);
+    void merge(const LatencyHistogram& other);
+    void reset();
+
+    uint64_t count() const;
+    uint64_t max() const;
+    double mean() const;
+    uint64_t percentile(double pct) const;
+
+    static unsigned bucketIndex(uint64_t value);
+    static uint64_t bucketHighest(unsigned index);
+
+private:
+    LatencyHistogram(const LatencyHistogram&);
+    LatencyHistogram& operator=(const LatencyHistogram&);
+
+    std::atomic<uint64_t> counts_[NUM_BUCKETS];
+    std::atomic<uint64_t> total_;
+    std::atomic<uint64_t> sum_;
+    std::atomic<uint64_t> max_;
+};
+
+inline LatencyHistogram::LatencyHistogram()
+{
+    reset();
+}
+
+/**
+* Maps a value to its bucket: exact below 2 * SUB_BUCKETS, then
+* SUB_BUCKETS buckets per power of two.
+*/
+inline unsigned LatencyHistogram::bucketIndex(uint64_t value)
+{
+    if(value < 2 * SUB_BUCKETS)
+    {
+        return (unsigned)value;
+    }
+    unsigned msb = 63 - __builtin_clzll(value);
+    unsigned shift = msb - SUB_BUCKET_BITS;
+    return (shift + 1) * SUB_BUCKETS + (unsigned)((value >> shift) - SUB_BUCKETS);
+}
+
+/**
+* Returns the largest value that maps to the given bucket.
+*/
+inline uint64_t LatencyHistogram::bucketHighest(unsigned index)
+{
+    if(index < 2 * SUB_BUCKETS)
+    {
+        return index;
+    }
+    unsigned shift = index / SUB_BUCKETS - 1;
+    uint64_t lowest = (uint64_t)(index % SUB_BUCKETS + SUB_BUCKETS) << shift;
+    return lowest + ((uint64_t)1 << shift) - 1;
+}
+
+inline void LatencyHistogram::record(uint64_t nanos)
+{
+    counts_[bucketIndex(nanos)].fetch_add(1, std::memory_order_relaxed);
+    total_.fetch_add(1, std::memory_order_relaxed);
+    sum_.fetch_add(nanos, std::memory_order_relaxed);
+    uint64_t prev = max_.load(std::memory_order_relaxed);
+    while(nanos > prev && !max_.compare_exchange_weak(prev, nanos, std::memory_order_relaxed))
+    {
+    }
+}
+
+/**
+* Adds all of other's samples into this histogram.
+*/
+inline void LatencyHistogram::merge(const LatencyHistogram& other)
+{
+    for(unsigned i = 0; i < NUM_BUCKETS; ++i)
+    {
+        uint64_t c = other.counts_[i].load(std::memory_order_relaxed);
+        if(c != 0)
+        {
+            counts_[i].fetch_add(c, std::memory_order_relaxed);
+        }
+    }
+    total_.fetch_add(other.total_.load(std::memory_order_relaxed), std::memory_order_relaxed);
+    sum_.fetch_add(other.sum_.load(std::memory_order_relaxed), std::memory_order_relaxed);
+    uint64_t otherMax = other.max_.load(std::memory_order_relaxed);
+    uint64_t prev = max_.load(std::memory_order_relaxed);
+    while(otherMax > prev && !max_.compare_exchange_weak(prev, otherMax, std::memory_order_relaxed))
+    {
+    }
+}
+
+inline void LatencyHistogram::reset()
+{
+    for(unsigned i = 0; i < NUM_BUCKETS; ++i)
+    {
+        counts_[i].store(0, std::memory_order_relaxed);
+    }
+    total_.store(0, std::memory_order_relaxed);
+    sum_.store(0, std::memory_order_relaxed);
+    max_.store(0, std::memory_order_relaxed);
+}
+
+inline uint64_t LatencyHistogram::count() const
+{
+    return total_.load(std::memory_order_relaxed);
+}
+
+inline uint64_t LatencyHistogram::max() const
+{
+    return max_.load(std::memory_order_relaxed);
+}
+
+inline double LatencyHistogram::mean() const
+{
+    uint64_t n = count();
+    return n == 0 ? 0.0 : (double)sum_.load(std::memory_order_relaxed) / n;
+}
+
+/**
+* Returns the value at the given percentile (0-100), reported as the
+* highest value of its bucket but never more than the recorded max.
+*/
+inline uint64_t LatencyHistogram::percentile(double pct) const
+{
+    uint64_t n = count();
+    if(n == 0)
+    {
+        return 0;
+    }
+    uint64_t rank = (uint64_t)(pct / 100.0 * n + 0.5);
+    if(rank < 1) rank = 1;
+    if(rank > n) rank = n;
+
+    uint64_t seen = 0;
+    for(unsigned i = 0; i < NUM_BUCKETS; ++i)
+    {
+        seen += counts_[i].load(std::memory_order_relaxed);
+        if(seen >= rank)
+        {
+            return std::min(bucketHighest(i), max());
+        }
+    }
+    return max();
+}
+
+/**
+* Collects latency histograms per operation and per thread. Each thread
+* that records claims its own slot the first time it touches a recorder,
+* so recording is uncontended; readers merge the slots on export.
+* Past MAX_THREADS threads, late arrivals share the last slot, which is
+* still correct because the counters are atomic.
+*/
+class LatencyRecorder
+{
+public:
+    static const unsigned MAX_THREADS = 64;
+
+    LatencyRecorder();
+    ~LatencyRecorder();
+
+    LatencyHistogram& local(LatencyOp op);
+    void mergeInto(LatencyOp op, LatencyHistogram& out) const;
+    void reset();
+
+    void writeText(std::ostream& os) const;
+    void writeCsvHeader(std::ostream& os) const;
+    void writeCsv(std::ostream& os, const std::string& label) const;
+
+private:
+    struct Slot
+    {
+        LatencyHistogram hist[LAT_NUM_OPS];
+    };
+
+    LatencyRecorder(const LatencyRecorder&);
+    LatencyRecorder& operator=(const LatencyRecorder&);
+
+    Slot* claimSlot();
+
+    uint64_t id_;
+    std::atomic<unsigned> used_;
+    std::atomic<Slot*> slots_[MAX_THREADS];
+};
+
+inline LatencyRecorder::LatencyRecorder()
+    : used_(0)
+{
+    static std::atomic<uint64_t> nextId(1);
+    id_ = nextId.fetch_add(1);
+    for(unsigned i = 0; i < MAX_THREADS; ++i)
+    {
+        slots_[i].store(NULL);
+    }
+}
+
+inline LatencyRecorder::~LatencyRecorder()
+{
+    for(unsigned i = 0; i < MAX_THREADS; ++i)
+    {
+        delete slots_[i].load();
+    }
+}
+
+/**
+* Returns the calling thread's histogram for op. The thread remembers the
+* slot it claimed for the last few recorders it used.
+*/
+inline LatencyHistogram& LatencyRecorder::local(LatencyOp op)
+{
+    static const unsigned CACHE_SIZE = 4;
+    static thread_local std::pair<uint64_t, Slot*> cache[CACHE_SIZE];
+    static thread_local unsigned nextVictim = 0;
+
+    for(unsigned i = 0; i < CACHE_SIZE; ++i)
+    {
+        if(cache[i].first == id_)
+        {
+            return cache[i].second->hist[op];
+        }
+    }
+    Slot* slot = claimSlot();
+    cache[nextVictim] = std::make_pair(id_, slot);
+    nextVictim = (nextVictim + 1) % CACHE_SIZE;
+    return slot->hist[op];
+}
+
+inline LatencyRecorder::Slot* LatencyRecorder::claimSlot()
+{
+    unsigned index = used_.fetch_add(1);
+    if(index >= MAX_THREADS)
+    {
+        index = MAX_THREADS - 1;
+    }
+    Slot* slot = slots_[index].load();
+    if(slot == NULL)
+    {
+        Slot* fresh = new Slot;
+        if(slots_[index].compare_exchange_strong(slot, fresh))
+        {
+            slot = fresh;
+        }
+        else
+        {
+            delete fresh;
+        }
+    }
+    return slot;
+}
+
+/**
+* Merges every thread's histogram for op into out.
+*/
+inline void LatencyRecorder::mergeInto(LatencyOp op, LatencyHistogram& out) const
+{
+    for(unsigned i = 0; i < MAX_THREADS; ++i)
+    {
+        Slot* slot = slots_[i].load();
+        if(slot != NULL)
+        {
+            out.merge(slot->hist[op]);
+        }
+    }
+}
+
+inline void LatencyRecorder::reset()
+{
+    for(unsigned i = 0; i < MAX_THREADS; ++i)
+    {
+        Slot* slot = slots_[i].load();
+        if(slot != NULL)
+        {
+            for(unsigned op = 0; op < LAT_NUM_OPS; ++op)
+            {
+                slot->hist[op].reset();
+            }
+        }
+    }
+}
+
+/**
+* Writes a human-readable summary, one line per operation that has samples.
+*/
+inline void LatencyRecorder::writeText(std::ostream& os) const
+{
+    for(unsigned op = 0; op < LAT_NUM_OPS; ++op)
+    {
+        LatencyHistogram h;
+        mergeInto((LatencyOp)op, h);
+        if(h.count() == 0)
+        {
+            continue;
+        }
+        os << latencyOpName((LatencyOp)op) << ": n=" << h.count()
+           << " mean=" << (uint64_t)h.mean() << "ns"
+           << " p50=" << h.percentile(50) << "ns"
+           << " p99=" << h.percentile(99) << "ns"
+           << " p999=" << h.percentile(99.9) << "ns"
+           << " max=" << h.max() << "ns" << std::endl;
+    }
+}
+
+inline void LatencyRecorder::writeCsvHeader(std::ostream& os) const
+{
+    os << "label,op,count,mean_ns,p50_ns,p99_ns,p999_ns,max_ns" << std::endl;
+}
+
+/**
+* Writes one CSV row per operation. The label column lets periodic
+* snapshots be lined up against other timelines (e.g. rebalancing).
+*/
+inline void LatencyRecorder::writeCsv(std::ostream& os, const std::string& label) const
+{
+    for(unsigned op = 0; op < LAT_NUM_OPS; ++op)
+    {
+        LatencyHistogram h;
+        mergeInto((LatencyOp)op, h);
+        os << label << ',' << latencyOpName((LatencyOp)op) << ',' << h.count()
+           << ',' << (uint64_t)h.mean() << ',' << h.percentile(50)
+           << ',' << h.percentile(99) << ',' << h.percentile(99.9)
+           << ',' << h.max() << std::endl;
+    }
+}
+
+/**
+* Returns nanoseconds elapsed since start on the steady clock.
+*/
+inline uint64_t latencyNanosSince(std::chrono::steady_clock::time_point start)
+{
+    return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now() - start).count();
+}
+
+/**
+* An optional latency-recording layer over any of the tree containers.
+* Inserts, hinted or not, are timed in the tree's insertNear, removes in
+* its remove, each erase call in its eraseRange (one remove sample per
+* call, however many items it takes) and clears in clear, so calls made
+* through a base pointer are timed too; find, operator[] and iterator
+* increments are timed through the wrappers below. Tree must be one of
+* BinarySearchTree<Key, Value> or a class derived from it.
+*/
+template <typename Key, typename Value, class Tree>
+class LatencyTree : public Tree
+{
+public:
+    /**
+    * An iterator that times each increment into the recorder.
+    */
+    class iterator : public Tree::iterator
+    {
+    public:
+        iterator();
+        iterator(const typename Tree::iterator& it, LatencyRecorder* recorder);
+        iterator& operator++();
+
+    private:
+        LatencyRecorder* recorder_;
+    };
+
+    explicit LatencyTree(LatencyRecorder& recorder);
+
+    virtual void remove(const Key& key);
+    virtual void clear();
+
+    iterator begin() const;
+    iterator end() const;
+    iterator find(const Key& key) const;
+    Value& operator[](const Key& key);
+    Value const & operator[](const Key& key) const;
+
+    LatencyRecorder& recorder() const;
+
+protected:
+    virtual Node<Key, Value>* insertNear(Node<Key, Value>* finger, const std::pair<const Key, Value>& keyValuePair);
+    virtual void eraseRange(Node<Key, Value>* first, Node<Key, Value>* last);
+
+private:
+    LatencyRecorder* recorder_;
+};
+
+template <typename Key, typename Value, class Tree>
+LatencyTree<Key, Value, Tree>::iterator::iterator()
+    : Tree::iterator(), recorder_(NULL)
+{
+
+}
+
+template <typename Key, typename Value, class Tree>
+LatencyTree<Key, Value, Tree>::iterator::iterator(const typename Tree::iterator& it, LatencyRecorder* recorder)
+    : Tree::iterator(it), recorder_(recorder)
+{
+
+}
+
+template <typename Key, typename Value, class Tree>
+typename LatencyTree<Key, Value, Tree>::iterator&
+LatencyTree<Key, Value, Tree>::iterator::operator++()
+{
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    Tree::iterator::operator++();
+    recorder_->local(LAT_ITERATE).record(latencyNanosSince(start));
+    return *this;
+}
+
+template <typename Key, typename Value, class Tree>
+LatencyTree<Key, Value, Tree>::LatencyTree(LatencyRecorder& recorder)
+    : Tree(), recorder_(&recorder)
+{
+
+}
+
+template <typename Key, typename Value, class Tree>
+Node<Key, Value>* LatencyTree<Key, Value, Tree>::insertNear(Node<Key, Value>* finger,
+                                                      const std::pair<const Key, Value>& keyValuePair)
+{
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    Node<Key, Value>* node = Tree::insertNear(finger, keyValuePair);
+    recorder_->local(LAT_INSERT).record(latencyNanosSince(start));
+    return node;
+}
+
+template <typename Key, typename Value, class Tree>
+void LatencyTree<Key, Value, Tree>::remove(const Key& key)
+{
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    Tree::remove(key);
+    recorder_->local(LAT_REMOVE).record(latencyNanosSince(start));
+}
+
+template <typename Key, typename Value, class Tree>
+void LatencyTree<Key, Value, Tree>::eraseRange(Node<Key, Value>* first, Node<Key, Value>* last)
+{
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    Tree::eraseRange(first, last);
+    recorder_->local(LAT_REMOVE).record(latencyNanosSince(start));
+}
+
+template <typename Key, typename Value, class Tree>
+void LatencyTree<Key, Value, Tree>::clear()
+{
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    Tree::clear();
+    recorder_->local(LAT_CLEAR).record(latencyNanosSince(start));
+}
+
+template <typename Key, typename Value, class Tree>
+typename LatencyTree<Key, Value, Tree>::iterator
+LatencyTree<Key, Value, Tree>::begin() const
+{
+    return iterator(Tree::begin(), recorder_);
+}
+
+template <typename Key, typename Value, class Tree>
+typename LatencyTree<Key, Value, Tree>::iterator
+LatencyTree<Key, Value, Tree>::end() const
+{
+    return iterator(Tree::end(), recorder_);
+}
+
+template <typename Key, typename Value, class Tree>
+typename LatencyTree<Key, Value, Tree>::iterator
+LatencyTree<Key, Value, Tree>::find(const Key& key) const
+{
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    typename Tree::iterator it = Tree::find(key);
+    recorder_->local(LAT_FIND).record(latencyNanosSince(start));
+    return iterator(it, recorder_);
+}
+
+template <typename Key, typename Value, class Tree>
+Value& LatencyTree<Key, Value, Tree>::operator[](const Key& key)
+{
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    Value& value = Tree::operator[](key);
+    recorder_->local(LAT_FIND).record(latencyNanosSince(start));
+    return value;
+}
+
+template <typename Key, typename Value, class Tree>
+Value const & LatencyTree<Key, Value, Tree>::operator[](const Key& key) const
+{
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    Value const & value = Tree::operator[](key);
+    recorder_->local(LAT_FIND).record(latencyNanosSince(start));
+    return value;
+}
+
+template <typename Key, typename Value, class Tree>
+LatencyRecorder& LatencyTree<Key, Value, Tree>::recorder() const
+{
+    return *recorder_;
+}
+
+#endif
@@ -0,0 +1,688 @@
+#ifndef PATHAVL_H
+#define PATHAVL_H
+
+#include <iostream>
+#include <exception>
+#include <cstdlib>
+#include <cstdint>
+#include <stdexcept>
+#include <utility>
+
+/**
+* A node for PathAVLTree: no parent pointer and no virtual functions,
+* just the item, two child links and the balance. For <int,int> that is
+* 32 bytes against 48 for an AVLNode.
+*/
+template <typename Key, typename Value>
+struct PathAVLNode
+{
+    PathAVLNode(const Key& key, const Value& value);
+
+    std::pair<const Key, Value> item;
+    PathAVLNode<Key, Value>* child[2];     // [0] left, [1] right
+    int8_t balance;                        // right height - left height
+};
+
+template<class Key, class Value>
+PathAVLNode<Key, Value>::PathAVLNode(const Key& key, const Value& value)
+    : item(key, value), balance(0)
+{
+    child[0] = NULL;
+    child[1] = NULL;
+}
+
+/**
+* An AVL tree whose nodes do not store parent pointers. Updates record
+* the descent path in a fixed-size array and retrace it to rebalance, so
+* rotations write only the links that actually change. Iterators carry
+* the stack of ancestors whose left subtree they are in.
+*
+* MAX_HEIGHT bounds both; an AVL tree of height 64 would need more than
+* 2^44 nodes.
+*/
+template <typename Key, typename Value>
+class PathAVLTree
+{
+public:
+    static const int MAX_HEIGHT = 64;
+    typedef PathAVLNode<Key, Value> NodeType;
+
+    PathAVLTree();
+    PathAVLTree(const PathAVLTree<Key, Value>& other);
+    PathAVLTree(PathAVLTree<Key, Value>&& other);
+    virtual ~PathAVLTree();
+    PathAVLTree<Key, Value>& operator=(const PathAVLTree<Key, Value>& other);
+    PathAVLTree<Key, Value>& operator=(PathAVLTree<Key, Value>&& other);
+    void swap(PathAVLTree<Key, Value>& other);
+    virtual void insert(const std::pair<const Key, Value>& new_item);
+    virtual void remove(const Key& key);
+    void clear();
+    bool isBalanced() const;
+    void print() const;
+    bool empty() const;
+    size_t size() const;
+
+    /**
+    * An in-order iterator over a fixed-capacity ancestor stack. The top
+    * of the stack is the current node; below it are the ancestors still
+    * waiting to be visited.
+    */
+    class iterator
+    {
+    public:
+        iterator();
+
+        std::pair<const Key,Value>& operator*() const;
+        std::pair<const Key,Value>* operator->() const;
+
+        bool operator==(const iterator& rhs) const;
+        bool operator!=(const iterator& rhs) const;
+
+        iterator& operator++();
+
+    protected:
+        friend class PathAVLTree<Key, Value>;
+        void push(NodeType* node);
+        void pushLeftSpine(NodeType* node);
+        NodeType* current() const;
+
+        NodeType* stack_[MAX_HEIGHT];
+        int depth_;
+    };
+
+    iterator begin() const;
+    iterator end() const;
+    iterator find(const Key& key) const;
+    Value& operator[](const Key& key);
+    Value const & operator[](const Key& key) const;
+
+protected:
+    NodeType* internalFind(const Key& key) const;
+    void relink(NodeType** path, int8_t* dirs, int level, NodeType* subtree);
+    static NodeType* rotate(NodeType* node, int dir);
+    void insertFix(NodeType** path, int8_t* dirs, int top);
+    void removeFix(NodeType** path, int8_t* dirs, int top);
+    void exactClear(NodeType* node);
+    static NodeType* copySubtree(const NodeType* node);
+    int calculateHeightIfBalanced(NodeType* node) const;
+
+    NodeType* root_;
+    size_t size_;
+};
+
+/*
+---------------------------------------------------------
+Begin implementations for the PathAVLTree::iterator class.
+---------------------------------------------------------
+*/
+
+template<class Key, class Value>
+PathAVLTree<Key, Value>::iterator::iterator()
+    : depth_(0)
+{
+
+}
+
+template<class Key, class Value>
+void PathAVLTree<Key, Value>::iterator::push(NodeType* node)
+{
+    if(depth_ == MAX_HEIGHT)
+    {
+        throw std::length_error("PathAVLTree iterator stack overflow");
+    }
+    stack_[depth_++] = node;
+}
+
+template<class Key, class Value>
+void PathAVLTree<Key, Value>::iterator::pushLeftSpine(NodeType* node)
+{
+    while(node != NULL)
+    {
+        push(node);
+        node = node->child[0];
+    }
+}
+
+template<class Key, class Value>
+typename PathAVLTree<Key, Value>::NodeType*
+PathAVLTree<Key, Value>::iterator::current() const
+{
+    return depth_ == 0 ? NULL : stack_[depth_ - 1];
+}
+
+template<class Key, class Value>
+std::pair<const Key,Value>&
+PathAVLTree<Key, Value>::iterator::operator*() const
+{
+    return current()->item;
+}
+
+template<class Key, class Value>
+std::pair<const Key,Value>*
+PathAVLTree<Key, Value>::iterator::operator->() const
+{
+    return &(current()->item);
+}
+
+template<class Key, class Value>
+bool PathAVLTree<Key, Value>::iterator::operator==(const iterator& rhs) const
+{
+    return current() == rhs.current();
+}
+
+template<class Key, class Value>
+bool PathAVLTree<Key, Value>::iterator::operator!=(const iterator& rhs) const
+{
+    return current() != rhs.current();
+}
+
+/**
+* Pops the current node and descends the left spine of its right subtree;
+* if there is none, the next ancestor on the stack is the successor.
+*/
+template<class Key, class Value>
+typename PathAVLTree<Key, Value>::iterator&
+PathAVLTree<Key, Value>::iterator::operator++()
+{
+    NodeType* node = stack_[--depth_];
+    pushLeftSpine(node->child[1]);
+    return *this;
+}
+
+/*
+-----------------------------------------------
+Begin implementations for the PathAVLTree class.
+-----------------------------------------------
+*/
+
+template<class Key, class Value>
+PathAVLTree<Key, Value>::PathAVLTree()
+    : root_(NULL), size_(0)
+{
+
+}
+
+/**
+* Copies every node, balance included. The recursion is as deep as the
+* tree, which is at most MAX_HEIGHT.
+*/
+template<class Key, class Value>
+PathAVLTree<Key, Value>::PathAVLTree(const PathAVLTree<Key, Value>& other)
+    : root_(copySubtree(other.root_)), size_(other.size_)
+{
+
+}
+
+template<class Key, class Value>
+PathAVLTree<Key, Value>::PathAVLTree(PathAVLTree<Key, Value>&& other)
+    : root_(other.root_), size_(other.size_)
+{
+    other.root_ = NULL;
+    other.size_ = 0;
+}
+
+template<class Key, class Value>
+PathAVLTree<Key, Value>::~PathAVLTree()
+{
+    clear();
+}
+
+template<class Key, class Value>
+PathAVLTree<Key, Value>& PathAVLTree<Key, Value>::operator=(const PathAVLTree<Key, Value>& other)
+{
+    if(this != &other)
+    {
+        PathAVLTree<Key, Value> copy(other);
+        swap(copy);
+    }
+    return *this;
+}
+
+template<class Key, class Value>
+PathAVLTree<Key, Value>& PathAVLTree<Key, Value>::operator=(PathAVLTree<Key, Value>&& other)
+{
+    if(this != &other)
+    {
+        clear();
+        swap(other);
+    }
+    return *this;
+}
+
+template<class Key, class Value>
+void PathAVLTree<Key, Value>::swap(PathAVLTree<Key, Value>& other)
+{
+    std::swap(root_, other.root_);
+    std::swap(size_, other.size_);
+}
+
+/**
+* Returns a copy of the subtree rooted at node; if copying an item
+* throws, the nodes copied so far are freed.
+*/
+template<class Key, class Value>
+typename PathAVLTree<Key, Value>::NodeType* PathAVLTree<Key, Value>::copySubtree(const NodeType* node)
+{
+    if(node == NULL)
+    {
+        return NULL;
+    }
+    NodeType* copy = new NodeType(node->item.first, node->item.second);
+    copy->balance = node->balance;
+    try
+    {
+        copy->child[0] = copySubtree(node->child[0]);
+        copy->child[1] = copySubtree(node->child[1]);
+    }
+    catch(...)
+    {
+        // frees copy and whatever was copied below it
+        PathAVLTree<Key, Value> partial;
+        partial.root_ = copy;
+        throw;
+    }
+    return copy;
+}
+
+template<class Key, class Value>
+bool PathAVLTree<Key, Value>::empty() const
+{
+    return root_ == NULL;
+}
+
+template<class Key, class Value>
+size_t PathAVLTree<Key, Value>::size() const
+{
+    return size_;
+}
+
+template<class Key, class Value>
+void PathAVLTree<Key, Value>::clear()
+{
+    exactClear(root_);
+    root_ = NULL;
+    size_ = 0;
+}
+
+template<class Key, class Value>
+void PathAVLTree<Key, Value>::exactClear(NodeType* node)
+{
+    if(node == NULL)
+    {
+        return;
+    }
+    exactClear(node->child[0]);
+    exactClear(node->child[1]);
+    delete node;
+}
+
+/**
+* Prints the items in key order.
+*/
+template<class Key, class Value>
+void PathAVLTree<Key, Value>::print() const
+{
+    for(iterator it = begin(); it != end(); ++it)
+    {
+        std::cout << '(' << it->first << ", " << it->second << ") ";
+    }
+    std::cout << "\n";
+}
+
+template<class Key, class Value>
+typename PathAVLTree<Key, Value>::iterator
+PathAVLTree<Key, Value>::begin() const
+{
+    iterator it;
+    it.pushLeftSpine(root_);
+    return it;
+}
+
+template<class Key, class Value>
+typename PathAVLTree<Key, Value>::iterator
+PathAVLTree<Key, Value>::end() const
+{
+    return iterator();
+}
+
+/**
+* Builds the iterator's stack during the descent: every node we leave
+* to the left is a pending successor.
+*/
+template<class Key, class Value>
+typename PathAVLTree<Key, Value>::iterator
+PathAVLTree<Key, Value>::find(const Key& key) const
+{
+    iterator it;
+    NodeType* curr = root_;
+    while(curr != NULL)
+    {
+        if(key < curr->item.first)
+        {
+            it.push(curr);
+            curr = curr->child[0];
+        }
+        else if(key > curr->item.first)
+        {
+            curr = curr->child[1];
+        }
+        else
+        {
+            it.push(curr);
+            return it;
+        }
+    }
+    return end();
+}
+
+template<class Key, class Value>
+Value& PathAVLTree<Key, Value>::operator[](const Key& key)
+{
+    NodeType* node = internalFind(key);
+    if(node == NULL) throw std::out_of_range("Invalid key");
+    return node->item.second;
+}
+
+template<class Key, class Value>
+Value const & PathAVLTree<Key, Value>::operator[](const Key& key) const
+{
+    NodeType* node = internalFind(key);
+    if(node == NULL) throw std::out_of_range("Invalid key");
+    return node->item.second;
+}
+
+template<class Key, class Value>
+typename PathAVLTree<Key, Value>::NodeType*
+PathAVLTree<Key, Value>::internalFind(const Key& key) const
+{
+    NodeType* curr = root_;
+    while(curr != NULL)
+    {
+        if(key < curr->item.first)
+        {
+            curr = curr->child[0];
+        }
+        else if(key > curr->item.first)
+        {
+            curr = curr->child[1];
+        }
+        else
+        {
+            return curr;
+        }
+    }
+    return NULL;
+}
+
+/**
+* Points the link that held path[level] (its parent's child, or root_)
+* at subtree.
+*/
+template<class Key, class Value>
+void PathAVLTree<Key, Value>::relink(NodeType** path, int8_t* dirs, int level, NodeType* subtree)
+{
+    if(level == 0)
+    {
+        root_ = subtree;
+    }
+    else
+    {
+        path[level - 1]->child[dirs[level - 1]] = subtree;
+    }
+    path[level] = subtree;
+}
+
+/**
+* Rotates node's child on side dir up and returns it; dir 1 is a left
+* rotation, dir 0 a right rotation.
+*/
+template<class Key, class Value>
+typename PathAVLTree<Key, Value>::NodeType*
+PathAVLTree<Key, Value>::rotate(NodeType* node, int dir)
+{
+    NodeType* pivot = node->child[dir];
+    node->child[dir] = pivot->child[1 - dir];
+    pivot->child[1 - dir] = node;
+    return pivot;
+}
+
+template<class Key, class Value>
+void PathAVLTree<Key, Value>::insert(const std::pair<const Key, Value>& new_item)
+{
+    NodeType* path[MAX_HEIGHT];
+    int8_t dirs[MAX_HEIGHT];
+    int top = 0;
+
+    NodeType* curr = root_;
+    while(curr != NULL)
+    {
+        int8_t dir;
+        if(new_item.first < curr->item.first)
+        {
+            dir = 0;
+        }
+        else if(new_item.first > curr->item.first)
+        {
+            dir = 1;
+        }
+        else
+        {
+            curr->item.second = new_item.second;
+            return;
+        }
+        if(top == MAX_HEIGHT - 1)
+        {
+            throw std::length_error("PathAVLTree is too tall");
+        }
+        path[top] = curr;
+        dirs[top++] = dir;
+        curr = curr->child[dir];
+    }
+
+    NodeType* node = new NodeType(new_item.first, new_item.second);
+    ++size_;
+    if(top == 0)
+    {
+        root_ = node;
+        return;
+    }
+    path[top - 1]->child[dirs[top - 1]] = node;
+    insertFix(path, dirs, top);
+}
+
+/**
+* Retraces the recorded path after a leaf was added below path[top - 1];
+* the same cases as AVLTree::insertFix.
+*/
+template<class Key, class Value>
+void PathAVLTree<Key, Value>::insertFix(NodeType** path, int8_t* dirs, int top)
+{
+    for(int level = top - 1; level >= 0; --level)
+    {
+        NodeType* parent = path[level];
+        int dir = dirs[level];
+        int8_t diff = dir ? 1 : -1;
+        int balance = parent->balance + diff;
+        if(balance == 0)
+        {
+            parent->balance = 0;
+            return;
+        }
+        if(balance == diff)
+        {
+            parent->balance = diff;
+            continue;
+        }
+
+        NodeType* node = parent->child[dir];
+        if(node->balance == diff)
+        {
+            relink(path, dirs, level, rotate(parent, dir));
+            parent->balance = 0;
+            node->balance = 0;
+        }
+        else
+        {
+            NodeType* grandChild = node->child[1 - dir];
+            int8_t gb = grandChild->balance;
+            parent->child[dir] = rotate(node, 1 - dir);
+            relink(path, dirs, level, rotate(parent, dir));
+            node->balance = (gb == -diff) ? diff : 0;
+            parent->balance = (gb == diff) ? -diff : 0;
+            grandChild->balance = 0;
+        }
+        return;
+    }
+}
+
+/**
+* Removes key. A node with two children is replaced by its predecessor,
+* which is unlinked from its own spot first; the path then retraces from
+* the predecessor's old parent.
+*/
+template<class Key, class Value>
+void PathAVLTree<Key, Value>::remove(const Key& key)
+{
+    NodeType* path[MAX_HEIGHT];
+    int8_t dirs[MAX_HEIGHT];
+    int top = 0;
+
+    NodeType* curr = root_;
+    while(curr != NULL)
+    {
+        int8_t dir;
+        if(key < curr->item.first)
+        {
+            dir = 0;
+        }
+        else if(key > curr->item.first)
+        {
+            dir = 1;
+        }
+        else
+        {
+            break;
+        }
+        path[top] = curr;
+        dirs[top++] = dir;
+        curr = curr->child[dir];
+    }
+    if(curr == NULL)
+    {
+        return;
+    }
+
+    NodeType* node = curr;
+    int nodeLevel = top;
+    if(node->child[0] != NULL && node->child[1] != NULL)
+    {
+        // walk to the predecessor, recording the path
+        path[top] = node;
+        dirs[top++] = 0;
+        NodeType* pred = node->child[0];
+        while(pred->child[1] != NULL)
+        {
+            path[top] = pred;
+            dirs[top++] = 1;
+            pred = pred->child[1];
+        }
+        // unlink the predecessor, then let it take node's place
+        path[top - 1]->child[dirs[top - 1]] = pred->child[0];
+        pred->child[0] = node->child[0];
+        pred->child[1] = node->child[1];
+        pred->balance = node->balance;
+        relink(path, dirs, nodeLevel, pred);
+    }
+    else
+    {
+        NodeType* child = (node->child[0] != NULL) ? node->child[0] : node->child[1];
+        if(top == 0)
+        {
+            root_ = child;
+        }
+        else
+        {
+            path[top - 1]->child[dirs[top - 1]] = child;
+        }
+    }
+    delete node;
+    --size_;
+    removeFix(path, dirs, top);
+}
+
+/**
+* Retraces the path after the subtree under path[top - 1] on side
+* dirs[top - 1] lost a level; the same cases as AVLTree::removeFix.
+*/
+template<class Key, class Value>
+void PathAVLTree<Key, Value>::removeFix(NodeType** path, int8_t* dirs, int top)
+{
+    for(int level = top - 1; level >= 0; --level)
+    {
+        NodeType* node = path[level];
+        int dir = dirs[level];
+        int8_t diff = dir ? -1 : 1;
+        int balance = node->balance + diff;
+        if(balance == diff)
+        {
+            node->balance = diff;
+            return;
+        }
+        if(balance == 0)
+        {
+            node->balance = 0;
+            continue;
+        }
+
+        // off by two on the side opposite dir
+        int tall = 1 - dir;
+        NodeType* child = node->child[tall];
+        int8_t cb = child->balance;
+        if(cb == -diff)
+        {
+            NodeType* grandChild = child->child[dir];
+            int8_t gb = grandChild->balance;
+            node->child[tall] = rotate(child, dir);
+            relink(path, dirs, level, rotate(node, tall));
+            node->balance = (gb == diff) ? -diff : 0;
+            child->balance = (gb == -diff) ? diff : 0;
+            grandChild->balance = 0;
+        }
+        else
+        {
+            relink(path, dirs, level, rotate(node, tall));
+            if(cb == 0)
+            {
+                node->balance = diff;
+                child->balance = -diff;
+                return;
+            }
+            node->balance = 0;
+            child->balance = 0;
+        }
+    }
+}
+
+template<class Key, class Value>
+bool PathAVLTree<Key, Value>::isBalanced() const
+{
+    return calculateHeightIfBalanced(root_) != -1;
+}
+
+template<class Key, class Value>
+int PathAVLTree<Key, Value>::calculateHeightIfBalanced(NodeType* node) const
+{
+    if(node == NULL)
+    {
+        return 0;
+    }
+    int leftHeight = calculateHeightIfBalanced(node->child[0]);
+    int rightHeight = calculateHeightIfBalanced(node->child[1]);
+    if(leftHeight == -1 || rightHeight == -1 || leftHeight - rightHeight > 1 || rightHeight - leftHeight > 1)
+    {
+        return -1;
+    }
+    return (leftHeight > rightHeight ? leftHeight : rightHeight) + 1;
+}
+
+#endif
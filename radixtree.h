@@ -0,0 +1,680 @@
+#ifndef RADIXTREE_H
+#define RADIXTREE_H
+
+#include <iostream>
+#include <exception>
+#include <cstdlib>
+#include <cstdint>
+#include <cstring>
+#include <new>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <utility>
+
+/**
+* An ordered map from std::string keys to values, stored as a radix tree
+* (a trie with single-child chains collapsed). Every node holds only the
+* part of the key beyond its parent's, so shared prefixes are stored
+* once, and a lookup looks at each byte of the key at most once instead
+* of comparing whole strings at every level as BinarySearchTree does.
+*
+* Iteration is in std::string order. Because keys are not stored whole,
+* an iterator rebuilds the current key in its own buffer: operator*
+* yields a pair of references (key, value) that stay valid until the
+* iterator moves.
+*/
+template <typename Value>
+class RadixTree
+{
+public:
+    RadixTree();
+    RadixTree(const RadixTree<Value>& other);
+    RadixTree(RadixTree<Value>&& other);
+    virtual ~RadixTree();
+    RadixTree<Value>& operator=(const RadixTree<Value>& other);
+    RadixTree<Value>& operator=(RadixTree<Value>&& other);
+    void swap(RadixTree<Value>& other);
+    void insert(const std::pair<const std::string, Value>& keyValuePair);
+    void remove(const std::string& key);
+    void clear();
+    bool empty() const;
+    size_t size() const;
+    void print() const;
+
+protected:
+    struct RadixNode;
+
+public:
+    typedef std::pair<const std::string&, Value&> reference;
+
+    /**
+    * Pre-order iterator over the keys that hold values.
+    */
+    class iterator
+    {
+    public:
+        struct pointer
+        {
+            reference ref;
+            const reference* operator->() const { return &ref; }
+        };
+
+        iterator();
+
+        reference operator*() const;
+        pointer operator->() const;
+
+        bool operator==(const iterator& rhs) const;
+        bool operator!=(const iterator& rhs) const;
+
+        iterator& operator++();
+
+    protected:
+        friend class RadixTree<Value>;
+        iterator(RadixNode* node, const std::string& key);
+        void advance();
+
+        RadixNode* node_;
+        std::string key_;
+    };
+
+    iterator begin() const;
+    iterator end() const;
+    iterator find(const std::string& key) const;
+    Value& operator[](const std::string& key);
+    Value const & operator[](const std::string& key) const;
+
+protected:
+    /**
+    * A node is one allocation: this header followed by the label bytes.
+    * The children block holds childCount pointers followed by the first
+    * label byte of each child, kept sorted so lookups scan bytes only.
+    */
+    struct RadixNode
+    {
+        RadixNode* parent;
+        RadixNode** children;
+        uint32_t labelSize;
+        uint16_t childCount;
+        bool terminal;
+        typename std::aligned_storage<sizeof(Value), alignof(Value)>::type storage;
+
+        char* label() { return reinterpret_cast<char*>(this + 1); }
+        unsigned char* firstBytes() { return reinterpret_cast<unsigned char*>(children + childCount); }
+        Value& value() { return *reinterpret_cast<Value*>(&storage); }
+    };
+
+    static RadixNode* makeNode(const char* label, size_t size, RadixNode* parent);
+    static void destroyNode(RadixNode* node);
+    static int childIndex(RadixNode* node, unsigned char first);
+    static void insertChild(RadixNode* node, RadixNode* child);
+    static void removeChildAt(RadixNode* node, int index);
+    static void setValue(RadixNode* node, const Value& value);
+    static void clearValue(RadixNode* node);
+    RadixNode* internalFind(const std::string& key) const;
+    void mergeWithChild(RadixNode* node);
+    static void exactClear(RadixNode* node);
+    static RadixNode* copySubtree(RadixNode* node, RadixNode* parent);
+
+    RadixNode* root_;
+    size_t size_;
+};
+
+/*
+------------------------------------------------
+Begin implementations for the RadixTree::iterator.
+------------------------------------------------
+*/
+
+template<typename Value>
+RadixTree<Value>::iterator::iterator()
+    : node_(NULL)
+{
+
+}
+
+template<typename Value>
+RadixTree<Value>::iterator::iterator(RadixNode* node, const std::string& key)
+    : node_(node), key_(key)
+{
+
+}
+
+template<typename Value>
+typename RadixTree<Value>::reference
+RadixTree<Value>::iterator::operator*() const
+{
+    return reference(key_, node_->value());
+}
+
+template<typename Value>
+typename RadixTree<Value>::iterator::pointer
+RadixTree<Value>::iterator::operator->() const
+{
+    pointer p = { **this };
+    return p;
+}
+
+template<typename Value>
+bool RadixTree<Value>::iterator::operator==(const iterator& rhs) const
+{
+    return node_ == rhs.node_;
+}
+
+template<typename Value>
+bool RadixTree<Value>::iterator::operator!=(const iterator& rhs) const
+{
+    return node_ != rhs.node_;
+}
+
+template<typename Value>
+typename RadixTree<Value>::iterator&
+RadixTree<Value>::iterator::operator++()
+{
+    advance();
+    return *this;
+}
+
+/**
+* Moves to the next node in pre-order that holds a value, keeping key_
+* equal to the concatenated labels from the root.
+*/
+template<typename Value>
+void RadixTree<Value>::iterator::advance()
+{
+    do
+    {
+        if(node_->childCount > 0)
+        {
+            node_ = node_->children[0];
+            key_.append(node_->label(), node_->labelSize);
+            continue;
+        }
+        // climb until some ancestor has a next child
+        while(true)
+        {
+            RadixNode* parent = node_->parent;
+            key_.resize(key_.size() - node_->labelSize);
+            if(parent == NULL)
+            {
+                node_ = NULL;
+                return;
+            }
+            int index = childIndex(parent, (unsigned char)node_->label()[0]);
+            if(index + 1 < parent->childCount)
+            {
+                node_ = parent->children[index + 1];
+                key_.append(node_->label(), node_->labelSize);
+                break;
+            }
+            node_ = parent;
+        }
+    } while(!node_->terminal);
+}
+
+/*
+-----------------------------------------------
+Begin implementations for the RadixTree class.
+-----------------------------------------------
+*/
+
+template<typename Value>
+RadixTree<Value>::RadixTree()
+    : root_(makeNode("", 0, NULL)), size_(0)
+{
+
+}
+
+/**
+* Copies every node, label and children block included.
+*/
+template<typename Value>
+RadixTree<Value>::RadixTree(const RadixTree<Value>& other)
+    : root_(copySubtree(other.root_, NULL)), size_(other.size_)
+{
+
+}
+
+/**
+* Takes other's nodes and leaves it an empty root of its own, since
+* every operation expects root_ to be there.
+*/
+template<typename Value>
+RadixTree<Value>::RadixTree(RadixTree<Value>&& other)
+    : root_(makeNode("", 0, NULL)), size_(0)
+{
+    swap(other);
+}
+
+template<typename Value>
+RadixTree<Value>::~RadixTree()
+{
+    exactClear(root_);
+}
+
+template<typename Value>
+RadixTree<Value>& RadixTree<Value>::operator=(const RadixTree<Value>& other)
+{
+    if(this != &other)
+    {
+        RadixTree<Value> copy(other);
+        swap(copy);
+    }
+    return *this;
+}
+
+template<typename Value>
+RadixTree<Value>& RadixTree<Value>::operator=(RadixTree<Value>&& other)
+{
+    if(this != &other)
+    {
+        clear();
+        swap(other);
+    }
+    return *this;
+}
+
+template<typename Value>
+void RadixTree<Value>::swap(RadixTree<Value>& other)
+{
+    std::swap(root_, other.root_);
+    std::swap(size_, other.size_);
+}
+
+/**
+* Returns a copy of the subtree rooted at node, hung under parent; if
+* copying a value or allocating throws, the nodes copied so far are
+* freed.
+*/
+template<typename Value>
+typename RadixTree<Value>::RadixNode*
+RadixTree<Value>::copySubtree(RadixNode* node, RadixNode* parent)
+{
+    RadixNode* copy = makeNode(node->label(), node->labelSize, parent);
+    try
+    {
+        if(node->terminal)
+        {
+            setValue(copy, node->value());
+        }
+        if(node->childCount > 0)
+        {
+            copy->children = static_cast<RadixNode**>(std::malloc(node->childCount * (sizeof(RadixNode*) + 1)));
+            if(copy->children == NULL)
+            {
+                throw std::bad_alloc();
+            }
+            // childCount counts the children copied so far, so that a
+            // throw below frees exactly those
+            for(uint16_t i = 0; i < node->childCount; ++i)
+            {
+                copy->children[i] = copySubtree(node->children[i], copy);
+                copy->childCount = (uint16_t)(i + 1);
+            }
+            std::memcpy(copy->firstBytes(), node->firstBytes(), node->childCount);
+        }
+    }
+    catch(...)
+    {
+        exactClear(copy);
+        throw;
+    }
+    return copy;
+}
+
+template<typename Value>
+bool RadixTree<Value>::empty() const
+{
+    return size_ == 0;
+}
+
+template<typename Value>
+size_t RadixTree<Value>::size() const
+{
+    return size_;
+}
+
+template<typename Value>
+void RadixTree<Value>::clear()
+{
+    exactClear(root_);
+    root_ = makeNode("", 0, NULL);
+    size_ = 0;
+}
+
+template<typename Value>
+void RadixTree<Value>::exactClear(RadixNode* node)
+{
+    for(uint16_t i = 0; i < node->childCount; ++i)
+    {
+        exactClear(node->children[i]);
+    }
+    destroyNode(node);
+}
+
+template<typename Value>
+void RadixTree<Value>::print() const
+{
+    for(iterator it = begin(); it != end(); ++it)
+    {
+        std::cout << '(' << it->first << ", " << it->second << ") ";
+    }
+    std::cout << "\n";
+}
+
+template<typename Value>
+typename RadixTree<Value>::iterator
+RadixTree<Value>::begin() const
+{
+    iterator it(root_, std::string());
+    if(!root_->terminal)
+    {
+        it.advance();
+    }
+    return it;
+}
+
+template<typename Value>
+typename RadixTree<Value>::iterator
+RadixTree<Value>::end() const
+{
+    return iterator();
+}
+
+template<typename Value>
+typename RadixTree<Value>::iterator
+RadixTree<Value>::find(const std::string& key) const
+{
+    RadixNode* node = internalFind(key);
+    if(node == NULL)
+    {
+        return end();
+    }
+    return iterator(node, key);
+}
+
+template<typename Value>
+Value& RadixTree<Value>::operator[](const std::string& key)
+{
+    RadixNode* node = internalFind(key);
+    if(node == NULL) throw std::out_of_range("Invalid key");
+    return node->value();
+}
+
+template<typename Value>
+Value const & RadixTree<Value>::operator[](const std::string& key) const
+{
+    RadixNode* node = internalFind(key);
+    if(node == NULL) throw std::out_of_range("Invalid key");
+    return node->value();
+}
+
+/**
+* Follows key down the tree; each step picks a child by one byte and
+* then checks only that child's label against the rest of the key.
+*/
+template<typename Value>
+typename RadixTree<Value>::RadixNode*
+RadixTree<Value>::internalFind(const std::string& key) const
+{
+    RadixNode* node = root_;
+    size_t pos = 0;
+    while(pos < key.size())
+    {
+        int index = childIndex(node, (unsigned char)key[pos]);
+        if(index < 0)
+        {
+            return NULL;
+        }
+        node = node->children[index];
+        if(node->labelSize > key.size() - pos ||
+           std::memcmp(node->label(), key.data() + pos, node->labelSize) != 0)
+        {
+            return NULL;
+        }
+        pos += node->labelSize;
+    }
+    return node->terminal ? node : NULL;
+}
+
+template<typename Value>
+void RadixTree<Value>::insert(const std::pair<const std::string, Value>& keyValuePair)
+{
+    const std::string& key = keyValuePair.first;
+    RadixNode* node = root_;
+    size_t pos = 0;
+    while(pos < key.size())
+    {
+        int index = childIndex(node, (unsigned char)key[pos]);
+        if(index < 0)
+        {
+            RadixNode* leaf = makeNode(key.data() + pos, key.size() - pos, node);
+            insertChild(node, leaf);
+            node = leaf;
+            break;
+        }
+
+        RadixNode* child = node->children[index];
+        size_t common = 1;
+        size_t limit = std::min<size_t>(child->labelSize, key.size() - pos);
+        while(common < limit && child->label()[common] == key[pos + common])
+        {
+            ++common;
+        }
+        if(common < child->labelSize)
+        {
+            // split child: a new node takes the shared part of the label
+            RadixNode* mid = makeNode(child->label(), common, node);
+            node->children[index] = mid;
+            std::memmove(child->label(), child->label() + common, child->labelSize - common);
+            child->labelSize -= (uint32_t)common;
+            child->parent = mid;
+            insertChild(mid, child);
+            child = mid;
+        }
+        node = child;
+        pos += common;
+    }
+
+    if(!node->terminal)
+    {
+        ++size_;
+    }
+    setValue(node, keyValuePair.second);
+}
+
+/**
+* Removes key, then collapses any node left with no value and a single
+* child so that the tree stays fully compressed.
+*/
+template<typename Value>
+void RadixTree<Value>::remove(const std::string& key)
+{
+    RadixNode* node = internalFind(key);
+    if(node == NULL)
+    {
+        return;
+    }
+    clearValue(node);
+    --size_;
+    if(node == root_)
+    {
+        return;
+    }
+
+    if(node->childCount == 0)
+    {
+        RadixNode* parent = node->parent;
+        removeChildAt(parent, childIndex(parent, (unsigned char)node->label()[0]));
+        destroyNode(node);
+        if(parent != root_ && !parent->terminal && parent->childCount == 1)
+        {
+            mergeWithChild(parent);
+        }
+    }
+    else if(node->childCount == 1)
+    {
+        mergeWithChild(node);
+    }
+}
+
+/**
+* Replaces node (valueless, with one child) by a copy of its child whose
+* label is the two labels joined.
+*/
+template<typename Value>
+void RadixTree<Value>::mergeWithChild(RadixNode* node)
+{
+    RadixNode* child = node->children[0];
+    RadixNode* parent = node->parent;
+    std::string label(node->label(), node->labelSize);
+    label.append(child->label(), child->labelSize);
+    RadixNode* merged = makeNode(label.data(), label.size(), parent);
+
+    // take over the child's value and children
+    if(child->terminal)
+    {
+        setValue(merged, child->value());
+    }
+    merged->children = child->children;
+    merged->childCount = child->childCount;
+    child->children = NULL;
+    child->childCount = 0;
+    for(uint16_t i = 0; i < merged->childCount; ++i)
+    {
+        merged->children[i]->parent = merged;
+    }
+
+    parent->children[childIndex(parent, (unsigned char)node->label()[0])] = merged;
+    destroyNode(child);
+    destroyNode(node);
+}
+
+template<typename Value>
+typename RadixTree<Value>::RadixNode*
+RadixTree<Value>::makeNode(const char* label, size_t size, RadixNode* parent)
+{
+    void* raw = ::operator new(sizeof(RadixNode) + size);
+    RadixNode* node = static_cast<RadixNode*>(raw);
+    node->parent = parent;
+    node->children = NULL;
+    node->labelSize = (uint32_t)size;
+    node->childCount = 0;
+    node->terminal = false;
+    std::memcpy(node->label(), label, size);
+    return node;
+}
+
+template<typename Value>
+void RadixTree<Value>::destroyNode(RadixNode* node)
+{
+    clearValue(node);
+    std::free(node->children);
+    ::operator delete(node);
+}
+
+template<typename Value>
+void RadixTree<Value>::setValue(RadixNode* node, const Value& value)
+{
+    if(node->terminal)
+    {
+        node->value() = value;
+    }
+    else
+    {
+        new (&node->storage) Value(value);
+        node->terminal = true;
+    }
+}
+
+template<typename Value>
+void RadixTree<Value>::clearValue(RadixNode* node)
+{
+    if(node->terminal)
+    {
+        node->value().~Value();
+        node->terminal = false;
+    }
+}
+
+/**
+* Returns the index of the child whose label starts with first, or -1.
+*/
+template<typename Value>
+int RadixTree<Value>::childIndex(RadixNode* node, unsigned char first)
+{
+    if(node->childCount == 0)
+    {
+        return -1;
+    }
+    const void* hit = std::memchr(node->firstBytes(), first, node->childCount);
+    return hit == NULL ? -1 : (int)(static_cast<const unsigned char*>(hit) - node->firstBytes());
+}
+
+/**
+* Adds child in first-byte order, growing the children block by one.
+*/
+template<typename Value>
+void RadixTree<Value>::insertChild(RadixNode* node, RadixNode* child)
+{
+    uint16_t count = node->childCount;
+    unsigned char first = (unsigned char)child->label()[0];
+    unsigned char* oldBytes = node->firstBytes();
+    int at = 0;
+    while(at < count && oldBytes[at] < first)
+    {
+        ++at;
+    }
+
+    size_t newSize = (count + 1) * (sizeof(RadixNode*) + 1);
+    RadixNode** block = static_cast<RadixNode**>(std::malloc(newSize));
+    if(block == NULL)
+    {
+        throw std::bad_alloc();
+    }
+    unsigned char* bytes = reinterpret_cast<unsigned char*>(block + count + 1);
+    for(int i = 0, j = 0; i <= count; ++i)
+    {
+        if(i == at)
+        {
+            block[i] = child;
+            bytes[i] = first;
+        }
+        else
+        {
+            block[i] = node->children[j];
+            bytes[i] = oldBytes[j];
+            ++j;
+        }
+    }
+    std::free(node->children);
+    node->children = block;
+    node->childCount = (uint16_t)(count + 1);
+}
+
+/**
+* Drops the child at index, compacting the block in place.
+*/
+template<typename Value>
+void RadixTree<Value>::removeChildAt(RadixNode* node, int index)
+{
+    uint16_t count = node->childCount;
+    unsigned char* oldBytes = node->firstBytes();
+    unsigned char bytes[256];
+    std::memcpy(bytes, oldBytes, count);
+    for(int i = index; i + 1 < count; ++i)
+    {
+        node->children[i] = node->children[i + 1];
+        bytes[i] = bytes[i + 1];
+    }
+    node->childCount = (uint16_t)(count - 1);
+    std::memcpy(node->firstBytes(), bytes, node->childCount);
+    if(node->childCount == 0)
+    {
+        std::free(node->children);
+        node->children = NULL;
+    }
+}
+
+#endif
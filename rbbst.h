@@ -0,0 +1,496 @@
+#ifndef RBBST_H
+#define RBBST_H
+
+#include <iostream>
+#include <exception>
+#include <cstdlib>
+#include <cstdint>
+#include "bst.h"
+
+/**
+* A node for a red-black tree. The color lives in a tag bit of the
+* parent pointer (see Node), so an RBNode is no larger than a plain Node.
+*/
+template <typename Key, typename Value>
+class RBNode : public Node<Key, Value>
+{
+public:
+    RBNode(const Key& key, const Value& value, RBNode<Key, Value>* parent);
+    virtual ~RBNode();
+
+    bool isRed() const;
+    void setRed(bool red);
+
+    virtual RBNode<Key, Value>* getParent() const override;
+    virtual RBNode<Key, Value>* getLeft() const override;
+    virtual RBNode<Key, Value>* getRight() const override;
+
+    virtual Node<Key, Value>* cloneAt(void* mem, Node<Key, Value>* parent) const override;
+    virtual size_t allocationSize() const override;
+
+protected:
+    static const uintptr_t RED_TAG = 1;
+};
+
+/*
+  -------------------------------------------------
+  Begin implementations for the RBNode class.
+  -------------------------------------------------
+*/
+
+/**
+* New nodes start out red, as every inserted node is red at first.
+*/
+template<class Key, class Value>
+RBNode<Key, Value>::RBNode(const Key& key, const Value& value, RBNode<Key, Value>* parent) :
+    Node<Key, Value>(key, value, parent)
+{
+    setRed(true);
+}
+
+template<class Key, class Value>
+RBNode<Key, Value>::~RBNode()
+{
+
+}
+
+template<class Key, class Value>
+bool RBNode<Key, Value>::isRed() const
+{
+    return (this->getTags() & RED_TAG) != 0;
+}
+
+template<class Key, class Value>
+void RBNode<Key, Value>::setRed(bool red)
+{
+    this->setTags(red ? (this->getTags() | RED_TAG) : (this->getTags() & ~RED_TAG));
+}
+
+template<class Key, class Value>
+RBNode<Key, Value> *RBNode<Key, Value>::getParent() const
+{
+    return static_cast<RBNode<Key, Value>*>(Node<Key, Value>::getParent());
+}
+
+template<class Key, class Value>
+RBNode<Key, Value> *RBNode<Key, Value>::getLeft() const
+{
+    return static_cast<RBNode<Key, Value>*>(Node<Key, Value>::getLeft());
+}
+
+template<class Key, class Value>
+RBNode<Key, Value> *RBNode<Key, Value>::getRight() const
+{
+    return static_cast<RBNode<Key, Value>*>(Node<Key, Value>::getRight());
+}
+
+/**
+* Copies the node; the color travels with the tag bits.
+*/
+template<class Key, class Value>
+Node<Key, Value>* RBNode<Key, Value>::cloneAt(void* mem, Node<Key, Value>* parent) const
+{
+    RBNode<Key, Value>* copy = new (mem) RBNode<Key, Value>(this->getKey(), this->getValue(),
+                                                            static_cast<RBNode<Key, Value>*>(parent));
+    copy->setTags(this->getTags());
+    return copy;
+}
+
+template<class Key, class Value>
+size_t RBNode<Key, Value>::allocationSize() const
+{
+    return sizeof(RBNode<Key, Value>);
+}
+
+/*
+  -----------------------------------------------
+  End implementations for the RBNode class.
+  -----------------------------------------------
+*/
+
+/**
+* A red-black tree. Compared to AVLTree it does at most two rotations
+* per insert and three per remove, with O(1) amortized recoloring, at
+* the cost of paths up to twice the minimum height.
+*/
+template <class Key, class Value, class Compare = std::less<Key> >
+class RBTree : public BinarySearchTree<Key, Value, Compare>
+{
+protected:
+    virtual Node<Key, Value>* insertNear(Node<Key, Value>* finger, const std::pair<const Key, Value>& new_item);
+    virtual void removeNode(Node<Key, Value>* node);
+    virtual void nodeSwap(RBNode<Key,Value>* n1, RBNode<Key,Value>* n2);
+
+    bool insertFix(RBNode<Key, Value>* node);
+    void removeFix(RBNode<Key, Value>* node, RBNode<Key, Value>* parent);
+    // Ranks are black heights.
+    virtual int rankOf(Node<Key, Value>* node) const;
+    virtual int rankAbove(Node<Key, Value>* parent, bool fromLeft, int childRank, int& siblingRank) const;
+    virtual Node<Key, Value>* join(Node<Key, Value>* left, int leftRank, Node<Key, Value>* mid,
+                                   Node<Key, Value>* right, int rightRank, int& rank);
+    static bool isRed(RBNode<Key, Value>* node);
+    virtual void rebuildFix(Node<Key, Value>* subtree);
+    virtual void describeNode(std::ostream& os, const Node<Key, Value>* node) const;
+    static int height(RBNode<Key, Value>* node);
+    static void colorByDepth(RBNode<Key, Value>* node, int depth, int redDepth);
+};
+
+/*
+ * Inserts a red leaf, then repairs red-red violations by recoloring
+ * upward and at most two rotations.
+ */
+template<typename Key, typename Value, typename Compare>
+Node<Key, Value>* RBTree<Key, Value, Compare>::insertNear(Node<Key, Value>* finger, const std::pair<const Key, Value>& new_item)
+{
+    Node<Key, Value>* parentNode;
+    bool isMax;
+    Node<Key, Value>* found = this->locate(finger, new_item.first, parentNode, isMax);
+    if(found != NULL)
+    {
+        found->setValue(new_item.second);
+        return found;
+    }
+
+    RBNode<Key, Value>* parent = static_cast<RBNode<Key, Value>*>(parentNode);
+    RBNode<Key, Value>* newNode = new RBNode<Key, Value>(new_item.first, new_item.second, parent);
+    this->nodeAdded(newNode, isMax);
+    if(parent == NULL)
+    {
+        this->root_ = newNode;
+    }
+    else if(this->comp_(new_item.first, parent->getKey()))
+    {
+        parent->setLeft(newNode);
+    }
+    else
+    {
+        parent->setRight(newNode);
+    }
+    insertFix(newNode);
+    return newNode;
+}
+
+/*
+ * Like the other trees, a node with two children is first swapped with
+ * its predecessor; colors stay with the tree positions.
+ */
+template<typename Key, typename Value, typename Compare>
+void RBTree<Key, Value, Compare>::removeNode(Node<Key, Value>* deletedNode)
+{
+    RBNode<Key, Value>* node = static_cast<RBNode<Key, Value>*>(deletedNode);
+    if(node->getLeft() != NULL && node->getRight() != NULL)
+    {
+        nodeSwap(static_cast<RBNode<Key, Value>*>(this->predecessor(node)), node);
+    }
+
+    RBNode<Key, Value>* child = node->getLeft();
+    if(child == NULL)
+    {
+        child = node->getRight();
+    }
+    RBNode<Key, Value>* parent = node->getParent();
+    if(child != NULL)
+    {
+        child->setParent(parent);
+    }
+    if(parent == NULL)
+    {
+        this->root_ = child;
+    }
+    else if(parent->getLeft() == node)
+    {
+        parent->setLeft(child);
+    }
+    else
+    {
+        parent->setRight(child);
+    }
+
+    bool removedBlack = !node->isRed();
+    this->nodeRemoved(node);
+    this->releaseNode(node);
+    if(removedBlack)
+    {
+        removeFix(child, parent);
+    }
+}
+
+template<typename Key, typename Value, typename Compare>
+void RBTree<Key, Value, Compare>::nodeSwap(RBNode<Key,Value>* n1, RBNode<Key,Value>* n2)
+{
+    BinarySearchTree<Key, Value, Compare>::nodeSwap(n1, n2);
+    bool tempRed = n1->isRed();
+    n1->setRed(n2->isRed());
+    n2->setRed(tempRed);
+}
+
+/**
+* Colors a rebuilt tree: its leaves are on the last two levels, so
+* making only the deepest level red gives every path the same number of
+* black nodes. Only valid for the whole tree, which is all compact
+* rebuilds.
+*/
+template<typename Key, typename Value, typename Compare>
+void RBTree<Key, Value, Compare>::rebuildFix(Node<Key, Value>* subtree)
+{
+    RBNode<Key, Value>* root = static_cast<RBNode<Key, Value>*>(subtree);
+    int levels = height(root);
+    colorByDepth(root, 1, levels > 1 ? levels : 0);
+}
+
+/**
+* Exporters show each node's color.
+*/
+template<typename Key, typename Value, typename Compare>
+void RBTree<Key, Value, Compare>::describeNode(std::ostream& os, const Node<Key, Value>* node) const
+{
+    os << (static_cast<const RBNode<Key, Value>*>(node)->isRed() ? " red" : " black");
+    BinarySearchTree<Key, Value, Compare>::describeNode(os, node);
+}
+
+template<typename Key, typename Value, typename Compare>
+int RBTree<Key, Value, Compare>::height(RBNode<Key, Value>* node)
+{
+    int levels = 0;
+    // buildBalanced puts the larger half on the left
+    for(; node != NULL; node = node->getLeft())
+    {
+        ++levels;
+    }
+    return levels;
+}
+
+template<typename Key, typename Value, typename Compare>
+void RBTree<Key, Value, Compare>::colorByDepth(RBNode<Key, Value>* node, int depth, int redDepth)
+{
+    if(node == NULL)
+    {
+        return;
+    }
+    node->setRed(depth == redDepth);
+    colorByDepth(node->getLeft(), depth + 1, redDepth);
+    colorByDepth(node->getRight(), depth + 1, redDepth);
+}
+
+template<typename Key, typename Value, typename Compare>
+bool RBTree<Key, Value, Compare>::isRed(RBNode<Key, Value>* node)
+{
+    return node != NULL && node->isRed();
+}
+
+/**
+* Restores the red-black properties after node was attached as a red leaf.
+* Returns true if the root had to be blackened, adding a black level.
+*/
+template<typename Key, typename Value, typename Compare>
+bool RBTree<Key, Value, Compare>::insertFix(RBNode<Key, Value>* node)
+{
+    while(isRed(node->getParent()))
+    {
+        RBNode<Key, Value>* parent = node->getParent();
+        RBNode<Key, Value>* grand = parent->getParent();
+        bool parentIsLeft = (parent == grand->getLeft());
+        RBNode<Key, Value>* uncle = parentIsLeft ? grand->getRight() : grand->getLeft();
+
+        if(isRed(uncle))
+        {
+            // push the red up two levels and keep going
+            parent->setRed(false);
+            uncle->setRed(false);
+            grand->setRed(true);
+            node = grand;
+            continue;
+        }
+
+        if(parentIsLeft)
+        {
+            if(node == parent->getRight())
+            {
+                this->rotateLeft(parent);
+                node = parent;
+                parent = node->getParent();
+            }
+            this->rotateRight(grand);
+        }
+        else
+        {
+            if(node == parent->getLeft())
+            {
+                this->rotateRight(parent);
+                node = parent;
+                parent = node->getParent();
+            }
+            this->rotateLeft(grand);
+        }
+        parent->setRed(false);
+        grand->setRed(true);
+        break;
+    }
+    RBNode<Key, Value>* root = static_cast<RBNode<Key, Value>*>(this->root_);
+    bool grew = root->isRed();
+    root->setRed(false);
+    return grew;
+}
+
+/**
+* Restores the black-height after a black node was spliced out. node
+* (possibly NULL) took its place under parent and carries an extra black.
+*/
+template<typename Key, typename Value, typename Compare>
+void RBTree<Key, Value, Compare>::removeFix(RBNode<Key, Value>* node, RBNode<Key, Value>* parent)
+{
+    while(node != this->root_ && !isRed(node))
+    {
+        if(node == parent->getLeft())
+        {
+            RBNode<Key, Value>* sibling = parent->getRight();
+            if(isRed(sibling))
+            {
+                sibling->setRed(false);
+                parent->setRed(true);
+                this->rotateLeft(parent);
+                sibling = parent->getRight();
+            }
+            if(!isRed(sibling->getLeft()) && !isRed(sibling->getRight()))
+            {
+                sibling->setRed(true);
+                node = parent;
+                parent = node->getParent();
+                continue;
+            }
+            if(!isRed(sibling->getRight()))
+            {
+                sibling->getLeft()->setRed(false);
+                sibling->setRed(true);
+                this->rotateRight(sibling);
+                sibling = parent->getRight();
+            }
+            sibling->setRed(parent->isRed());
+            parent->setRed(false);
+            sibling->getRight()->setRed(false);
+            this->rotateLeft(parent);
+        }
+        else
+        {
+            RBNode<Key, Value>* sibling = parent->getLeft();
+            if(isRed(sibling))
+            {
+                sibling->setRed(false);
+                parent->setRed(true);
+                this->rotateRight(parent);
+                sibling = parent->getLeft();
+            }
+            if(!isRed(sibling->getLeft()) && !isRed(sibling->getRight()))
+            {
+                sibling->setRed(true);
+                node = parent;
+                parent = node->getParent();
+                continue;
+            }
+            if(!isRed(sibling->getLeft()))
+            {
+                sibling->getRight()->setRed(false);
+                sibling->setRed(true);
+                this->rotateLeft(sibling);
+                sibling = parent->getLeft();
+            }
+            sibling->setRed(parent->isRed());
+            parent->setRed(false);
+            sibling->getLeft()->setRed(false);
+            this->rotateRight(parent);
+        }
+        node = static_cast<RBNode<Key, Value>*>(this->root_);
+        break;
+    }
+    if(node != NULL)
+    {
+        node->setRed(false);
+    }
+}
+
+/**
+* Returns the black height of the subtree at node, counting node itself
+* if it is black.
+*/
+template<typename Key, typename Value, typename Compare>
+int RBTree<Key, Value, Compare>::rankOf(Node<Key, Value>* node) const
+{
+    int blacks = 0;
+    for(RBNode<Key, Value>* n = static_cast<RBNode<Key, Value>*>(node); n != NULL; n = n->getLeft())
+    {
+        blacks += n->isRed() ? 0 : 1;
+    }
+    return blacks;
+}
+
+template<typename Key, typename Value, typename Compare>
+int RBTree<Key, Value, Compare>::rankAbove(Node<Key, Value>* parent, bool, int childRank, int& siblingRank) const
+{
+    siblingRank = childRank;
+    return childRank + (static_cast<RBNode<Key, Value>*>(parent)->isRed() ? 0 : 1);
+}
+
+/**
+* Blackens both roots, then joins trees of equal black height under a
+* black mid. Otherwise mid goes down the taller tree's inner spine to
+* the first black subtree as black-high as the shorter tree and is
+* attached there red, repairing as after an insert.
+*/
+template<typename Key, typename Value, typename Compare>
+Node<Key, Value>* RBTree<Key, Value, Compare>::join(Node<Key, Value>* leftNode, int leftRank, Node<Key, Value>* mid,
+                                                    Node<Key, Value>* rightNode, int rightRank, int& rank)
+{
+    RBNode<Key, Value>* left = static_cast<RBNode<Key, Value>*>(leftNode);
+    RBNode<Key, Value>* right = static_cast<RBNode<Key, Value>*>(rightNode);
+    RBNode<Key, Value>* node = static_cast<RBNode<Key, Value>*>(mid);
+    if(isRed(left))
+    {
+        left->setRed(false);
+        ++leftRank;
+    }
+    if(isRed(right))
+    {
+        right->setRed(false);
+        ++rightRank;
+    }
+    if(leftRank == rightRank)
+    {
+        this->linkChildren(node, left, right);
+        node->setParent(NULL);
+        node->setRed(false);
+        rank = leftRank + 1;
+        return node;
+    }
+
+    bool descendRight = leftRank > rightRank;
+    RBNode<Key, Value>* top = descendRight ? left : right;
+    int low = std::min(leftRank, rightRank);
+    RBNode<Key, Value>* parent = NULL;
+    RBNode<Key, Value>* spine = top;
+    int spineRank = std::max(leftRank, rightRank);
+    while(isRed(spine) || spineRank > low)
+    {
+        parent = spine;
+        spineRank -= spine->isRed() ? 0 : 1;
+        spine = descendRight ? spine->getRight() : spine->getLeft();
+    }
+
+    if(descendRight)
+    {
+        this->linkChildren(node, spine, right);
+        parent->setRight(node);
+    }
+    else
+    {
+        this->linkChildren(node, left, spine);
+        parent->setLeft(node);
+    }
+    node->setParent(parent);
+    node->setRed(true);
+    // rotations at the top of the taller tree move root_
+    this->root_ = top;
+    rank = std::max(leftRank, rightRank) + (insertFix(node) ? 1 : 0);
+    return this->root_;
+}
+
+#endif
@@ -0,0 +1,627 @@
+#ifndef RELAXEDAVL_H
+#define RELAXEDAVL_H
+
+#include <iostream>
+#include <exception>
+#include <cstdlib>
+#include <cstdint>
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "avlbst.h"
+
+/**
+* An AVL node that stores its subtree height rather than deriving it,
+* so that a node can be checked on its own long after the change below
+* it, and remembers its place in the tree's pending list.
+*/
+template <typename Key, typename Value>
+class RelaxedAVLNode : public AVLNode<Key, Value>
+{
+public:
+    static const uint32_t NOT_PENDING = UINT32_MAX;
+
+    RelaxedAVLNode(const Key& key, const Value& value, RelaxedAVLNode<Key, Value>* parent);
+
+    int32_t getHeight() const { return height_; }
+    void setHeight(int32_t height) { height_ = height; }
+    uint32_t getPendingSlot() const { return pendingSlot_; }
+    void setPendingSlot(uint32_t slot) { pendingSlot_ = slot; }
+
+    virtual RelaxedAVLNode<Key, Value>* getParent() const override;
+    virtual RelaxedAVLNode<Key, Value>* getLeft() const override;
+    virtual RelaxedAVLNode<Key, Value>* getRight() const override;
+
+    virtual Node<Key, Value>* cloneAt(void* mem, Node<Key, Value>* parent) const override;
+    virtual size_t allocationSize() const override;
+
+protected:
+    int32_t height_;
+    uint32_t pendingSlot_;
+};
+
+template<class Key, class Value>
+RelaxedAVLNode<Key, Value>::RelaxedAVLNode(const Key& key, const Value& value, RelaxedAVLNode<Key, Value>* parent)
+    : AVLNode<Key, Value>(key, value, parent), height_(1), pendingSlot_(NOT_PENDING)
+{
+
+}
+
+template<class Key, class Value>
+RelaxedAVLNode<Key, Value>* RelaxedAVLNode<Key, Value>::getParent() const
+{
+    return static_cast<RelaxedAVLNode<Key, Value>*>(Node<Key, Value>::getParent());
+}
+
+template<class Key, class Value>
+RelaxedAVLNode<Key, Value>* RelaxedAVLNode<Key, Value>::getLeft() const
+{
+    return static_cast<RelaxedAVLNode<Key, Value>*>(Node<Key, Value>::getLeft());
+}
+
+template<class Key, class Value>
+RelaxedAVLNode<Key, Value>* RelaxedAVLNode<Key, Value>::getRight() const
+{
+    return static_cast<RelaxedAVLNode<Key, Value>*>(Node<Key, Value>::getRight());
+}
+
+/**
+* Copies the node and its height; the copy is in no pending list.
+*/
+template<class Key, class Value>
+Node<Key, Value>* RelaxedAVLNode<Key, Value>::cloneAt(void* mem, Node<Key, Value>* parent) const
+{
+    RelaxedAVLNode<Key, Value>* copy = new (mem) RelaxedAVLNode<Key, Value>(
+        this->getKey(), this->getValue(), static_cast<RelaxedAVLNode<Key, Value>*>(parent));
+    copy->setTags(this->getTags());
+    copy->height_ = height_;
+    return copy;
+}
+
+template<class Key, class Value>
+size_t RelaxedAVLNode<Key, Value>::allocationSize() const
+{
+    return sizeof(RelaxedAVLNode<Key, Value>);
+}
+
+/**
+* An AVLTree with relaxed balance: insert and remove only link or
+* unlink their node and record its parent as pending, so they do no
+* retracing and no rotations. The rebalancing is done later, a bounded
+* amount at a time, by rebalance_step or by a background maintenance
+* thread, which keeps the latency of each update at one descent.
+*
+* A pending node's stored height may be stale. rebalance_step takes
+* pending nodes one at a time and retraces upward from each, fixing
+* heights and rotating where a node leans by two or more, until a
+* subtree's height stops changing. Every node it visits costs one unit
+* of the budget. Once nothing is pending the heights are exact and the
+* tree is a valid AVL tree again, so the height returns to O(log n)
+* as soon as the maintenance catches up; until then lookups stay
+* correct but may descend further.
+*
+* The tree is not safe for concurrent use by itself. While maintenance
+* runs, every access, reads included, must hold mutex(); the thread
+* takes it for one budgeted step at a time.
+*/
+template <class Key, class Value, class Compare = std::less<Key> >
+class RelaxedAVLTree : public AVLTree<Key, Value, Compare>
+{
+public:
+    typedef RelaxedAVLNode<Key, Value> NodeType;
+
+    RelaxedAVLTree();
+    RelaxedAVLTree(const RelaxedAVLTree<Key, Value, Compare>& other);
+    RelaxedAVLTree(RelaxedAVLTree<Key, Value, Compare>&& other);
+    virtual ~RelaxedAVLTree();
+    RelaxedAVLTree<Key, Value, Compare>& operator=(const RelaxedAVLTree<Key, Value, Compare>& other);
+    RelaxedAVLTree<Key, Value, Compare>& operator=(RelaxedAVLTree<Key, Value, Compare>&& other);
+
+    // Retraces from pending nodes, visiting at most budget nodes, and
+    // returns how many nodes are still pending.
+    size_t rebalance_step(size_t budget);
+    // Finishes all pending rebalancing.
+    void rebalance();
+    size_t pendingRebalance() const;
+
+    // Runs rebalance_step(budget) on a thread of its own whenever
+    // anything is pending, checking again every idle period otherwise.
+    // stopMaintenance must not be called while holding mutex().
+    void startMaintenance(size_t budget = 64,
+                          std::chrono::microseconds idle = std::chrono::microseconds(200));
+    void stopMaintenance();
+    std::mutex& mutex();
+
+protected:
+    virtual Node<Key, Value>* insertNear(Node<Key, Value>* finger, const std::pair<const Key, Value>& new_item);
+    virtual void removeNode(Node<Key, Value>* node);
+    virtual void eraseRange(Node<Key, Value>* first, Node<Key, Value>* last);
+    virtual AVLNode<Key, Value>* createNode(const Key& key, const Value& value, AVLNode<Key, Value>* parent);
+    virtual void nodeSwap(AVLNode<Key, Value>* n1, AVLNode<Key, Value>* n2);
+    virtual void rebuildFix(Node<Key, Value>* subtree);
+    virtual void cleared();
+    virtual void describeNode(std::ostream& os, const Node<Key, Value>* node) const;
+    virtual void profileNode(TreeProfile& profile, const Node<Key, Value>* node) const;
+
+    void markPending(NodeType* node);
+    void unmarkPending(NodeType* node);
+    NodeType* fixNode(NodeType* node);
+    void settleCopy(bool hadPending);
+    void maintain();
+    static int32_t height(const NodeType* node);
+    static int balance(const NodeType* node);
+    static void update(NodeType* node);
+    static int32_t setHeights(NodeType* node, bool unmark);
+
+    std::vector<NodeType*> pending_;
+    std::mutex mutex_;
+    std::condition_variable wake_;
+    std::thread maintenance_;
+    bool stopping_;
+    size_t budget_;
+    std::chrono::microseconds idle_;
+};
+
+template<class Key, class Value, class Compare>
+RelaxedAVLTree<Key, Value, Compare>::RelaxedAVLTree()
+    : stopping_(false), budget_(0), idle_(0)
+{
+
+}
+
+/**
+* Copies other's nodes. Their heights are copied as they are, so if
+* other had rebalancing pending the copy is rebuilt balanced instead.
+* other must not be changing while it is copied.
+*/
+template<class Key, class Value, class Compare>
+RelaxedAVLTree<Key, Value, Compare>::RelaxedAVLTree(const RelaxedAVLTree<Key, Value, Compare>& other)
+    : AVLTree<Key, Value, Compare>(other), stopping_(false), budget_(0), idle_(0)
+{
+    settleCopy(!other.pending_.empty());
+}
+
+/**
+* Takes over other's nodes and pending list; other's maintenance, if
+* running, is stopped first.
+*/
+template<class Key, class Value, class Compare>
+RelaxedAVLTree<Key, Value, Compare>::RelaxedAVLTree(RelaxedAVLTree<Key, Value, Compare>&& other)
+    : stopping_(false), budget_(0), idle_(0)
+{
+    other.stopMaintenance();
+    this->takeFrom(other);
+    pending_.swap(other.pending_);
+}
+
+template<class Key, class Value, class Compare>
+RelaxedAVLTree<Key, Value, Compare>::~RelaxedAVLTree()
+{
+    stopMaintenance();
+}
+
+template<class Key, class Value, class Compare>
+RelaxedAVLTree<Key, Value, Compare>&
+RelaxedAVLTree<Key, Value, Compare>::operator=(const RelaxedAVLTree<Key, Value, Compare>& other)
+{
+    if(this != &other)
+    {
+        AVLTree<Key, Value, Compare>::operator=(other);
+        settleCopy(!other.pending_.empty());
+    }
+    return *this;
+}
+
+template<class Key, class Value, class Compare>
+RelaxedAVLTree<Key, Value, Compare>&
+RelaxedAVLTree<Key, Value, Compare>::operator=(RelaxedAVLTree<Key, Value, Compare>&& other)
+{
+    if(this != &other)
+    {
+        other.stopMaintenance();
+        AVLTree<Key, Value, Compare>::operator=(std::move(other));
+        pending_.swap(other.pending_);
+    }
+    return *this;
+}
+
+template<class Key, class Value, class Compare>
+void RelaxedAVLTree<Key, Value, Compare>::settleCopy(bool hadPending)
+{
+    if(hadPending && this->root_ != NULL)
+    {
+        this->rebuildSubtree(this->root_);
+    }
+}
+
+/**
+* Links the new node with no retracing and leaves its parent pending.
+*/
+template<class Key, class Value, class Compare>
+Node<Key, Value>* RelaxedAVLTree<Key, Value, Compare>::insertNear(Node<Key, Value>* finger,
+                                                                  const std::pair<const Key, Value>& new_item)
+{
+    Node<Key, Value>* parentNode;
+    bool isMax;
+    Node<Key, Value>* found = this->locate(finger, new_item.first, parentNode, isMax);
+    if(found != NULL)
+    {
+        found->setValue(new_item.second);
+        return found;
+    }
+
+    NodeType* parent = static_cast<NodeType*>(parentNode);
+    NodeType* newNode = static_cast<NodeType*>(createNode(new_item.first, new_item.second, parent));
+    this->nodeAdded(newNode, isMax);
+    if(parent == NULL)
+    {
+        this->root_ = newNode;
+        return newNode;
+    }
+    if(this->comp_(new_item.first, parent->getKey()))
+    {
+        parent->setLeft(newNode);
+    }
+    else
+    {
+        parent->setRight(newNode);
+    }
+    markPending(parent);
+    return newNode;
+}
+
+template<class Key, class Value, class Compare>
+AVLNode<Key, Value>* RelaxedAVLTree<Key, Value, Compare>::createNode(const Key& key, const Value& value,
+                                                                     AVLNode<Key, Value>* parent)
+{
+    return new NodeType(key, value, static_cast<NodeType*>(parent));
+}
+
+/**
+* Splices the node out like AVLTree::removeNode, swapping with the
+* predecessor first if it has two children, and leaves its parent
+* pending instead of retracing.
+*/
+template<class Key, class Value, class Compare>
+void RelaxedAVLTree<Key, Value, Compare>::removeNode(Node<Key, Value>* deletedNode)
+{
+    NodeType* node = static_cast<NodeType*>(deletedNode);
+    if(node->getLeft() != NULL && node->getRight() != NULL)
+    {
+        nodeSwap(static_cast<NodeType*>(this->predecessor(node)), node);
+    }
+
+    NodeType* child = node->getLeft();
+    if(child == NULL)
+    {
+        child = node->getRight();
+    }
+    NodeType* parent = node->getParent();
+    if(child != NULL)
+    {
+        child->setParent(parent);
+    }
+    if(parent == NULL)
+    {
+        this->root_ = child;
+    }
+    else if(parent->getLeft() == node)
+    {
+        parent->setLeft(child);
+    }
+    else
+    {
+        parent->setRight(child);
+    }
+    if(node->getPendingSlot() != NodeType::NOT_PENDING)
+    {
+        unmarkPending(node);
+    }
+    if(parent != NULL)
+    {
+        markPending(parent);
+    }
+    this->nodeRemoved(node);
+    this->releaseNode(node);
+}
+
+/**
+* Swaps positions; a height and a pending mark describe a position, so
+* they trade places along with the nodes.
+*/
+template<class Key, class Value, class Compare>
+void RelaxedAVLTree<Key, Value, Compare>::nodeSwap(AVLNode<Key, Value>* n1, AVLNode<Key, Value>* n2)
+{
+    AVLTree<Key, Value, Compare>::nodeSwap(n1, n2);
+    NodeType* a = static_cast<NodeType*>(n1);
+    NodeType* b = static_cast<NodeType*>(n2);
+    int32_t h = a->getHeight();
+    a->setHeight(b->getHeight());
+    b->setHeight(h);
+    uint32_t slotA = a->getPendingSlot();
+    uint32_t slotB = b->getPendingSlot();
+    a->setPendingSlot(slotB);
+    b->setPendingSlot(slotA);
+    if(slotA != NodeType::NOT_PENDING)
+    {
+        pending_[slotA] = b;
+    }
+    if(slotB != NodeType::NOT_PENDING)
+    {
+        pending_[slotB] = a;
+    }
+}
+
+template<class Key, class Value, class Compare>
+size_t RelaxedAVLTree<Key, Value, Compare>::rebalance_step(size_t budget)
+{
+    size_t used = 0;
+    while(!pending_.empty() && used < budget)
+    {
+        NodeType* node = pending_.back();
+        unmarkPending(node);
+        while(node != NULL)
+        {
+            if(used == budget)
+            {
+                markPending(node);
+                return pending_.size();
+            }
+            ++used;
+            int32_t before = node->getHeight();
+            NodeType* top = fixNode(node);
+            if(top->getHeight() == before)
+            {
+                // nothing above depends on this subtree's shape
+                break;
+            }
+            node = top->getParent();
+        }
+    }
+    return pending_.size();
+}
+
+template<class Key, class Value, class Compare>
+void RelaxedAVLTree<Key, Value, Compare>::rebalance()
+{
+    rebalance_step(SIZE_MAX);
+}
+
+template<class Key, class Value, class Compare>
+size_t RelaxedAVLTree<Key, Value, Compare>::pendingRebalance() const
+{
+    return pending_.size();
+}
+
+/**
+* Recomputes node's height from its children and, if it leans by two
+* or more, rotates its taller child up (twice if that child leans the
+* other way). Returns the subtree's new root. A node left leaning by
+* two or more, possible when heights below were stale, is made pending.
+*/
+template<class Key, class Value, class Compare>
+typename RelaxedAVLTree<Key, Value, Compare>::NodeType*
+RelaxedAVLTree<Key, Value, Compare>::fixNode(NodeType* node)
+{
+    update(node);
+    int b = balance(node);
+    if(b >= -1 && b <= 1)
+    {
+        return node;
+    }
+    NodeType* child = b > 0 ? node->getRight() : node->getLeft();
+    NodeType* top = child;
+    if((b > 0 && balance(child) < 0) || (b < 0 && balance(child) > 0))
+    {
+        top = b > 0 ? child->getLeft() : child->getRight();
+        if(b > 0) this->rotateRight(child);
+        else this->rotateLeft(child);
+        update(child);
+    }
+    if(b > 0) this->rotateLeft(node);
+    else this->rotateRight(node);
+    update(node);
+    update(top);
+    NodeType* moved[3] = { node, child, top };
+    for(int i = 0; i < 3; ++i)
+    {
+        int lean = balance(moved[i]);
+        if((lean < -1 || lean > 1) && moved[i]->getPendingSlot() == NodeType::NOT_PENDING)
+        {
+            markPending(moved[i]);
+        }
+    }
+    return top;
+}
+
+template<class Key, class Value, class Compare>
+void RelaxedAVLTree<Key, Value, Compare>::markPending(NodeType* node)
+{
+    if(node->getPendingSlot() == NodeType::NOT_PENDING)
+    {
+        node->setPendingSlot((uint32_t)pending_.size());
+        pending_.push_back(node);
+    }
+}
+
+template<class Key, class Value, class Compare>
+void RelaxedAVLTree<Key, Value, Compare>::unmarkPending(NodeType* node)
+{
+    uint32_t slot = node->getPendingSlot();
+    NodeType* last = pending_.back();
+    pending_[slot] = last;
+    last->setPendingSlot(slot);
+    pending_.pop_back();
+    node->setPendingSlot(NodeType::NOT_PENDING);
+}
+
+/**
+* A rebuilt subtree gets exact heights. Rebuilding the whole tree
+* (compact) also settles everything pending, and may have released
+* pending nodes, so the list is dropped; a smaller rebuild leaves the
+* subtree's parent pending.
+*/
+template<class Key, class Value, class Compare>
+void RelaxedAVLTree<Key, Value, Compare>::rebuildFix(Node<Key, Value>* subtree)
+{
+    NodeType* top = static_cast<NodeType*>(subtree);
+    if(top == this->root_)
+    {
+        pending_.clear();
+        setHeights(top, true);
+        return;
+    }
+    setHeights(top, false);
+    markPending(top->getParent());
+}
+
+/**
+* Stored heights may be stale, so the split and join AVLTree erases
+* with cannot be trusted; the items go one removeNode at a time, which
+* does no rebalancing here anyway.
+*/
+template<class Key, class Value, class Compare>
+void RelaxedAVLTree<Key, Value, Compare>::eraseRange(Node<Key, Value>* first, Node<Key, Value>* last)
+{
+    this->removeEach(first, last);
+}
+
+template<class Key, class Value, class Compare>
+void RelaxedAVLTree<Key, Value, Compare>::cleared()
+{
+    pending_.clear();
+}
+
+/**
+* Stores the exact height of every node below node, also clearing their
+* pending marks if unmark is set, and returns node's height. Pending
+* nodes left marked are harmless: their retrace finds nothing to fix.
+*/
+template<class Key, class Value, class Compare>
+int32_t RelaxedAVLTree<Key, Value, Compare>::setHeights(NodeType* node, bool unmark)
+{
+    if(node == NULL)
+    {
+        return 0;
+    }
+    int32_t h = std::max(setHeights(node->getLeft(), unmark), setHeights(node->getRight(), unmark)) + 1;
+    node->setHeight(h);
+    if(unmark)
+    {
+        node->setPendingSlot(NodeType::NOT_PENDING);
+    }
+    return h;
+}
+
+template<class Key, class Value, class Compare>
+int32_t RelaxedAVLTree<Key, Value, Compare>::height(const NodeType* node)
+{
+    return node == NULL ? 0 : node->getHeight();
+}
+
+template<class Key, class Value, class Compare>
+int RelaxedAVLTree<Key, Value, Compare>::balance(const NodeType* node)
+{
+    return height(node->getRight()) - height(node->getLeft());
+}
+
+template<class Key, class Value, class Compare>
+void RelaxedAVLTree<Key, Value, Compare>::update(NodeType* node)
+{
+    node->setHeight(std::max(height(node->getLeft()), height(node->getRight())) + 1);
+}
+
+/**
+* Exporters show each node's stored height and balance, and whether it
+* is pending.
+*/
+template<class Key, class Value, class Compare>
+void RelaxedAVLTree<Key, Value, Compare>::describeNode(std::ostream& os, const Node<Key, Value>* node) const
+{
+    const NodeType* n = static_cast<const NodeType*>(node);
+    int b = balance(n);
+    os << " h=" << n->getHeight() << " b=" << (b > 0 ? "+" : "") << b;
+    if(n->getPendingSlot() != NodeType::NOT_PENDING)
+    {
+        os << " pending";
+    }
+    BinarySearchTree<Key, Value, Compare>::describeNode(os, node);
+}
+
+/**
+* Profiles count balances from the stored heights; those outside
+* [-1, 1] are violations still awaiting rebalancing. Heights above a
+* pending node may be stale, so only a settled tree's counts are exact.
+*/
+template<class Key, class Value, class Compare>
+void RelaxedAVLTree<Key, Value, Compare>::profileNode(TreeProfile& profile, const Node<Key, Value>* node) const
+{
+    profile.balanceCounts.resize(3);
+    int b = balance(static_cast<const NodeType*>(node));
+    if(b >= -1 && b <= 1)
+    {
+        ++profile.balanceCounts[b + 1];
+    }
+    else
+    {
+        ++profile.balanceViolations;
+    }
+}
+
+template<class Key, class Value, class Compare>
+void RelaxedAVLTree<Key, Value, Compare>::startMaintenance(size_t budget, std::chrono::microseconds idle)
+{
+    stopMaintenance();
+    budget_ = budget;
+    idle_ = idle;
+    stopping_ = false;
+    maintenance_ = std::thread(&RelaxedAVLTree<Key, Value, Compare>::maintain, this);
+}
+
+template<class Key, class Value, class Compare>
+void RelaxedAVLTree<Key, Value, Compare>::stopMaintenance()
+{
+    if(!maintenance_.joinable())
+    {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> guard(mutex_);
+        stopping_ = true;
+    }
+    wake_.notify_all();
+    maintenance_.join();
+}
+
+template<class Key, class Value, class Compare>
+std::mutex& RelaxedAVLTree<Key, Value, Compare>::mutex()
+{
+    return mutex_;
+}
+
+/**
+* The maintenance loop: one budgeted step per hold of the mutex, then
+* a yield so that waiting operations get in between steps.
+*/
+template<class Key, class Value, class Compare>
+void RelaxedAVLTree<Key, Value, Compare>::maintain()
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    while(!stopping_)
+    {
+        if(pending_.empty())
+        {
+            wake_.wait_for(lock, idle_);
+            continue;
+        }
+        rebalance_step(budget_);
+        lock.unlock();
+        std::this_thread::yield();
+        lock.lock();
+    }
+}
+
+#endif
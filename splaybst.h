@@ -0,0 +1,394 @@
+#ifndef SPLAYBST_H
+#define SPLAYBST_H
+
+#include <iostream>
+#include <exception>
+#include <cstdlib>
+#include <stdexcept>
+#include "bst.h"
+
+/**
+* How a SplayTree restructures itself on access.
+* SPLAY_FULL splays the accessed node all the way to the root top-down.
+* SPLAY_SEMI semi-splays bottom-up: each zig-zig step rotates only the
+* parent over the grandparent and continues from the parent, roughly
+* halving the access path with half the rotations of a full splay.
+*/
+enum SplayMode
+{
+    SPLAY_FULL,
+    SPLAY_SEMI
+};
+
+/**
+* A self-adjusting binary search tree. Nodes are plain Nodes, so the
+* iterator, predecessor and nodeSwap machinery of BinarySearchTree all
+* apply unchanged. Writes always splay; reads splay only on every Nth
+* access (see setReadSplayInterval) to limit restructuring on read-mostly
+* workloads.
+*/
+template <typename Key, typename Value, typename Compare = std::less<Key> >
+class SplayTree : public BinarySearchTree<Key, Value, Compare>
+{
+public:
+    SplayTree(SplayMode mode = SPLAY_FULL, unsigned readSplayInterval = 1);
+
+    virtual void remove(const Key& key);
+
+    // Non-const lookups restructure the tree; the const overloads
+    // inherited from BinarySearchTree do not.
+    typename BinarySearchTree<Key, Value, Compare>::iterator find(const Key& key);
+    template<typename K, typename C = Compare, typename = typename C::is_transparent>
+    typename BinarySearchTree<Key, Value, Compare>::iterator find(const K& key);
+    Value& operator[](const Key& key);
+    using BinarySearchTree<Key, Value, Compare>::find;
+    using BinarySearchTree<Key, Value, Compare>::operator[];
+
+    void setMode(SplayMode mode);
+    void setReadSplayInterval(unsigned interval);
+
+protected:
+    // Always splays from the root; a finger would be moved anyway.
+    virtual Node<Key, Value>* insertNear(Node<Key, Value>* finger, const std::pair<const Key, Value>& keyValuePair);
+    template<typename K>
+    Node<Key, Value>* splayFrom(Node<Key, Value>* subtree, const K& key);
+    void semiSplay(Node<Key, Value>* node);
+    template<typename K>
+    Node<Key, Value>* access(const K& key);
+    void rotateUp(Node<Key, Value>* node);
+
+    SplayMode mode_;
+    unsigned readSplayInterval_;
+    unsigned readsSinceSplay_;
+};
+
+template<typename Key, typename Value, typename Compare>
+SplayTree<Key, Value, Compare>::SplayTree(SplayMode mode, unsigned readSplayInterval)
+    : BinarySearchTree<Key, Value, Compare>(),
+      mode_(mode),
+      readSplayInterval_(readSplayInterval == 0 ? 1 : readSplayInterval),
+      readsSinceSplay_(0)
+{
+
+}
+
+template<typename Key, typename Value, typename Compare>
+void SplayTree<Key, Value, Compare>::setMode(SplayMode mode)
+{
+    mode_ = mode;
+}
+
+/**
+* Reads splay only on every interval-th access; 1 splays on every read.
+*/
+template<typename Key, typename Value, typename Compare>
+void SplayTree<Key, Value, Compare>::setReadSplayInterval(unsigned interval)
+{
+    readSplayInterval_ = (interval == 0) ? 1 : interval;
+    readsSinceSplay_ = 0;
+}
+
+/**
+* Inserts by splaying the key's neighbourhood to the root and then
+* either updating the root or splitting it around a new root node.
+*/
+template<typename Key, typename Value, typename Compare>
+Node<Key, Value>* SplayTree<Key, Value, Compare>::insertNear(Node<Key, Value>*, const std::pair<const Key, Value>& keyValuePair)
+{
+    const Key& key = keyValuePair.first;
+    if(mode_ == SPLAY_SEMI)
+    {
+        Node<Key, Value>* node = BinarySearchTree<Key, Value, Compare>::insertNear(NULL, keyValuePair);
+        semiSplay(node);
+        return node;
+    }
+
+    Node<Key, Value>* root = splayFrom(this->root_, key);
+    this->root_ = root;
+    int c = root != NULL ? this->order(key, root->getKey()) : 0;
+    if(root != NULL && c == 0)
+    {
+        this->revive(root);
+        root->setValue(keyValuePair.second);
+        return root;
+    }
+
+    Node<Key, Value>* newNode = new Node<Key, Value>(key, keyValuePair.second, NULL);
+    this->nodeAdded(newNode);
+    if(root != NULL)
+    {
+        if(c < 0)
+        {
+            newNode->setLeft(root->getLeft());
+            newNode->setRight(root);
+            root->setLeft(NULL);
+        }
+        else
+        {
+            newNode->setRight(root->getRight());
+            newNode->setLeft(root);
+            root->setRight(NULL);
+        }
+        root->setParent(newNode);
+        if(newNode->getLeft() != NULL) newNode->getLeft()->setParent(newNode);
+        if(newNode->getRight() != NULL) newNode->getRight()->setParent(newNode);
+    }
+    this->root_ = newNode;
+    return newNode;
+}
+
+/**
+* Splays the key as the current mode does, then removes it with the
+* base class's predecessor swap. A full splay leaves the key at the
+* root, so the swap only walks the root's left subtree; a semi-splay
+* only shortens the key's path, and the swap starts wherever it ends.
+*/
+template<typename Key, typename Value, typename Compare>
+void SplayTree<Key, Value, Compare>::remove(const Key& key)
+{
+    Node<Key, Value>* node = access(key);
+    if(node != NULL)
+    {
+        BinarySearchTree<Key, Value, Compare>::remove(key);
+    }
+}
+
+template<typename Key, typename Value, typename Compare>
+typename BinarySearchTree<Key, Value, Compare>::iterator
+SplayTree<Key, Value, Compare>::find(const Key& key)
+{
+    if(++readsSinceSplay_ < readSplayInterval_)
+    {
+        return BinarySearchTree<Key, Value, Compare>::find(key);
+    }
+    readsSinceSplay_ = 0;
+    return this->makeIterator(access(key));
+}
+
+/**
+* The transparent lookup, splaying like find(const Key&).
+*/
+template<typename Key, typename Value, typename Compare>
+template<typename K, typename C, typename>
+typename BinarySearchTree<Key, Value, Compare>::iterator
+SplayTree<Key, Value, Compare>::find(const K& key)
+{
+    if(++readsSinceSplay_ < readSplayInterval_)
+    {
+        return BinarySearchTree<Key, Value, Compare>::find(key);
+    }
+    readsSinceSplay_ = 0;
+    return this->makeIterator(access(key));
+}
+
+template<typename Key, typename Value, typename Compare>
+Value& SplayTree<Key, Value, Compare>::operator[](const Key& key)
+{
+    Node<Key, Value>* node;
+    if(++readsSinceSplay_ < readSplayInterval_)
+    {
+        node = this->internalFind(key);
+    }
+    else
+    {
+        readsSinceSplay_ = 0;
+        node = access(key);
+    }
+    if(node == NULL) throw std::out_of_range("Invalid key");
+    return node->getValue();
+}
+
+/**
+* Splays key according to the current mode and returns its node, or
+* NULL if the key is absent or a tombstone (the last node on the search
+* path is still brought up).
+*/
+template<typename Key, typename Value, typename Compare>
+template<typename K>
+Node<Key, Value>* SplayTree<Key, Value, Compare>::access(const K& key)
+{
+    if(mode_ == SPLAY_SEMI)
+    {
+        Node<Key, Value>* curr = this->root_;
+        Node<Key, Value>* last = NULL;
+        while(curr != NULL)
+        {
+            last = curr;
+            int c = this->order(key, curr->getKey());
+            if(c < 0) curr = curr->getLeft();
+            else if(c > 0) curr = curr->getRight();
+            else break;
+        }
+        semiSplay(last);
+        return (curr != NULL && curr->isDead()) ? NULL : curr;
+    }
+
+    this->root_ = splayFrom(this->root_, key);
+    Node<Key, Value>* root = this->root_;
+    if(root != NULL && !root->isDead() && this->order(key, root->getKey()) == 0)
+    {
+        return root;
+    }
+    return NULL;
+}
+
+/**
+* Top-down splay (Sleator & Tarjan) of the subtree rooted at subtree,
+* which must have no parent. Nodes passed on the way down are hung off
+* a left tree (keys below key) and a right tree (keys above), which are
+* reassembled under the final node. Returns the new subtree root.
+*/
+template<typename Key, typename Value, typename Compare>
+template<typename K>
+Node<Key, Value>* SplayTree<Key, Value, Compare>::splayFrom(Node<Key, Value>* subtree, const K& key)
+{
+    if(subtree == NULL)
+    {
+        return NULL;
+    }
+
+    Node<Key, Value>* t = subtree;
+    Node<Key, Value>* leftHead = NULL;
+    Node<Key, Value>* leftTail = NULL;
+    Node<Key, Value>* rightHead = NULL;
+    Node<Key, Value>* rightTail = NULL;
+
+    while(true)
+    {
+        int c = this->order(key, t->getKey());
+        if(c < 0)
+        {
+            Node<Key, Value>* y = t->getLeft();
+            if(y == NULL) break;
+            if(this->comp_(key, y->getKey()))
+            {
+                // zig-zig: rotate right before linking
+                t->setLeft(y->getRight());
+                if(y->getRight() != NULL) y->getRight()->setParent(t);
+                y->setRight(t);
+                t->setParent(y);
+                t = y;
+                if(t->getLeft() == NULL) break;
+            }
+            // link t into the right tree
+            if(rightTail == NULL) rightHead = t;
+            else rightTail->setLeft(t);
+            t->setParent(rightTail);
+            rightTail = t;
+            t = t->getLeft();
+        }
+        else if(c > 0)
+        {
+            Node<Key, Value>* y = t->getRight();
+            if(y == NULL) break;
+            if(this->comp_(y->getKey(), key))
+            {
+                // zag-zag: rotate left before linking
+                t->setRight(y->getLeft());
+                if(y->getLeft() != NULL) y->getLeft()->setParent(t);
+                y->setLeft(t);
+                t->setParent(y);
+                t = y;
+                if(t->getRight() == NULL) break;
+            }
+            // link t into the left tree
+            if(leftTail == NULL) leftHead = t;
+            else leftTail->setRight(t);
+            t->setParent(leftTail);
+            leftTail = t;
+            t = t->getRight();
+        }
+        else
+        {
+            break;
+        }
+    }
+
+    // reassemble: t's subtrees become the inner edges of the side trees
+    if(leftTail != NULL)
+    {
+        leftTail->setRight(t->getLeft());
+        if(t->getLeft() != NULL) t->getLeft()->setParent(leftTail);
+        t->setLeft(leftHead);
+        leftHead->setParent(t);
+    }
+    if(rightTail != NULL)
+    {
+        rightTail->setLeft(t->getRight());
+        if(t->getRight() != NULL) t->getRight()->setParent(rightTail);
+        t->setRight(rightHead);
+        rightHead->setParent(t);
+    }
+    t->setParent(NULL);
+    return t;
+}
+
+/**
+* Bottom-up semi-splay of node. A zig-zig step rotates the parent over
+* the grandparent and continues from the parent; zig-zag and zig steps
+* are the same as in a full splay.
+*/
+template<typename Key, typename Value, typename Compare>
+void SplayTree<Key, Value, Compare>::semiSplay(Node<Key, Value>* node)
+{
+    while(node != NULL && node->getParent() != NULL)
+    {
+        Node<Key, Value>* parent = node->getParent();
+        Node<Key, Value>* grand = parent->getParent();
+        if(grand == NULL)
+        {
+            rotateUp(node);
+            return;
+        }
+        bool nodeLeft = (parent->getLeft() == node);
+        bool parentLeft = (grand->getLeft() == parent);
+        if(nodeLeft == parentLeft)
+        {
+            rotateUp(parent);
+            node = parent;
+        }
+        else
+        {
+            rotateUp(node);
+            rotateUp(node);
+        }
+    }
+}
+
+/**
+* Rotates node above its parent, keeping parent pointers and root_ right.
+*/
+template<typename Key, typename Value, typename Compare>
+void SplayTree<Key, Value, Compare>::rotateUp(Node<Key, Value>* node)
+{
+    Node<Key, Value>* parent = node->getParent();
+    Node<Key, Value>* grand = parent->getParent();
+    if(parent->getLeft() == node)
+    {
+        parent->setLeft(node->getRight());
+        if(node->getRight() != NULL) node->getRight()->setParent(parent);
+        node->setRight(parent);
+    }
+    else
+    {
+        parent->setRight(node->getLeft());
+        if(node->getLeft() != NULL) node->getLeft()->setParent(parent);
+        node->setLeft(parent);
+    }
+    parent->setParent(node);
+    node->setParent(grand);
+    if(grand == NULL)
+    {
+        this->root_ = node;
+    }
+    else if(grand->getLeft() == parent)
+    {
+        grand->setLeft(node);
+    }
+    else
+    {
+        grand->setRight(node);
+    }
+}
+
+#endif
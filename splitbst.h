@@ -0,0 +1,491 @@
+#ifndef SPLITBST_H
+#define SPLITBST_H
+
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+#include "bst.h"
+#include "avlbst.h"
+
+/**
+* Out-of-line storage for the values of a SplitAVLTree: fixed-size
+* chunks of slots addressed by a 32-bit index. Values never move, so
+* references to them stay valid until they are released, and released
+* slots are reused before the pool grows.
+*/
+template <typename Value>
+class ValuePool
+{
+public:
+    typedef uint32_t Index;
+    static const unsigned CHUNK_BITS = 10;
+    static const Index CHUNK_SLOTS = (Index)1 << CHUNK_BITS;
+
+    ValuePool();
+    ValuePool(const ValuePool<Value>& other);
+    ValuePool(ValuePool<Value>&& other);
+    ~ValuePool();
+    ValuePool<Value>& operator=(const ValuePool<Value>& other);
+    void swap(ValuePool<Value>& other);
+
+    Index allocate(const Value& value);
+    void release(Index index);
+    void clear();
+    Value& operator[](Index index) const;
+
+    size_t size() const;
+    // Bytes reserved for values, used or free.
+    size_t capacityBytes() const;
+
+private:
+    Value* slot(Index index) const;
+
+    std::vector<Value*> chunks_;
+    std::vector<bool> live_;
+    std::vector<Index> free_;
+    size_t size_;
+};
+
+template<typename Value>
+ValuePool<Value>::ValuePool()
+    : size_(0)
+{
+
+}
+
+/**
+* Copies every live value into the same slot, so indices held by a
+* copy of the owning tree stay correct.
+*/
+template<typename Value>
+ValuePool<Value>::ValuePool(const ValuePool<Value>& other)
+    : live_(other.live_), free_(other.free_), size_(0)
+{
+    std::allocator<Value> alloc;
+    chunks_.reserve(other.chunks_.size());
+    try
+    {
+        // release may then push any slot without growing free_
+        free_.reserve(live_.size());
+        for(size_t c = 0; c < other.chunks_.size(); ++c)
+        {
+            chunks_.push_back(alloc.allocate(CHUNK_SLOTS));
+        }
+        for(Index i = 0; i < (Index)live_.size(); ++i)
+        {
+            if(live_[i])
+            {
+                new (slot(i)) Value(other[i]);
+                ++size_;
+            }
+        }
+    }
+    catch(...)
+    {
+        for(Index i = 0; size_ > 0; ++i)
+        {
+            if(live_[i])
+            {
+                slot(i)->~Value();
+                --size_;
+            }
+        }
+        for(size_t c = 0; c < chunks_.size(); ++c)
+        {
+            alloc.deallocate(chunks_[c], CHUNK_SLOTS);
+        }
+        throw;
+    }
+}
+
+template<typename Value>
+ValuePool<Value>::ValuePool(ValuePool<Value>&& other)
+    : size_(0)
+{
+    swap(other);
+}
+
+template<typename Value>
+ValuePool<Value>::~ValuePool()
+{
+    clear();
+    std::allocator<Value> alloc;
+    for(size_t c = 0; c < chunks_.size(); ++c)
+    {
+        alloc.deallocate(chunks_[c], CHUNK_SLOTS);
+    }
+}
+
+template<typename Value>
+ValuePool<Value>& ValuePool<Value>::operator=(const ValuePool<Value>& other)
+{
+    if(this != &other)
+    {
+        ValuePool<Value> copy(other);
+        swap(copy);
+    }
+    return *this;
+}
+
+template<typename Value>
+void ValuePool<Value>::swap(ValuePool<Value>& other)
+{
+    chunks_.swap(other.chunks_);
+    live_.swap(other.live_);
+    free_.swap(other.free_);
+    std::swap(size_, other.size_);
+}
+
+/**
+* Copies value into a free slot and returns its index. Room in every
+* vector is made before the value is constructed, so nothing after that
+* can throw and leak it; free_ is kept as large as live_, so release
+* never has to grow it.
+*/
+template<typename Value>
+typename ValuePool<Value>::Index ValuePool<Value>::allocate(const Value& value)
+{
+    Index index;
+    if(!free_.empty())
+    {
+        index = free_.back();
+        new (slot(index)) Value(value);
+        free_.pop_back();
+    }
+    else
+    {
+        if(live_.size() >= UINT32_MAX)
+        {
+            throw std::length_error("ValuePool: more than 2^32 - 1 values");
+        }
+        index = (Index)live_.size();
+        if(live_.size() == live_.capacity())
+        {
+            live_.reserve(2 * live_.size() + 1);
+        }
+        if(free_.capacity() <= live_.size())
+        {
+            free_.reserve(2 * live_.size() + 1);
+        }
+        if((index >> CHUNK_BITS) == chunks_.size())
+        {
+            if(chunks_.size() == chunks_.capacity())
+            {
+                chunks_.reserve(2 * chunks_.size() + 1);
+            }
+            chunks_.push_back(std::allocator<Value>().allocate(CHUNK_SLOTS));
+        }
+        new (slot(index)) Value(value);
+        live_.push_back(false);
+    }
+    live_[index] = true;
+    ++size_;
+    return index;
+}
+
+template<typename Value>
+void ValuePool<Value>::release(Index index)
+{
+    slot(index)->~Value();
+    live_[index] = false;
+    free_.push_back(index);
+    --size_;
+}
+
+/**
+* Destroys every value, keeping the chunks for reuse.
+*/
+template<typename Value>
+void ValuePool<Value>::clear()
+{
+    for(Index i = 0; i < (Index)live_.size(); ++i)
+    {
+        if(live_[i])
+        {
+            slot(i)->~Value();
+        }
+    }
+    live_.clear();
+    free_.clear();
+    size_ = 0;
+}
+
+template<typename Value>
+Value& ValuePool<Value>::operator[](Index index) const
+{
+    return *slot(index);
+}
+
+template<typename Value>
+size_t ValuePool<Value>::size() const
+{
+    return size_;
+}
+
+template<typename Value>
+size_t ValuePool<Value>::capacityBytes() const
+{
+    return chunks_.size() * CHUNK_SLOTS * sizeof(Value);
+}
+
+template<typename Value>
+Value* ValuePool<Value>::slot(Index index) const
+{
+    return chunks_[index >> CHUNK_BITS] + (index & (CHUNK_SLOTS - 1));
+}
+
+/**
+* An AVL tree that keeps its values out of its nodes. Each node holds a
+* key, its links and a 32-bit index into a ValuePool, so a node is as
+* small as the key allows whatever the value type, and a descent reads
+* no value bytes: a lookup touches the pool once, on a hit, when the
+* value is read through the iterator.
+*
+* The interface follows BinarySearchTree, except that iterators yield a
+* proxy: *it is a reference with members first (the key) and second
+* (the value), and it->first and it->second work as usual, but there
+* is no std::pair to take the address of. Values stay where they are
+* until removed, so references to them survive other inserts and
+* removes.
+*/
+template <typename Key, typename Value, typename Compare = std::less<Key> >
+class SplitAVLTree
+{
+public:
+    typedef ValuePool<Value> Pool;
+    typedef AVLTree<Key, typename Pool::Index, Compare> KeyTree;
+
+    /**
+    * What an iterator points at: the key and a reference to the value.
+    */
+    struct reference
+    {
+        const Key& first;
+        Value& second;
+    };
+
+    /**
+    * An iterator over the tree in key order.
+    */
+    class iterator
+    {
+    public:
+        // Lets it->second reach the value through a temporary reference.
+        struct arrow
+        {
+            reference ref;
+            const reference* operator->() const { return &ref; }
+        };
+
+        iterator();
+
+        reference operator*() const;
+        arrow operator->() const;
+
+        bool operator==(const iterator& rhs) const;
+        bool operator!=(const iterator& rhs) const;
+
+        iterator& operator++();
+
+    protected:
+        friend class SplitAVLTree<Key, Value, Compare>;
+        iterator(typename KeyTree::iterator it, const Pool* pool);
+        typename KeyTree::iterator it_;
+        const Pool* pool_;
+    };
+
+    SplitAVLTree();
+
+    void insert(const std::pair<const Key, Value>& keyValuePair);
+    void remove(const Key& key);
+    void clear();
+    bool isBalanced() const;
+    // The key nodes' profile, with the value pool counted in
+    // allocatedBytes.
+    TreeProfile profile() const;
+    bool empty() const;
+    size_t size() const;
+
+    iterator begin() const;
+    iterator end() const;
+    iterator find(const Key& key) const;
+    Value& operator[](const Key& key);
+    Value const & operator[](const Key& key) const;
+
+private:
+    KeyTree keys_;
+    Pool values_;
+};
+
+template<typename Key, typename Value, typename Compare>
+SplitAVLTree<Key, Value, Compare>::iterator::iterator()
+    : pool_(NULL)
+{
+
+}
+
+template<typename Key, typename Value, typename Compare>
+SplitAVLTree<Key, Value, Compare>::iterator::iterator(typename KeyTree::iterator it, const Pool* pool)
+    : it_(it), pool_(pool)
+{
+
+}
+
+template<typename Key, typename Value, typename Compare>
+typename SplitAVLTree<Key, Value, Compare>::reference
+SplitAVLTree<Key, Value, Compare>::iterator::operator*() const
+{
+    reference ref = { it_->first, (*pool_)[it_->second] };
+    return ref;
+}
+
+template<typename Key, typename Value, typename Compare>
+typename SplitAVLTree<Key, Value, Compare>::iterator::arrow
+SplitAVLTree<Key, Value, Compare>::iterator::operator->() const
+{
+    arrow a = { **this };
+    return a;
+}
+
+template<typename Key, typename Value, typename Compare>
+bool SplitAVLTree<Key, Value, Compare>::iterator::operator==(const iterator& rhs) const
+{
+    return it_ == rhs.it_;
+}
+
+template<typename Key, typename Value, typename Compare>
+bool SplitAVLTree<Key, Value, Compare>::iterator::operator!=(const iterator& rhs) const
+{
+    return it_ != rhs.it_;
+}
+
+template<typename Key, typename Value, typename Compare>
+typename SplitAVLTree<Key, Value, Compare>::iterator&
+SplitAVLTree<Key, Value, Compare>::iterator::operator++()
+{
+    ++it_;
+    return *this;
+}
+
+template<typename Key, typename Value, typename Compare>
+SplitAVLTree<Key, Value, Compare>::SplitAVLTree()
+{
+
+}
+
+/**
+* Inserts the item, or overwrites the value in place if the key is
+* already present.
+*/
+template<typename Key, typename Value, typename Compare>
+void SplitAVLTree<Key, Value, Compare>::insert(const std::pair<const Key, Value>& keyValuePair)
+{
+    typename KeyTree::iterator it = keys_.find(keyValuePair.first);
+    if(it != keys_.end())
+    {
+        values_[it->second] = keyValuePair.second;
+        return;
+    }
+    typename Pool::Index index = values_.allocate(keyValuePair.second);
+    try
+    {
+        keys_.insert(std::make_pair(keyValuePair.first, index));
+    }
+    catch(...)
+    {
+        values_.release(index);
+        throw;
+    }
+}
+
+template<typename Key, typename Value, typename Compare>
+void SplitAVLTree<Key, Value, Compare>::remove(const Key& key)
+{
+    typename KeyTree::iterator it = keys_.find(key);
+    if(it == keys_.end())
+    {
+        return;
+    }
+    typename Pool::Index index = it->second;
+    keys_.erase(it);
+    values_.release(index);
+}
+
+template<typename Key, typename Value, typename Compare>
+void SplitAVLTree<Key, Value, Compare>::clear()
+{
+    keys_.clear();
+    values_.clear();
+}
+
+template<typename Key, typename Value, typename Compare>
+bool SplitAVLTree<Key, Value, Compare>::isBalanced() const
+{
+    return keys_.isBalanced();
+}
+
+template<typename Key, typename Value, typename Compare>
+TreeProfile SplitAVLTree<Key, Value, Compare>::profile() const
+{
+    TreeProfile profile = keys_.profile();
+    profile.allocatedBytes += values_.capacityBytes();
+    return profile;
+}
+
+template<typename Key, typename Value, typename Compare>
+bool SplitAVLTree<Key, Value, Compare>::empty() const
+{
+    return keys_.empty();
+}
+
+template<typename Key, typename Value, typename Compare>
+size_t SplitAVLTree<Key, Value, Compare>::size() const
+{
+    return keys_.size();
+}
+
+template<typename Key, typename Value, typename Compare>
+typename SplitAVLTree<Key, Value, Compare>::iterator SplitAVLTree<Key, Value, Compare>::begin() const
+{
+    return iterator(keys_.begin(), &values_);
+}
+
+template<typename Key, typename Value, typename Compare>
+typename SplitAVLTree<Key, Value, Compare>::iterator SplitAVLTree<Key, Value, Compare>::end() const
+{
+    return iterator(keys_.end(), &values_);
+}
+
+template<typename Key, typename Value, typename Compare>
+typename SplitAVLTree<Key, Value, Compare>::iterator
+SplitAVLTree<Key, Value, Compare>::find(const Key& key) const
+{
+    return iterator(keys_.find(key), &values_);
+}
+
+template<typename Key, typename Value, typename Compare>
+Value& SplitAVLTree<Key, Value, Compare>::operator[](const Key& key)
+{
+    typename KeyTree::iterator it = keys_.find(key);
+    if(it == keys_.end())
+    {
+        throw std::out_of_range("Invalid key");
+    }
+    return values_[it->second];
+}
+
+template<typename Key, typename Value, typename Compare>
+Value const & SplitAVLTree<Key, Value, Compare>::operator[](const Key& key) const
+{
+    typename KeyTree::iterator it = keys_.find(key);
+    if(it == keys_.end())
+    {
+        throw std::out_of_range("Invalid key");
+    }
+    return values_[it->second];
+}
+
+#endif
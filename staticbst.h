@@ -0,0 +1,254 @@
+#ifndef STATICBST_H
+#define STATICBST_H
+
+#include <array>
+#include <cstddef>
+#include <stdexcept>
+#include <utility>
+
+/**
+* The number of levels of a complete binary tree with n nodes.
+*/
+constexpr size_t staticTreeDepth(size_t n)
+{
+    size_t depth = 0;
+    for(; n > 0; n /= 2)
+    {
+        ++depth;
+    }
+    return depth;
+}
+
+/**
+* A search tree over a key set fixed at compile time. The constructor
+* is constexpr: it sorts the items and lays them out in breadth-first
+* (Eytzinger) order, where the children of slot i are slots 2i + 1 and
+* 2i + 2, so a constexpr table is built entirely by the compiler and
+* lives in read-only data with no heap use and no startup cost.
+*
+* find descends one level per template instantiation, so the search is
+* unrolled to exactly DEPTH comparisons with no loop. Iteration visits
+* the items in key order like BinarySearchTree's iterator.
+*
+* Key and Value must be literal types with default constructors, and
+* keys must be distinct; a duplicate key in a constexpr table is a
+* compile error.
+*/
+template <typename Key, typename Value, size_t N>
+class StaticSearchTree
+{
+    static_assert(N > 0, "StaticSearchTree needs at least one item");
+
+public:
+    /**
+    * An item; first and second as in std::pair, which is not constexpr
+    * assignable before C++20.
+    */
+    struct Item
+    {
+        Key first;
+        Value second;
+    };
+
+    /**
+    * Walks the slots in key order.
+    */
+    class iterator
+    {
+    public:
+        constexpr iterator(const StaticSearchTree* tree, size_t slot) : tree_(tree), slot_(slot) { }
+        constexpr const Item& operator*() const { return tree_->items_[slot_]; }
+        constexpr const Item* operator->() const { return &tree_->items_[slot_]; }
+        constexpr bool operator==(const iterator& rhs) const { return slot_ == rhs.slot_; }
+        constexpr bool operator!=(const iterator& rhs) const { return slot_ != rhs.slot_; }
+        constexpr iterator& operator++()
+        {
+            slot_ = successor(slot_);
+            return *this;
+        }
+
+    private:
+        const StaticSearchTree* tree_;
+        size_t slot_;
+    };
+
+    // The number of levels, and so of comparisons in a failed find.
+    static constexpr size_t DEPTH = staticTreeDepth(N);
+
+    constexpr explicit StaticSearchTree(const std::pair<Key, Value> (&items)[N]);
+    constexpr explicit StaticSearchTree(const std::array<std::pair<Key, Value>, N>& items);
+
+    constexpr iterator begin() const;
+    constexpr iterator end() const;
+    constexpr iterator find(const Key& key) const;
+    constexpr const Value& operator[](const Key& key) const;
+    constexpr size_t size() const { return N; }
+    constexpr bool empty() const { return false; }
+
+private:
+    template <typename Source>
+    constexpr void build(const Source& items);
+    constexpr size_t layout(const Item* sorted, size_t next, size_t slot);
+    template <size_t Level>
+    constexpr size_t search(const Key& key, size_t slot) const;
+    static constexpr size_t leftmost(size_t slot);
+    static constexpr size_t successor(size_t slot);
+
+    Item items_[N];
+};
+
+template<typename Key, typename Value, size_t N>
+constexpr StaticSearchTree<Key, Value, N>::StaticSearchTree(const std::pair<Key, Value> (&items)[N])
+    : items_()
+{
+    build(items);
+}
+
+template<typename Key, typename Value, size_t N>
+constexpr StaticSearchTree<Key, Value, N>::StaticSearchTree(const std::array<std::pair<Key, Value>, N>& items)
+    : items_()
+{
+    build(items);
+}
+
+/**
+* Insertion-sorts a copy of the items, which is cheap for the table
+* sizes compile-time evaluation is meant for, then places them.
+*/
+template<typename Key, typename Value, size_t N>
+template<typename Source>
+constexpr void StaticSearchTree<Key, Value, N>::build(const Source& items)
+{
+    Item sorted[N] = {};
+    for(size_t i = 0; i < N; ++i)
+    {
+        Item item = { items[i].first, items[i].second };
+        size_t j = i;
+        for(; j > 0 && item.first < sorted[j - 1].first; --j)
+        {
+            sorted[j] = sorted[j - 1];
+        }
+        if(j > 0 && !(sorted[j - 1].first < item.first))
+        {
+            throw std::invalid_argument("StaticSearchTree: duplicate key");
+        }
+        sorted[j] = item;
+    }
+    layout(sorted, 0, 0);
+}
+
+/**
+* Fills the subtree at slot in order from sorted[next...] and returns
+* the index of the next unplaced item.
+*/
+template<typename Key, typename Value, size_t N>
+constexpr size_t StaticSearchTree<Key, Value, N>::layout(const Item* sorted, size_t next, size_t slot)
+{
+    if(slot >= N)
+    {
+        return next;
+    }
+    next = layout(sorted, next, 2 * slot + 1);
+    items_[slot] = sorted[next++];
+    return layout(sorted, next, 2 * slot + 2);
+}
+
+template<typename Key, typename Value, size_t N>
+constexpr typename StaticSearchTree<Key, Value, N>::iterator StaticSearchTree<Key, Value, N>::begin() const
+{
+    return iterator(this, leftmost(0));
+}
+
+template<typename Key, typename Value, size_t N>
+constexpr typename StaticSearchTree<Key, Value, N>::iterator StaticSearchTree<Key, Value, N>::end() const
+{
+    return iterator(this, N);
+}
+
+template<typename Key, typename Value, size_t N>
+constexpr typename StaticSearchTree<Key, Value, N>::iterator
+StaticSearchTree<Key, Value, N>::find(const Key& key) const
+{
+    return iterator(this, search<0>(key, 0));
+}
+
+template<typename Key, typename Value, size_t N>
+constexpr const Value& StaticSearchTree<Key, Value, N>::operator[](const Key& key) const
+{
+    size_t slot = search<0>(key, 0);
+    if(slot == N)
+    {
+        throw std::out_of_range("Invalid key");
+    }
+    return items_[slot].second;
+}
+
+/**
+* One level of the descent; returns the slot holding key, or N.
+*/
+template<typename Key, typename Value, size_t N>
+template<size_t Level>
+constexpr size_t StaticSearchTree<Key, Value, N>::search(const Key& key, size_t slot) const
+{
+    if constexpr(Level == DEPTH)
+    {
+        return N;
+    }
+    else
+    {
+        if(slot >= N)
+        {
+            return N;
+        }
+        if(key < items_[slot].first)
+        {
+            return search<Level + 1>(key, 2 * slot + 1);
+        }
+        if(items_[slot].first < key)
+        {
+            return search<Level + 1>(key, 2 * slot + 2);
+        }
+        return slot;
+    }
+}
+
+template<typename Key, typename Value, size_t N>
+constexpr size_t StaticSearchTree<Key, Value, N>::leftmost(size_t slot)
+{
+    while(2 * slot + 1 < N)
+    {
+        slot = 2 * slot + 1;
+    }
+    return slot;
+}
+
+/**
+* The in-order successor by index arithmetic: the leftmost slot of the
+* right subtree, or else the parent of the first ancestor reached from
+* a left child (odd slots are left children).
+*/
+template<typename Key, typename Value, size_t N>
+constexpr size_t StaticSearchTree<Key, Value, N>::successor(size_t slot)
+{
+    if(2 * slot + 2 < N)
+    {
+        return leftmost(2 * slot + 2);
+    }
+    while(slot > 0 && slot % 2 == 0)
+    {
+        slot = (slot - 1) / 2;
+    }
+    return slot == 0 ? N : (slot - 1) / 2;
+}
+
+/**
+* Builds a StaticSearchTree from a braced list, deducing its size:
+* constexpr auto table = makeStaticTree<int, int>({ { 1, 10 }, { 2, 20 } });
+*/
+template <typename Key, typename Value, size_t N>
+constexpr StaticSearchTree<Key, Value, N> makeStaticTree(const std::pair<Key, Value> (&items)[N])
+{
+    return StaticSearchTree<Key, Value, N>(items);
+}
+
+#endif
@@ -0,0 +1,611 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <istream>
+#include <mutex>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+/*
+ * Binary operation traces.
+ *
+ * A trace starts with the 8-byte magic "BSTTRC01" and continues with
+ * blocks, each written by one recording thread:
+ *
+ *     varint thread    varint length    length bytes of records
+ *
+ * A record is an op byte, the key as a zigzag varint delta from the
+ * previous key of the same thread, and for inserts the value (zigzag
+ * varint) or for scans the step count (varint). A clear has key 0.
+ * Varints are LEB128.
+ * Keys and values are 64-bit integers. Records keep their order within
+ * a thread; the interleaving between threads is not recorded.
+ */
+
+enum TraceOp
+{
+    TRACE_INSERT,
+    TRACE_REMOVE,
+    TRACE_FIND,
+    TRACE_SCAN,
+    TRACE_CLEAR,
+    TRACE_NUM_OPS
+};
+
+inline const char* traceOpName(TraceOp op)
+{
+    static const char* const names[TRACE_NUM_OPS] = { "insert", "remove", "find", "scan", "clear" };
+    return names[op];
+}
+
+/**
+* One operation. arg is the value of an insert or the number of
+* iterator steps of a scan, which starts at key; otherwise 0.
+*/
+struct TraceRecord
+{
+    TraceOp op;
+    int64_t key;
+    int64_t arg;
+};
+
+// One record sequence per recording thread.
+typedef std::vector<std::vector<TraceRecord> > TraceStreams;
+
+static const char TRACE_MAGIC[8] = { 'B', 'S', 'T', 'T', 'R', 'C', '0', '1' };
+
+inline void tracePutVarint(std::string& out, uint64_t v)
+{
+    while(v >= 0x80)
+    {
+        out.push_back((char)(v | 0x80));
+        v >>= 7;
+    }
+    out.push_back((char)v);
+}
+
+/**
+* Decodes a varint from [p, end) and advances p; throws on truncation.
+*/
+inline uint64_t traceGetVarint(const char*& p, const char* end)
+{
+    uint64_t v = 0;
+    for(unsigned shift = 0; shift < 64; shift += 7)
+    {
+        if(p == end)
+        {
+            throw std::runtime_error("trace: truncated varint");
+        }
+        uint8_t byte = (uint8_t)*p++;
+        v |= (uint64_t)(byte & 0x7f) << shift;
+        if((byte & 0x80) == 0)
+        {
+            return v;
+        }
+    }
+    throw std::runtime_error("trace: varint too long");
+}
+
+inline uint64_t traceZigzag(int64_t v)
+{
+    return ((uint64_t)v << 1) ^ (uint64_t)(v >> 63);
+}
+
+inline int64_t traceUnzigzag(uint64_t v)
+{
+    return (int64_t)(v >> 1) ^ -(int64_t)(v & 1);
+}
+
+/**
+* Appends the encoding of rec to out; prevKey carries the delta base.
+*/
+inline void traceEncode(std::string& out, int64_t& prevKey, const TraceRecord& rec)
+{
+    out.push_back((char)rec.op);
+    tracePutVarint(out, traceZigzag((int64_t)((uint64_t)rec.key - (uint64_t)prevKey)));
+    prevKey = rec.key;
+    if(rec.op == TRACE_INSERT)
+    {
+        tracePutVarint(out, traceZigzag(rec.arg));
+    }
+    else if(rec.op == TRACE_SCAN)
+    {
+        tracePutVarint(out, (uint64_t)rec.arg);
+    }
+}
+
+/**
+* Decodes every record in [p, end) onto out.
+*/
+inline void traceDecode(const char* p, const char* end, int64_t& prevKey, std::vector<TraceRecord>& out)
+{
+    while(p != end)
+    {
+        TraceRecord rec;
+        uint8_t op = (uint8_t)*p++;
+        if(op >= TRACE_NUM_OPS)
+        {
+            throw std::runtime_error("trace: unknown operation");
+        }
+        rec.op = (TraceOp)op;
+        rec.key = (int64_t)((uint64_t)prevKey + (uint64_t)traceUnzigzag(traceGetVarint(p, end)));
+        prevKey = rec.key;
+        rec.arg = 0;
+        if(rec.op == TRACE_INSERT)
+        {
+            rec.arg = traceUnzigzag(traceGetVarint(p, end));
+        }
+        else if(rec.op == TRACE_SCAN)
+        {
+            rec.arg = (int64_t)traceGetVarint(p, end);
+        }
+        out.push_back(rec);
+    }
+}
+
+/**
+* Writes a trace to a stream. Any number of threads may record at once:
+* each claims its own slot the first time it records, encodes into the
+* slot's buffer, and takes the stream lock only to write out a full
+* block. Consecutive iterator steps are merged into one scan record.
+* Past MAX_THREADS threads, late arrivals share the last slot under its
+* lock and their records are merged into one stream.
+*/
+class TraceWriter
+{
+public:
+    static const unsigned MAX_THREADS = 64;
+    static const size_t BLOCK_BYTES = 64 * 1024;
+
+    explicit TraceWriter(std::ostream& os);
+    ~TraceWriter();
+
+    void record(TraceOp op, int64_t key, int64_t arg = 0);
+    // Notes one iterator step from key; next is the key stepped to,
+    // meaningful only if atEnd is false.
+    void recordStep(int64_t key, int64_t next, bool atEnd);
+    // Writes out everything buffered. No thread may be recording.
+    void flush();
+
+private:
+    struct Slot
+    {
+        Slot() : prevKey(0), scanning(false), scanKey(0), scanSteps(0), scanNext(0) { }
+
+        std::mutex lock;
+        std::string buffer;
+        int64_t prevKey;
+        bool scanning;
+        int64_t scanKey;
+        int64_t scanSteps;
+        int64_t scanNext;
+    };
+
+    TraceWriter(const TraceWriter&);
+    TraceWriter& operator=(const TraceWriter&);
+
+    Slot& local(unsigned& index);
+    void append(Slot& slot, unsigned index, const TraceRecord& rec);
+    void endScan(Slot& slot, unsigned index);
+    void writeBlock(Slot& slot, unsigned index);
+
+    std::ostream* os_;
+    std::mutex streamLock_;
+    uint64_t id_;
+    std::atomic<unsigned> used_;
+    Slot slots_[MAX_THREADS];
+};
+
+inline TraceWriter::TraceWriter(std::ostream& os)
+    : os_(&os), used_(0)
+{
+    static std::atomic<uint64_t> nextId(1);
+    id_ = nextId.fetch_add(1);
+    os_->write(TRACE_MAGIC, sizeof(TRACE_MAGIC));
+}
+
+inline TraceWriter::~TraceWriter()
+{
+    flush();
+}
+
+/**
+* Returns the calling thread's slot, remembered per thread for the last
+* few writers it used.
+*/
+inline TraceWriter::Slot& TraceWriter::local(unsigned& index)
+{
+    static const unsigned CACHE_SIZE = 4;
+    static thread_local std::pair<uint64_t, unsigned> cache[CACHE_SIZE];
+    static thread_local unsigned nextVictim = 0;
+
+    for(unsigned i = 0; i < CACHE_SIZE; ++i)
+    {
+        if(cache[i].first == id_)
+        {
+            index = cache[i].second;
+            return slots_[index];
+        }
+    }
+    index = std::min(used_.fetch_add(1), MAX_THREADS - 1);
+    cache[nextVictim] = std::make_pair(id_, index);
+    nextVictim = (nextVictim + 1) % CACHE_SIZE;
+    return slots_[index];
+}
+
+inline void TraceWriter::record(TraceOp op, int64_t key, int64_t arg)
+{
+    unsigned index;
+    Slot& slot = local(index);
+    std::lock_guard<std::mutex> guard(slot.lock);
+    endScan(slot, index);
+    TraceRecord rec = { op, key, arg };
+    append(slot, index, rec);
+}
+
+/**
+* A step that continues where the thread's last step ended extends the
+* open scan; any other step starts a new one.
+*/
+inline void TraceWriter::recordStep(int64_t key, int64_t next, bool atEnd)
+{
+    unsigned index;
+    Slot& slot = local(index);
+    std::lock_guard<std::mutex> guard(slot.lock);
+    if(!slot.scanning || slot.scanNext != key)
+    {
+        endScan(slot, index);
+        slot.scanning = true;
+        slot.scanKey = key;
+        slot.scanSteps = 0;
+    }
+    ++slot.scanSteps;
+    slot.scanNext = next;
+    if(atEnd)
+    {
+        endScan(slot, index);
+    }
+}
+
+inline void TraceWriter::flush()
+{
+    for(unsigned i = 0; i < MAX_THREADS; ++i)
+    {
+        std::lock_guard<std::mutex> guard(slots_[i].lock);
+        endScan(slots_[i], i);
+        writeBlock(slots_[i], i);
+    }
+    std::lock_guard<std::mutex> guard(streamLock_);
+    os_->flush();
+}
+
+inline void TraceWriter::append(Slot& slot, unsigned index, const TraceRecord& rec)
+{
+    traceEncode(slot.buffer, slot.prevKey, rec);
+    if(slot.buffer.size() >= BLOCK_BYTES)
+    {
+        writeBlock(slot, index);
+    }
+}
+
+inline void TraceWriter::endScan(Slot& slot, unsigned index)
+{
+    if(slot.scanning)
+    {
+        slot.scanning = false;
+        TraceRecord rec = { TRACE_SCAN, slot.scanKey, slot.scanSteps };
+        append(slot, index, rec);
+    }
+}
+
+inline void TraceWriter::writeBlock(Slot& slot, unsigned index)
+{
+    if(slot.buffer.empty())
+    {
+        return;
+    }
+    std::string header;
+    tracePutVarint(header, index);
+    tracePutVarint(header, slot.buffer.size());
+    std::lock_guard<std::mutex> guard(streamLock_);
+    os_->write(header.data(), header.size());
+    os_->write(slot.buffer.data(), slot.buffer.size());
+    slot.buffer.clear();
+}
+
+/**
+* Returns the number of bytes between the read position of is and its
+* end, or UINT64_MAX if is cannot seek.
+*/
+inline uint64_t traceBytesLeft(std::istream& is)
+{
+    std::istream::pos_type here = is.tellg();
+    if(here == std::istream::pos_type(-1))
+    {
+        return UINT64_MAX;
+    }
+    is.seekg(0, std::ios::end);
+    std::istream::pos_type end = is.tellg();
+    is.seekg(here);
+    if(end == std::istream::pos_type(-1) || !is)
+    {
+        is.clear();
+        is.seekg(here);
+        return UINT64_MAX;
+    }
+    return (uint64_t)(end - here);
+}
+
+/**
+* Reads a whole trace into one record vector per recording thread.
+* Throws std::runtime_error if the stream is not a well-formed trace,
+* including when a block claims more bytes than the stream has left;
+* such a length is never allocated.
+*/
+inline void readTrace(std::istream& is, TraceStreams& streams)
+{
+    char magic[sizeof(TRACE_MAGIC)];
+    if(!is.read(magic, sizeof(magic)) || std::memcmp(magic, TRACE_MAGIC, sizeof(magic)) != 0)
+    {
+        throw std::runtime_error("trace: bad magic");
+    }
+    uint64_t left = traceBytesLeft(is);
+    std::vector<int64_t> prevKeys;
+    std::string header;
+    std::string block;
+    while(is.peek() != std::char_traits<char>::eof())
+    {
+        // the two header varints are at most 20 bytes
+        header.clear();
+        for(int varints = 0; varints < 2; )
+        {
+            int c = is.get();
+            if(c == std::char_traits<char>::eof())
+            {
+                throw std::runtime_error("trace: truncated block header");
+            }
+            header.push_back((char)c);
+            if((c & 0x80) == 0)
+            {
+                ++varints;
+            }
+            else if(header.size() >= 20)
+            {
+                throw std::runtime_error("trace: block header too long");
+            }
+        }
+        const char* p = header.data();
+        uint64_t thread = traceGetVarint(p, header.data() + header.size());
+        uint64_t length = traceGetVarint(p, header.data() + header.size());
+        if(thread >= TraceWriter::MAX_THREADS)
+        {
+            throw std::runtime_error("trace: bad thread number");
+        }
+        if(left != UINT64_MAX)
+        {
+            left -= header.size();
+            if(length > left)
+            {
+                throw std::runtime_error("trace: truncated block");
+            }
+            left -= length;
+        }
+        // A stream that cannot seek is read a block-sized chunk at a
+        // time, so a bad length fails at the end of the data instead of
+        // in one huge allocation.
+        block.clear();
+        while(block.size() < length)
+        {
+            size_t at = block.size();
+            size_t chunk = (length - at < TraceWriter::BLOCK_BYTES) ? (size_t)(length - at) : TraceWriter::BLOCK_BYTES;
+            block.resize(at + chunk);
+            if(!is.read(&block[at], chunk))
+            {
+                throw std::runtime_error("trace: truncated block");
+            }
+        }
+        if(streams.size() <= thread)
+        {
+            streams.resize(thread + 1);
+            prevKeys.resize(thread + 1, 0);
+        }
+        traceDecode(block.data(), block.data() + block.size(), prevKeys[thread], streams[thread]);
+    }
+}
+
+/**
+* Applies one record to tree and returns a value derived from the
+* result, so that replay loops cannot be optimized away. A scan finds
+* its start key and then steps up to arg times.
+*/
+template <typename Key, typename Value, class Tree>
+int64_t applyTraceRecord(Tree& tree, const TraceRecord& rec)
+{
+    switch(rec.op)
+    {
+    case TRACE_INSERT:
+        tree.insert(std::make_pair((Key)rec.key, (Value)rec.arg));
+        return 0;
+    case TRACE_REMOVE:
+        tree.remove((Key)rec.key);
+        return 0;
+    case TRACE_FIND:
+        return tree.find((Key)rec.key) != tree.end();
+    case TRACE_SCAN:
+    {
+        int64_t sum = 0;
+        typename Tree::iterator it = tree.find((Key)rec.key);
+        for(int64_t i = 0; i < rec.arg && it != tree.end(); ++i, ++it)
+        {
+            sum += (int64_t)it->second;
+        }
+        return sum;
+    }
+    case TRACE_CLEAR:
+        tree.clear();
+        return 0;
+    default:
+        return 0;
+    }
+}
+
+/**
+* A recording layer over any of the tree containers, in the manner of
+* LatencyTree: inserts, hinted or not, are recorded in the tree's
+* insertNear, removes in its remove, erases in its eraseRange (as one
+* remove per item) and clears in clear, while find, operator[] and
+* iterator increments are recorded through the wrappers below. Key and
+* Value must convert to and from int64_t.
+*/
+template <typename Key, typename Value, class Tree>
+class RecordingTree : public Tree
+{
+public:
+    /**
+    * An iterator that records each increment as a scan step.
+    */
+    class iterator : public Tree::iterator
+    {
+    public:
+        iterator();
+        iterator(const typename Tree::iterator& it, const RecordingTree* tree);
+        iterator& operator++();
+
+    private:
+        const RecordingTree* tree_;
+    };
+
+    explicit RecordingTree(TraceWriter& writer);
+
+    virtual void remove(const Key& key);
+    virtual void clear();
+
+    iterator begin() const;
+    iterator end() const;
+    iterator find(const Key& key) const;
+    Value& operator[](const Key& key);
+
+    TraceWriter& writer() const;
+
+protected:
+    virtual Node<Key, Value>* insertNear(Node<Key, Value>* finger, const std::pair<const Key, Value>& keyValuePair);
+    virtual void eraseRange(Node<Key, Value>* first, Node<Key, Value>* last);
+
+private:
+    TraceWriter* writer_;
+};
+
+template <typename Key, typename Value, class Tree>
+RecordingTree<Key, Value, Tree>::iterator::iterator()
+    : Tree::iterator(), tree_(NULL)
+{
+
+}
+
+template <typename Key, typename Value, class Tree>
+RecordingTree<Key, Value, Tree>::iterator::iterator(const typename Tree::iterator& it, const RecordingTree* tree)
+    : Tree::iterator(it), tree_(tree)
+{
+
+}
+
+template <typename Key, typename Value, class Tree>
+typename RecordingTree<Key, Value, Tree>::iterator&
+RecordingTree<Key, Value, Tree>::iterator::operator++()
+{
+    int64_t from = (int64_t)(*this)->first;
+    Tree::iterator::operator++();
+    bool atEnd = *this == tree_->Tree::end();
+    tree_->writer_->recordStep(from, atEnd ? 0 : (int64_t)(*this)->first, atEnd);
+    return *this;
+}
+
+template <typename Key, typename Value, class Tree>
+RecordingTree<Key, Value, Tree>::RecordingTree(TraceWriter& writer)
+    : Tree(), writer_(&writer)
+{
+
+}
+
+template <typename Key, typename Value, class Tree>
+Node<Key, Value>* RecordingTree<Key, Value, Tree>::insertNear(Node<Key, Value>* finger,
+                                                        const std::pair<const Key, Value>& keyValuePair)
+{
+    writer_->record(TRACE_INSERT, (int64_t)keyValuePair.first, (int64_t)keyValuePair.second);
+    return Tree::insertNear(finger, keyValuePair);
+}
+
+template <typename Key, typename Value, class Tree>
+void RecordingTree<Key, Value, Tree>::remove(const Key& key)
+{
+    writer_->record(TRACE_REMOVE, (int64_t)key);
+    Tree::remove(key);
+}
+
+/**
+* Records a remove for each live item in the range, which replays to
+* the same tree as the erase did.
+*/
+template <typename Key, typename Value, class Tree>
+void RecordingTree<Key, Value, Tree>::eraseRange(Node<Key, Value>* first, Node<Key, Value>* last)
+{
+    for(Node<Key, Value>* node = first; node != last; node = this->successor(node))
+    {
+        if(!node->isDead())
+        {
+            writer_->record(TRACE_REMOVE, (int64_t)node->getKey());
+        }
+    }
+    Tree::eraseRange(first, last);
+}
+
+template <typename Key, typename Value, class Tree>
+void RecordingTree<Key, Value, Tree>::clear()
+{
+    writer_->record(TRACE_CLEAR, 0);
+    Tree::clear();
+}
+
+template <typename Key, typename Value, class Tree>
+typename RecordingTree<Key, Value, Tree>::iterator
+RecordingTree<Key, Value, Tree>::begin() const
+{
+    return iterator(Tree::begin(), this);
+}
+
+template <typename Key, typename Value, class Tree>
+typename RecordingTree<Key, Value, Tree>::iterator
+RecordingTree<Key, Value, Tree>::end() const
+{
+    return iterator(Tree::end(), this);
+}
+
+template <typename Key, typename Value, class Tree>
+typename RecordingTree<Key, Value, Tree>::iterator
+RecordingTree<Key, Value, Tree>::find(const Key& key) const
+{
+    writer_->record(TRACE_FIND, (int64_t)key);
+    return iterator(Tree::find(key), this);
+}
+
+template <typename Key, typename Value, class Tree>
+Value& RecordingTree<Key, Value, Tree>::operator[](const Key& key)
+{
+    writer_->record(TRACE_FIND, (int64_t)key);
+    return Tree::operator[](key);
+}
+
+template <typename Key, typename Value, class Tree>
+TraceWriter& RecordingTree<Key, Value, Tree>::writer() const
+{
+    return *writer_;
+}
+
+#endif
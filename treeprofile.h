@@ -0,0 +1,167 @@
+#ifndef TREEPROFILE_H
+#define TREEPROFILE_H
+
+#include <iostream>
+#include <iomanip>
+#include <cstddef>
+#include <cmath>
+#include <vector>
+#if defined(__GLIBC__)
+#include <malloc.h>
+#endif
+
+/**
+* The shape and memory layout of a search tree, as measured by
+* BinarySearchTree::profile in one pass over its nodes.
+*
+* Levels count from 0 at the root; a search for a key on level d
+* visits d + 1 nodes. The optimum is a complete tree of the same size.
+*/
+struct TreeProfile
+{
+    static const size_t CACHE_LINE = 64;
+    static const size_t PAGE = 4096;
+
+    TreeProfile()
+        : nodes(0), deadNodes(0), height(0), optimalHeight(0), averagePath(0), optimalAveragePath(0),
+          balanceViolations(0), nodeBytes(0), allocatedBytes(0), arenaNodes(0), indexBytes(0), links(0), lineCrossings(0),
+          pageCrossings(0)
+    {
+    }
+
+    // Linked nodes, tombstones included, and how many are tombstones.
+    size_t nodes;
+    size_t deadNodes;
+    // levelCounts[d] is the number of nodes on level d.
+    std::vector<size_t> levelCounts;
+    size_t height;
+    size_t optimalHeight;
+    // Mean nodes visited by a successful search, actual and optimal.
+    double averagePath;
+    double optimalAveragePath;
+    // balanceCounts[b + 1] counts AVL balance factors b of -1, 0 and +1;
+    // empty for trees that keep no balance factor. Nodes whose balance
+    // lies outside that range, which only a relaxed tree with pending
+    // rebalancing can have, are counted in balanceViolations.
+    std::vector<size_t> balanceCounts;
+    size_t balanceViolations;
+    // The node object's size, and the heap memory the nodes take
+    // including allocator headers and rounding. Nodes from a structural
+    // copy share arenas and carry no per-node overhead.
+    size_t nodeBytes;
+    size_t allocatedBytes;
+    size_t arenaNodes;
+    size_t indexBytes;
+    // Parent-to-child links, and how many of them join nodes on
+    // different cache lines and on different pages.
+    size_t links;
+    size_t lineCrossings;
+    size_t pageCrossings;
+
+    void writeText(std::ostream& os) const;
+};
+
+/**
+* The heap memory behind a block of size bytes allocated with new at
+* p, counting the allocator's header and rounding.
+*/
+inline size_t heapBlockBytes(void* p, size_t size)
+{
+#if defined(__GLIBC__)
+    (void)size;
+    return malloc_usable_size(p) + sizeof(size_t);
+#else
+    (void)p;
+    return (size + sizeof(size_t) + 15) / 16 * 16;
+#endif
+}
+
+/**
+* Fills in height, optimalHeight, averagePath and optimalAveragePath
+* from nodes and levelCounts.
+*/
+inline void finishTreeProfile(TreeProfile& profile)
+{
+    profile.height = profile.levelCounts.size();
+    double pathSum = 0;
+    for(size_t d = 0; d < profile.levelCounts.size(); ++d)
+    {
+        pathSum += (double)(d + 1) * profile.levelCounts[d];
+    }
+    double optimalSum = 0;
+    size_t left = profile.nodes;
+    size_t level = 0;
+    for(size_t width = 1; left > 0; width *= 2)
+    {
+        size_t placed = left < width ? left : width;
+        optimalSum += (double)(++level) * placed;
+        left -= placed;
+    }
+    profile.optimalHeight = level;
+    profile.averagePath = profile.nodes == 0 ? 0 : pathSum / profile.nodes;
+    profile.optimalAveragePath = profile.nodes == 0 ? 0 : optimalSum / profile.nodes;
+}
+
+/**
+* Writes a human-readable report.
+*/
+inline void TreeProfile::writeText(std::ostream& os) const
+{
+    std::ios::fmtflags flags = os.flags();
+    std::streamsize precision = os.precision();
+    os << std::fixed << std::setprecision(2);
+    os << "nodes " << nodes << " (" << deadNodes << " dead), height " << height
+       << ", optimal " << optimalHeight << "\n";
+    os << "search path: average " << averagePath << " nodes, optimal " << optimalAveragePath;
+    if(optimalAveragePath > 0)
+    {
+        os << " (+" << 100.0 * (averagePath - optimalAveragePath) / optimalAveragePath << "%)";
+    }
+    os << "\n";
+    os << "levels:\n";
+    const size_t shown = 64;
+    for(size_t d = 0; d < levelCounts.size() && d < shown; ++d)
+    {
+        os << std::setw(6) << d << std::setw(12) << levelCounts[d] << std::setw(9)
+           << 100.0 * levelCounts[d] / std::ldexp(1.0, (int)d) << "% full\n";
+    }
+    if(levelCounts.size() > shown)
+    {
+        size_t rest = 0;
+        for(size_t d = shown; d < levelCounts.size(); ++d)
+        {
+            rest += levelCounts[d];
+        }
+        os << "  ... " << levelCounts.size() - shown << " more levels holding " << rest << " nodes\n";
+    }
+    if(!balanceCounts.empty() && nodes > 0)
+    {
+        os << "balance:";
+        for(size_t b = 0; b < balanceCounts.size(); ++b)
+        {
+            int factor = (int)b - 1;
+            os << "  " << (factor > 0 ? "+" : "") << factor << ": " << balanceCounts[b]
+               << " (" << 100.0 * balanceCounts[b] / nodes << "%)";
+        }
+        if(balanceViolations > 0)
+        {
+            os << "  other: " << balanceViolations << " (" << 100.0 * balanceViolations / nodes << "%)";
+        }
+        os << "\n";
+    }
+    if(nodes > 0)
+    {
+        os << "memory: " << (double)allocatedBytes / nodes << " B/node allocated for a "
+           << nodeBytes << " B node (" << arenaNodes << " in arenas), hash index "
+           << indexBytes << " B\n";
+    }
+    if(links > 0)
+    {
+        os << "locality: " << 100.0 * lineCrossings / links << "% of " << links
+           << " links cross a cache line, " << 100.0 * pageCrossings / links << "% cross a page\n";
+    }
+    os.flags(flags);
+    os.precision(precision);
+}
+
+#endif